@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <thread>
+
+#include "AllocationGroups.hpp"
+
+void AllocationGroups::build(const unsigned char * bitmap, const int32_t clusterCount, const int32_t groupClusters) {
+
+    this->clusterCount = clusterCount;
+    this->groupClusters = groupClusters;
+
+    int32_t count = std::max((clusterCount + groupClusters - 1) / groupClusters, 1);
+    groups.clear();
+    for (int32_t i = 0; i < count; i++) {
+        groups.push_back(std::unique_ptr<struct allocation_group>(new allocation_group()));
+        groups.back()->cursor = groupStart(i);
+    }
+
+    // every group scans only its part of bitmap
+    std::vector<std::thread> threads;
+    for (int32_t i = 0; i < count; i++) {
+        threads.push_back(std::thread([this, bitmap, i]() {
+            groups[i]->freeExtents.build(bitmap, groupStart(i), std::min(groupStart(i + 1), this->clusterCount));
+        }));
+    }
+
+    int32_t free = 0;
+    for (int32_t i = 0; i < count; i++) {
+        threads[i].join();
+        free += groups[i]->freeExtents.getFreeClusters();
+    }
+    freeClusters.store(free);
+}
+
+void AllocationGroups::allocate(const int32_t cluster) {
+
+    struct allocation_group * group = groups[groupOf(cluster)].get();
+    std::lock_guard<std::mutex> lock(group->mutex);
+    if (group->freeExtents.allocate(cluster)) {
+        freeClusters--;
+    }
+}
+
+void AllocationGroups::release(const int32_t cluster) {
+
+    struct allocation_group * group = groups[groupOf(cluster)].get();
+    std::lock_guard<std::mutex> lock(group->mutex);
+    if (group->freeExtents.release(cluster)) {
+        freeClusters++;
+    }
+}
+
+void AllocationGroups::release(const int32_t start, const int32_t count) {
+
+    // run can cross border of groups
+    for (int32_t first = start, end = start + count; first < end; ) {
+        int32_t last = std::min(end, groupStart(groupOf(first) + 1));
+        struct allocation_group * group = groups[groupOf(first)].get();
+        std::lock_guard<std::mutex> lock(group->mutex);
+        group->freeExtents.release(first, last - first);
+        freeClusters += last - first;
+        first = last;
+    }
+}
+
+int32_t AllocationGroups::reserve(const int32_t group, const int32_t count, const std::function<int32_t(const FreeExtentIndex &, int32_t *)> & find, int32_t * start) {
+
+    struct allocation_group * reserved = groups[group].get();
+    std::lock_guard<std::mutex> lock(reserved->mutex);
+
+    int32_t found = find(reserved->freeExtents, start);
+    if (found >= count) {
+        reserved->freeExtents.allocate(*start, count);
+        reserved->cursor = *start + count;
+        freeClusters -= count;
+    }
+    return found;
+}
+
+int32_t AllocationGroups::reserveRuns(const int32_t group, const int32_t from, const int32_t count, std::vector<struct reserved_run> * runs) {
+
+    struct allocation_group * reserved = groups[group].get();
+    std::lock_guard<std::mutex> lock(reserved->mutex);
+
+    // run is taken before the next one is searched, so map changes only behind iterator
+    int32_t taken = 0;
+    while (taken < count && reserved->freeExtents.getFreeClusters() > 0) {
+        const std::map<int32_t, int32_t> & extents = reserved->freeExtents.getExtents();
+        std::map<int32_t, int32_t>::const_iterator extent = extents.lower_bound(from);
+        if (extent == extents.end()) {
+            extent = extents.begin();
+        }
+
+        struct reserved_run run = {extent->first, std::min(count - taken, extent->second)};
+        reserved->freeExtents.allocate(run.start, run.count);
+        runs->push_back(run);
+        taken += run.count;
+        reserved->cursor = run.start + run.count;
+    }
+
+    freeClusters -= taken;
+    return taken;
+}
+
+bool AllocationGroups::reserveContiguous(const int32_t count, const int32_t from, int32_t * start) {
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (const std::unique_ptr<struct allocation_group> & group : groups) {
+        locks.push_back(std::unique_lock<std::mutex>(group->mutex));
+    }
+
+    // runs are walked in order of clusters, the first one behind from wins over the first one of volume
+    bool found = false, wrapped = false;
+    int32_t runStart = 0, runCount = 0, wrappedStart = 0;
+    for (size_t i = 0; i < groups.size() && !found; i++) {
+        const std::map<int32_t, int32_t> & extents = groups[i]->freeExtents.getExtents();
+        for (std::map<int32_t, int32_t>::const_iterator extent = extents.begin(); extent != extents.end() && !found; extent++) {
+            if (runStart + runCount == extent->first) {
+                runCount += extent->second;
+            }
+            else {
+                runStart = extent->first;
+                runCount = extent->second;
+            }
+            if (runStart + runCount - std::max(runStart, from) >= count) {
+                *start = std::max(runStart, from);
+                found = true;
+            }
+            else if (!wrapped && runCount >= count) {
+                wrappedStart = runStart;
+                wrapped = true;
+            }
+        }
+    }
+
+    if (!found && !wrapped) {
+        return false;
+    }
+    if (!found) {
+        *start = wrappedStart;
+    }
+
+    // every group takes its part of run
+    for (int32_t first = *start, end = *start + count; first < end; ) {
+        int32_t last = std::min(end, groupStart(groupOf(first) + 1));
+        struct allocation_group * group = groups[groupOf(first)].get();
+        group->freeExtents.allocate(first, last - first);
+        group->cursor = last;
+        first = last;
+    }
+    freeClusters -= count;
+    return true;
+}
+
+bool AllocationGroups::reserveAt(const int32_t cluster) {
+
+    struct allocation_group * group = groups[groupOf(cluster)].get();
+    std::lock_guard<std::mutex> lock(group->mutex);
+    if (!group->freeExtents.allocate(cluster)) {
+        return false;
+    }
+    freeClusters--;
+    return true;
+}
+
+int32_t AllocationGroups::findLargest(int32_t * start) {
+
+    int32_t largest = 0;
+    for (const std::unique_ptr<struct allocation_group> & group : groups) {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        int32_t groupStart = 0;
+        int32_t count = group->freeExtents.findLargest(&groupStart);
+        if (count > largest) {
+            largest = count;
+            *start = groupStart;
+        }
+    }
+    return largest;
+}
+
+void AllocationGroups::histogram(std::vector<int32_t> * histogram) {
+
+    histogram->clear();
+    for (const std::unique_ptr<struct allocation_group> & group : groups) {
+        std::vector<int32_t> groupHistogram;
+        {
+            std::lock_guard<std::mutex> lock(group->mutex);
+            group->freeExtents.histogram(&groupHistogram);
+        }
+        if (groupHistogram.size() > histogram->size()) {
+            histogram->resize(groupHistogram.size(), 0);
+        }
+        for (size_t k = 0; k < groupHistogram.size(); k++) {
+            (*histogram)[k] += groupHistogram[k];
+        }
+    }
+}
+
+void AllocationGroups::groupFreeClusters(std::vector<int32_t> * counts) {
+
+    counts->clear();
+    for (const std::unique_ptr<struct allocation_group> & group : groups) {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        counts->push_back(group->freeExtents.getFreeClusters());
+    }
+}
+
+int32_t AllocationGroups::getExtentsCount() {
+
+    int32_t count = 0;
+    for (const std::unique_ptr<struct allocation_group> & group : groups) {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        count += group->freeExtents.getExtents().size();
+    }
+    return count;
+}
+
+int32_t AllocationGroups::getCursor(const int32_t group) {
+
+    std::lock_guard<std::mutex> lock(groups[group]->mutex);
+    return groups[group]->cursor;
+}
+
+bool AllocationGroups::beginPrepared() {
+
+    std::lock_guard<std::mutex> lock(preparedMutex);
+    if (frozen > 0) {
+        return false;
+    }
+    prepared++;
+    return true;
+}
+
+void AllocationGroups::endPrepared() {
+
+    std::lock_guard<std::mutex> lock(preparedMutex);
+    prepared--;
+    preparedDone.notify_all();
+}
+
+void AllocationGroups::freeze() {
+
+    std::unique_lock<std::mutex> lock(preparedMutex);
+    frozen++;
+    preparedDone.wait(lock, [this]() {return prepared == 0;});
+}
+
+void AllocationGroups::thaw() {
+
+    std::lock_guard<std::mutex> lock(preparedMutex);
+    frozen--;
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#ifndef _ALLOCATION_GROUPS_HPP_
+#define _ALLOCATION_GROUPS_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FreeExtentIndex.hpp"
+
+    // run of data clusters taken from allocation group, it is not in bitmap yet
+    struct reserved_run {
+        int32_t start;
+        int32_t count;
+    };
+
+    /* data clusters split to groups of same size, every group has its part of bitmap, its own runs of free clusters and its own lock
+     * allocations in different groups do not wait for each other
+     * cluster reserved by search is no longer in runs of its group, it is free in bitmap until it is written
+    */
+    class AllocationGroups {
+
+        private:
+
+            struct allocation_group {
+                FreeExtentIndex freeExtents;
+                // cluster behind the last reserved run
+                int32_t cursor;
+                std::mutex mutex;
+            };
+
+            std::vector<std::unique_ptr<struct allocation_group>> groups;
+            int32_t groupClusters;
+            int32_t clusterCount;
+            std::atomic<int32_t> freeClusters;
+
+            // files with clusters reserved out of volume lock, operations changing bitmap as whole wait for them
+            std::mutex preparedMutex;
+            std::condition_variable preparedDone;
+            int32_t prepared;
+            int32_t frozen;
+
+        public:
+
+            AllocationGroups() : groupClusters(8), clusterCount(0), freeClusters(0), prepared(0), frozen(0) {};
+
+            /* build runs of all groups from bitmap, groups are built in parallel
+             * +param - bitmap - bitmap of data clusters, set bit is used cluster
+             * +param - clusterCount - count of data clusters
+             * +param - groupClusters - count of data clusters in group, multiple of 8
+            */
+            void build(const unsigned char * bitmap, const int32_t clusterCount, const int32_t groupClusters);
+            /* remove free cluster from runs of its group
+             * +param - cluster - index of data cluster
+            */
+            void allocate(const int32_t cluster);
+            /* add free cluster to runs of its group
+             * +param - cluster - index of data cluster
+            */
+            void release(const int32_t cluster);
+            /* add reserved clusters back to runs of their groups
+             * +param - start - index of first data cluster
+             * +param - count - count of data clusters
+            */
+            void release(const int32_t start, const int32_t count);
+            /* find run in group and reserve its first clusters, search and reservation are done under lock of group
+             * +param - group - index of group
+             * +param - count - count of demanded clusters
+             * +param - find - search in runs of group, it returns count of clusters of found run and its start
+             * +param - start - first reserved cluster
+             * +return count of clusters of found run, clusters are reserved only if there are at least demanded ones
+            */
+            int32_t reserve(const int32_t group, const int32_t count, const std::function<int32_t(const FreeExtentIndex &, int32_t *)> & find, int32_t * start);
+            /* reserve free runs of group one after another from given cluster, search wraps around to start of group
+             * +param - group - index of group
+             * +param - from - data cluster where search starts
+             * +param - count - count of demanded clusters
+             * +param - runs - reserved runs are appended
+             * +return count of reserved clusters
+            */
+            int32_t reserveRuns(const int32_t group, const int32_t from, const int32_t count, std::vector<struct reserved_run> * runs);
+            /* find run of free clusters and reserve its clusters, run of group ending at its border goes on in the next group
+             * all groups are locked in order of their indexes while run is searched and reserved
+             * +param - count - count of demanded clusters
+             * +param - from - data cluster where search starts, search wraps around to start of volume
+             * +param - start - first reserved cluster
+             * +return true - clusters are reserved, false - there is no run of count clusters
+            */
+            bool reserveContiguous(const int32_t count, const int32_t from, int32_t * start);
+            /* reserve given cluster
+             * +param - cluster - index of data cluster
+             * +return true - cluster was free and it is reserved
+            */
+            bool reserveAt(const int32_t cluster);
+            /* find the largest run of all groups
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is no free cluster
+            */
+            int32_t findLargest(int32_t * start);
+            /* count runs of all groups by their size
+             * +param - histogram - count of runs of class k at index k
+            */
+            void histogram(std::vector<int32_t> * histogram);
+            /* free clusters of every group
+             * +param - counts - count of free clusters of group at its index
+            */
+            void groupFreeClusters(std::vector<int32_t> * counts);
+            int32_t getExtentsCount();
+
+            /* start file with clusters reserved out of volume lock
+             * +return false - bitmap is frozen, file has to be saved under volume lock
+            */
+            bool beginPrepared();
+            /* clusters of prepared file are taken over by transaction
+            */
+            void endPrepared();
+            /* wait until no cluster is reserved out of volume lock and do not let new reservations start
+             * it must not be called under volume lock, prepared file waits for it with reserved clusters
+            */
+            void freeze();
+            void thaw();
+
+            // bitmap is frozen while it lives
+            class Freeze {
+                private:
+                    AllocationGroups * groups;
+                public:
+                    Freeze(AllocationGroups * groups) : groups(groups) {groups->freeze();};
+                    ~Freeze() {groups->thaw();};
+            };
+
+            int32_t groupOf(const int32_t cluster) const {return cluster / groupClusters;};
+            int32_t groupStart(const int32_t group) const {return group * groupClusters;};
+            int32_t getCount() const {return groups.size();};
+            int32_t getGroupClusters() const {return groupClusters;};
+            int32_t getFreeClusters() const {return freeClusters.load();};
+            /* +param - group - index of group
+             * +return cluster behind the last run reserved in group
+            */
+            int32_t getCursor(const int32_t group);
+    };
+
+#endif
\ No newline at end of file
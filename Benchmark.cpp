@@ -0,0 +1,2264 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+#include "Benchmark.hpp"
+#include "Crc32c.hpp"
+#include "PseudoNTFS.hpp"
+#include "SlotScan.hpp"
+#include "Utils.hpp"
+
+const char BENCHMARK_VOLUME[] = "benchmark.ntfs";
+const char BENCHMARK_FILE[] = "benchmark.txt";
+const char BENCHMARK_IMAGE[] = "benchmark.img";
+const char BENCHMARK_RESTORED_VOLUME[] = "restored.ntfs";
+const int32_t BENCHMARK_CLUSTER_SIZE = 128;
+// volumes of hundreds of MB filled with files of 1 MB
+const int32_t BENCHMARK_LARGE_CLUSTER_SIZE = 4096;
+const int32_t BENCHMARK_LARGE_FILE_SIZE = 1024 * 1024;
+
+/* create directories in given directory
+ * +param - pntfs - volume
+ * +param - parentMftItemIndex - index of mft item of parent directory
+ * +param - count - count of created directories
+*/
+static void makeDirectories(PseudoNTFS * pntfs, const int32_t parentMftItemIndex, const int32_t count) {
+
+    char name[12];
+    for (int32_t i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->makeDirectory(parentMftItemIndex, name);
+    }
+}
+
+/* run journal workload on new volume
+ * +param - groupCommit - true - group commit, false - flush after every operation
+ * +param - operations - count of created directories
+ * +param - threads - count of threads creating directories
+*/
+static void runJournalWorkload(const bool groupCommit, const int32_t operations, const int32_t threads) {
+
+    // mft table takes 10% of disk
+    int32_t diskSize = (operations + threads + 16) * sizeof(mft_item) * 11;
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_CLUSTER_SIZE, "bench", BENCHMARK_VOLUME);
+    pntfs->getJournal()->setGroupCommit(groupCommit);
+
+    // every thread works in its own directory
+    std::vector<int32_t> directories;
+    char name[12];
+    for (int32_t i = 0; i < threads; i++) {
+        snprintf(name, sizeof(name), "t%d", i);
+        pntfs->makeDirectory(0, name);
+        directories.push_back(pntfs->contains(0, name, true));
+    }
+
+    int64_t commits = pntfs->getJournal()->getCommitCount();
+    int64_t flushes = pntfs->getJournal()->getFlushCount();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < threads; i++) {
+        workers.push_back(std::thread(makeDirectories, pntfs, directories[i], operations / threads));
+    }
+    for (int32_t i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    commits = pntfs->getJournal()->getCommitCount() - commits;
+    flushes = pntfs->getJournal()->getFlushCount() - flushes;
+
+    std::cout << (groupCommit ? "GROUP COMMIT: " : "FLUSH PER OPERATION: ");
+    std::cout << commits << " commits, " << flushes << " flushes, ";
+    std::cout << seconds << " s, " << (int64_t) (commits / seconds) << " ops/s" << std::endl;
+
+    delete pntfs;
+    remove(BENCHMARK_VOLUME);
+}
+
+void benchmarkJournal(const int32_t operations, const int32_t threads) {
+
+    if (operations <= 0 || threads <= 0) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    runJournalWorkload(false, operations, threads);
+    runJournalWorkload(true, operations, threads);
+}
+
+/* write text file similar to imported documents - words from small vocabulary
+ * +param - size - size of file in bytes
+ * +param - seed - seed of generated words
+ * +param - path - path to file
+*/
+static void writeTextFile(const int32_t size, const int32_t seed, const char * path) {
+
+    const char * words[] = {"the", "file", "system", "cluster", "data", "of", "and", "directory", "mft", "item",
+                            "is", "to", "in", "record", "volume", "a", "journal", "bitmap", "free", "space"};
+    const int32_t wordsCount = sizeof(words) / sizeof(words[0]);
+
+    std::string text;
+    srand(seed);
+    while ((int32_t) text.length() < size) {
+        text += words[rand() % wordsCount];
+        text += (rand() % 12 == 0) ? '\n' : ' ';
+    }
+    text.resize(size);
+
+    std::ofstream file(path);
+    file << text;
+}
+
+/* save and load file repeatedly on new volume
+ * +param - compression - true - file is saved compressed
+ * +param - size - size of file in bytes
+ * +param - rounds - count of file writes and reads
+*/
+static void runCompressionWorkload(const bool compression, const int32_t size, const int32_t rounds) {
+
+    // every round saves new file, mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS((size + BENCHMARK_CLUSTER_SIZE) * rounds * 1.5 + 100000, BENCHMARK_CLUSTER_SIZE, "bench");
+    pntfs->setCompression(compression);
+
+    double writeSeconds = 0, readSeconds = 0;
+    int32_t clusters = 0;
+    std::string content;
+    bool valid = true;
+    char name[12];
+
+    for (int32_t i = 0; i < rounds; i++) {
+
+        snprintf(name, sizeof(name), "f%d", i);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pntfs->saveFileToPseudoNtfs(name, BENCHMARK_FILE, 0);
+        writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int32_t mftItemIndex = pntfs->contains(0, name, false);
+        if (mftItemIndex == NOT_FOUND) {
+            std::cout << "BENCHMARK FAILED";
+            break;
+        }
+
+        start = std::chrono::steady_clock::now();
+        pntfs->loadFileFromPseudoNtfs(mftItemIndex, &content);
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        valid &= (int32_t) content.length() == size;
+        clusters = pntfs->getUsedClusters(mftItemIndex);
+    }
+
+    double megabytes = (double) size * rounds / (1024 * 1024);
+
+    std::cout << (compression ? "COMPRESSED: " : "UNCOMPRESSED: ");
+    std::cout << clusters << " clusters, ratio " << (double) size / (clusters * BENCHMARK_CLUSTER_SIZE) << ", ";
+    std::cout << "write " << megabytes / writeSeconds << " MB/s, read " << megabytes / readSeconds << " MB/s";
+    std::cout << (valid ? "" : ", CONTENT DIFFERS") << std::endl;
+
+    delete pntfs;
+}
+
+void benchmarkCompression(const int32_t size, const int32_t rounds) {
+
+    if (size <= 0 || rounds <= 0) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    writeTextFile(size * 1024, 1, BENCHMARK_FILE);
+    runCompressionWorkload(false, size * 1024, rounds);
+    runCompressionWorkload(true, size * 1024, rounds);
+    remove(BENCHMARK_FILE);
+}
+
+/* save files with repeating contents on new volume
+ * +param - deduplication - true - deduplication is on
+ * +param - files - count of saved files
+ * +param - distinct - count of distinct contents of files
+*/
+static void runDeduplicationWorkload(const bool deduplication, const int32_t files, const int32_t distinct) {
+
+    const int32_t fileSize = 8 * 1024;
+
+    // mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS((fileSize + BENCHMARK_CLUSTER_SIZE) * files * 1.5 + (files + 16) * sizeof(mft_item) * 11, BENCHMARK_CLUSTER_SIZE, "bench");
+    pntfs->setDeduplication(deduplication);
+
+    char name[12], path[32];
+    double seconds = 0;
+
+    for (int32_t i = 0; i < files; i++) {
+
+        snprintf(name, sizeof(name), "f%d", i);
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i % distinct);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pntfs->saveFileToPseudoNtfs(name, path, 0);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << (deduplication ? "DEDUPLICATION: " : "NO DEDUPLICATION: ");
+    std::cout << seconds * 1000 << " ms, " << seconds * 1000000 / files << " us per file, ";
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+    pntfs->printDeduplicationStatistics();
+    std::cout << std::endl;
+
+    delete pntfs;
+}
+
+void benchmarkDeduplication(const int32_t files, const int32_t distinct) {
+
+    if (files <= 0 || distinct <= 0) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    char path[32];
+    for (int32_t i = 0; i < distinct; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(8 * 1024, i + 1, path);
+    }
+
+    runDeduplicationWorkload(false, files, distinct);
+    runDeduplicationWorkload(true, files, distinct);
+
+    for (int32_t i = 0; i < distinct; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+}
+
+/* create and read small files on new volume
+ * +param - resident - true - files are stored in mft items
+ * +param - files - count of created files
+*/
+static void runResidentWorkload(const bool resident, const int32_t files) {
+
+    // directories are kept small, lookup in directory is linear
+    const int32_t filesPerDirectory = 50;
+    int32_t directories = (files + filesPerDirectory - 1) / filesPerDirectory;
+
+    // mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS((files + directories + 16) * (sizeof(mft_item) * 11 + BENCHMARK_CLUSTER_SIZE * 2), BENCHMARK_CLUSTER_SIZE, "bench");
+    pntfs->setResidentData(resident);
+
+    std::vector<int32_t> mftItemIndexes;
+    char name[12];
+    double createSeconds = 0, readSeconds = 0;
+    int32_t directory = 0;
+
+    for (int32_t i = 0; i < files; i++) {
+
+        if (i % filesPerDirectory == 0) {
+            snprintf(name, sizeof(name), "d%d", i / filesPerDirectory);
+            pntfs->makeDirectory(0, name);
+            directory = pntfs->contains(0, name, true);
+        }
+
+        snprintf(name, sizeof(name), "f%d", i);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pntfs->saveFileToPseudoNtfs(name, BENCHMARK_FILE, directory);
+        createSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        mftItemIndexes.push_back(pntfs->contains(directory, name, false));
+    }
+
+    std::string content;
+    int32_t clusters = 0;
+    for (int32_t mftItemIndex : mftItemIndexes) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pntfs->loadFileFromPseudoNtfs(mftItemIndex, &content);
+        readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        clusters += pntfs->getUsedClusters(mftItemIndex);
+    }
+
+    std::cout << (resident ? "RESIDENT: " : "DATA CLUSTERS: ");
+    std::cout << "create " << createSeconds * 1000000 / files << " us, read " << readSeconds * 1000000 / files << " us per file, ";
+    std::cout << clusters << " data clusters, ";
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    delete pntfs;
+}
+
+void benchmarkResident(const int32_t files, const int32_t size) {
+
+    if (files <= 0 || size <= 0 || size > MFT_RESIDENT_SIZE) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    writeTextFile(size, 1, BENCHMARK_FILE);
+    runResidentWorkload(false, files);
+    runResidentWorkload(true, files);
+    remove(BENCHMARK_FILE);
+}
+
+/* write file of clusters with distinct content
+ * +param - clusters - labels of clusters, each cluster repeats its label
+ * +param - path - path to file
+ * +param - content - content of file
+*/
+static void writeClustersFile(const std::vector<std::string> & clusters, const char * path, std::string * content) {
+
+    content->clear();
+    for (const std::string & label : clusters) {
+        std::string cluster;
+        while ((int32_t) cluster.length() < BENCHMARK_CLUSTER_SIZE) {
+            cluster += label;
+        }
+        cluster.resize(BENCHMARK_CLUSTER_SIZE);
+        *content += cluster;
+    }
+
+    std::ofstream file(path);
+    file << *content;
+}
+
+void benchmarkExtents(const int32_t extents) {
+
+    if (extents <= 0) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // data clusters for base file, interleaved file twice as big and less than one extent of free space behind them
+    // mft table takes 10% of disk, it needs item for every MFT_FRAGMENTS_COUNT extents
+    int32_t clusterCount = extents * 3 + extents / 2 + 2;
+    int32_t diskSize = std::max((clusterCount * (BENCHMARK_CLUSTER_SIZE + 0.125) + sizeof(boot_record)) / 0.8, (extents / 8.0 + 16) * sizeof(mft_item) * 11);
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_CLUSTER_SIZE, "bench");
+
+    std::vector<std::string> base, interleaved, fragmented;
+    char label[16];
+    for (int32_t i = 0; i < extents; i++) {
+        snprintf(label, sizeof(label), "a%07d ", i);
+        base.push_back(label);
+        interleaved.push_back(label);
+        snprintf(label, sizeof(label), "b%07d ", i);
+        interleaved.push_back(label);
+        snprintf(label, sizeof(label), "c%07d ", i);
+        fragmented.push_back(label);
+    }
+
+    // every other cluster of interleaved file is shared with base file, its own cluster stays free - volume is fragmented
+    std::string content, expected;
+    pntfs->setDeduplication(true);
+    writeClustersFile(base, BENCHMARK_FILE, &content);
+    pntfs->saveFileToPseudoNtfs("a", BENCHMARK_FILE, 0);
+    writeClustersFile(interleaved, BENCHMARK_FILE, &expected);
+    pntfs->saveFileToPseudoNtfs("b", BENCHMARK_FILE, 0);
+    pntfs->setDeduplication(false);
+
+    // free space is only in holes of one cluster
+    writeClustersFile(fragmented, BENCHMARK_FILE, &content);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pntfs->saveFileToPseudoNtfs("c", BENCHMARK_FILE, 0);
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    remove(BENCHMARK_FILE);
+
+    int32_t mftItemIndex = pntfs->contains(0, "c", false);
+    int32_t interleavedMftItemIndex = pntfs->contains(0, "b", false);
+    if (mftItemIndex == NOT_FOUND || interleavedMftItemIndex == NOT_FOUND) {
+        std::cout << "BENCHMARK FAILED";
+        delete pntfs;
+        return;
+    }
+
+    std::string loaded;
+    start = std::chrono::steady_clock::now();
+    pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+    double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool valid = loaded == content;
+    pntfs->loadFileFromPseudoNtfs(interleavedMftItemIndex, &loaded);
+    valid &= loaded == expected;
+
+    ExtentMap extentMap;
+    pntfs->loadExtentMap(mftItemIndex, &extentMap);
+    const std::vector<struct extent> & fileExtents = extentMap.getExtents();
+
+    // random offsets are located by binary search and by walk through fragments
+    const int32_t lookups = 100000;
+    std::vector<int32_t> offsets;
+    srand(1);
+    for (int32_t i = 0; i < lookups; i++) {
+        offsets.push_back(rand() % extentMap.getClusterCount());
+    }
+
+    int64_t binarySum = 0, linearSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int32_t offset : offsets) {
+        binarySum += extentMap.find(offset);
+    }
+    double binarySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t offset : offsets) {
+        for (const struct extent & extent : fileExtents) {
+            if (offset < extent.logical_start + extent.count) {
+                linearSum += extent.start + offset - extent.logical_start;
+                break;
+            }
+        }
+    }
+    double linearSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "EXTENTS: " << extentMap.getClusterCount() << " clusters in " << fileExtents.size() << " extents, ";
+    std::cout << "write " << writeSeconds * 1000 << " ms, read " << readSeconds * 1000 << " ms";
+    std::cout << (valid ? "" : ", CONTENT DIFFERS") << std::endl;
+    std::cout << "LOOKUP: binary search " << binarySeconds * 1000000000 / lookups << " ns, ";
+    std::cout << "linear walk " << linearSeconds * 1000000000 / lookups << " ns per offset";
+    std::cout << (binarySum == linearSum ? "" : ", LOOKUPS DIFFER") << std::endl;
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete pntfs;
+}
+
+/* import files to directory
+ * +param - pntfs - volume
+ * +param - directory - index of mft item of directory
+ * +param - sizes - count of host files with different sizes
+ * +param - count - count of imported files
+*/
+static void importFiles(PseudoNTFS * pntfs, const int32_t directory, const int32_t sizes, const int32_t count) {
+
+    char name[12], path[32];
+    for (int32_t i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, (directory + i) % sizes);
+        pntfs->saveFileToPseudoNtfs(name, path, directory);
+    }
+}
+
+/* import files concurrently on new volume
+ * +param - delayed - true - delayed allocation is on
+ * +param - files - count of imported files
+ * +param - threads - count of threads importing files
+ * +param - sizes - count of host files with different sizes
+*/
+static void runDelayedWorkload(const bool delayed, const int32_t files, const int32_t threads, const int32_t sizes) {
+
+    const int32_t maxFileSize = 4096;
+
+    // mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS((maxFileSize + BENCHMARK_CLUSTER_SIZE) * files * 1.5 + (files + threads + 16) * sizeof(mft_item) * 11, BENCHMARK_CLUSTER_SIZE, "bench");
+    if (delayed) {
+        pntfs->setDelayedAllocation(true, DELAYED_BUDGET);
+    }
+
+    std::vector<int32_t> directories;
+    char name[12];
+    for (int32_t i = 0; i < threads; i++) {
+        snprintf(name, sizeof(name), "t%d", i);
+        pntfs->makeDirectory(0, name);
+        directories.push_back(pntfs->contains(0, name, true));
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < threads; i++) {
+        workers.push_back(std::thread(importFiles, pntfs, directories[i], sizes, files / threads));
+    }
+    for (int32_t i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+    pntfs->sync();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // files of directory read in order of creation, file continuing where previous one ended is in the same extent
+    int32_t extents = 0, fileExtents = 0;
+    ExtentMap extentMap;
+    for (int32_t directory : directories) {
+        int32_t previousEnd = NOT_FOUND;
+        for (int32_t i = 0; i < files / threads; i++) {
+            snprintf(name, sizeof(name), "f%d", i);
+            pntfs->loadExtentMap(pntfs->contains(directory, name, false), &extentMap);
+            for (const struct extent & extent : extentMap.getExtents()) {
+                extents += extent.start != previousEnd;
+                previousEnd = extent.start + extent.count;
+            }
+            fileExtents += extentMap.getExtents().size();
+        }
+    }
+
+    int32_t imported = files / threads * threads;
+    std::cout << (delayed ? "DELAYED ALLOCATION: " : "IMMEDIATE ALLOCATION: ");
+    std::cout << seconds * 1000 << " ms, " << (int64_t) (imported / seconds) << " files/s, ";
+    std::cout << (double) imported / extents << " files per extent, " << (double) fileExtents / imported << " extents per file, ";
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+    if (delayed) {
+        pntfs->printDelayedStatistics();
+        std::cout << std::endl;
+    }
+
+    delete pntfs;
+}
+
+void benchmarkDelayed(const int32_t files, const int32_t threads) {
+
+    if (files <= 0 || threads <= 0 || files < threads) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // files bigger than resident data, smaller than 4 kB
+    const int32_t sizes = 8;
+    char path[32];
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(300 + i * 500, i + 1, path);
+    }
+
+    runDelayedWorkload(false, files, threads, sizes);
+    runDelayedWorkload(true, files, threads, sizes);
+
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+}
+
+void benchmarkPartial(const int32_t size, const int32_t operations) {
+
+    if (size <= 0 || operations <= 0) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t blockSize = 4096;
+    const int32_t wholeOperations = std::min(operations, 5);
+    int32_t fileSize = size * 1024;
+
+    // file, its appends and copies saved by whole file rewrites, mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS((fileSize + blockSize * operations) * (wholeOperations + 2) * 1.5 + 100000, BENCHMARK_CLUSTER_SIZE, "bench");
+
+    writeTextFile(fileSize, 1, BENCHMARK_FILE);
+    pntfs->saveFileToPseudoNtfs("f", BENCHMARK_FILE, 0);
+    int32_t mftItemIndex = pntfs->contains(0, "f", false);
+    if (mftItemIndex == NOT_FOUND) {
+        std::cout << "BENCHMARK FAILED";
+        remove(BENCHMARK_FILE);
+        delete pntfs;
+        return;
+    }
+
+    std::string expected, loaded;
+    pntfs->loadFileFromPseudoNtfs(mftItemIndex, &expected);
+
+    std::vector<int32_t> offsets;
+    srand(1);
+    for (int32_t i = 0; i < operations; i++) {
+        offsets.push_back(rand() % (fileSize - std::min(fileSize, blockSize) + 1));
+    }
+
+    // block read at offset against load of whole file
+    char * buffer = new char[blockSize];
+    bool valid = true;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int32_t offset : offsets) {
+        int32_t count = pntfs->readFileData(mftItemIndex, offset, buffer, blockSize);
+        valid &= count >= 0 && expected.compare(offset, count, buffer, count) == 0;
+    }
+    double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < wholeOperations; i++) {
+        pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+        valid &= loaded.compare(offsets[i], blockSize, expected, offsets[i], blockSize) == 0;
+    }
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // blocks of text from another part of file are written over file and behind its end
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < operations; i++) {
+        std::string block = expected.substr(offsets[operations - i - 1], blockSize);
+        pntfs->writeFileData(mftItemIndex, offsets[i], block.data(), block.length());
+        expected.replace(offsets[i], block.length(), block);
+    }
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t offset : offsets) {
+        std::string block = expected.substr(offset, blockSize);
+        pntfs->appendFileData(mftItemIndex, block.data(), block.length());
+        expected += block;
+    }
+    double appendSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // append without partial writes - whole file is loaded and saved again
+    char name[12];
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < wholeOperations; i++) {
+        pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+        loaded.append(buffer, blockSize);
+        std::ofstream file(BENCHMARK_FILE);
+        file << loaded;
+        file.close();
+        snprintf(name, sizeof(name), "r%d", i);
+        pntfs->saveFileToPseudoNtfs(name, BENCHMARK_FILE, 0);
+    }
+    double rewriteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    remove(BENCHMARK_FILE);
+
+    start = std::chrono::steady_clock::now();
+    pntfs->truncateFile(mftItemIndex, fileSize / 2);
+    double truncateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    expected.resize(fileSize / 2);
+
+    pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+    valid &= loaded == expected;
+
+    std::cout << "READ: " << blockSize << " B at offset " << readSeconds * 1000000 / operations << " us, ";
+    std::cout << "whole file " << loadSeconds * 1000000 / wholeOperations << " us" << std::endl;
+    std::cout << "WRITE: overwrite " << writeSeconds * 1000000 / operations << " us, append " << appendSeconds * 1000000 / operations << " us, ";
+    std::cout << "append by whole file save " << rewriteSeconds * 1000000 / wholeOperations << " us" << std::endl;
+    std::cout << "TRUNCATE: " << truncateSeconds * 1000000 << " us";
+    std::cout << (valid ? "" : ", CONTENT DIFFERS") << std::endl;
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete [] buffer;
+    delete pntfs;
+}
+
+void benchmarkSparse(const int32_t size) {
+
+    if (size <= 0 || size > 512) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t blockSize = 64 * 1024;
+    const int32_t readSize = 4096;
+    const int32_t reads = 1000;
+    int32_t fileSize = size * 1024 * 1024;
+
+    // every eighth block of image is written, other blocks are zeros
+    std::string image(fileSize, '\0');
+    for (int32_t i = 0; i < fileSize; i += 8 * blockSize) {
+        for (int32_t j = i; j < std::min(i + blockSize, fileSize); j++) {
+            image[j] = 'a' + (j / 7) % 26;
+        }
+    }
+    std::ofstream file(BENCHMARK_FILE, std::ios::binary);
+    file << image;
+    file.close();
+
+    // written blocks and the one written to hole, mft table takes 10% of disk
+    PseudoNTFS * pntfs = new PseudoNTFS(fileSize / 8 * 2 + 1000000, BENCHMARK_CLUSTER_SIZE, "bench");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pntfs->saveFileToPseudoNtfs("image", BENCHMARK_FILE, 0);
+    double importSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    remove(BENCHMARK_FILE);
+
+    int32_t mftItemIndex = pntfs->contains(0, "image", false);
+    if (mftItemIndex == NOT_FOUND) {
+        std::cout << "BENCHMARK FAILED";
+        delete pntfs;
+        return;
+    }
+    int32_t allocated = pntfs->getUsedClusters(mftItemIndex);
+    int32_t clusters = (fileSize + BENCHMARK_CLUSTER_SIZE - 1) / BENCHMARK_CLUSTER_SIZE;
+
+    std::string loaded;
+    start = std::chrono::steady_clock::now();
+    pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool valid = loaded == image;
+
+    // reads hit written blocks and holes
+    char * buffer = new char[readSize];
+    srand(1);
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < reads; i++) {
+        int32_t offset = rand() % (fileSize - readSize + 1);
+        int32_t count = pntfs->readFileData(mftItemIndex, offset, buffer, readSize);
+        valid &= count == readSize && image.compare(offset, count, buffer, count) == 0;
+    }
+    double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // block written in hole takes data clusters only for itself, growing file takes none
+    std::string block(readSize, 'z');
+    start = std::chrono::steady_clock::now();
+    pntfs->writeFileData(mftItemIndex, blockSize + blockSize / 2, block.data(), readSize);
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    image.replace(blockSize + blockSize / 2, readSize, block);
+
+    start = std::chrono::steady_clock::now();
+    pntfs->truncateFile(mftItemIndex, fileSize * 2);
+    double truncateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    image.resize(fileSize * 2, '\0');
+
+    pntfs->loadFileFromPseudoNtfs(mftItemIndex, &loaded);
+    valid &= loaded == image;
+
+    // exported file keeps holes on host
+    struct stat status;
+    bool exported = writeSparseFile(BENCHMARK_FILE, loaded, 4096) && stat(BENCHMARK_FILE, &status) == 0;
+    remove(BENCHMARK_FILE);
+
+    std::cout << "SPARSE: " << size << " MB file, " << allocated << " of " << clusters << " clusters allocated, ";
+    std::cout << "import " << importSeconds * 1000 << " ms, load " << loadSeconds * 1000 << " ms, ";
+    std::cout << readSize << " B at offset " << readSeconds * 1000000 / reads << " us";
+    std::cout << (valid ? "" : ", CONTENT DIFFERS") << std::endl;
+    std::cout << "WRITE TO HOLE: " << writeSeconds * 1000000 << " us, truncate to double size " << truncateSeconds * 1000000 << " us, ";
+    std::cout << pntfs->getUsedClusters(mftItemIndex) << " clusters allocated" << std::endl;
+    if (exported) {
+        std::cout << "EXPORT: host file " << status.st_size / (1024 * 1024) << " MB, " << status.st_blocks * 512 / (1024 * 1024) << " MB allocated" << std::endl;
+    }
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete [] buffer;
+    delete pntfs;
+}
+
+void benchmarkDirectory(const int32_t entries) {
+
+    if (entries <= 0 || entries > 200000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t lookups = 100000;
+
+    // mft table takes 10% of disk, every entry has its mft item
+    PseudoNTFS * pntfs = new PseudoNTFS((entries + 16) * sizeof(mft_item) * 11, BENCHMARK_CLUSTER_SIZE, "bench");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    makeDirectories(pntfs, 0, entries);
+    double createSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // half of lookups are for missing names
+    char name[12];
+    int32_t found = 0;
+    srand(1);
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < lookups; i++) {
+        snprintf(name, sizeof(name), i % 2 == 0 ? "d%d" : "x%d", rand() % entries);
+        found += pntfs->contains(0, name, true) != NOT_FOUND;
+    }
+    double containsSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::list<mft_item> content;
+    start = std::chrono::steady_clock::now();
+    pntfs->getDirectoryContent(0, &content);
+    double lsSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int32_t blocks = pntfs->getUsedClusters(0);
+    int32_t capacity = (BENCHMARK_CLUSTER_SIZE - sizeof(directory_block)) / sizeof(directory_entry);
+
+    // every other entry is removed
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < entries; i += 2) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->removeDirectory(pntfs->contains(0, name, true), 0);
+    }
+    double removeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    content.clear();
+    pntfs->getDirectoryContent(0, &content);
+    bool valid = found == lookups / 2 && (int32_t) content.size() == entries / 2;
+
+    std::cout << "DIRECTORY: " << entries << " entries in " << blocks << " blocks of " << capacity << " entries, ";
+    std::cout << "fill " << (blocks == 0 ? 0 : 100.0 * entries / (blocks * capacity)) << " %" << std::endl;
+    std::cout << "CREATE: " << createSeconds * 1000000 / entries << " us per entry, ";
+    std::cout << "CONTAINS: " << containsSeconds * 1000000 / lookups << " us, ";
+    std::cout << "LS: " << lsSeconds * 1000 << " ms, ";
+    std::cout << "REMOVE: " << removeSeconds * 1000000 / ((entries + 1) / 2) << " us per entry";
+    std::cout << (valid ? "" : ", ENTRIES DIFFER") << std::endl;
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete pntfs;
+}
+
+void benchmarkMftScan(const int32_t items) {
+
+    if (items <= 1 || items > 4000000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t rounds = 20;
+
+    // mft table is built in memory, volume with so many mft items does not fit into 32 bit disk size
+    // every tenth item is directory, the only free item is the last one
+    std::vector<mft_item> mftItems(items);
+    MftHotTable hotTable;
+    hotTable.resize(items);
+    for (int32_t i = 0; i < items; i++) {
+        memset(&mftItems[i], 0, sizeof(mft_item));
+        mftItems[i].uid = i == items - 1 ? UID_ITEM_FREE : i + 1;
+        mftItems[i].isDirectory = i % 10 == 0;
+        mftItems[i].item_order = 1;
+        mftItems[i].item_order_total = 1;
+        mftItems[i].item_size = i % 1000;
+        snprintf(mftItems[i].item_name, sizeof(mftItems[i].item_name), "f%d", i);
+        hotTable.update(i, &mftItems[i]);
+    }
+
+    char name[12];
+    snprintf(name, sizeof(name), "f%d", items - 2);
+
+    int32_t recordFree = NOT_FOUND, recordName = NOT_FOUND, recordDirectories = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        for (int32_t i = 0; i < items; i++) {
+            if (mftItems[i].uid == UID_ITEM_FREE) {
+                recordFree = i;
+                break;
+            }
+        }
+    }
+    double recordFreeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        for (int32_t i = 0; i < items; i++) {
+            if (mftItems[i].uid != UID_ITEM_FREE && mftItems[i].item_order == 1 && strncmp(mftItems[i].item_name, name, sizeof(name)) == 0) {
+                recordName = i;
+                break;
+            }
+        }
+    }
+    double recordNameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        recordDirectories = 0;
+        for (int32_t i = 0; i < items; i++) {
+            recordDirectories += mftItems[i].uid != UID_ITEM_FREE && mftItems[i].isDirectory;
+        }
+    }
+    double recordCountSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int32_t hotFree = NOT_FOUND, hotName = NOT_FOUND, hotDirectories = 0;
+    start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        hotFree = hotTable.findFree(0);
+    }
+    double hotFreeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // name hash only selects candidates, name of candidate is compared in its record
+    uint32_t hash = MftHotTable::nameHash(name);
+    start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        hotName = hotTable.findName(hash, 0);
+        while (hotName != NOT_FOUND && strncmp(mftItems[hotName].item_name, name, sizeof(name)) != 0) {
+            hotName = hotTable.findName(hash, hotName + 1);
+        }
+    }
+    double hotNameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t r = 0; r < rounds; r++) {
+        hotDirectories = 0;
+        for (int32_t i = 0; i < items; i++) {
+            hotDirectories += hotTable.getUid(i) != UID_ITEM_FREE && (hotTable.getFlags(i) & MFT_HOT_DIRECTORY);
+        }
+    }
+    double hotCountSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool valid = recordFree == hotFree && recordName == hotName && recordDirectories == hotDirectories && hotFree == items - 1;
+
+    // bytes brought to cache per round, scan over records reads one cache line of every record
+    const int32_t cacheLine = 64;
+    double recordMegabytes = (double) items * std::min((int32_t) sizeof(mft_item), cacheLine) / (1024 * 1024);
+    double uidMegabytes = (double) items * sizeof(int32_t) / (1024 * 1024);
+    double nameMegabytes = (double) items * sizeof(uint32_t) / (1024 * 1024);
+    double countMegabytes = (double) items * (sizeof(int32_t) + sizeof(uint8_t)) / (1024 * 1024);
+
+    std::cout << "MFT SCAN: " << items << " mft items, record " << sizeof(mft_item) << " B, " << rounds << " rounds" << std::endl;
+    std::cout << "FREE ITEM RECORDS: " << recordFreeSeconds * 1000 / rounds << " ms (" << recordMegabytes * rounds / recordFreeSeconds << " MB/s), ";
+    std::cout << "HOT TABLE: " << hotFreeSeconds * 1000 / rounds << " ms (" << uidMegabytes * rounds / hotFreeSeconds << " MB/s), ";
+    std::cout << "SPEEDUP: " << recordFreeSeconds / hotFreeSeconds << "x" << std::endl;
+    std::cout << "NAME RECORDS: " << recordNameSeconds * 1000 / rounds << " ms (" << recordMegabytes * rounds / recordNameSeconds << " MB/s), ";
+    std::cout << "HOT TABLE: " << hotNameSeconds * 1000 / rounds << " ms (" << nameMegabytes * rounds / hotNameSeconds << " MB/s), ";
+    std::cout << "SPEEDUP: " << recordNameSeconds / hotNameSeconds << "x" << std::endl;
+    std::cout << "DIRECTORIES RECORDS: " << recordCountSeconds * 1000 / rounds << " ms (" << recordMegabytes * rounds / recordCountSeconds << " MB/s), ";
+    std::cout << "HOT TABLE: " << hotCountSeconds * 1000 / rounds << " ms (" << countMegabytes * rounds / hotCountSeconds << " MB/s), ";
+    std::cout << "SPEEDUP: " << recordCountSeconds / hotCountSeconds << "x";
+    std::cout << (valid ? "" : ", RESULTS DIFFER");
+}
+
+void benchmarkSlots(const int32_t maxSlots) {
+
+    if (maxSlots <= 0 || maxSlots > 16000000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    enum slot_kernel detected = getSlotKernel();
+    std::cout << "SLOT KERNELS: detected " << slotKernelName(detected);
+
+    // every sixteenth slot is free, the searched uid is the last one
+    std::vector<int32_t> slots(maxSlots);
+    std::vector<int32_t> indexes(maxSlots);
+    for (int32_t size = 1; size <= maxSlots; size *= 10) {
+
+        for (int32_t i = 0; i < size; i++) {
+            slots[i] = i % 16 == 15 ? UID_ITEM_FREE : i + 1;
+        }
+        int32_t last = slots[size - 1] = size + 1;
+
+        // every size scans about the same count of slots
+        int32_t rounds = std::max(16000000 / size, 1);
+        std::cout << std::endl << size << " SLOTS:";
+
+        for (int32_t kernel = SLOT_KERNEL_SCALAR; kernel <= SLOT_KERNEL_AVX2; kernel++) {
+
+            if (!setSlotKernel((enum slot_kernel) kernel)) {
+                continue;
+            }
+
+            int64_t found = 0, counted = 0, collected = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int32_t r = 0; r < rounds; r++) {
+                found += findSlot(slots.data(), size, last);
+            }
+            double findSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            for (int32_t r = 0; r < rounds; r++) {
+                counted += countSlots(slots.data(), size, UID_ITEM_FREE);
+            }
+            double countSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            for (int32_t r = 0; r < rounds; r++) {
+                collected += collectSlots(slots.data(), size, UID_ITEM_FREE, indexes.data(), size);
+            }
+            double collectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            bool valid = found == (int64_t) rounds * (size - 1) && counted == (int64_t) rounds * ((size - 1) / 16)
+                && collected == counted && (counted == 0 || indexes[0] == 15);
+
+            std::cout << " " << slotKernelName((enum slot_kernel) kernel) << " find " << findSeconds * 1000000000 / rounds << " ns";
+            std::cout << ", count " << countSeconds * 1000000000 / rounds << " ns";
+            std::cout << ", compact " << collectSeconds * 1000000000 / rounds << " ns" << (valid ? "" : " RESULTS DIFFER") << ";";
+        }
+
+        if (size > maxSlots / 10) {
+            break;
+        }
+    }
+
+    setSlotKernel(detected);
+}
+
+/* fill root directory of volume with text files of BENCHMARK_LARGE_FILE_SIZE
+ * +param - pntfs - volume
+ * +param - files - count of files
+*/
+static void fillVolume(PseudoNTFS * pntfs, const int32_t files) {
+
+    std::string text(BENCHMARK_LARGE_FILE_SIZE, '\0');
+    for (int32_t i = 0; i < BENCHMARK_LARGE_FILE_SIZE; i++) {
+        text[i] = 'a' + (i / 7) % 26;
+    }
+    std::ofstream file(BENCHMARK_FILE, std::ios::binary);
+    file << text;
+    file.close();
+
+    char name[12];
+    for (int32_t i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        pntfs->saveFileToPseudoNtfs(name, BENCHMARK_FILE, 0);
+    }
+    remove(BENCHMARK_FILE);
+}
+
+void benchmarkCheck(const int32_t size) {
+
+    if (size <= 0 || size > 1536) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    PseudoNTFS * pntfs = new PseudoNTFS(size * 1024 * 1024, BENCHMARK_LARGE_CLUSTER_SIZE, "bench");
+    int32_t files = size * 8 / 10;
+    fillVolume(pntfs, files);
+
+    double gigabytes = (double) files * BENCHMARK_LARGE_FILE_SIZE / (1024 * 1024 * 1024);
+    std::cout << "CHECK: " << size << " MB volume, " << files << " files of 1 MB" << std::endl;
+
+    enum slot_kernel detected = getSlotKernel();
+    for (int32_t kernel = SLOT_KERNEL_SCALAR; kernel <= SLOT_KERNEL_AVX2; kernel++) {
+
+        if (!setSlotKernel((enum slot_kernel) kernel)) {
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool valid = pntfs->checkDiskConsistency();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "COUNT BYTES " << slotKernelName((enum slot_kernel) kernel) << ": " << seconds << " s, " << gigabytes / seconds << " GB/s";
+        std::cout << (valid ? ", disk is ok" : ", DISK IS CORRUPTED") << std::endl;
+    }
+    setSlotKernel(detected);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool valid = pntfs->checkDiskConsistency(false);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "SIZES ONLY: " << seconds << " s" << (valid ? ", disk is ok" : ", DISK IS CORRUPTED") << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    valid = pntfs->checkDiskConsistency(false, true);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "SIZES AND CHECKSUMS: " << seconds << " s, " << gigabytes / seconds << " GB/s" << (valid ? ", disk is ok" : ", DISK IS CORRUPTED");
+
+    delete pntfs;
+}
+
+void benchmarkScrub(const int32_t size) {
+
+    if (size <= 0 || size > 1536) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    PseudoNTFS * pntfs = new PseudoNTFS(size * 1024 * 1024, BENCHMARK_LARGE_CLUSTER_SIZE, "bench");
+    int32_t files = size * 8 / 10;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fillVolume(pntfs, files);
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double gigabytes = (double) files * BENCHMARK_LARGE_FILE_SIZE / (1024 * 1024 * 1024);
+    std::cout << "SCRUB: " << size << " MB volume, " << files << " files of 1 MB, " << std::thread::hardware_concurrency() << " threads" << std::endl;
+
+    // checksums of written clusters are computed again alone, their share of write time is overhead of write path
+    bool hardware = getCrc32cHardware();
+    std::vector<unsigned char> cluster(BENCHMARK_LARGE_CLUSTER_SIZE, 'a');
+    int32_t clusters = files * (BENCHMARK_LARGE_FILE_SIZE / BENCHMARK_LARGE_CLUSTER_SIZE);
+    // result is kept, so computation is not left out
+    volatile uint32_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < clusters; i++) {
+        cluster[0] = i;
+        sum = sum + crc32c(cluster.data(), cluster.size());
+    }
+    double crcSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "WRITE: " << gigabytes * 1024 / writeSeconds << " MB/s, checksums " << (hardware ? "SSE4.2" : "table") << " ";
+    std::cout << 100 * crcSeconds / writeSeconds << " % of write time" << std::endl;
+
+    for (int32_t mode = 1; mode >= 0; mode--) {
+
+        if (!setCrc32cHardware(mode == 1)) {
+            continue;
+        }
+
+        std::vector<int32_t> corrupted;
+        start = std::chrono::steady_clock::now();
+        bool valid = pntfs->scrub(&corrupted);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "SCRUB " << (mode == 1 ? "SSE4.2" : "table") << ": " << seconds << " s, " << gigabytes / seconds << " GB/s";
+        std::cout << (valid ? ", all clusters match" : ", CLUSTERS DIFFER") << std::endl;
+    }
+    setCrc32cHardware(hardware);
+
+    // read of all files without and with verification of checksums
+    std::string content;
+    double readSeconds[2];
+    for (int32_t verify = 0; verify < 2; verify++) {
+        pntfs->setVerifyChecksums(verify == 1);
+        start = std::chrono::steady_clock::now();
+        for (int32_t i = 0; i < files; i++) {
+            char name[12];
+            snprintf(name, sizeof(name), "f%d", i);
+            pntfs->loadFileFromPseudoNtfs(pntfs->contains(0, name, false), &content);
+        }
+        readSeconds[verify] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    pntfs->setVerifyChecksums(false);
+    std::cout << "READ: " << gigabytes * 1024 / readSeconds[0] << " MB/s, with verification " << gigabytes * 1024 / readSeconds[1] << " MB/s";
+
+    delete pntfs;
+}
+
+void benchmarkMount(const int32_t items) {
+
+    // mft table takes 10% of disk, 32 bit disk size limits volume to about 670000 mft items
+    int64_t diskSize = (int64_t) (items + 16) * sizeof(mft_item) * 11;
+    if (items <= 0 || diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t cacheClusters = 4096;
+    const int32_t directories = 1000;
+
+    // items are spread over directories, every directory keeps few blocks
+    // directories are filled by threads, so group commit joins their flushes
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_LARGE_CLUSTER_SIZE, "bench", BENCHMARK_VOLUME, cacheClusters);
+    pntfs->getJournal()->setGroupCommit(true);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    makeDirectories(pntfs, 0, std::min(directories, items));
+    char name[12];
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < std::min(directories, items); i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        workers.push_back(std::thread(makeDirectories, pntfs, pntfs->contains(0, name, true), (items - directories) / directories));
+        if (workers.size() == 64) {
+            for (std::thread & worker : workers) {
+                worker.join();
+            }
+            workers.clear();
+        }
+    }
+    for (std::thread & worker : workers) {
+        worker.join();
+    }
+    double fillSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    delete pntfs;
+
+    std::cout << "MOUNT: " << items << " mft items, " << diskSize / (1024 * 1024) << " MB volume, filled in " << fillSeconds << " s" << std::endl;
+
+    // resident part of volume is read by constructor, indexes are built behind it
+    start = std::chrono::steady_clock::now();
+    pntfs = new PseudoNTFS(BENCHMARK_VOLUME, cacheClusters);
+    double mountSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    snprintf(name, sizeof(name), "d%d", directories / 2);
+    bool found = pntfs->contains(0, name, true) != NOT_FOUND;
+    double firstSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    pntfs->waitIndexes();
+    double warmSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "MOUNT: " << mountSeconds * 1000 << " ms, first command " << firstSeconds * 1000 << " ms" << (found ? "" : " (NOT FOUND)");
+    std::cout << ", fully warm " << warmSeconds * 1000 << " ms" << std::endl;
+    std::cout << "INDEXES: ";
+    pntfs->printIndexStatistics();
+    std::cout << std::endl;
+    std::cout << (pntfs->checkDiskConsistency(false) ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete pntfs;
+    remove(BENCHMARK_VOLUME);
+}
+
+/* overwrite blocks of files at given positions
+ * +param - pntfs - volume
+ * +param - positions - pairs of index of mft item of file and offset in file
+ * +param - block - written block
+ * +return seconds of writes
+*/
+static double overwriteBlocks(PseudoNTFS * pntfs, const std::vector<std::pair<int32_t, int32_t>> & positions, const std::string & block) {
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const std::pair<int32_t, int32_t> & position : positions) {
+        pntfs->writeFileData(position.first, position.second, block.data(), block.length());
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmarkSnapshot(const int32_t size) {
+
+    if (size < 16 || size > 1536) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // half of volume stays free for clusters copied on write
+    PseudoNTFS * pntfs = new PseudoNTFS(size * 1024 * 1024, BENCHMARK_LARGE_CLUSTER_SIZE, "bench");
+    int32_t files = size / 2;
+    fillVolume(pntfs, files);
+
+    // random blocks of cluster size, every round writes about 1/4 of files once
+    const int32_t writes = files * (BENCHMARK_LARGE_FILE_SIZE / BENCHMARK_LARGE_CLUSTER_SIZE) / 4;
+    std::vector<int32_t> fileIndexes;
+    char name[12];
+    for (int32_t i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        fileIndexes.push_back(pntfs->contains(0, name, false));
+    }
+    std::vector<std::pair<int32_t, int32_t>> positions[2];
+    srand(1);
+    for (int32_t round = 0; round < 2; round++) {
+        for (int32_t i = 0; i < writes; i++) {
+            int32_t offset = rand() % (BENCHMARK_LARGE_FILE_SIZE / BENCHMARK_LARGE_CLUSTER_SIZE) * BENCHMARK_LARGE_CLUSTER_SIZE;
+            positions[round].push_back(std::make_pair(fileIndexes[rand() % files], offset));
+        }
+    }
+    std::string blocks[3] = {std::string(BENCHMARK_LARGE_CLUSTER_SIZE, 'x'), std::string(BENCHMARK_LARGE_CLUSTER_SIZE, 'y'),
+        std::string(BENCHMARK_LARGE_CLUSTER_SIZE, 'z')};
+    double megabytes = (double) writes * BENCHMARK_LARGE_CLUSTER_SIZE / (1024 * 1024);
+
+    std::cout << "SNAPSHOT: " << size << " MB volume, " << files << " files of 1 MB, " << writes << " writes of ";
+    std::cout << BENCHMARK_LARGE_CLUSTER_SIZE << " B per round" << std::endl;
+
+    // journaled bytes per written byte without snapshot
+    int64_t committed = pntfs->getCommittedBytes();
+    double seconds = overwriteBlocks(pntfs, positions[0], blocks[0]);
+    std::cout << "NO SNAPSHOT: " << megabytes / seconds << " MB/s, write amplification ";
+    std::cout << (double) (pntfs->getCommittedBytes() - committed) / (megabytes * 1024 * 1024) << std::endl;
+
+    // content of some files at time of snapshot is compared with mounted snapshot
+    std::vector<std::string> expected(std::min(files, 16));
+    for (int32_t i = 0; i < (int32_t) expected.size(); i++) {
+        pntfs->loadFileFromPseudoNtfs(positions[1][i].first, &expected[i]);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int32_t id = pntfs->createSnapshot();
+    double createSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "CREATE: " << createSeconds * 1000000 << " us" << std::endl;
+
+    // first writes of clusters copy them, second writes of same clusters do not
+    for (int32_t round = 0; round < 2; round++) {
+        committed = pntfs->getCommittedBytes();
+        int64_t copiedClusters = pntfs->getSnapshotCopiedClusters();
+        int64_t copiedItems = pntfs->getSnapshotCopiedItems();
+        seconds = overwriteBlocks(pntfs, positions[1], blocks[round + 1]);
+        std::cout << (round == 0 ? "WITH SNAPSHOT: " : "WITH SNAPSHOT, SAME CLUSTERS AGAIN: ") << megabytes / seconds << " MB/s, write amplification ";
+        std::cout << (double) (pntfs->getCommittedBytes() - committed) / (megabytes * 1024 * 1024) << ", ";
+        std::cout << pntfs->getSnapshotCopiedClusters() - copiedClusters << " clusters written copy on write, ";
+        std::cout << pntfs->getSnapshotCopiedItems() - copiedItems << " mft items copied" << std::endl;
+    }
+
+    PseudoNTFS * snapshot = new PseudoNTFS(pntfs, id);
+    bool valid = true;
+    std::string loaded;
+    for (int32_t i = 0; i < (int32_t) expected.size(); i++) {
+        snapshot->loadFileFromPseudoNtfs(positions[1][i].first, &loaded);
+        valid &= loaded == expected[i];
+    }
+    valid &= snapshot->checkDiskConsistency(false);
+    delete snapshot;
+
+    int32_t held = pntfs->getHeldClusters();
+    pntfs->deleteSnapshot(id);
+    start = std::chrono::steady_clock::now();
+    pntfs->sync();
+    double reclaimSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "DELETE: " << held << " held clusters, " << held - pntfs->getHeldClusters() << " reclaimed in " << reclaimSeconds * 1000 << " ms" << std::endl;
+    std::cout << (valid ? "snapshot is ok" : "SNAPSHOT DIFFERS") << ", ";
+    std::cout << (pntfs->checkDiskConsistency(false) ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete pntfs;
+}
+
+void benchmarkImage(const int32_t size, const int32_t files) {
+
+    // disk size of volume is 32 bit
+    if (size <= 0 || (int64_t) size * 1024 * 1024 > INT32_MAX || files < 0 || files > size / 2) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // both volumes are in host files, only their metadata are in memory
+    const int32_t cacheClusters = 4096;
+    PseudoNTFS * pntfs = new PseudoNTFS(size * 1024 * 1024, BENCHMARK_LARGE_CLUSTER_SIZE, "bench", BENCHMARK_VOLUME, cacheClusters);
+    fillVolume(pntfs, files);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool valid = pntfs->exportImage(BENCHMARK_IMAGE, NOT_FOUND) != NOT_FOUND;
+    double exportSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    struct stat imageStat;
+    stat(BENCHMARK_IMAGE, &imageStat);
+    double imageMegabytes = (double) imageStat.st_size / (1024 * 1024);
+
+    struct boot_record br;
+    valid &= PseudoNTFS::readImageBootRecord(BENCHMARK_IMAGE, &br);
+    PseudoNTFS * restored = new PseudoNTFS(br.disk_size, br.cluster_size, br.signature, BENCHMARK_RESTORED_VOLUME, cacheClusters);
+    start = std::chrono::steady_clock::now();
+    valid &= restored->importImage(BENCHMARK_IMAGE);
+    double importSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "IMAGE: " << size << " MB volume, " << files << " files of 1 MB, image " << imageMegabytes << " MB (";
+    std::cout << 100 * imageMegabytes / size << " % of volume)" << std::endl;
+    std::cout << "EXPORT: " << exportSeconds * 1000 << " ms, " << imageMegabytes / exportSeconds << " MB/s" << std::endl;
+    std::cout << "IMPORT: " << importSeconds * 1000 << " ms, " << imageMegabytes / importSeconds << " MB/s" << std::endl;
+
+    std::string content, restoredContent;
+    char name[12];
+    for (int32_t i = 0; i < files && valid; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        pntfs->loadFileFromPseudoNtfs(pntfs->contains(0, name, false), &content);
+        int32_t mftItemIndex = restored->contains(0, name, false);
+        valid = mftItemIndex != NOT_FOUND && restored->loadFileFromPseudoNtfs(mftItemIndex, &restoredContent) && content == restoredContent;
+    }
+    std::cout << (valid ? "files match" : "FILES DIFFER") << ", ";
+    std::cout << (restored->checkDiskConsistency(false) ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete restored;
+    delete pntfs;
+    remove(BENCHMARK_RESTORED_VOLUME);
+    remove(BENCHMARK_VOLUME);
+    remove(BENCHMARK_IMAGE);
+}
+
+void benchmarkIncremental(const int32_t size) {
+
+    if (size < 16 || (int64_t) size * 1024 * 1024 > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // a quarter of volume is filled, the same random clusters of files are changed by every round
+    const int32_t cacheClusters = 4096;
+    const int32_t files = size / 4;
+    const int32_t fileClusters = BENCHMARK_LARGE_FILE_SIZE / BENCHMARK_LARGE_CLUSTER_SIZE;
+    PseudoNTFS * pntfs = new PseudoNTFS(size * 1024 * 1024, BENCHMARK_LARGE_CLUSTER_SIZE, "bench", BENCHMARK_VOLUME, cacheClusters);
+    fillVolume(pntfs, files);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int32_t generation = pntfs->exportImage(BENCHMARK_IMAGE, NOT_FOUND);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    struct stat imageStat;
+    stat(BENCHMARK_IMAGE, &imageStat);
+    std::cout << "INCREMENTAL: " << size << " MB volume, " << files << " files of 1 MB" << std::endl;
+    std::cout << "FULL: " << (double) imageStat.st_size / (1024 * 1024) << " MB image, export " << seconds * 1000 << " ms";
+
+    struct boot_record br;
+    PseudoNTFS::readImageBootRecord(BENCHMARK_IMAGE, &br);
+    PseudoNTFS * restored = new PseudoNTFS(br.disk_size, br.cluster_size, br.signature, BENCHMARK_RESTORED_VOLUME, cacheClusters);
+    start = std::chrono::steady_clock::now();
+    bool valid = generation != NOT_FOUND && restored->importImage(BENCHMARK_IMAGE);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << ", import " << seconds * 1000 << " ms" << std::endl;
+
+    std::vector<int32_t> fileIndexes;
+    char name[12];
+    for (int32_t i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        fileIndexes.push_back(pntfs->contains(0, name, false));
+    }
+
+    std::string block(BENCHMARK_LARGE_CLUSTER_SIZE, 'x');
+    srand(1);
+    for (int32_t changes = 16; changes <= files * fileClusters / 4 && valid; changes *= 8) {
+        for (int32_t i = 0; i < changes; i++) {
+            block[0] = 'a' + i % 26;
+            pntfs->writeFileData(fileIndexes[rand() % files], rand() % fileClusters * BENCHMARK_LARGE_CLUSTER_SIZE, block.data(), block.length());
+        }
+
+        start = std::chrono::steady_clock::now();
+        int32_t next = pntfs->exportImage(BENCHMARK_IMAGE, generation);
+        double exportSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stat(BENCHMARK_IMAGE, &imageStat);
+
+        start = std::chrono::steady_clock::now();
+        valid = next != NOT_FOUND && restored->importImage(BENCHMARK_IMAGE);
+        double applySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        generation = next;
+
+        std::cout << changes << " CHANGED CLUSTERS: " << (double) imageStat.st_size / 1024 << " kB image, export " << exportSeconds * 1000 << " ms, ";
+        std::cout << "apply " << applySeconds * 1000 << " ms" << std::endl;
+    }
+
+    std::string content, restoredContent;
+    for (int32_t i = 0; i < files && valid; i++) {
+        pntfs->loadFileFromPseudoNtfs(fileIndexes[i], &content);
+        snprintf(name, sizeof(name), "f%d", i);
+        int32_t mftItemIndex = restored->contains(0, name, false);
+        valid = mftItemIndex != NOT_FOUND && restored->loadFileFromPseudoNtfs(mftItemIndex, &restoredContent) && content == restoredContent;
+    }
+    std::cout << (valid ? "files match" : "FILES DIFFER") << ", ";
+    std::cout << (restored->checkDiskConsistency(false) ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete restored;
+    delete pntfs;
+    remove(BENCHMARK_RESTORED_VOLUME);
+    remove(BENCHMARK_VOLUME);
+    remove(BENCHMARK_IMAGE);
+}
+
+// operations of aging workload replayed on every allocation policy
+const int32_t WORKLOAD_CREATE = 0;
+const int32_t WORKLOAD_APPEND = 1;
+const int32_t WORKLOAD_REMOVE = 2;
+
+// operation of workload - file is order of created file, directory and size are chosen when file is created
+struct workload_operation {
+    int32_t type;
+    int32_t file;
+    int32_t directory;
+    // index of host file for created file, count of bytes for append
+    int32_t size;
+};
+
+/* replay workload on new volume and measure fragmentation of files and seeks of reading directories
+ * +param - policy - allocation policy of volume
+ * +param - operations - workload
+ * +param - directories - count of directories
+ * +param - files - count of files created by workload
+ * +param - diskSize - size of volume in bytes
+*/
+static void replayAllocationWorkload(const int32_t policy, const std::vector<struct workload_operation> & operations, const int32_t directories, const int32_t files, const int32_t diskSize) {
+
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_CLUSTER_SIZE, "bench", NULL, 0, policy);
+    makeDirectories(pntfs, 0, directories);
+
+    char name[12], path[32];
+    std::vector<int32_t> directoryIndexes;
+    for (int32_t i = 0; i < directories; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        directoryIndexes.push_back(pntfs->contains(0, name, true));
+    }
+
+    std::vector<int32_t> fileIndexes(files, NOT_FOUND);
+    std::vector<int32_t> fileDirectories(files, 0);
+    std::string block(BENCHMARK_CLUSTER_SIZE * 8, 'a');
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const struct workload_operation & operation : operations) {
+        if (operation.type == WORKLOAD_CREATE) {
+            int32_t directory = directoryIndexes[operation.directory];
+            snprintf(name, sizeof(name), "f%d", operation.file);
+            snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, operation.size);
+            pntfs->saveFileToPseudoNtfs(name, path, directory);
+            fileIndexes[operation.file] = pntfs->contains(directory, name, false);
+            fileDirectories[operation.file] = directory;
+        }
+        else if (operation.type == WORKLOAD_APPEND) {
+            pntfs->appendFileData(fileIndexes[operation.file], block.data(), operation.size);
+        }
+        else {
+            pntfs->removeFile(fileIndexes[operation.file], fileDirectories[operation.file]);
+            fileIndexes[operation.file] = NOT_FOUND;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // files of every directory are read in order of creation, reading starts at the first block of directory
+    // seek is distance between end of read extent and start of the next one
+    int64_t liveFiles = 0, extents = 0, seek = 0;
+    ExtentMap extentMap;
+    for (int32_t directory : directoryIndexes) {
+        pntfs->loadExtentMap(directory, &extentMap);
+        int32_t previousEnd = extentMap.getExtents().empty() ? 0 : extentMap.getExtents().front().start + 1;
+        for (int32_t i = 0; i < files; i++) {
+            if (fileIndexes[i] == NOT_FOUND || fileDirectories[i] != directory || !pntfs->loadExtentMap(fileIndexes[i], &extentMap)) {
+                continue;
+            }
+            liveFiles++;
+            for (const struct extent & extent : extentMap.getExtents()) {
+                if (extent.start != EXTENT_HOLE) {
+                    extents++;
+                    seek += std::abs(extent.start - previousEnd);
+                    previousEnd = extent.start + extent.count;
+                }
+            }
+        }
+    }
+
+    std::cout << ALLOCATION_POLICY_NAMES[policy] << ": " << seconds * 1000 << " ms, " << liveFiles << " files, ";
+    std::cout << (liveFiles == 0 ? 0 : (double) extents / liveFiles) << " extents per file, ";
+    std::cout << (liveFiles == 0 ? 0 : (double) seek / liveFiles) << " clusters of seek per file read, ";
+    std::cout << (pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    delete pntfs;
+}
+
+void benchmarkAllocation(const int32_t files) {
+
+    if (files <= 0 || files > 100000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // files of 1 to 29 clusters, they take more than resident data
+    const int32_t sizes = 8;
+    const int32_t directories = 16;
+    char path[32];
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(BENCHMARK_CLUSTER_SIZE * (1 + i * 4), i + 1, path);
+    }
+
+    // workload ages volume - files are created, appended and removed in random order, it is generated once for all policies
+    std::vector<struct workload_operation> operations;
+    std::vector<int32_t> liveFiles;
+    std::vector<int32_t> fileClusters;
+    int64_t usedClusters = 0, peakClusters = 0, peakFiles = 0;
+    struct workload_operation operation;
+    srand(1);
+    while ((int32_t) fileClusters.size() < files) {
+        int32_t choice = rand() % 100;
+        if (choice < 50 || liveFiles.empty()) {
+            operation.type = WORKLOAD_CREATE;
+            operation.file = fileClusters.size();
+            operation.directory = rand() % directories;
+            operation.size = rand() % sizes;
+            liveFiles.push_back(operation.file);
+            fileClusters.push_back(1 + operation.size * 4);
+            usedClusters += fileClusters.back();
+        }
+        else if (choice < 80) {
+            operation.type = WORKLOAD_APPEND;
+            operation.file = liveFiles[rand() % liveFiles.size()];
+            operation.size = 1 + rand() % (BENCHMARK_CLUSTER_SIZE * 8);
+            // append can start new cluster behind partly filled one
+            int32_t clusters = operation.size / BENCHMARK_CLUSTER_SIZE + 1;
+            fileClusters[operation.file] += clusters;
+            usedClusters += clusters;
+        }
+        else {
+            int32_t position = rand() % liveFiles.size();
+            operation.type = WORKLOAD_REMOVE;
+            operation.file = liveFiles[position];
+            liveFiles[position] = liveFiles.back();
+            liveFiles.pop_back();
+            usedClusters -= fileClusters[operation.file];
+        }
+        operations.push_back(operation);
+        peakClusters = std::max(peakClusters, usedClusters);
+        peakFiles = std::max(peakFiles, (int64_t) liveFiles.size());
+    }
+
+    // data clusters are 80% full at peak, fragmented files need more mft items
+    int64_t diskSize = peakClusters * (BENCHMARK_CLUSTER_SIZE + 5) * 1.25 + (peakFiles * 2 + directories + 16) * sizeof(mft_item) * 11;
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    std::cout << "ALLOCATION: " << operations.size() << " operations, " << files << " files in " << directories << " directories, ";
+    std::cout << peakClusters << " clusters used at peak" << std::endl;
+    for (int32_t policy = 0; policy < ALLOCATION_POLICIES_COUNT; policy++) {
+        replayAllocationWorkload(policy, operations, directories, files, diskSize);
+    }
+
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+}
+
+/* import files concurrently on new volume with allocation groups
+ * +param - files - count of imported files
+ * +param - threads - count of threads importing files
+ * +param - sizes - count of host files with different sizes
+ * +param - diskSize - size of volume in bytes
+ * +return imported files per second
+*/
+static double runGroupsWorkload(const int32_t files, const int32_t threads, const int32_t sizes, const int32_t diskSize) {
+
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_LARGE_CLUSTER_SIZE, "bench");
+
+    // directories go to groups by their mft items, so every thread allocates in its own group
+    std::vector<int32_t> directories;
+    char name[12];
+    for (int32_t i = 0; i < threads; i++) {
+        snprintf(name, sizeof(name), "t%d", i);
+        pntfs->makeDirectory(0, name);
+        directories.push_back(pntfs->contains(0, name, true));
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < threads; i++) {
+        workers.push_back(std::thread(importFiles, pntfs, directories[i], sizes, files / threads));
+    }
+    for (int32_t i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // groups holding data of files of every directory
+    ExtentMap extentMap;
+    std::vector<bool> used(pntfs->getAllocationGroupsCount(), false);
+    int32_t imported = 0;
+    for (int32_t directory : directories) {
+        for (int32_t i = 0; i < files / threads; i++) {
+            snprintf(name, sizeof(name), "f%d", i);
+            int32_t index = pntfs->contains(directory, name, false);
+            if (index == NOT_FOUND || !pntfs->loadExtentMap(index, &extentMap)) {
+                continue;
+            }
+            imported++;
+            for (const struct extent & extent : extentMap.getExtents()) {
+                if (extent.start != EXTENT_HOLE) {
+                    used[extent.start / pntfs->getAllocationGroupClusters()] = true;
+                }
+            }
+        }
+    }
+
+    std::cout << threads << " threads: " << seconds * 1000 << " ms, " << (int64_t) (imported / seconds) << " files/s, ";
+    std::cout << (int64_t) (imported / seconds / threads) << " files/s per thread, ";
+    std::cout << std::count(used.begin(), used.end(), true) << " of " << used.size() << " groups used, ";
+    std::cout << (imported == files / threads * threads && pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    delete pntfs;
+    return imported / seconds;
+}
+
+void benchmarkGroups(const int32_t files, const int32_t threads) {
+
+    if (files <= 0 || threads <= 0 || files < threads || files > 100000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // files of 4 to 64 kB, copy and checksum of their clusters run out of volume lock
+    const int32_t sizes = 8;
+    char path[32];
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(4096 + i * 8192, i + 1, path);
+    }
+
+    // volume is half full after import, it has the most allocation groups
+    int64_t diskSize = (int64_t) files * (32 * 1024 + BENCHMARK_LARGE_CLUSTER_SIZE) * 2 + (files + threads + 16) * sizeof(mft_item) * 11;
+    diskSize = std::max(diskSize, (int64_t) ALLOCATION_GROUPS_MAX * ALLOCATION_GROUP_MIN_CLUSTERS * (BENCHMARK_LARGE_CLUSTER_SIZE + 5) * 5 / 4);
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    std::cout << "GROUPS: " << files << " files, " << diskSize / (1024 * 1024) << " MB volume, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+    double single = 0;
+    for (int32_t count = 1; count <= threads; count *= 2) {
+        double throughput = runGroupsWorkload(files, count, sizes, diskSize);
+        if (count == 1) {
+            single = throughput;
+        }
+        else {
+            std::cout << "  speedup against 1 thread: " << throughput / single << std::endl;
+        }
+    }
+
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+}
+
+/* append large files concurrently on new volume while small files are imported
+ * +param - preallocated - true - clusters of large files are reserved before they are written
+ * +param - files - count of large files
+ * +param - size - size of large file in bytes
+ * +param - sizes - count of host files with different sizes, the next one is empty
+ * +param - diskSize - size of volume in bytes
+*/
+static void runPreallocateWorkload(const bool preallocated, const int32_t files, const int32_t size, const int32_t sizes, const int32_t diskSize) {
+
+    const int32_t chunkSize = 64 * 1024;
+    const int32_t smallThreads = 2;
+    const int32_t smallFilesLimit = 1024;
+
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, BENCHMARK_LARGE_CLUSTER_SIZE, "bench");
+
+    char name[12], path[32];
+    pntfs->makeDirectory(0, "large");
+    int32_t large = pntfs->contains(0, "large", true);
+    std::vector<int32_t> directories;
+    for (int32_t i = 0; i < smallThreads; i++) {
+        snprintf(name, sizeof(name), "s%d", i);
+        pntfs->makeDirectory(0, name);
+        directories.push_back(pntfs->contains(0, name, true));
+    }
+
+    // large files start empty
+    std::vector<int32_t> fileIndexes;
+    snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, sizes);
+    for (int32_t i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "l%d", i);
+        pntfs->saveFileToPseudoNtfs(name, path, large);
+        fileIndexes.push_back(pntfs->contains(large, name, false));
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // size of file is kept, writers append to it like to file without reserved clusters
+    double preallocateSeconds = 0;
+    if (preallocated) {
+        for (int32_t index : fileIndexes) {
+            pntfs->preallocate(index, size, PREALLOCATE_KEEP_SIZE);
+        }
+        preallocateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // chunks of large files and small files are allocated between each other
+    std::atomic<bool> done(false);
+    std::atomic<int32_t> smallFiles(0);
+    std::vector<std::thread> small;
+    for (int32_t i = 0; i < smallThreads; i++) {
+        small.push_back(std::thread([pntfs, &directories, &done, &smallFiles, sizes, i, smallFilesLimit]() {
+            char name[12], path[32];
+            for (int32_t j = 0; j < smallFilesLimit && !done; j++) {
+                snprintf(name, sizeof(name), "f%d", j);
+                snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, j % sizes);
+                pntfs->saveFileToPseudoNtfs(name, path, directories[i]);
+                smallFiles++;
+                std::this_thread::yield();
+            }
+        }));
+    }
+
+    std::vector<std::thread> writers;
+    for (int32_t i = 0; i < files; i++) {
+        writers.push_back(std::thread([pntfs, &fileIndexes, i, size, chunkSize]() {
+            std::string chunk(chunkSize, 'a' + i % 26);
+            for (int32_t written = 0; written < size; written += chunkSize) {
+                pntfs->appendFileData(fileIndexes[i], chunk.data(), std::min(chunkSize, size - written));
+                std::this_thread::yield();
+            }
+        }));
+    }
+    for (std::thread & writer : writers) {
+        writer.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    done = true;
+    for (std::thread & thread : small) {
+        thread.join();
+    }
+
+    // written data are read back, file in one extent is read without seek
+    ExtentMap extentMap;
+    int64_t extents = 0;
+    int32_t contiguous = 0, maxExtents = 0;
+    bool correct = true;
+    std::string content(size, '\0');
+    for (int32_t i = 0; i < files; i++) {
+        pntfs->loadExtentMap(fileIndexes[i], &extentMap);
+        int32_t count = 0;
+        for (const struct extent & extent : extentMap.getExtents()) {
+            count += extent.start != EXTENT_HOLE;
+        }
+        extents += count;
+        contiguous += count == 1;
+        maxExtents = std::max(maxExtents, count);
+        correct = correct && pntfs->readFileData(fileIndexes[i], 0, &content[0], size) == size && content == std::string(size, 'a' + i % 26);
+    }
+
+    std::cout << (preallocated ? "preallocated: " : "appended: ") << seconds * 1000 << " ms";
+    if (preallocated) {
+        std::cout << " (" << preallocateSeconds * 1000 << " ms to preallocate)";
+    }
+    std::cout << ", " << (int64_t) ((double) files * size / (1024 * 1024) / seconds) << " MB/s, ";
+    std::cout << (double) extents / files << " extents per file, at most " << maxExtents << ", " << contiguous << " of " << files << " files in one extent, ";
+    std::cout << smallFiles << " small files meanwhile, ";
+    std::cout << (correct && pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    delete pntfs;
+}
+
+void benchmarkPreallocate(const int32_t files, const int32_t size) {
+
+    if (files <= 0 || size <= 0 || files > 64 || (int64_t) files * size > 1024) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // small files of 4 to 16 kB
+    const int32_t sizes = 4;
+    char path[32];
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(4096 + i * 4096, i + 1, path);
+    }
+    snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, sizes);
+    writeTextFile(0, 1, path);
+
+    // appended files can take one mft item for every chunk
+    int32_t fileSize = size * 1024 * 1024;
+    int64_t diskSize = ((int64_t) files * fileSize + 2 * 1024 * 16 * 1024) * 3 / 2 + (files * (fileSize / (64 * 1024) + 1) + 2 * 1024 + 16) * sizeof(mft_item) * 11;
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    std::cout << "PREALLOCATE: " << files << " files of " << size << " MB appended by 64 kB, " << diskSize / (1024 * 1024) << " MB volume" << std::endl;
+    runPreallocateWorkload(false, files, fileSize, sizes, diskSize);
+    runPreallocateWorkload(true, files, fileSize, sizes, diskSize);
+
+    for (int32_t i = 0; i <= sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+}
+
+// tree of benchmark - directories of two levels under its root, files are spread over leaf directories
+// tree is src in root of volume, its copy is src in directory dst
+const int32_t TREE_FANOUT = 10;
+const int32_t TREE_LEAVES = TREE_FANOUT * TREE_FANOUT;
+const int32_t TREE_DIRECTORIES = 1 + TREE_FANOUT + TREE_LEAVES;
+
+/* find root of tree by its path from root of volume
+ * +param - pntfs - volume
+ * +param - copied - true - copy of tree, false - original
+ * +return index of mft item of root of tree, or NOT_FOUND
+*/
+static int32_t resolveTree(PseudoNTFS * pntfs, const bool copied) {
+
+    int32_t index = copied ? pntfs->contains(0, "dst", true) : 0;
+    return index == NOT_FOUND ? NOT_FOUND : pntfs->contains(index, "src", true);
+}
+
+/* find directory of tree by its path from root of volume, every call resolves whole path
+ * +param - pntfs - volume
+ * +param - copied - true - copy of tree, false - original
+ * +param - directory - order of directory of the first level
+ * +param - leaf - order of leaf directory in directory of the first level, NOT_FOUND for directory of the first level
+ * +return index of mft item of directory, or NOT_FOUND
+*/
+static int32_t resolveDirectory(PseudoNTFS * pntfs, const bool copied, const int32_t directory, const int32_t leaf) {
+
+    char name[12];
+    int32_t index = resolveTree(pntfs, copied);
+    snprintf(name, sizeof(name), "d%d", directory);
+    index = index == NOT_FOUND ? NOT_FOUND : pntfs->contains(index, name, true);
+    if (leaf == NOT_FOUND || index == NOT_FOUND) {
+        return index;
+    }
+    snprintf(name, sizeof(name), "e%d", leaf);
+    return pntfs->contains(index, name, true);
+}
+
+/* copy tree entry by entry, every entry resolves its path as command of script would
+ * +param - pntfs - volume
+ * +param - files - count of files of tree
+*/
+static void copyTreePerEntry(PseudoNTFS * pntfs, const int32_t files) {
+
+    char name[12];
+    pntfs->makeDirectory(0, "dst");
+    pntfs->makeDirectory(pntfs->contains(0, "dst", true), "src");
+    for (int32_t i = 0; i < TREE_FANOUT; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->makeDirectory(resolveTree(pntfs, true), name);
+        for (int32_t j = 0; j < TREE_FANOUT; j++) {
+            snprintf(name, sizeof(name), "e%d", j);
+            pntfs->makeDirectory(resolveDirectory(pntfs, true, i, NOT_FOUND), name);
+        }
+    }
+
+    for (int32_t i = 0; i < files; i++) {
+        int32_t leaf = i % TREE_LEAVES;
+        snprintf(name, sizeof(name), "f%d", i / TREE_LEAVES);
+        int32_t file = pntfs->contains(resolveDirectory(pntfs, false, leaf / TREE_FANOUT, leaf % TREE_FANOUT), name, false);
+        pntfs->copy(file, resolveDirectory(pntfs, true, leaf / TREE_FANOUT, leaf % TREE_FANOUT));
+    }
+}
+
+/* remove copy of tree entry by entry, every entry resolves its path as command of script would
+ * +param - pntfs - volume
+ * +param - files - count of files of tree
+*/
+static void removeTreePerEntry(PseudoNTFS * pntfs, const int32_t files) {
+
+    char name[12];
+    for (int32_t i = 0; i < files; i++) {
+        int32_t leaf = i % TREE_LEAVES;
+        snprintf(name, sizeof(name), "f%d", i / TREE_LEAVES);
+        int32_t directory = resolveDirectory(pntfs, true, leaf / TREE_FANOUT, leaf % TREE_FANOUT);
+        pntfs->removeFile(pntfs->contains(directory, name, false), directory);
+    }
+
+    for (int32_t i = 0; i < TREE_FANOUT; i++) {
+        for (int32_t j = 0; j < TREE_FANOUT; j++) {
+            pntfs->removeDirectory(resolveDirectory(pntfs, true, i, j), resolveDirectory(pntfs, true, i, NOT_FOUND));
+        }
+        pntfs->removeDirectory(resolveDirectory(pntfs, true, i, NOT_FOUND), resolveTree(pntfs, true));
+    }
+    pntfs->removeDirectory(resolveTree(pntfs, true), pntfs->contains(0, "dst", true));
+    pntfs->removeDirectory(pntfs->contains(0, "dst", true), 0);
+}
+
+/* compare every file of copy with its original
+ * +param - pntfs - volume
+ * +param - files - count of files of tree
+ * +return true - all files were copied with same content
+*/
+static bool compareTrees(PseudoNTFS * pntfs, const int32_t files) {
+
+    char name[12];
+    std::string original, copied;
+    for (int32_t leaf = 0; leaf < TREE_LEAVES; leaf++) {
+        int32_t originalLeaf = resolveDirectory(pntfs, false, leaf / TREE_FANOUT, leaf % TREE_FANOUT);
+        int32_t copiedLeaf = resolveDirectory(pntfs, true, leaf / TREE_FANOUT, leaf % TREE_FANOUT);
+        for (int32_t i = leaf; i < files; i += TREE_LEAVES) {
+            snprintf(name, sizeof(name), "f%d", i / TREE_LEAVES);
+            int32_t originalIndex = pntfs->contains(originalLeaf, name, false);
+            int32_t copiedIndex = pntfs->contains(copiedLeaf, name, false);
+            original.clear();
+            copied.clear();
+            if (originalIndex == NOT_FOUND || copiedIndex == NOT_FOUND || !pntfs->loadFileFromPseudoNtfs(originalIndex, &original)
+                || !pntfs->loadFileFromPseudoNtfs(copiedIndex, &copied) || original != copied) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void benchmarkTree(const int32_t entries) {
+
+    if (entries <= TREE_DIRECTORIES || entries > 200000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // files of 300 B to 900 B take one cluster each, they are not resident
+    const int32_t clusterSize = 1024;
+    const int32_t sizes = 4;
+    char path[32], name[12];
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        writeTextFile(300 + i * 200, i + 1, path);
+    }
+
+    // tree and one copy at a time, mft table takes 10% of disk
+    int32_t files = entries - TREE_DIRECTORIES;
+    int64_t diskSize = std::max((int64_t) ((entries * 2 + 16) * sizeof(mft_item) * 11), (int64_t) entries * 2 * clusterSize * 2);
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, clusterSize, "bench");
+    std::cout << "TREE: " << entries << " entries, " << TREE_DIRECTORIES << " directories, " << diskSize / (1024 * 1024) << " MB volume, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    pntfs->makeDirectory(0, "src");
+    for (int32_t i = 0; i < TREE_FANOUT; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->makeDirectory(resolveTree(pntfs, false), name);
+        for (int32_t j = 0; j < TREE_FANOUT; j++) {
+            snprintf(name, sizeof(name), "e%d", j);
+            pntfs->makeDirectory(resolveDirectory(pntfs, false, i, NOT_FOUND), name);
+        }
+    }
+    std::vector<int32_t> leaves;
+    for (int32_t leaf = 0; leaf < TREE_LEAVES; leaf++) {
+        leaves.push_back(resolveDirectory(pntfs, false, leaf / TREE_FANOUT, leaf % TREE_FANOUT));
+    }
+    for (int32_t i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "f%d", i / TREE_LEAVES);
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i % sizes);
+        pntfs->saveFileToPseudoNtfs(name, path, leaves[i % TREE_LEAVES]);
+    }
+
+    // every entry of script resolves its path and runs in its own transaction
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    copyTreePerEntry(pntfs, files);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool copied = compareTrees(pntfs, files);
+    std::cout << "per entry copy: " << seconds * 1000 << " ms, " << (int64_t) (entries / seconds) << " entries/s, " << (copied ? "copy is same" : "COPY DIFFERS") << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    removeTreePerEntry(pntfs, files);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool removed = pntfs->contains(0, "dst", true) == NOT_FOUND;
+    std::cout << "per entry remove: " << seconds * 1000 << " ms, " << (int64_t) (entries / seconds) << " entries/s, ";
+    std::cout << (removed && pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    // subtree is walked once, directories are created in one transaction, files are copied by pool of threads
+    pntfs->makeDirectory(0, "dst");
+    start = std::chrono::steady_clock::now();
+    pntfs->copyTree(resolveTree(pntfs, false), pntfs->contains(0, "dst", true));
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    copied = compareTrees(pntfs, files);
+    std::cout << "tree copy: " << seconds * 1000 << " ms, " << (int64_t) (entries / seconds) << " entries/s, " << (copied ? "copy is same" : "COPY DIFFERS") << std::endl;
+
+    // entries of removed directories are not removed, their clusters are released by runs
+    start = std::chrono::steady_clock::now();
+    pntfs->removeTree(pntfs->contains(0, "dst", true), 0);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    removed = pntfs->contains(0, "dst", true) == NOT_FOUND;
+    std::cout << "tree remove: " << seconds * 1000 << " ms, " << (int64_t) (entries / seconds) << " entries/s, ";
+    std::cout << (removed && pntfs->checkDiskConsistency() ? "disk is ok" : "DISK IS CORRUPTED") << std::endl;
+
+    for (int32_t i = 0; i < sizes; i++) {
+        snprintf(path, sizeof(path), "%s.%d", BENCHMARK_FILE, i);
+        remove(path);
+    }
+    delete pntfs;
+}
+
+/* walk subtree level by level as ls would do it, every directory is read by getDirectoryContent and found by its name
+ * +param - pntfs - volume
+ * +param - directory - index of mft item of starting directory
+ * +param - pattern - shell pattern of names
+ * +param - usage - totals of subtree
+ * +param - paths - paths of names matching pattern
+*/
+static void scanTreeByLevels(PseudoNTFS * pntfs, const int32_t directory, const char * pattern, struct tree_usage * usage, std::vector<std::string> * paths) {
+
+    usage->size = 0;
+    usage->allocated = 0;
+    usage->files = 0;
+    usage->directories = 0;
+
+    std::vector<std::pair<int32_t, std::string>> stack(1, std::make_pair(directory, std::string()));
+    while (!stack.empty()) {
+        std::pair<int32_t, std::string> current = stack.back();
+        stack.pop_back();
+        usage->directories++;
+        usage->allocated += (int64_t) pntfs->getUsedClusters(current.first) * pntfs->getClusterSize();
+
+        std::list<mft_item> content;
+        pntfs->getDirectoryContent(current.first, &content);
+        for (const mft_item & item : content) {
+            int32_t index = pntfs->contains(current.first, item.item_name, item.isDirectory);
+            if (fnmatch(pattern, item.item_name, 0) == 0) {
+                paths->push_back(current.second + item.item_name + (item.isDirectory ? "/" : ""));
+            }
+            if (item.isDirectory) {
+                stack.push_back(std::make_pair(index, current.second + item.item_name + "/"));
+                continue;
+            }
+            usage->size += item.item_size;
+            usage->allocated += (int64_t) pntfs->getUsedClusters(index) * pntfs->getClusterSize();
+            usage->files++;
+        }
+    }
+    std::sort(paths->begin(), paths->end());
+}
+
+/* compare walk level by level with parallel walk of du, find and tree on one tree
+ * +param - pntfs - volume
+ * +param - name - name of tree
+ * +param - directory - index of mft item of root of tree
+*/
+static void runWalkWorkload(PseudoNTFS * pntfs, const char * name, const int32_t directory) {
+
+    const char pattern[] = "f7";
+
+    struct tree_usage scanned;
+    std::vector<std::string> scannedPaths;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    scanTreeByLevels(pntfs, directory, pattern, &scanned, &scannedPaths);
+    double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    struct tree_usage usage;
+    start = std::chrono::steady_clock::now();
+    pntfs->diskUsage(directory, &usage);
+    double duSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::string> paths;
+    start = std::chrono::steady_clock::now();
+    pntfs->findItems(directory, pattern, &paths);
+    double findSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // printed tree is thrown away, only walk and formatting are measured
+    std::ostringstream printed;
+    std::streambuf * output = std::cout.rdbuf(printed.rdbuf());
+    start = std::chrono::steady_clock::now();
+    pntfs->printTree(directory);
+    double treeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(output);
+
+    bool same = usage.size == scanned.size && usage.allocated == scanned.allocated && usage.files == scanned.files
+        && usage.directories == scanned.directories && paths == scannedPaths;
+    std::cout << name << ": " << usage.directories << " directories, " << usage.files << " files, ";
+    std::cout << "by levels: " << scanSeconds * 1000 << " ms, du: " << duSeconds * 1000 << " ms, find: " << findSeconds * 1000 << " ms, ";
+    std::cout << "tree: " << treeSeconds * 1000 << " ms, " << paths.size() << " found, " << (same ? "results are same" : "RESULTS DIFFER") << std::endl;
+}
+
+void benchmarkWalk(const int32_t entries) {
+
+    // wide tree has one level of directories, deep one is chain of directories with files on every level
+    const int32_t wideDirectories = 100;
+    const int32_t deepLevels = 1000;
+    if (entries < deepLevels * 2 || entries > 200000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // small files are resident, tree takes mft items and blocks of directories only
+    const int32_t clusterSize = 1024;
+    char path[32], name[12];
+    snprintf(path, sizeof(path), "%s.0", BENCHMARK_FILE);
+    writeTextFile(100, 1, path);
+
+    int64_t diskSize = (int64_t) (entries * 2 + 16) * sizeof(mft_item) * 11;
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, clusterSize, "bench");
+    std::cout << "WALK: " << entries << " entries in every tree, " << diskSize / (1024 * 1024) << " MB volume, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    pntfs->makeDirectory(0, "wide");
+    int32_t wide = pntfs->contains(0, "wide", true);
+    int32_t wideFiles = (entries - wideDirectories - 1) / wideDirectories;
+    for (int32_t i = 0; i < wideDirectories; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->makeDirectory(wide, name);
+        int32_t directory = pntfs->contains(wide, name, true);
+        for (int32_t j = 0; j < wideFiles; j++) {
+            snprintf(name, sizeof(name), "f%d", j);
+            pntfs->saveFileToPseudoNtfs(name, path, directory);
+        }
+    }
+
+    pntfs->makeDirectory(0, "deep");
+    int32_t deep = pntfs->contains(0, "deep", true);
+    int32_t deepFiles = entries / deepLevels - 1;
+    for (int32_t i = 0, directory = deep; i < deepLevels; i++) {
+        for (int32_t j = 0; j < deepFiles; j++) {
+            snprintf(name, sizeof(name), "f%d", j);
+            pntfs->saveFileToPseudoNtfs(name, path, directory);
+        }
+        pntfs->makeDirectory(directory, "d");
+        directory = pntfs->contains(directory, "d", true);
+    }
+
+    runWalkWorkload(pntfs, "wide", wide);
+    runWalkWorkload(pntfs, "deep", deep);
+
+    remove(path);
+    delete pntfs;
+}
+
+/* search names of whole volume by walk of tree, by scan of mft and by name index, results have to be same
+ * +param - pntfs - volume with name index off
+ * +param - patterns - searched patterns
+ * +param - found - count of names found by index for every pattern
+ * +return true - all searches found same names
+*/
+static bool runNamesQueries(PseudoNTFS * pntfs, const std::vector<std::string> & patterns, std::vector<int32_t> * found) {
+
+    const int32_t rounds = 1000;
+    bool same = true;
+    found->clear();
+
+    for (const std::string & pattern : patterns) {
+        // walk takes shell pattern, text is searched anywhere in name
+        std::string glob = NameIndex::isGlob(pattern.c_str()) ? pattern : "*" + pattern + "*";
+        std::vector<std::string> paths;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pntfs->findItems(0, glob.c_str(), &paths);
+        double walkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<int32_t> scanned;
+        pntfs->setNameIndex(false);
+        start = std::chrono::steady_clock::now();
+        pntfs->locateItems(pattern.c_str(), &scanned);
+        double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<int32_t> located;
+        pntfs->setNameIndex(true);
+        start = std::chrono::steady_clock::now();
+        for (int32_t i = 0; i < rounds; i++) {
+            pntfs->locateItems(pattern.c_str(), &located);
+        }
+        double indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+        bool matched = located == scanned && paths.size() == scanned.size();
+        same = same && matched;
+        found->push_back(located.size());
+
+        std::cout << "  \"" << pattern << "\": " << located.size() << " found, walk: " << walkSeconds * 1000 << " ms, mft scan: " << scanSeconds * 1000 << " ms, ";
+        std::cout << "index: " << indexSeconds * 1000000 << " us" << (matched ? "" : " (RESULTS DIFFER)") << std::endl;
+    }
+
+    return same;
+}
+
+void benchmarkNames(const int32_t entries) {
+
+    const int32_t directoriesCount = 100;
+    const int32_t changes = 1000;
+    if (entries < directoriesCount * 10 || entries > 200000) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    const int32_t clusterSize = 1024;
+    char path[32], name[12];
+    snprintf(path, sizeof(path), "%s.0", BENCHMARK_FILE);
+    writeTextFile(100, 1, path);
+
+    int64_t diskSize = (int64_t) (entries + changes + 16) * sizeof(mft_item) * 11;
+    if (diskSize > INT32_MAX) {
+        std::cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    // small files are resident, names are distinct numbers in mixed order
+    PseudoNTFS * pntfs = new PseudoNTFS(diskSize, clusterSize, "bench", BENCHMARK_VOLUME, 0);
+    std::cout << "NAMES: " << entries << " entries, " << diskSize / (1024 * 1024) << " MB volume" << std::endl;
+    std::vector<int32_t> directories;
+    for (int32_t i = 0; i < directoriesCount; i++) {
+        snprintf(name, sizeof(name), "d%d", i);
+        pntfs->makeDirectory(0, name);
+        directories.push_back(pntfs->contains(0, name, true));
+    }
+    for (int32_t i = directoriesCount; i < entries; i++) {
+        snprintf(name, sizeof(name), "n%07d", (int32_t) ((int64_t) i * 7919 % 10000000));
+        pntfs->saveFileToPseudoNtfs(name, path, directories[i % directoriesCount]);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pntfs->setNameIndex(true);
+    double enableSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "build and save of index: " << enableSeconds * 1000 << " ms, ";
+    pntfs->printNameIndexStatistics();
+    std::cout << std::endl;
+
+    // selective text, selective pattern and pattern with single chars only
+    std::vector<std::string> patterns = {"4242", "n12*9", "*0?0?0*"};
+    std::vector<int32_t> found;
+    bool same = runNamesQueries(pntfs, patterns, &found);
+
+    // names of changed files are updated by their mft items, cost is compared with index off
+    // rounds with index off and on alternate, the best round of each is taken
+    const int32_t rounds = 5;
+    pntfs->makeDirectory(0, "new");
+    int32_t added = pntfs->contains(0, "new", true);
+    double changeSeconds[2] = {0, 0};
+    for (int32_t round = 0; round < rounds * 2; round++) {
+        int32_t indexed = round % 2;
+        pntfs->setNameIndex(indexed == 1);
+        start = std::chrono::steady_clock::now();
+        for (int32_t i = 0; i < changes; i++) {
+            snprintf(name, sizeof(name), "a%d4242", i);
+            pntfs->saveFileToPseudoNtfs(name, path, added);
+        }
+        for (int32_t i = 0; i < changes; i++) {
+            snprintf(name, sizeof(name), "a%d4242", i);
+            pntfs->removeFile(pntfs->contains(added, name, false), added);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (round < 2 || seconds < changeSeconds[indexed]) {
+            changeSeconds[indexed] = seconds;
+        }
+    }
+    std::cout << changes << " files created and removed, best of " << rounds << " rounds, index off: " << changeSeconds[0] * 1000 << " ms, index on: " << changeSeconds[1] * 1000 << " ms" << std::endl;
+
+    // unmount saves changed index, mount loads it on first search
+    std::vector<int32_t> located;
+    pntfs->locateItems("a*4242", &located);
+    same = same && located.empty();
+    delete pntfs;
+
+    pntfs = new PseudoNTFS(BENCHMARK_VOLUME, 0);
+    pntfs->waitIndexes();
+    start = std::chrono::steady_clock::now();
+    pntfs->locateItems(patterns[0].c_str(), &located);
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    same = same && (int32_t) located.size() == found[0];
+
+    std::cout << "after mount, first search with load of index: " << loadSeconds * 1000 << " ms, " << located.size() << " found" << std::endl;
+    std::cout << (same ? "results are same" : "RESULTS DIFFER") << ", " << (pntfs->checkDiskConsistency(false) ? "disk is ok" : "DISK IS CORRUPTED");
+
+    delete pntfs;
+    remove(path);
+    remove(BENCHMARK_VOLUME);
+}
\ No newline at end of file
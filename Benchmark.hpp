@@ -0,0 +1,112 @@
+#ifndef _BENCHMARK_HPP_
+#define _BENCHMARK_HPP_
+
+#include <cstdint>
+
+    /* BENCHMARKS
+     * every benchmark formats its own volume, volume of shell is not touched
+    */
+
+    /* metadata operations per second with flush after every operation and with group commit
+     * +param - operations - count of created directories
+     * +param - threads - count of threads creating directories
+    */
+    void benchmarkJournal(const int32_t operations, const int32_t threads);
+    /* compression ratio and read/write throughput of compressed and uncompressed text file
+     * +param - size - size of file in kB
+     * +param - rounds - count of file writes and reads
+    */
+    void benchmarkCompression(const int32_t size, const int32_t rounds);
+    /* deduplication ratio and write time with and without deduplication
+     * +param - files - count of saved files
+     * +param - distinct - count of distinct contents of files
+    */
+    void benchmarkDeduplication(const int32_t files, const int32_t distinct);
+    /* creation and read latency of small files stored in mft items and in data clusters
+     * +param - files - count of created files
+     * +param - size - size of file in bytes
+    */
+    void benchmarkResident(const int32_t files, const int32_t size);
+    /* read, offset lookup and consistency check of file fragmented to given count of extents
+     * +param - extents - count of extents of file
+    */
+    void benchmarkExtents(const int32_t extents);
+    /* fragmentation of files imported concurrently with immediate and delayed allocation
+     * +param - files - count of imported files
+     * +param - threads - count of threads importing files, every thread to its own directory
+    */
+    void benchmarkDelayed(const int32_t files, const int32_t threads);
+    /* latency of reads, overwrites and appends of 4 kB at offsets of file and of whole file load and save
+     * +param - size - size of file in kB
+     * +param - operations - count of reads, overwrites and appends
+    */
+    void benchmarkPartial(const int32_t size, const int32_t operations);
+    /* allocated space, import and read time of disk image like file with every eighth block written and rest of zeros
+     * +param - size - size of file in MB
+    */
+    void benchmarkSparse(const int32_t size);
+    /* creation, lookup, listing and removal of entries of one large directory
+     * +param - entries - count of entries in directory
+    */
+    void benchmarkDirectory(const int32_t entries);
+    /* search for free mft item, search by name and count of directories over mft records and over hot table
+     * +param - items - count of mft items
+    */
+    void benchmarkMftScan(const int32_t items);
+    /* find, count and compaction of free slots by scalar, SSE4.1 and AVX2 kernels over arrays of 1 to given count of slots
+     * +param - maxSlots - count of slots of the largest array
+    */
+    void benchmarkSlots(const int32_t maxSlots);
+    /* consistency check of volume filled with files, non-zero bytes counted by every supported kernel and check of sizes only
+     * +param - size - size of volume in MB
+    */
+    void benchmarkCheck(const int32_t size);
+    /* write throughput with checksums, parallel scrub throughput and read throughput with and without verification of checksums
+     * +param - size - size of volume in MB
+    */
+    void benchmarkScrub(const int32_t size);
+    /* time to first command and time until all indexes are built after mount of persisted volume with given count of mft items
+     * +param - items - count of used mft items
+    */
+    void benchmarkMount(const int32_t items);
+    /* latency of snapshot creation and bytes written to journal per written byte before snapshot, while snapshot exists and after it
+     * +param - size - size of volume in MB
+    */
+    void benchmarkSnapshot(const int32_t size);
+    /* size of image of mostly empty volume, export and import throughput and check of restored volume
+     * +param - size - size of volume in MB
+     * +param - files - count of files of 1 MB on volume
+    */
+    void benchmarkImage(const int32_t size, const int32_t files);
+    /* time and size of incremental images after growing count of changed clusters against full image, time of their apply
+     * +param - size - size of volume in MB
+    */
+    void benchmarkIncremental(const int32_t size);
+    /* replay of aging workload creating, appending and removing files on every allocation policy, fragmentation of files and seeks of reading directories
+     * +param - files - count of files created by workload
+    */
+    void benchmarkAllocation(const int32_t files);
+    /* throughput of files imported concurrently into directories spread over allocation groups with growing count of threads
+     * +param - files - count of imported files
+     * +param - threads - the largest count of threads importing files, every thread to its own directory
+    */
+    void benchmarkGroups(const int32_t files, const int32_t threads);
+    /* extents of large files appended by concurrent writers while small files are imported, with and without preallocation of their size
+     * +param - files - count of large files, every file has its own writer thread
+     * +param - size - size of large file in MB
+    */
+    void benchmarkPreallocate(const int32_t files, const int32_t size);
+    /* time to copy and remove tree entry by entry as script would do it, against recursive copy and remove of whole tree
+     * +param - entries - count of directories and files of tree
+    */
+    void benchmarkTree(const int32_t entries);
+    /* time of du, find and tree walking subtree in parallel against walk level by level through content of directories, on wide and deep tree
+     * +param - entries - count of directories and files of every tree
+    */
+    void benchmarkWalk(const int32_t entries);
+    /* latency of name search over whole volume by name index against walk of tree and scan of mft, cost of index updates and its load after mount
+     * +param - entries - count of directories and files of volume
+    */
+    void benchmarkNames(const int32_t entries);
+
+#endif
\ No newline at end of file
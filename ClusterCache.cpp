@@ -0,0 +1,239 @@
+#include <cstring>
+
+#include "ClusterCache.hpp"
+#include "Utils.hpp"
+
+// queues of cache entries
+const int8_t QUEUE_IN = 1;
+const int8_t QUEUE_MAIN = 2;
+
+ClusterCache::ClusterCache(const int file, const int64_t dataOffset, const int32_t clusterSize, const int32_t capacity) {
+
+    this->file = file;
+    this->dataOffset = dataOffset;
+    this->clusterSize = clusterSize;
+    this->capacity = capacity;
+
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    writeBacks = 0;
+    overflows = 0;
+}
+
+ClusterCache::~ClusterCache() {
+
+    flush();
+
+    for (std::pair<const int32_t, cache_entry> & entry : entries) {
+        delete [] entry.second.frame;
+    }
+}
+
+unsigned char * ClusterCache::getCluster(const int32_t index) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup(index)->frame;
+}
+
+void ClusterCache::readCluster(const int32_t index, unsigned char * data) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    memcpy(data, lookup(index)->frame, clusterSize);
+}
+
+void ClusterCache::readClusters(const int32_t index, const int32_t count, unsigned char * data) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // cached clusters may be newer than host file, long scan does not push them out
+    readFileAt(file, dataOffset + (int64_t) index * clusterSize, data, (int64_t) count * clusterSize);
+    for (int32_t i = 0; i < count; i++) {
+        std::unordered_map<int32_t, cache_entry>::iterator it = entries.find(index + i);
+        if (it != entries.end()) {
+            memcpy(&data[(int64_t) i * clusterSize], it->second.frame, clusterSize);
+        }
+    }
+}
+
+void ClusterCache::markDirty(const int32_t index) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    lookup(index)->dirty = true;
+}
+
+void ClusterCache::pin(const int32_t index) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    lookup(index)->pins++;
+}
+
+void ClusterCache::unpin(const int32_t index, const bool written) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // pinned cluster cannot be evicted, so it is still there
+    std::unordered_map<int32_t, cache_entry>::iterator it = entries.find(index);
+    if (it == entries.end() || it->second.pins == 0) {
+        return;
+    }
+
+    it->second.pins--;
+    if (written && it->second.pins == 0) {
+        it->second.dirty = false;
+    }
+
+    // cache grown over its capacity while clusters were pinned returns back
+    while ((int32_t) entries.size() > capacity) {
+        unsigned char * frame = evictFrom(&in, true);
+        if (frame == NULL) {
+            frame = evictFrom(&main, false);
+        }
+        if (frame == NULL) {
+            break;
+        }
+        delete [] frame;
+    }
+}
+
+void ClusterCache::flush() {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (std::pair<const int32_t, cache_entry> & entry : entries) {
+        if (entry.second.dirty && entry.second.pins == 0) {
+            writeBack(entry.first, &entry.second);
+        }
+    }
+}
+
+ClusterCache::cache_entry * ClusterCache::lookup(const int32_t index) {
+
+    std::unordered_map<int32_t, cache_entry>::iterator it = entries.find(index);
+
+    if (it != entries.end()) {
+        hits++;
+        // A1in is FIFO, only hits in Am change order
+        if (it->second.queue == QUEUE_MAIN) {
+            main.splice(main.begin(), main, it->second.position);
+        }
+        return &it->second;
+    }
+
+    misses++;
+
+    struct cache_entry entry;
+    entry.frame = reclaimFrame();
+    entry.dirty = false;
+    entry.pins = 0;
+
+    if (!readFileAt(file, dataOffset + (int64_t) index * clusterSize, entry.frame, clusterSize)) {
+        // never written part of sparse host file
+        memset(entry.frame, 0, clusterSize);
+    }
+
+    // cluster evicted from A1in not long ago is hot
+    std::unordered_map<int32_t, std::list<int32_t>::iterator>::iterator ghost = ghosts.find(index);
+    if (ghost != ghosts.end()) {
+        out.erase(ghost->second);
+        ghosts.erase(ghost);
+        main.push_front(index);
+        entry.queue = QUEUE_MAIN;
+        entry.position = main.begin();
+    }
+    else {
+        in.push_front(index);
+        entry.queue = QUEUE_IN;
+        entry.position = in.begin();
+    }
+
+    return &(entries[index] = entry);
+}
+
+unsigned char * ClusterCache::reclaimFrame() {
+
+    if ((int32_t) entries.size() < capacity) {
+        return new unsigned char[clusterSize];
+    }
+
+    unsigned char * frame = NULL;
+
+    if (in.size() > capacity * CACHE_IN_SHARE) {
+        frame = evictFrom(&in, true);
+    }
+    if (frame == NULL) {
+        frame = evictFrom(&main, false);
+    }
+    if (frame == NULL) {
+        frame = evictFrom(&in, true);
+    }
+
+    // everything is pinned, cache has to grow over its capacity
+    if (frame == NULL) {
+        overflows++;
+        frame = new unsigned char[clusterSize];
+    }
+
+    return frame;
+}
+
+unsigned char * ClusterCache::evictFrom(std::list<int32_t> * queue, const bool remember) {
+
+    for (std::list<int32_t>::reverse_iterator it = queue->rbegin(); it != queue->rend(); it++) {
+
+        int32_t index = *it;
+        cache_entry * entry = &entries[index];
+
+        if (entry->pins > 0) {
+            continue;
+        }
+
+        if (entry->dirty) {
+            writeBack(index, entry);
+        }
+
+        unsigned char * frame = entry->frame;
+        queue->erase(entry->position);
+        entries.erase(index);
+        evictions++;
+
+        if (remember) {
+            out.push_front(index);
+            ghosts[index] = out.begin();
+            if (out.size() > capacity * CACHE_OUT_SHARE) {
+                ghosts.erase(out.back());
+                out.pop_back();
+            }
+        }
+
+        return frame;
+    }
+
+    return NULL;
+}
+
+void ClusterCache::writeBack(const int32_t index, cache_entry * entry) {
+
+    writeFileAt(file, dataOffset + (int64_t) index * clusterSize, entry->frame, clusterSize);
+    entry->dirty = false;
+    writeBacks++;
+}
+
+void ClusterCache::printStatistics(std::ostream * output) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int64_t accesses = hits + misses;
+    int32_t dirty = 0, pinned = 0;
+    for (std::pair<const int32_t, cache_entry> & entry : entries) {
+        dirty += entry.second.dirty;
+        pinned += entry.second.pins > 0;
+    }
+
+    *output << "Capacity: " << capacity << " clusters" << std::endl;
+    *output << "Cached: " << entries.size() << " (A1in " << in.size() << ", Am " << main.size() << ", A1out " << out.size() << ")" << std::endl;
+    *output << "Dirty: " << dirty << ", pinned: " << pinned << std::endl;
+    *output << "Hits: " << hits << ", misses: " << misses;
+    *output << ", hit rate: " << (accesses == 0 ? 0 : 100.0 * hits / accesses) << " %" << std::endl;
+    *output << "Evictions: " << evictions << ", write backs: " << writeBacks << ", overflows: " << overflows;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef _CLUSTER_CACHE_HPP_
+#define _CLUSTER_CACHE_HPP_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+    // share of capacity for clusters seen only once (A1in) and count of remembered evicted ones (A1out)
+    const double CACHE_IN_SHARE = 0.25;
+    const double CACHE_OUT_SHARE = 0.5;
+
+    /* bounded cache of data clusters of volume stored in host file
+     * 2Q replacement - clusters seen once go through FIFO (A1in), clusters seen again after
+     * their eviction from FIFO (A1out) are kept in LRU (Am)
+     * dirty clusters are written back on eviction and flush, pinned clusters are never evicted
+     * THREAD SAFE - but pointer returned by getCluster is valid only until next getCluster call,
+     * so it can be used only by one thread at time
+    */
+    class ClusterCache {
+
+        private:
+
+            struct cache_entry {
+                unsigned char * frame;
+                bool dirty;
+                int32_t pins;
+                int8_t queue;
+                std::list<int32_t>::iterator position;
+            };
+
+            int file;
+            int64_t dataOffset;
+            int32_t clusterSize;
+            int32_t capacity;
+
+            std::mutex mutex;
+            std::unordered_map<int32_t, cache_entry> entries;
+            std::list<int32_t> in;
+            std::list<int32_t> main;
+            std::list<int32_t> out;
+            std::unordered_map<int32_t, std::list<int32_t>::iterator> ghosts;
+
+            /* statistics */
+            int64_t hits;
+            int64_t misses;
+            int64_t evictions;
+            int64_t writeBacks;
+            int64_t overflows;
+
+            /* find cluster in cache, load it on miss
+             * +param - index - data cluster index
+             * +return cache entry of cluster
+            */
+            cache_entry * lookup(const int32_t index);
+            /* get frame for new cluster - free one, or frame of evicted cluster
+             * +return frame
+            */
+            unsigned char * reclaimFrame();
+            /* evict first unpinned cluster from queue
+             * +param - queue - A1in or Am
+             * +param - remember - true - evicted cluster is remembered in A1out
+             * +return frame of evicted cluster, or NULL if all clusters in queue are pinned
+            */
+            unsigned char * evictFrom(std::list<int32_t> * queue, const bool remember);
+            /* write cluster to host file
+             * +param - index - data cluster index
+             * +param - entry - cache entry of cluster
+            */
+            void writeBack(const int32_t index, cache_entry * entry);
+
+        public:
+
+            /* +param - file - descriptor of host file with volume
+             * +param - dataOffset - offset of first data cluster in host file
+             * +param - clusterSize - size of data cluster
+             * +param - capacity - maximal count of cached clusters
+            */
+            ClusterCache(const int file, const int64_t dataOffset, const int32_t clusterSize, const int32_t capacity);
+            ~ClusterCache();
+
+            /* get cluster data in cache
+             * +param - index - data cluster index
+             * +return cluster data, valid until next call
+            */
+            unsigned char * getCluster(const int32_t index);
+            /* copy cluster data
+             * +param - index - data cluster index
+             * +param - data - buffer for cluster data
+            */
+            void readCluster(const int32_t index, unsigned char * data);
+            /* copy data of run of clusters, clusters not in cache are read from host file at once and they are not cached
+             * +param - index - index of first data cluster of run
+             * +param - count - count of clusters
+             * +param - data - buffer for data of clusters
+            */
+            void readClusters(const int32_t index, const int32_t count, unsigned char * data);
+
+            /* mark cluster as changed, it will be written back
+             * +param - index - data cluster index
+            */
+            void markDirty(const int32_t index);
+            /* pinned cluster is never evicted
+             * +param - index - data cluster index
+            */
+            void pin(const int32_t index);
+            /* release pin of cluster, clusters over capacity are evicted
+             * +param - index - data cluster index
+             * +param - written - true - content was written to host file by someone else (journal),
+             *                    cluster is clean if nobody else pinned it meanwhile
+            */
+            void unpin(const int32_t index, const bool written);
+
+            /* write back all dirty unpinned clusters
+            */
+            void flush();
+
+            /* print hit rate and eviction metrics
+             * +param - output - output stream
+            */
+            void printStatistics(std::ostream * output);
+    };
+
+#endif
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Compression.hpp"
+#include "Utils.hpp"
+
+const int32_t MIN_MATCH = 4;
+const int32_t MAX_OFFSET = 65535;
+const int32_t HASH_BITS = 12;
+// length which does not fit to token nibble continues in extension bytes
+const int32_t TOKEN_LENGTH_MAX = 15;
+
+/* read 4 bytes at position
+ * +param - data - data
+ * +return 4 bytes as number
+*/
+static uint32_t read32(const unsigned char * data) {
+
+    uint32_t value;
+    memcpy(&value, data, sizeof(uint32_t));
+    return value;
+}
+
+/* write length extension bytes of token
+ * +param - length - rest of length over token nibble
+ * +param - destination - output buffer
+ * +param - position - position in output buffer, moved behind written bytes
+ * +param - capacity - size of output buffer
+ * +return true - written, false - buffer is full
+*/
+static bool writeLength(int32_t length, unsigned char * destination, int32_t * position, const int32_t capacity) {
+
+    while (length >= 255) {
+        if (*position >= capacity) {
+            return false;
+        }
+        destination[(*position)++] = 255;
+        length -= 255;
+    }
+
+    if (*position >= capacity) {
+        return false;
+    }
+    destination[(*position)++] = length;
+    return true;
+}
+
+/* read length extension bytes of token
+ * +param - source - input buffer
+ * +param - position - position in input buffer, moved behind read bytes
+ * +param - length - length of input buffer
+ * +return rest of length over token nibble, or NOT_FOUND if input ends
+*/
+static int32_t readLength(const unsigned char * source, int32_t * position, const int32_t length) {
+
+    int32_t value = 0;
+    unsigned char byte;
+
+    do {
+        if (*position >= length) {
+            return NOT_FOUND;
+        }
+        byte = source[(*position)++];
+        value += byte;
+    } while (byte == 255);
+
+    return value;
+}
+
+/* write one sequence - literals and match
+ * +param - literals - start of literals
+ * +param - literalsLength - count of literals
+ * +param - offset - distance of match, 0 for last sequence without match
+ * +param - matchLength - length of match
+ * +param - destination - output buffer
+ * +param - position - position in output buffer, moved behind sequence
+ * +param - capacity - size of output buffer
+ * +return true - written, false - buffer is full
+*/
+static bool writeSequence(const unsigned char * literals, const int32_t literalsLength, const int32_t offset, const int32_t matchLength, unsigned char * destination, int32_t * position, const int32_t capacity) {
+
+    if (*position >= capacity) {
+        return false;
+    }
+
+    int32_t tokenPosition = (*position)++;
+    int32_t matchCode = offset > 0 ? matchLength - MIN_MATCH : 0;
+    destination[tokenPosition] = (std::min(literalsLength, TOKEN_LENGTH_MAX) << 4) | std::min(matchCode, TOKEN_LENGTH_MAX);
+
+    if (literalsLength >= TOKEN_LENGTH_MAX && !writeLength(literalsLength - TOKEN_LENGTH_MAX, destination, position, capacity)) {
+        return false;
+    }
+
+    if (*position + literalsLength > capacity) {
+        return false;
+    }
+    memcpy(&destination[*position], literals, literalsLength);
+    *position += literalsLength;
+
+    if (offset == 0) {
+        return true;
+    }
+
+    if (*position + 2 > capacity) {
+        return false;
+    }
+    destination[(*position)++] = offset & 0xff;
+    destination[(*position)++] = offset >> 8;
+
+    if (matchCode >= TOKEN_LENGTH_MAX && !writeLength(matchCode - TOKEN_LENGTH_MAX, destination, position, capacity)) {
+        return false;
+    }
+
+    return true;
+}
+
+int32_t compressChunk(const unsigned char * source, const int32_t length, unsigned char * destination, const int32_t capacity) {
+
+    // last position of every hashed 4 byte sequence
+    std::vector<int32_t> table(1 << HASH_BITS, NOT_FOUND);
+
+    int32_t position = 0, anchor = 0, output = 0;
+
+    while (position + MIN_MATCH <= length) {
+
+        uint32_t sequence = read32(&source[position]);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        int32_t candidate = table[hash];
+        table[hash] = position;
+
+        if (candidate == NOT_FOUND || position - candidate > MAX_OFFSET || read32(&source[candidate]) != sequence) {
+            position++;
+            continue;
+        }
+
+        int32_t matchLength = MIN_MATCH;
+        while (position + matchLength < length && source[candidate + matchLength] == source[position + matchLength]) {
+            matchLength++;
+        }
+
+        if (!writeSequence(&source[anchor], position - anchor, position - candidate, matchLength, destination, &output, capacity)) {
+            return 0;
+        }
+
+        position += matchLength;
+        anchor = position;
+    }
+
+    if (!writeSequence(&source[anchor], length - anchor, 0, 0, destination, &output, capacity)) {
+        return 0;
+    }
+
+    return output;
+}
+
+bool decompressChunk(const unsigned char * source, const int32_t length, unsigned char * destination, const int32_t rawLength) {
+
+    int32_t input = 0, output = 0;
+
+    while (input < length) {
+
+        unsigned char token = source[input++];
+
+        int32_t literalsLength = token >> 4;
+        if (literalsLength == TOKEN_LENGTH_MAX) {
+            int32_t rest = readLength(source, &input, length);
+            if (rest == NOT_FOUND) {
+                return false;
+            }
+            literalsLength += rest;
+        }
+
+        if (input + literalsLength > length || output + literalsLength > rawLength) {
+            return false;
+        }
+        memcpy(&destination[output], &source[input], literalsLength);
+        input += literalsLength;
+        output += literalsLength;
+
+        // last sequence has no match
+        if (output == rawLength) {
+            break;
+        }
+
+        if (input + 2 > length) {
+            return false;
+        }
+        int32_t offset = source[input] | (source[input + 1] << 8);
+        input += 2;
+
+        int32_t matchLength = (token & 0x0f);
+        if (matchLength == TOKEN_LENGTH_MAX) {
+            int32_t rest = readLength(source, &input, length);
+            if (rest == NOT_FOUND) {
+                return false;
+            }
+            matchLength += rest;
+        }
+        matchLength += MIN_MATCH;
+
+        if (offset == 0 || offset > output || output + matchLength > rawLength) {
+            return false;
+        }
+
+        // match can overlap with its own output, then it has to be copied byte by byte
+        if (offset >= matchLength) {
+            memcpy(&destination[output], &destination[output - offset], matchLength);
+            output += matchLength;
+        }
+        else {
+            for (int32_t i = 0; i < matchLength; i++, output++) {
+                destination[output] = destination[output - offset];
+            }
+        }
+    }
+
+    return output == rawLength;
+}
+
+void compressData(const char * data, const int32_t length, std::string * stored) {
+
+    unsigned char * buffer = new unsigned char[COMPRESSION_CHUNK_SIZE];
+    struct compressed_chunk chunk;
+
+    stored->clear();
+
+    for (int32_t position = 0; position < length; position += COMPRESSION_CHUNK_SIZE) {
+
+        chunk.raw_length = std::min(COMPRESSION_CHUNK_SIZE, length - position);
+        const unsigned char * raw = (const unsigned char *) &data[position];
+
+        // compressed chunk has to be smaller, else it is stored as it is
+        chunk.stored_length = compressChunk(raw, chunk.raw_length, buffer, chunk.raw_length - 1);
+        if (chunk.stored_length == 0) {
+            chunk.stored_length = chunk.raw_length;
+            memcpy(buffer, raw, chunk.raw_length);
+        }
+
+        stored->append((const char *) &chunk, sizeof(compressed_chunk));
+        stored->append((const char *) buffer, chunk.stored_length);
+    }
+
+    delete [] buffer;
+}
+
+int32_t decompressChunks(const unsigned char * stored, const int32_t length, std::string * content, const int32_t contentLength) {
+
+    struct compressed_chunk chunk;
+    int32_t position = 0;
+
+    // rest of last data cluster behind last chunk is not used
+    while (position + (int32_t) sizeof(compressed_chunk) <= length && (int32_t) content->length() < contentLength) {
+
+        memcpy(&chunk, &stored[position], sizeof(compressed_chunk));
+
+        if (chunk.raw_length <= 0 || chunk.raw_length > COMPRESSION_CHUNK_SIZE || chunk.stored_length <= 0 || chunk.stored_length > chunk.raw_length
+            || (int32_t) content->length() + chunk.raw_length > contentLength) {
+            return NOT_FOUND;
+        }
+
+        // rest of chunk was not read yet
+        if (position + (int32_t) sizeof(compressed_chunk) + chunk.stored_length > length) {
+            break;
+        }
+
+        const unsigned char * data = &stored[position + sizeof(compressed_chunk)];
+        int32_t offset = content->length();
+        content->resize(offset + chunk.raw_length);
+
+        if (chunk.stored_length == chunk.raw_length) {
+            memcpy(&(*content)[offset], data, chunk.raw_length);
+        }
+        else if (!decompressChunk(data, chunk.stored_length, (unsigned char *) &(*content)[offset], chunk.raw_length)) {
+            return NOT_FOUND;
+        }
+
+        position += sizeof(compressed_chunk) + chunk.stored_length;
+    }
+
+    return position;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef _COMPRESSION_HPP_
+#define _COMPRESSION_HPP_
+
+#include <cstdint>
+#include <string>
+
+    // file data are compressed in independent chunks of this size
+    const int32_t COMPRESSION_CHUNK_SIZE = 4096;
+
+    struct compressed_chunk {
+        int32_t stored_length;      //delka ulozenych dat chunku, rovna raw_length pro nekomprimovany chunk
+        int32_t raw_length;         //delka puvodnich dat chunku
+    };
+
+    /* LZ77 compression of one chunk - sequences of literals and matches with 16-bit offset (LZ4 like)
+     * +param - source - data to compress
+     * +param - length - length of data, at most 64 kB
+     * +param - destination - buffer for compressed data
+     * +param - capacity - size of destination buffer
+     * +return length of compressed data, or 0 if data cannot be compressed to less than capacity
+    */
+    int32_t compressChunk(const unsigned char * source, const int32_t length, unsigned char * destination, const int32_t capacity);
+    /* decompress one chunk
+     * +param - source - compressed data
+     * +param - length - length of compressed data
+     * +param - destination - buffer for decompressed data
+     * +param - rawLength - expected length of decompressed data
+     * +return true - chunk was decompressed, false - compressed data are corrupted
+    */
+    bool decompressChunk(const unsigned char * source, const int32_t length, unsigned char * destination, const int32_t rawLength);
+
+    /* compress data to sequence of chunks, each with compressed_chunk header
+     * chunk which cannot be compressed is stored as it is
+     * +param - data - data to compress
+     * +param - length - length of data
+     * +param - stored - compressed data
+    */
+    void compressData(const char * data, const int32_t length, std::string * stored);
+    /* decompress all complete chunks at start of stored data, so data can be decompressed while they are read
+     * +param - stored - compressed data read so far
+     * +param - length - length of compressed data read so far
+     * +param - content - decompressed data are appended here
+     * +param - contentLength - length of whole decompressed content, decompression stops there
+     * +return count of consumed bytes, or NOT_FOUND if data are corrupted
+    */
+    int32_t decompressChunks(const unsigned char * stored, const int32_t length, std::string * content, const int32_t contentLength);
+
+#endif
\ No newline at end of file
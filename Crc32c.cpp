@@ -0,0 +1,107 @@
+#include <cstring>
+
+#include "Crc32c.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_X86
+#include <immintrin.h>
+#endif
+
+// reflected Castagnoli polynomial
+const uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+
+/* table of crc of every byte value
+ * +param - table - table of 256 checksums
+*/
+static void initTable(uint32_t * table) {
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+        }
+        table[i] = crc;
+    }
+}
+
+static uint32_t crcTable(const unsigned char * data, const int64_t length) {
+
+    static uint32_t table[256];
+    static bool initialized = (initTable(table), true);
+    (void) initialized;
+
+    uint32_t crc = 0xffffffff;
+    for (int64_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+#ifdef CRC32C_X86
+
+__attribute__((target("sse4.2")))
+static uint32_t crcHardware(const unsigned char * data, const int64_t length) {
+
+    int64_t i = 0;
+#ifdef __x86_64__
+    uint64_t crc = 0xffffffff;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+    }
+    uint32_t crc32 = crc;
+#else
+    uint32_t crc32 = 0xffffffff;
+#endif
+    for (; i + 4 <= length; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        crc32 = _mm_crc32_u32(crc32, word);
+    }
+    for (; i < length; i++) {
+        crc32 = _mm_crc32_u8(crc32, data[i]);
+    }
+
+    return ~crc32;
+}
+
+#endif
+
+bool crc32cHardwareSupported() {
+
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+static bool useHardware = crc32cHardwareSupported();
+
+bool setCrc32cHardware(const bool hardware) {
+
+    if (hardware && !crc32cHardwareSupported()) {
+        return false;
+    }
+
+    useHardware = hardware;
+    return true;
+}
+
+bool getCrc32cHardware() {
+    return useHardware;
+}
+
+uint32_t crc32c(const unsigned char * data, const int64_t length) {
+
+#ifdef CRC32C_X86
+    if (useHardware) {
+        return crcHardware(data, length);
+    }
+#endif
+
+    return crcTable(data, length);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _CRC32C_HPP_
+#define _CRC32C_HPP_
+
+#include <cstdint>
+
+    /* CRC32C (Castagnoli) of data, SSE4.2 crc32 instruction is used when cpu supports it
+     * +param - data - data
+     * +param - length - length of data
+     * +return checksum
+    */
+    uint32_t crc32c(const unsigned char * data, const int64_t length);
+
+    /* +return true if cpu has crc32 instruction
+    */
+    bool crc32cHardwareSupported();
+    /* compute checksums by crc32 instruction or by table
+     * +param - hardware - true - crc32 instruction, false - table
+     * +return false if cpu does not support crc32 instruction
+    */
+    bool setCrc32cHardware(const bool hardware);
+    bool getCrc32cHardware();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include <algorithm>
+
+#include "ExtentMap.hpp"
+#include "Utils.hpp"
+
+void ExtentMap::append(const int32_t start, const int32_t count) {
+
+    if (count <= 0) {
+        return;
+    }
+
+    // hole follows hole, data cluster follows the last data cluster
+    bool continual = !extents.empty() && (start == EXTENT_HOLE ? extents.back().start == EXTENT_HOLE
+        : extents.back().start != EXTENT_HOLE && extents.back().start + extents.back().count == start);
+
+    if (continual) {
+        extents.back().count += count;
+    }
+    else {
+        struct extent extent;
+        extent.logical_start = clusterCount;
+        extent.start = start;
+        extent.count = count;
+        extents.push_back(extent);
+    }
+
+    clusterCount += count;
+    if (start != EXTENT_HOLE) {
+        allocatedCount += count;
+    }
+}
+
+int32_t ExtentMap::findExtent(const int32_t logicalCluster) const {
+
+    if (logicalCluster < 0 || logicalCluster >= clusterCount) {
+        return NOT_FOUND;
+    }
+
+    // first extent starting behind the cluster, the cluster is in the one before it
+    std::vector<struct extent>::const_iterator it = std::upper_bound(extents.begin(), extents.end(), logicalCluster,
+        [](const int32_t cluster, const struct extent & extent) {return cluster < extent.logical_start;});
+
+    return (it - extents.begin()) - 1;
+}
+
+int32_t ExtentMap::find(const int32_t logicalCluster) const {
+
+    int32_t index = findExtent(logicalCluster);
+    if (index == NOT_FOUND || extents[index].start == EXTENT_HOLE) {
+        return NOT_FOUND;
+    }
+
+    return extents[index].start + (logicalCluster - extents[index].logical_start);
+}
+
+void ExtentMap::clear() {
+
+    extents.clear();
+    clusterCount = 0;
+    allocatedCount = 0;
+}
\ No newline at end of file
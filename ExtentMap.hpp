@@ -0,0 +1,54 @@
+#ifndef _EXTENT_MAP_HPP_
+#define _EXTENT_MAP_HPP_
+
+#include <cstdint>
+#include <vector>
+
+    // start of extent without data clusters - hole of sparse file, it reads as zeros
+    const int32_t EXTENT_HOLE = -1;
+
+    struct extent {
+        int32_t logical_start;      //poradi prvniho clusteru extentu v souboru
+        int32_t start;              //index prvniho datoveho clusteru, EXTENT_HOLE u diry
+        int32_t count;              //pocet clusteru v extentu
+    };
+
+    /* map of file data clusters - fragments of all mft items of file in order of their position in file
+     * data cluster holding given position of file is found by binary search over prefix sums
+     * clusters never written to sparse file are holes, extents with EXTENT_HOLE start
+    */
+    class ExtentMap {
+
+        private:
+
+            std::vector<struct extent> extents;
+            int32_t clusterCount;
+            int32_t allocatedCount;
+
+        public:
+
+            ExtentMap() : clusterCount(0), allocatedCount(0) {};
+
+            /* append extent behind the last one, continual extents and neighbouring holes are merged
+             * +param - start - index of first data cluster, or EXTENT_HOLE
+             * +param - count - count of data clusters
+            */
+            void append(const int32_t start, const int32_t count);
+            /* find data cluster of file
+             * +param - logicalCluster - order of cluster in file
+             * +return data cluster index, or NOT_FOUND for cluster in hole or behind end of file
+            */
+            int32_t find(const int32_t logicalCluster) const;
+            /* find extent holding cluster of file
+             * +param - logicalCluster - order of cluster in file
+             * +return index of extent, or NOT_FOUND
+            */
+            int32_t findExtent(const int32_t logicalCluster) const;
+            void clear();
+
+            const std::vector<struct extent> & getExtents() const {return extents;};
+            int32_t getClusterCount() const {return clusterCount;};
+            int32_t getAllocatedCount() const {return allocatedCount;};
+    };
+
+#endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include <algorithm>
+
+#include "FreeExtentIndex.hpp"
+
+void FreeExtentIndex::insert(const int32_t start, const int32_t count) {
+
+    extents[start] = count;
+    sizes.insert(std::make_pair(-count, start));
+    freeClusters += count;
+}
+
+void FreeExtentIndex::erase(std::map<int32_t, int32_t>::iterator extent) {
+
+    sizes.erase(std::make_pair(-extent->second, extent->first));
+    freeClusters -= extent->second;
+    extents.erase(extent);
+}
+
+void FreeExtentIndex::build(const unsigned char * bitmap, const int32_t first, const int32_t end) {
+
+    clear();
+
+    int32_t runStart = -1;
+    for (int32_t i = first; i < end; i++) {
+
+        // bytes of whole free or whole used clusters are skipped at once
+        if (i % 8 == 0 && i + 8 <= end && (bitmap[i / 8] == 0x00 || bitmap[i / 8] == 0xff)) {
+            bool free = bitmap[i / 8] == 0x00;
+            if (free && runStart < 0) {
+                runStart = i;
+            }
+            else if (!free && runStart >= 0) {
+                insert(runStart, i - runStart);
+                runStart = -1;
+            }
+            i += 7;
+            continue;
+        }
+
+        bool free = !(bitmap[i / 8] & (128 >> (i % 8)));
+        if (free && runStart < 0) {
+            runStart = i;
+        }
+        else if (!free && runStart >= 0) {
+            insert(runStart, i - runStart);
+            runStart = -1;
+        }
+    }
+
+    if (runStart >= 0) {
+        insert(runStart, end - runStart);
+    }
+}
+
+bool FreeExtentIndex::allocate(const int32_t cluster) {
+
+    std::map<int32_t, int32_t>::iterator extent = extents.upper_bound(cluster);
+    if (extent == extents.begin()) {
+        return false;
+    }
+    extent--;
+
+    if (cluster >= extent->first + extent->second) {
+        return false;
+    }
+
+    allocate(cluster, 1);
+    return true;
+}
+
+void FreeExtentIndex::allocate(const int32_t start, const int32_t count) {
+
+    std::map<int32_t, int32_t>::iterator extent = extents.upper_bound(start);
+    if (extent == extents.begin()) {
+        return;
+    }
+    extent--;
+
+    int32_t runStart = extent->first;
+    int32_t runCount = extent->second;
+    if (start + count > runStart + runCount) {
+        return;
+    }
+
+    // run is split around the clusters
+    erase(extent);
+    if (start > runStart) {
+        insert(runStart, start - runStart);
+    }
+    if (start + count < runStart + runCount) {
+        insert(start + count, runStart + runCount - start - count);
+    }
+}
+
+bool FreeExtentIndex::release(const int32_t cluster) {
+
+    std::map<int32_t, int32_t>::iterator next = extents.upper_bound(cluster);
+    if (next != extents.begin()) {
+        std::map<int32_t, int32_t>::iterator previous = next;
+        previous--;
+        // cluster is free already
+        if (cluster < previous->first + previous->second) {
+            return false;
+        }
+    }
+
+    release(cluster, 1);
+    return true;
+}
+
+void FreeExtentIndex::release(const int32_t start, const int32_t count) {
+
+    int32_t runStart = start;
+    int32_t runCount = count;
+
+    std::map<int32_t, int32_t>::iterator next = extents.upper_bound(start);
+    if (next != extents.begin()) {
+        std::map<int32_t, int32_t>::iterator previous = next;
+        previous--;
+        if (previous->first + previous->second == start) {
+            runStart = previous->first;
+            runCount += previous->second;
+            erase(previous);
+        }
+    }
+
+    if (next != extents.end() && next->first == start + count) {
+        runCount += next->second;
+        erase(next);
+    }
+
+    insert(runStart, runCount);
+}
+
+void FreeExtentIndex::clear() {
+
+    extents.clear();
+    sizes.clear();
+    freeClusters = 0;
+}
+
+int32_t FreeExtentIndex::findFirst(const int32_t count, int32_t * start) const {
+
+    for (std::map<int32_t, int32_t>::const_iterator extent = extents.begin(); extent != extents.end(); extent++) {
+        if (extent->second >= count) {
+            *start = extent->first;
+            return extent->second;
+        }
+    }
+
+    return 0;
+}
+
+int32_t FreeExtentIndex::findNext(const int32_t count, const int32_t from, int32_t * start) const {
+
+    // run holding the cluster is the first candidate
+    std::map<int32_t, int32_t>::const_iterator first = extents.upper_bound(from);
+    if (first != extents.begin()) {
+        std::map<int32_t, int32_t>::const_iterator previous = first;
+        previous--;
+        if (from < previous->first + previous->second) {
+            first = previous;
+        }
+    }
+
+    std::map<int32_t, int32_t>::const_iterator extent = first;
+    for (size_t i = 0; i < extents.size(); i++, extent++) {
+        if (extent == extents.end()) {
+            extent = extents.begin();
+        }
+        if (extent->second >= count) {
+            *start = extent->first;
+            return extent->second;
+        }
+    }
+
+    return 0;
+}
+
+int32_t FreeExtentIndex::findBest(const int32_t count, int32_t * start) const {
+
+    // runs are ordered from the largest one, the last run not smaller than count is the smallest one
+    std::set<std::pair<int32_t, int32_t>>::const_iterator size = sizes.upper_bound(std::make_pair(-count, INT32_MAX));
+    if (size == sizes.begin()) {
+        return 0;
+    }
+    size--;
+
+    // the first run of the same size
+    size = sizes.lower_bound(std::make_pair(size->first, INT32_MIN));
+    *start = size->second;
+    return -size->first;
+}
+
+int32_t FreeExtentIndex::findNear(const int32_t count, const int32_t goal, int32_t * start) const {
+
+    // runs are visited by distance from goal, the one behind goal and the one before it are compared in every step
+    std::map<int32_t, int32_t>::const_iterator next = extents.upper_bound(goal);
+    std::map<int32_t, int32_t>::const_iterator previous = next;
+    bool before = previous != extents.begin();
+    if (before) {
+        previous--;
+    }
+
+    while (before || next != extents.end()) {
+        int32_t beforeDistance = before ? std::max(goal - (previous->first + previous->second - 1), 0) : INT32_MAX;
+        int32_t nextDistance = next != extents.end() ? next->first - goal : INT32_MAX;
+
+        std::map<int32_t, int32_t>::const_iterator extent = beforeDistance <= nextDistance ? previous : next;
+        if (extent->second >= count) {
+            *start = extent->first;
+            return extent->second;
+        }
+
+        if (beforeDistance <= nextDistance) {
+            before = previous != extents.begin();
+            if (before) {
+                previous--;
+            }
+        }
+        else {
+            next++;
+        }
+    }
+
+    return 0;
+}
+
+int32_t FreeExtentIndex::findLargest(int32_t * start) const {
+
+    if (sizes.empty()) {
+        return 0;
+    }
+
+    *start = sizes.begin()->second;
+    return -sizes.begin()->first;
+}
+
+void FreeExtentIndex::histogram(std::vector<int32_t> * histogram) const {
+
+    histogram->clear();
+
+    for (std::map<int32_t, int32_t>::const_iterator extent = extents.begin(); extent != extents.end(); extent++) {
+        std::size_t sizeClass = 0;
+        while ((extent->second >> (sizeClass + 1)) > 0) {
+            sizeClass++;
+        }
+        if (histogram->size() <= sizeClass) {
+            histogram->resize(sizeClass + 1, 0);
+        }
+        (*histogram)[sizeClass]++;
+    }
+}
\ No newline at end of file
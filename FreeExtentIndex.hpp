@@ -0,0 +1,98 @@
+#ifndef _FREE_EXTENT_INDEX_HPP_
+#define _FREE_EXTENT_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+    /* runs of free data clusters, it follows bitmap
+     * runs are ordered by start for first and next fit and by size for best fit and the largest one
+    */
+    class FreeExtentIndex {
+
+        private:
+
+            // first cluster of run - count of clusters
+            std::map<int32_t, int32_t> extents;
+            // negative count and start of run, the largest and first run is the first one
+            std::set<std::pair<int32_t, int32_t>> sizes;
+            int32_t freeClusters;
+
+            void insert(const int32_t start, const int32_t count);
+            void erase(std::map<int32_t, int32_t>::iterator extent);
+
+        public:
+
+            FreeExtentIndex() : freeClusters(0) {};
+
+            /* build runs from part of bitmap
+             * +param - bitmap - bitmap of data clusters, set bit is used cluster
+             * +param - first - the first data cluster of part, multiple of 8
+             * +param - end - data cluster behind the last one of part
+            */
+            void build(const unsigned char * bitmap, const int32_t first, const int32_t end);
+            /* remove free cluster from its run
+             * +param - cluster - index of data cluster
+             * +return true - cluster was free, false - it is not in any run
+            */
+            bool allocate(const int32_t cluster);
+            /* remove free clusters from their run
+             * +param - start - index of first data cluster, clusters must be in one run
+             * +param - count - count of data clusters
+            */
+            void allocate(const int32_t start, const int32_t count);
+            /* add free cluster, it is merged with neighbouring runs
+             * +param - cluster - index of data cluster
+             * +return true - cluster was added, false - it is free already
+            */
+            bool release(const int32_t cluster);
+            /* add free clusters, they are merged with neighbouring runs
+             * +param - start - index of first data cluster, no cluster of them may be free already
+             * +param - count - count of data clusters
+            */
+            void release(const int32_t start, const int32_t count);
+            void clear();
+            /* find the first run with given count of clusters
+             * +param - count - count of clusters
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is none
+            */
+            int32_t findFirst(const int32_t count, int32_t * start) const;
+            /* find the first run with given count of clusters from given cluster, search wraps around to start of volume
+             * +param - count - count of clusters
+             * +param - from - data cluster where search starts
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is none
+            */
+            int32_t findNext(const int32_t count, const int32_t from, int32_t * start) const;
+            /* find the smallest run with given count of clusters, the first one of the same size
+             * +param - count - count of clusters
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is none
+            */
+            int32_t findBest(const int32_t count, int32_t * start) const;
+            /* find run with given count of clusters nearest to given cluster
+             * +param - count - count of clusters
+             * +param - goal - data cluster the run should be near to
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is none
+            */
+            int32_t findNear(const int32_t count, const int32_t goal, int32_t * start) const;
+            /* find the largest run, the first one of the same size
+             * +param - start - first cluster of found run
+             * +return count of clusters of found run, 0 if there is no free cluster
+            */
+            int32_t findLargest(int32_t * start) const;
+            /* count runs by their size, sizes of runs in one class are from 2^k to 2^(k+1) - 1 clusters
+             * +param - histogram - count of runs of class k at index k
+            */
+            void histogram(std::vector<int32_t> * histogram) const;
+
+            const std::map<int32_t, int32_t> & getExtents() const {return extents;};
+            int32_t getFreeClusters() const {return freeClusters;};
+    };
+
+#endif
\ No newline at end of file
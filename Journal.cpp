@@ -0,0 +1,349 @@
+#include <cstring>
+#include <unistd.h>
+
+#include "Journal.hpp"
+#include "Utils.hpp"
+
+void JournalTransaction::addRecord(const int8_t type, const int64_t offset, const unsigned char * data, const int32_t length) {
+
+    struct journal_record record;
+    record.type = type;
+    record.length = length;
+    record.offset = offset;
+
+    records.insert(records.end(), (unsigned char *) &record, (unsigned char *) &record + sizeof(journal_record));
+    records.insert(records.end(), data, data + length);
+    recordCount++;
+}
+
+void JournalTransaction::addOrderedRecord(const int64_t offset, const unsigned char * data, const int32_t length) {
+
+    struct journal_record record;
+    record.type = JOURNAL_RECORD_REVOKE;
+    record.length = length;
+    record.offset = offset;
+
+    orderedRecords.insert(orderedRecords.end(), (unsigned char *) &record, (unsigned char *) &record + sizeof(journal_record));
+    orderedRecords.insert(orderedRecords.end(), data, data + length);
+
+    // revoke has no data in log
+    records.insert(records.end(), (unsigned char *) &record, (unsigned char *) &record + sizeof(journal_record));
+    recordCount++;
+}
+
+void JournalTransaction::addZeroRecord(const int64_t offset, const int32_t length) {
+
+    struct journal_record record;
+    record.type = JOURNAL_RECORD_ZERO;
+    record.length = length;
+    record.offset = offset;
+
+    records.insert(records.end(), (unsigned char *) &record, (unsigned char *) &record + sizeof(journal_record));
+    recordCount++;
+}
+
+Journal::Journal(unsigned char * region, const int64_t regionOffset, const int32_t regionSize, const int volumeFile) {
+
+    this->region = region;
+    this->regionOffset = regionOffset;
+    this->regionSize = regionSize;
+    this->volumeFile = volumeFile;
+
+    groupCommit = true;
+    flushing = false;
+    nextSequence = 1;
+    durableSequence = 0;
+
+    commitCount = 0;
+    flushCount = 0;
+    unloggedCount = 0;
+}
+
+void Journal::format() {
+
+    memset(region, 0, regionSize);
+
+    struct journal_header * header = (journal_header *) region;
+    strcpy(header->signature, JOURNAL_SIGNATURE);
+    header->sequence = nextSequence;
+
+    writeVolume(regionOffset, region, regionSize);
+}
+
+int32_t Journal::replay(unsigned char * volume, const int64_t volumeSize) {
+
+    struct journal_header * header = (journal_header *) region;
+
+    if (strcmp(header->signature, JOURNAL_SIGNATURE) != 0) {
+        format();
+        return 0;
+    }
+
+    struct journal_transaction_header transactionHeader;
+    std::map<int64_t, int64_t> revoked;
+    std::list<int32_t> transactions;
+    int64_t expectedSequence = header->sequence;
+    int32_t position = sizeof(journal_header);
+
+    // first pass - find complete transactions and their revoke records
+    while (position + (int32_t) sizeof(journal_transaction_header) <= regionSize) {
+
+        memcpy(&transactionHeader, &region[position], sizeof(journal_transaction_header));
+
+        if (transactionHeader.magic != JOURNAL_TRANSACTION_MAGIC || transactionHeader.length < 0 || transactionHeader.length > regionSize - position - (int32_t) sizeof(journal_transaction_header)) {
+            break;
+        }
+
+        // first transaction may follow already checkpointed ones, the rest must be continual
+        if ((transactions.empty() && transactionHeader.sequence < expectedSequence) || (!transactions.empty() && transactionHeader.sequence != expectedSequence)) {
+            break;
+        }
+
+        // torn write of last transaction
+        if (checksum(&region[position + sizeof(journal_transaction_header)], transactionHeader.length) != transactionHeader.checksum) {
+            break;
+        }
+
+        collectRevoked(&region[position + sizeof(journal_transaction_header)], transactionHeader.length, transactionHeader.sequence, &revoked);
+        transactions.push_back(position);
+        position += sizeof(journal_transaction_header) + transactionHeader.length;
+        expectedSequence = transactionHeader.sequence + 1;
+    }
+
+    // second pass - redo after images
+    for (int32_t transactionPosition : transactions) {
+        memcpy(&transactionHeader, &region[transactionPosition], sizeof(journal_transaction_header));
+        checkpoint(&region[transactionPosition + sizeof(journal_transaction_header)], transactionHeader.length, transactionHeader.sequence, &revoked, volume, volumeSize);
+    }
+
+    int32_t replayed = transactions.size();
+    if (replayed > 0) {
+        syncVolume();
+    }
+
+    nextSequence = expectedSequence;
+    durableSequence = expectedSequence - 1;
+    header->sequence = expectedSequence;
+    writeHeader();
+    syncVolume();
+
+    return replayed;
+}
+
+int64_t Journal::enqueue(JournalTransaction * transaction) {
+
+    if (transaction->isEmpty()) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    transaction->sequence = nextSequence++;
+    pending.push_back(std::move(*transaction));
+    commitCount++;
+
+    return pending.back().sequence;
+}
+
+void Journal::waitDurable(const int64_t sequence) {
+
+    if (sequence == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (durableSequence < sequence) {
+
+        // someone else is flushing, our transaction may be part of his batch
+        if (flushing) {
+            flushed.wait(lock);
+            continue;
+        }
+
+        // become leader and flush everything what is waiting
+        flushing = true;
+        std::list<JournalTransaction> batch;
+        if (groupCommit) {
+            batch.splice(batch.end(), pending);
+        }
+        else {
+            batch.splice(batch.end(), pending, pending.begin());
+        }
+
+        lock.unlock();
+        writeBatch(&batch);
+        lock.lock();
+
+        durableSequence = batch.back().sequence;
+        flushing = false;
+        flushed.notify_all();
+    }
+}
+
+void Journal::writeBatch(std::list<JournalTransaction> * batch) {
+
+    struct journal_header * header = (journal_header *) region;
+    struct journal_transaction_header transactionHeader;
+    transactionHeader.magic = JOURNAL_TRANSACTION_MAGIC;
+
+    std::list<JournalTransaction>::iterator first = batch->begin();
+    std::list<JournalTransaction>::iterator it;
+    std::map<int64_t, int64_t> revoked;
+
+    while (first != batch->end()) {
+
+        int32_t position = sizeof(journal_header);
+        int64_t lastSequence = 0;
+        revoked.clear();
+
+        // log as many transactions as fits to journal region
+        for (it = first; it != batch->end(); it++) {
+
+            int32_t length = it->records.size();
+            if (position + (int32_t) sizeof(journal_transaction_header) + length > regionSize) {
+                break;
+            }
+
+            transactionHeader.record_count = it->recordCount;
+            transactionHeader.sequence = it->sequence;
+            transactionHeader.length = length;
+            transactionHeader.checksum = checksum(it->records.data(), length);
+
+            memcpy(&region[position], &transactionHeader, sizeof(journal_transaction_header));
+            position += sizeof(journal_transaction_header);
+            memcpy(&region[position], it->records.data(), length);
+            position += length;
+
+            collectRevoked(it->records.data(), length, it->sequence, &revoked);
+            lastSequence = it->sequence;
+        }
+
+        if (it == first) {
+            // transaction is bigger than journal region, it can only be written directly, crash in it is not recovered
+            unloggedCount++;
+            writeOrdered(&(*first));
+            checkpoint(first->records.data(), first->records.size(), first->sequence, NULL, NULL, 0);
+            syncVolume();
+            first++;
+            continue;
+        }
+
+        // ordered data goes first, so metadata never points to unwritten clusters
+        for (std::list<JournalTransaction>::iterator data = first; data != it; data++) {
+            writeOrdered(&(*data));
+        }
+
+        // write-ahead - log is durable before any home location is touched
+        writeVolume(regionOffset + sizeof(journal_header), &region[sizeof(journal_header)], position - sizeof(journal_header));
+        syncVolume();
+        flushCount++;
+
+        for (; first != it; first++) {
+            checkpoint(first->records.data(), first->records.size(), first->sequence, &revoked, NULL, 0);
+        }
+        syncVolume();
+
+        // replay would only repeat checkpointed transactions, header does not need to be synced
+        header->sequence = lastSequence + 1;
+        writeHeader();
+    }
+}
+
+void Journal::writeOrdered(const JournalTransaction * transaction) {
+
+    struct journal_record record;
+    int32_t position = 0;
+    int32_t length = transaction->orderedRecords.size();
+
+    while (position < length) {
+
+        memcpy(&record, &transaction->orderedRecords[position], sizeof(journal_record));
+        position += sizeof(journal_record);
+
+        writeVolume(record.offset, &transaction->orderedRecords[position], record.length);
+        position += record.length;
+    }
+}
+
+void Journal::checkpoint(const unsigned char * records, const int32_t length, const int64_t sequence, const std::map<int64_t, int64_t> * revoked, unsigned char * volume, const int64_t volumeSize) {
+
+    struct journal_record record;
+    int32_t position = 0;
+
+    while (position < length) {
+
+        memcpy(&record, &records[position], sizeof(journal_record));
+        position += sizeof(journal_record);
+
+        if (record.type == JOURNAL_RECORD_REVOKE) {
+            continue;
+        }
+
+        // range was rewritten with data by later transaction
+        int32_t dataLength = record.type == JOURNAL_RECORD_ZERO ? 0 : record.length;
+        std::map<int64_t, int64_t>::const_iterator revoke;
+        if (revoked != NULL && (revoke = revoked->find(record.offset)) != revoked->end() && revoke->second > sequence) {
+            position += dataLength;
+            continue;
+        }
+
+        // freed clusters are cleared only now, metadata which used them are not pointing to them any more
+        if (record.type == JOURNAL_RECORD_ZERO) {
+            std::vector<unsigned char> zeros(record.length, 0);
+            if (volume != NULL && record.offset + record.length <= volumeSize) {
+                memset(&volume[record.offset], 0, record.length);
+            }
+            writeVolume(record.offset, zeros.data(), record.length);
+            continue;
+        }
+
+        if (volume != NULL && record.offset + record.length <= volumeSize) {
+            memcpy(&volume[record.offset], &records[position], record.length);
+        }
+        writeVolume(record.offset, &records[position], record.length);
+
+        position += record.length;
+    }
+}
+
+void Journal::collectRevoked(const unsigned char * records, const int32_t length, const int64_t sequence, std::map<int64_t, int64_t> * revoked) {
+
+    struct journal_record record;
+    int32_t position = 0;
+
+    while (position < length) {
+
+        memcpy(&record, &records[position], sizeof(journal_record));
+        position += sizeof(journal_record);
+
+        if (record.type == JOURNAL_RECORD_REVOKE) {
+            (*revoked)[record.offset] = sequence;
+        }
+        else if (record.type != JOURNAL_RECORD_ZERO) {
+            position += record.length;
+        }
+    }
+}
+
+void Journal::writeHeader() {
+    writeVolume(regionOffset, region, sizeof(journal_header));
+}
+
+void Journal::writeVolume(const int64_t offset, const unsigned char * data, const int64_t length) {
+
+    if (volumeFile < 0) {
+        return;
+    }
+
+    writeFileAt(volumeFile, offset, data, length);
+}
+
+void Journal::syncVolume() {
+
+    if (volumeFile < 0) {
+        return;
+    }
+
+    fsync(volumeFile);
+}
\ No newline at end of file
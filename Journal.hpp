@@ -0,0 +1,193 @@
+#ifndef _JOURNAL_HPP_
+#define _JOURNAL_HPP_
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+    const char JOURNAL_SIGNATURE[] = "PNTFSJRN";
+    const int32_t JOURNAL_TRANSACTION_MAGIC = 0x4a524e4c;
+
+    // types of journaled metadata updates
+    const int8_t JOURNAL_RECORD_MFT = 1;
+    const int8_t JOURNAL_RECORD_BITMAP = 2;
+    const int8_t JOURNAL_RECORD_DIRECTORY = 3;
+    // data cluster written in ordered mode, earlier images of the same range must not be replayed
+    const int8_t JOURNAL_RECORD_REVOKE = 4;
+    const int8_t JOURNAL_RECORD_CHECKSUM = 5;
+    const int8_t JOURNAL_RECORD_BOOT = 6;
+    // freed data cluster cleared when transaction is written to its home locations, log has only length of range
+    const int8_t JOURNAL_RECORD_ZERO = 7;
+
+    struct journal_header {
+        char signature[9];          //podpis zurnalu
+        int64_t sequence;           //prvni transakce, ktera jeste neni zapsana na sve misto ve svazku
+    };
+
+    struct journal_transaction_header {
+        int32_t magic;              //JOURNAL_TRANSACTION_MAGIC
+        int32_t record_count;       //pocet zaznamu v transakci
+        int64_t sequence;           //poradove cislo transakce
+        int32_t length;             //delka zaznamu transakce v bytech (bez hlavicky)
+        uint32_t checksum;          //kontrolni soucet zaznamu transakce
+    };
+
+    struct journal_record {
+        int8_t type;                //MFT, bitmapa, adresar nebo zruseni
+        int32_t length;             //delka zapisovanych dat (zruseni nema data, jen delku rozsahu)
+        int64_t offset;             //adresa zapisovanych dat od pocatku svazku
+    };
+
+    // range of volume updated by running transaction
+    struct journal_range {
+        int8_t type;
+        int32_t length;
+    };
+
+    /* metadata transaction - after images of updated volume ranges
+     * data clusters are not logged, they are written before the log (ordered mode)
+    */
+    class JournalTransaction {
+
+        public:
+
+            std::vector<unsigned char> records;
+            std::vector<unsigned char> orderedRecords;
+            int32_t recordCount = 0;
+            int64_t sequence = 0;
+
+            /* append after image of volume range to transaction
+             * +param - type - type of updated metadata
+             * +param - offset - offset of range from volume start
+             * +param - data - new content of range
+             * +param - length - length of range in bytes
+            */
+            void addRecord(const int8_t type, const int64_t offset, const unsigned char * data, const int32_t length);
+            /* append data range written before the log, the log gets only its revoke record
+             * +param - offset - offset of range from volume start
+             * +param - data - new content of range
+             * +param - length - length of range in bytes
+            */
+            void addOrderedRecord(const int64_t offset, const unsigned char * data, const int32_t length);
+            /* append range cleared after the log, it is replayed with metadata of transaction
+             * +param - offset - offset of range from volume start
+             * +param - length - length of range in bytes
+            */
+            void addZeroRecord(const int64_t offset, const int32_t length);
+            /* +return true - transaction has no records, else false
+            */
+            bool isEmpty() const {return recordCount == 0;};
+    };
+
+    /* write-ahead journal of metadata updates stored in journal region of volume
+     * transactions committed by concurrent operations are batched into one flush (group commit)
+     * THREAD SAFE
+    */
+    class Journal {
+
+        private:
+
+            unsigned char * region;
+            int64_t regionOffset;
+            int32_t regionSize;
+            int volumeFile;
+
+            bool groupCommit;
+
+            std::mutex mutex;
+            std::condition_variable flushed;
+            std::list<JournalTransaction> pending;
+            int64_t nextSequence;
+            int64_t durableSequence;
+            bool flushing;
+
+            /* statistics */
+            int64_t commitCount;
+            int64_t flushCount;
+            int64_t unloggedCount;
+
+            /* write batch of transactions to journal region, flush it and write records to their home locations
+             * +param - batch - transactions to be written
+            */
+            void writeBatch(std::list<JournalTransaction> * batch);
+            /* write records of transaction to their home locations in volume
+             * records revoked by later transaction are skipped
+             * +param - records - encoded records of transaction
+             * +param - length - length of transaction records
+             * +param - sequence - sequence of transaction
+             * +param - revoked - offsets of revoked ranges and sequence of last transaction revoking them
+             * +param - volume - in-memory volume records are also copied to, or NULL
+             * +param - volumeSize - size of in-memory volume, records behind it are only written to host file
+            */
+            void checkpoint(const unsigned char * records, const int32_t length, const int64_t sequence, const std::map<int64_t, int64_t> * revoked, unsigned char * volume, const int64_t volumeSize);
+            /* collect revoke records of transaction
+             * +param - records - encoded records of transaction
+             * +param - length - length of transaction records
+             * +param - sequence - sequence of transaction
+             * +param - revoked - offsets of revoked ranges and sequence of last transaction revoking them
+            */
+            void collectRevoked(const unsigned char * records, const int32_t length, const int64_t sequence, std::map<int64_t, int64_t> * revoked);
+            /* write ordered data of transaction to their home locations in volume
+             * +param - transaction - transaction with ordered data
+            */
+            void writeOrdered(const JournalTransaction * transaction);
+            /* write header of journal region to volume
+            */
+            void writeHeader();
+            /* write bytes to volume file
+             * +param - offset - offset from volume start
+             * +param - data - bytes to write
+             * +param - length - count of bytes
+            */
+            void writeVolume(const int64_t offset, const unsigned char * data, const int64_t length);
+            /* flush volume file to stable storage
+            */
+            void syncVolume();
+
+        public:
+
+            /* +param - region - journal region in in-memory volume
+             * +param - regionOffset - offset of journal region from volume start
+             * +param - regionSize - size of journal region in bytes
+             * +param - volumeFile - descriptor of host file with volume, or -1 for in-memory volume
+            */
+            Journal(unsigned char * region, const int64_t regionOffset, const int32_t regionSize, const int volumeFile);
+
+            /* initialize empty journal region
+            */
+            void format();
+            /* apply all complete transactions from journal region to volume
+             * +param - volume - in-memory volume, records are copied to it
+             * +param - volumeSize - size of in-memory volume, records behind it are only written to host file
+             * +return count of replayed transactions
+            */
+            int32_t replay(unsigned char * volume, const int64_t volumeSize);
+
+            /* queue transaction for flush
+             * +param - transaction - transaction to be committed, it is moved to journal
+             * +return sequence of transaction, 0 for empty transaction
+            */
+            int64_t enqueue(JournalTransaction * transaction);
+            /* block until transaction with given sequence is durable
+             * calling thread may flush transactions of other threads together with its own
+             * +param - sequence - sequence returned by enqueue
+            */
+            void waitDurable(const int64_t sequence);
+
+            /* true - concurrent commits are batched into one flush, false - every commit is flushed alone
+            */
+            void setGroupCommit(const bool groupCommit) {this->groupCommit = groupCommit;};
+
+            /* +return the longest records of transaction that fit journal region
+            */
+            int32_t getCapacity() const {return regionSize - sizeof(journal_header) - sizeof(journal_transaction_header);};
+            int64_t getCommitCount() const {return commitCount;};
+            int64_t getFlushCount() const {return flushCount;};
+            // transactions bigger than journal region, they were written to volume without log
+            int64_t getUnloggedCount() const {return unloggedCount;};
+    };
+
+#endif
\ No newline at end of file
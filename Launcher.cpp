@@ -3,12 +3,18 @@
 
 #include "PseudoNTFS.hpp"
 #include "Path.hpp"
+#include "Benchmark.hpp"
+#include "Utils.hpp"
 
 const int32_t DISK_SIZE = 100000;
 const int32_t CLUSTER_SIZE = 100; 
+// blocks of zeros of this size are left as holes in exported host file
+const int32_t HOST_BLOCK_SIZE = 4096;
 
 Path * currentPath;
 PseudoNTFS * pntfs;
+// volume of mounted snapshot, NULL when shell works with volume itself
+PseudoNTFS * mountedVolume = NULL;
 
 using namespace std;
 
@@ -25,15 +31,53 @@ void executeOutcp(string * fparam, string * sParam);
 void executeRm(string * param);
 void executeMv(string * fParam, string * sParam);
 void executeCp(string * fParam, string * sParam) ;
+void executeRmTree(string * param);
+void executeCpTree(string * fParam, string * sParam);
+bool isOnPath(Path path, const int32_t mftItemIndex);
+void executeFind(string * fParam, string * sParam, string * tParam);
+void executeDu(string * param);
+void executeTree(string * param);
+void executeLocate(string * param);
+void executeNames(string * param);
+void executeChdisk(string * param);
+void executeScrub();
+void executeVerify(string * param);
+void executeCompress(string * param);
+void executeDedup(string * param);
+void executeDelay(string * fParam, string * sParam);
+void executeAlloc(string * fParam);
+void executeAppend(string * fParam, string * sParam);
+void executeTruncate(string * fParam, string * sParam);
+void executePreallocate(string * fParam, string * sParam, string * tParam);
+void executeSnapshot(string * fParam, string * sParam);
+void executeExportImage(string * fParam, string * sParam, const bool incremental);
+void executeImportImage(string * fParam, string * sParam);
+bool isChangingCommand(const string & token);
+void executeBench(string * fParam, string * sParam);
 
 int main(int argc, char * argv[]) {
 
-    if (argc != 2) {
-        cout << "USAGE: PseudoNTFS.out <signature>";
+    if (argc < 2 || argc > 4) {
+        cout << "USAGE: PseudoNTFS.out <signature> [volume file] [cached clusters]";
         exit(0);
     }
 
-    pntfs = new PseudoNTFS(DISK_SIZE, CLUSTER_SIZE, argv[1]);
+    // volume in host file can be accessed through cache of data clusters
+    int32_t cacheClusters = 0;
+    if (argc == 4) {
+        cacheClusters = atoi(argv[3]);
+    }
+
+    if (argc == 2) {
+        pntfs = new PseudoNTFS(DISK_SIZE, CLUSTER_SIZE, argv[1]);
+    }
+    else if (ifstream(argv[2])) {
+        // existing volume is mounted
+        pntfs = new PseudoNTFS(argv[2], cacheClusters);
+    }
+    else {
+        pntfs = new PseudoNTFS(DISK_SIZE, CLUSTER_SIZE, argv[1], argv[2], cacheClusters);
+    }
 
     currentPath = new Path(pntfs);
   
@@ -51,7 +95,12 @@ int main(int argc, char * argv[]) {
         executeCommand(command);
         cout << endl;
     
-    }  
+    }
+
+    delete currentPath;
+    delete pntfs;
+    // volume is unmounted after its snapshot
+    delete mountedVolume;
 }
 
 void executeCommand(string command) {
@@ -60,21 +109,39 @@ void executeCommand(string command) {
     string token, fParam, sParam;
   
     getline(iss, token, DELIMETER);
+
+    if (pntfs->isSnapshot() && isChangingCommand(token)) {
+        cout << "SNAPSHOT IS READ-ONLY";
+        return;
+    }
   
     if (command == "PDISK" || command == "pdisk") {
             pntfs->printDisk();
     }
-    else if (command == "chdisk") {
-        if (pntfs->checkDiskConsistency()) {
-            cout << ">> DISK IS OK";
-        }
-        else {
-            cout << "DISK IS CORRUPTED";
-        }
+    else if (token == "chdisk") {
+        getline(iss, fParam, DELIMETER);
+        executeChdisk(&fParam);
+    }
+    else if (command == "scrub") {
+        executeScrub();
     }
     else if (command == "ddisk") {
         pntfs->defragmentDisk();
     }
+    else if (command == "cache") {
+        pntfs->printCacheStatistics();
+    }
+    else if (command == "indexes") {
+        pntfs->printIndexStatistics();
+    }
+    else if (command == "df") {
+        pntfs->printSpaceStatistics();
+    }
+    else if (command == "sync") {
+        if (pntfs->sync()) {
+            cout << "OK";
+        }
+    }
     else if (token ==  "load") {
         getline(iss, fParam, DELIMETER);
 
@@ -129,7 +196,13 @@ void executeCommand(string command) {
     }
     else if (token == "rm") {
         getline(iss, fParam, DELIMETER);
-        executeRm(&fParam); 
+        if (fParam == "-r") {
+            getline(iss, fParam, DELIMETER);
+            executeRmTree(&fParam);
+        }
+        else {
+            executeRm(&fParam); 
+        }
     }
     else if (token == "mv") {
         getline(iss, fParam, DELIMETER);
@@ -137,13 +210,122 @@ void executeCommand(string command) {
         executeMv(&fParam, &sParam);
     }
     else if (token == "cp") {
+        getline(iss, fParam, DELIMETER);
+        if (fParam == "-r") {
+            getline(iss, fParam, DELIMETER);
+            getline(iss, sParam, DELIMETER);
+            executeCpTree(&fParam, &sParam);
+        }
+        else {
+            getline(iss, sParam, DELIMETER);
+            executeCp(&fParam, &sParam);
+        }
+    }
+    else if (token == "find") {
+        string tParam;
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam, DELIMETER);
+        getline(iss, tParam, DELIMETER);
+        executeFind(&fParam, &sParam, &tParam);
+    }
+    else if (token == "du") {
+        getline(iss, fParam, DELIMETER);
+        executeDu(&fParam);
+    }
+    else if (token == "tree") {
+        getline(iss, fParam, DELIMETER);
+        executeTree(&fParam);
+    }
+    else if (token == "locate") {
+        getline(iss, fParam, DELIMETER);
+        executeLocate(&fParam);
+    }
+    else if (token == "names") {
+        getline(iss, fParam, DELIMETER);
+        executeNames(&fParam);
+    }
+    else if (token == "compress") {
+        getline(iss, fParam, DELIMETER);
+        executeCompress(&fParam);
+    }
+    else if (token == "verify") {
+        getline(iss, fParam, DELIMETER);
+        executeVerify(&fParam);
+    }
+    else if (token == "dedup") {
+        getline(iss, fParam, DELIMETER);
+        executeDedup(&fParam);
+    }
+    else if (token == "delay") {
         getline(iss, fParam, DELIMETER);
         getline(iss, sParam, DELIMETER);
-        executeCp(&fParam, &sParam);
+        executeDelay(&fParam, &sParam);
+    }
+    else if (token == "alloc") {
+        getline(iss, fParam, DELIMETER);
+        executeAlloc(&fParam);
+    }
+    else if (token == "append") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam);
+        executeAppend(&fParam, &sParam);
+    }
+    else if (token == "truncate") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam, DELIMETER);
+        executeTruncate(&fParam, &sParam);
+    }
+    else if (token == "falloc") {
+        string tParam;
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam, DELIMETER);
+        getline(iss, tParam, DELIMETER);
+        executePreallocate(&fParam, &sParam, &tParam);
+    }
+    else if (token == "snapshot") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam, DELIMETER);
+        executeSnapshot(&fParam, &sParam);
+    }
+    else if (token == "export-image") {
+        getline(iss, fParam, DELIMETER);
+        executeExportImage(&fParam, &sParam, false);
+    }
+    else if (token == "export-incremental") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam, DELIMETER);
+        executeExportImage(&fParam, &sParam, true);
+    }
+    else if (token == "apply-incremental") {
+        getline(iss, fParam, DELIMETER);
+        if (pntfs->importImage(fParam.c_str())) {
+            cout << "OK";
+        }
+    }
+    else if (token == "import-image") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam);
+        executeImportImage(&fParam, &sParam);
+    }
+    else if (token == "bench") {
+        getline(iss, fParam, DELIMETER);
+        getline(iss, sParam);
+        executeBench(&fParam, &sParam);
     }
   
 }
 
+bool isChangingCommand(const string & token) {
+
+    const char * commands[] = {"ddisk", "incp", "mkdir", "rmdir", "rm", "mv", "cp", "compress", "dedup", "delay", "alloc", "append", "truncate", "falloc", "apply-incremental"};
+    for (const char * command : commands) {
+        if (token == command) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void executeCd(string * param) {
 
     char * path = new char[param->length() + 1];
@@ -310,10 +492,7 @@ void executeOutcp(string * fParam, string * sParam) {
     if (tempPath.change(path, false)) {
         string content;
         if (pntfs->loadFileFromPseudoNtfs(tempPath.getCurrentMftIndex(), &content)) {
-            ofstream file(*sParam);
-            if (file) {
-                file << content;
-                file.close();
+            if (writeSparseFile(sParam->c_str(), content, HOST_BLOCK_SIZE)) {
                 cout << "OK"; 
             }
             else {
@@ -409,4 +588,596 @@ void executeCp(string * fParam, string * sParam) {
 
     delete [] fPath;
     delete [] sPath;
+}
+
+void executeRmTree(string * param) {
+
+    char * path = new char[param->length() + 1];
+    strcpy(path, param->c_str());
+
+    // path of file or directory, directory is tried first
+    Path tempPath = *currentPath;
+    if (tempPath.change(path, true) || (tempPath = *currentPath, tempPath.change(path, false))) {
+        int32_t mftItemIndex = tempPath.getCurrentMftIndex();
+        // current directory cannot lose any directory of its path
+        if (isOnPath(*currentPath, mftItemIndex) || !tempPath.goBack()) {
+            cout << "CANNOT REMOVE DIRECTORY ON CURRENT PATH";
+        }
+        else if (pntfs->removeTree(mftItemIndex, tempPath.getCurrentMftIndex())) {
+            cout << "OK";
+        }
+    }
+    else {
+        cout << "PATH NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeCpTree(string * fParam, string * sParam) {
+
+    char * fPath = new char[fParam->length() + 1];
+    strcpy(fPath, fParam->c_str());
+
+    char * sPath = new char[sParam->length() + 1];
+    strcpy(sPath, sParam->c_str());
+
+    Path tempPath = *currentPath;
+    if (tempPath.change(fPath, true) || (tempPath = *currentPath, tempPath.change(fPath, false))) {
+        int32_t mftItemIndex = tempPath.getCurrentMftIndex();
+        Path toPath = *currentPath;
+        if (!toPath.change(sPath, true)) {
+            cout << "PATH NOT FOUND";
+        }
+        // directory copied into its own subtree would copy itself forever
+        else if (isOnPath(toPath, mftItemIndex)) {
+            cout << "CANNOT COPY DIRECTORY INTO ITSELF";
+        }
+        else if (pntfs->copyTree(mftItemIndex, toPath.getCurrentMftIndex())) {
+            cout << "OK";
+        }
+    }
+    else {
+        cout << "PATH NOT FOUND";
+    }
+
+    delete [] fPath;
+    delete [] sPath;
+}
+
+bool isOnPath(Path path, const int32_t mftItemIndex) {
+
+    do {
+        if (path.getCurrentMftIndex() == mftItemIndex) {
+            return true;
+        }
+    } while (path.goBack());
+
+    return false;
+}
+
+void executeFind(string * fParam, string * sParam, string * tParam) {
+
+    if (*sParam != "-name" || tParam->empty()) {
+        cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    char * path = new char[fParam->length() + 1];
+    strcpy(path, fParam->c_str());
+
+    Path tempPath = *currentPath;
+    if (tempPath.change(path, true)) {
+        vector<string> paths;
+        pntfs->findItems(tempPath.getCurrentMftIndex(), tParam->c_str(), &paths);
+        // paths are printed as they were given, relative or from root
+        string prefix = *fParam;
+        if (!prefix.empty() && prefix.back() != PATH_SEPARATOR) {
+            prefix += PATH_SEPARATOR;
+        }
+        for (size_t i = 0; i < paths.size(); i++) {
+            cout << (i > 0 ? "\n" : "") << prefix << paths[i];
+        }
+    }
+    else {
+        cout << "PATH NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeDu(string * param) {
+
+    char * path = new char[param->length() + 1];
+    strcpy(path, param->c_str());
+
+    Path tempPath = *currentPath;
+    if (tempPath.change(path, true)) {
+        struct tree_usage usage;
+        pntfs->diskUsage(tempPath.getCurrentMftIndex(), &usage);
+        cout << usage.size << " B in " << usage.files << " files, " << usage.directories << " directories, " << usage.allocated << " B allocated";
+    }
+    else {
+        cout << "PATH NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeTree(string * param) {
+
+    char * path = new char[param->length() + 1];
+    strcpy(path, param->c_str());
+
+    Path tempPath = *currentPath;
+    if (tempPath.change(path, true)) {
+        pntfs->printTree(tempPath.getCurrentMftIndex());
+    }
+    else {
+        cout << "PATH NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeLocate(string * param) {
+
+    if (param->empty()) {
+        cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    vector<int32_t> indexes;
+    pntfs->locateItems(param->c_str(), &indexes);
+    bool first = true;
+    for (int32_t index : indexes) {
+        cout << (first ? "" : "\n") << (pntfs->isItemDirectory(index) ? "+" : "-") << pntfs->getItemName(index);
+        first = false;
+    }
+}
+
+void executeNames(string * param) {
+
+    // statistics of index can be printed on snapshot too
+    if (pntfs->isSnapshot() && !param->empty()) {
+        cout << "SNAPSHOT IS READ-ONLY";
+    }
+    else if (*param == "on" || *param == "off") {
+        if (pntfs->setNameIndex(*param == "on")) {
+            cout << "OK";
+        }
+    }
+    else if (*param == "save") {
+        if (!pntfs->hasNameIndex()) {
+            cout << "NAME INDEX IS OFF";
+        }
+        else if (pntfs->flushNameIndex()) {
+            cout << "OK";
+        }
+    }
+    else if (param->empty()) {
+        pntfs->printNameIndexStatistics();
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeChdisk(string * param) {
+
+    // sizes - data of files are not read, only count of their clusters is compared with their size
+    // checksums - sizes are checked the same way, every used data cluster is compared with its checksum
+    if (!param->empty() && *param != "sizes" && *param != "checksums") {
+        cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    if (pntfs->checkDiskConsistency(param->empty(), *param == "checksums")) {
+        cout << ">> DISK IS OK";
+    }
+    else {
+        cout << "DISK IS CORRUPTED";
+    }
+}
+
+void executeScrub() {
+
+    vector<int32_t> corrupted;
+    if (pntfs->scrub(&corrupted)) {
+        cout << "OK";
+        return;
+    }
+
+    cout << "CORRUPTED CLUSTERS:";
+    for (int32_t index : corrupted) {
+        cout << " " << index;
+    }
+}
+
+void executeVerify(string * param) {
+
+    if (*param == "on") {
+        pntfs->setVerifyChecksums(true);
+        cout << "OK";
+    }
+    else if (*param == "off") {
+        pntfs->setVerifyChecksums(false);
+        cout << "OK";
+    }
+    else if (param->empty()) {
+        cout << (pntfs->getVerifyChecksums() ? "VERIFY ON" : "VERIFY OFF");
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeCompress(string * param) {
+
+    if (*param == "on") {
+        pntfs->setCompression(true);
+        cout << "OK";
+    }
+    else if (*param == "off") {
+        pntfs->setCompression(false);
+        cout << "OK";
+    }
+    else if (param->empty()) {
+        cout << (pntfs->getCompression() ? "COMPRESSION ON" : "COMPRESSION OFF");
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeDedup(string * param) {
+
+    if (*param == "on") {
+        pntfs->setDeduplication(true);
+        cout << "OK";
+    }
+    else if (*param == "off") {
+        pntfs->setDeduplication(false);
+        cout << "OK";
+    }
+    else if (param->empty()) {
+        pntfs->printDeduplicationStatistics();
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeDelay(string * fParam, string * sParam) {
+
+    if (*fParam == "on") {
+        // budget in kB
+        int32_t budget = DELAYED_BUDGET / 1024;
+        istringstream(*sParam) >> budget;
+        if (budget <= 0) {
+            cout << "INVALID PARAMETERS";
+            return;
+        }
+        pntfs->setDelayedAllocation(true, budget * 1024);
+        cout << "OK";
+    }
+    else if (*fParam == "off") {
+        pntfs->setDelayedAllocation(false, DELAYED_BUDGET);
+        cout << "OK";
+    }
+    else if (fParam->empty()) {
+        pntfs->printDelayedStatistics();
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeAlloc(string * fParam) {
+
+    if (fParam->empty()) {
+        cout << "Allocation policy: " << ALLOCATION_POLICY_NAMES[pntfs->getAllocationPolicy()];
+        return;
+    }
+
+    for (int32_t policy = 0; policy < ALLOCATION_POLICIES_COUNT; policy++) {
+        if (*fParam == ALLOCATION_POLICY_NAMES[policy]) {
+            pntfs->setAllocationPolicy(policy);
+            cout << "OK";
+            return;
+        }
+    }
+    cout << "INVALID PARAMETERS";
+}
+
+void executeAppend(string * fParam, string * sParam) {
+
+    char * path = new char[fParam->length() + 1];
+    strcpy(path, fParam->c_str());
+
+    Path tempPath = *currentPath;
+    if (tempPath.change(path, false)) {
+        if (pntfs->appendFileData(tempPath.getCurrentMftIndex(), sParam->c_str(), sParam->length())) {
+            cout << "OK";
+        }
+    }
+    else {
+        cout << "FILE NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeTruncate(string * fParam, string * sParam) {
+
+    char * path = new char[fParam->length() + 1];
+    strcpy(path, fParam->c_str());
+
+    istringstream iss(*sParam);
+    int32_t size = -1;
+    iss >> size;
+
+    Path tempPath = *currentPath;
+    if (size < 0) {
+        cout << "INVALID PARAMETERS";
+    }
+    else if (tempPath.change(path, false)) {
+        if (pntfs->truncateFile(tempPath.getCurrentMftIndex(), size)) {
+            cout << "OK";
+        }
+    }
+    else {
+        cout << "FILE NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executePreallocate(string * fParam, string * sParam, string * tParam) {
+
+    char * path = new char[fParam->length() + 1];
+    strcpy(path, fParam->c_str());
+
+    istringstream iss(*sParam);
+    int32_t size = -1;
+    iss >> size;
+
+    Path tempPath = *currentPath;
+    if (size < 0 || !(tParam->empty() || *tParam == "keep")) {
+        cout << "INVALID PARAMETERS";
+    }
+    else if (tempPath.change(path, false)) {
+        if (pntfs->preallocate(tempPath.getCurrentMftIndex(), size, tParam->empty() ? 0 : PREALLOCATE_KEEP_SIZE)) {
+            cout << "OK";
+        }
+    }
+    else {
+        cout << "FILE NOT FOUND";
+    }
+
+    delete [] path;
+}
+
+void executeSnapshot(string * fParam, string * sParam) {
+
+    int32_t id = 0;
+    istringstream(*sParam) >> id;
+
+    if (*fParam == "umount") {
+        if (mountedVolume == NULL) {
+            cout << "SNAPSHOT NOT MOUNTED";
+            return;
+        }
+        delete currentPath;
+        delete pntfs;
+        pntfs = mountedVolume;
+        mountedVolume = NULL;
+        currentPath = new Path(pntfs);
+        cout << "OK";
+    }
+    else if (mountedVolume != NULL) {
+        // snapshots are managed on volume, not on mounted snapshot
+        cout << "SNAPSHOT IS MOUNTED";
+    }
+    else if (*fParam == "create") {
+        cout << "SNAPSHOT " << pntfs->createSnapshot() << " CREATED";
+    }
+    else if (*fParam == "delete") {
+        cout << (pntfs->deleteSnapshot(id) ? "OK" : "SNAPSHOT NOT FOUND");
+    }
+    else if (*fParam == "mount") {
+        if (!pntfs->hasSnapshot(id)) {
+            cout << "SNAPSHOT NOT FOUND";
+            return;
+        }
+        mountedVolume = pntfs;
+        pntfs = new PseudoNTFS(mountedVolume, id);
+        delete currentPath;
+        currentPath = new Path(pntfs);
+        cout << "OK";
+    }
+    else if (fParam->empty()) {
+        pntfs->printSnapshots();
+    }
+    else {
+        cout << "INVALID PARAMETERS";
+    }
+}
+
+void executeExportImage(string * fParam, string * sParam, const bool incremental) {
+
+    // incremental image has only changes made after its base image
+    int32_t baseGeneration = NOT_FOUND;
+    if (incremental && !(istringstream(*sParam) >> baseGeneration)) {
+        cout << "INVALID PARAMETERS";
+        return;
+    }
+
+    int32_t generation = pntfs->exportImage(fParam->c_str(), baseGeneration);
+    if (generation != NOT_FOUND) {
+        cout << "OK, GENERATION " << generation;
+    }
+}
+
+void executeImportImage(string * fParam, string * sParam) {
+
+    if (mountedVolume != NULL) {
+        cout << "SNAPSHOT IS MOUNTED";
+        return;
+    }
+
+    // image is restored to new volume in memory, or in given host file accessed through cache
+    string volumePath;
+    int32_t cacheClusters = 0;
+    istringstream(*sParam) >> volumePath >> cacheClusters;
+
+    struct boot_record br;
+    if (!PseudoNTFS::readImageBootRecord(fParam->c_str(), &br)) {
+        cout << "IMAGE NOT FOUND";
+        return;
+    }
+    if (!volumePath.empty() && ifstream(volumePath)) {
+        cout << "VOLUME FILE EXISTS";
+        return;
+    }
+
+    PseudoNTFS * volume = new PseudoNTFS(br.disk_size, br.cluster_size, br.signature, volumePath.empty() ? NULL : volumePath.c_str(), cacheClusters);
+    if (!volume->importImage(fParam->c_str())) {
+        delete volume;
+        if (!volumePath.empty()) {
+            remove(volumePath.c_str());
+        }
+        return;
+    }
+
+    // restored volume replaces volume of shell
+    delete currentPath;
+    delete pntfs;
+    pntfs = volume;
+    currentPath = new Path(pntfs);
+    cout << "OK";
+}
+
+void executeBench(string * fParam, string * sParam) {
+
+    istringstream iss(*sParam);
+
+    if (*fParam == "journal") {
+        int32_t operations = 1000, threads = 4;
+        iss >> operations >> threads;
+        benchmarkJournal(operations, threads);
+    }
+    else if (*fParam == "compression") {
+        int32_t size = 256, rounds = 20;
+        iss >> size >> rounds;
+        benchmarkCompression(size, rounds);
+    }
+    else if (*fParam == "dedup") {
+        int32_t files = 64, distinct = 8;
+        iss >> files >> distinct;
+        benchmarkDeduplication(files, distinct);
+    }
+    else if (*fParam == "resident") {
+        int32_t files = 2000, size = 100;
+        iss >> files >> size;
+        benchmarkResident(files, size);
+    }
+    else if (*fParam == "extents") {
+        int32_t extents = 10000;
+        iss >> extents;
+        benchmarkExtents(extents);
+    }
+    else if (*fParam == "delayed") {
+        int32_t files = 400, threads = 4;
+        iss >> files >> threads;
+        benchmarkDelayed(files, threads);
+    }
+    else if (*fParam == "sparse") {
+        int32_t size = 64;
+        iss >> size;
+        benchmarkSparse(size);
+    }
+    else if (*fParam == "partial") {
+        int32_t size = 4096, operations = 200;
+        iss >> size >> operations;
+        benchmarkPartial(size, operations);
+    }
+    else if (*fParam == "dirs") {
+        int32_t entries = 100000;
+        iss >> entries;
+        benchmarkDirectory(entries);
+    }
+    else if (*fParam == "mft") {
+        int32_t items = 1000000;
+        iss >> items;
+        benchmarkMftScan(items);
+    }
+    else if (*fParam == "slots") {
+        int32_t slots = 1000000;
+        iss >> slots;
+        benchmarkSlots(slots);
+    }
+    else if (*fParam == "check") {
+        int32_t size = 1024;
+        iss >> size;
+        benchmarkCheck(size);
+    }
+    else if (*fParam == "scrub") {
+        int32_t size = 1024;
+        iss >> size;
+        benchmarkScrub(size);
+    }
+    else if (*fParam == "mount") {
+        int32_t items = 600000;
+        iss >> items;
+        benchmarkMount(items);
+    }
+    else if (*fParam == "snapshot") {
+        int32_t size = 256;
+        iss >> size;
+        benchmarkSnapshot(size);
+    }
+    else if (*fParam == "image") {
+        int32_t size = 1024, files = 16;
+        iss >> size >> files;
+        benchmarkImage(size, files);
+    }
+    else if (*fParam == "incremental") {
+        int32_t size = 1024;
+        iss >> size;
+        benchmarkIncremental(size);
+    }
+    else if (*fParam == "allocation") {
+        int32_t files = 4000;
+        iss >> files;
+        benchmarkAllocation(files);
+    }
+    else if (*fParam == "groups") {
+        int32_t files = 4000, threads = std::max((int32_t) std::thread::hardware_concurrency(), 1);
+        iss >> files >> threads;
+        benchmarkGroups(files, threads);
+    }
+    else if (*fParam == "preallocate") {
+        int32_t files = 8, size = 16;
+        iss >> files >> size;
+        benchmarkPreallocate(files, size);
+    }
+    else if (*fParam == "tree") {
+        int32_t entries = 100000;
+        iss >> entries;
+        benchmarkTree(entries);
+    }
+    else if (*fParam == "walk") {
+        int32_t entries = 100000;
+        iss >> entries;
+        benchmarkWalk(entries);
+    }
+    else if (*fParam == "names") {
+        int32_t entries = 100000;
+        iss >> entries;
+        benchmarkNames(entries);
+    }
+    else {
+        cout << "BENCHMARK NOT FOUND";
+    }
 }
\ No newline at end of file
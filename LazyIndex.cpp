@@ -0,0 +1,34 @@
+#include <chrono>
+
+#include "LazyIndex.hpp"
+
+LazyIndex::~LazyIndex() {
+
+    if (builder.joinable()) {
+        builder.join();
+    }
+}
+
+void LazyIndex::build(std::function<void()> function) {
+
+    if (builder.joinable()) {
+        builder.join();
+    }
+
+    ready.store(false, std::memory_order_release);
+    builder = std::thread([this, function]() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        function();
+        buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.store(true, std::memory_order_release);
+        built.notify_all();
+    });
+}
+
+void LazyIndex::waitBuilt() const {
+
+    std::unique_lock<std::mutex> lock(mutex);
+    built.wait(lock, [this]() {return ready.load(std::memory_order_acquire);});
+}
\ No newline at end of file
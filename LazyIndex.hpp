@@ -0,0 +1,48 @@
+#ifndef _LAZY_INDEX_HPP_
+#define _LAZY_INDEX_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+    /* in-memory index built by worker thread after mount
+     * users of index wait until it is built, index without build is ready
+    */
+    class LazyIndex {
+
+        private:
+
+            std::atomic<bool> ready;
+            mutable std::mutex mutex;
+            mutable std::condition_variable built;
+            std::thread builder;
+            double buildSeconds;
+
+            /* block until builder finishes
+            */
+            void waitBuilt() const;
+
+        public:
+
+            LazyIndex() : ready(true), buildSeconds(0) {};
+            ~LazyIndex();
+
+            /* start building of index in worker thread
+             * +param - function - builds index
+            */
+            void build(std::function<void()> function);
+            /* block until index is built, returns at once if it is ready
+            */
+            void wait() const {
+                if (!ready.load(std::memory_order_acquire)) {
+                    waitBuilt();
+                }
+            };
+
+            bool isReady() const {return ready.load(std::memory_order_acquire);};
+            double getBuildSeconds() const {return buildSeconds;};
+    };
+
+#endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstring>
+
+#include "MftHotTable.hpp"
+#include "PseudoNTFS.hpp"
+#include "SlotScan.hpp"
+#include "Utils.hpp"
+
+void MftHotTable::resize(const int32_t count) {
+
+    uids.assign(count, UID_ITEM_FREE);
+    flags.assign(count, 0);
+    nameHashes.assign(count, nameHash(""));
+    sizes.assign(count, 0);
+}
+
+void MftHotTable::update(const int32_t index, const struct mft_item * mftItem) {
+
+    if (index < 0 || index >= (int32_t) uids.size()) {
+        return;
+    }
+
+    uids[index] = mftItem->uid;
+    flags[index] = (mftItem->item_flags & ~(MFT_HOT_DIRECTORY | MFT_HOT_FIRST)) | (mftItem->isDirectory ? MFT_HOT_DIRECTORY : 0) | (mftItem->item_order == 1 ? MFT_HOT_FIRST : 0);
+    nameHashes[index] = nameHash(mftItem->item_name);
+    sizes[index] = mftItem->item_size;
+}
+
+int32_t MftHotTable::findFree(const int32_t from) const {
+
+    int32_t start = std::max(from, 0);
+    int32_t index = findSlot(uids.data() + start, (int32_t) uids.size() - start, UID_ITEM_FREE);
+
+    return index == NOT_FOUND ? NOT_FOUND : start + index;
+}
+
+int32_t MftHotTable::findFree(const int32_t from, const int32_t count, std::vector<int32_t> * indexes) const {
+
+    int32_t start = std::max(from, 0);
+    indexes->resize(std::max(count, 0));
+    indexes->resize(collectSlots(uids.data() + start, (int32_t) uids.size() - start, UID_ITEM_FREE, indexes->data(), count));
+    for (size_t i = 0; i < indexes->size(); i++) {
+        (*indexes)[i] += start;
+    }
+
+    return indexes->size();
+}
+
+int32_t MftHotTable::findName(const uint32_t hash, const int32_t from) const {
+
+    // signed and unsigned hashes compare equal bit by bit
+    const int32_t * nameHash = (const int32_t *) nameHashes.data();
+    int32_t count = nameHashes.size();
+
+    for (int32_t i = std::max(from, 0); i < count; i++) {
+        int32_t index = findSlot(nameHash + i, count - i, (int32_t) hash);
+        if (index == NOT_FOUND) {
+            break;
+        }
+        i += index;
+        if (uids[i] != UID_ITEM_FREE && (flags[i] & MFT_HOT_FIRST)) {
+            return i;
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+int32_t MftHotTable::countFree() const {
+    return countSlots(uids.data(), uids.size(), UID_ITEM_FREE);
+}
+
+int32_t MftHotTable::maxUid() const {
+
+    const int32_t * uid = uids.data();
+    int32_t count = uids.size();
+
+    int32_t max = UID_ITEM_FREE;
+    for (int32_t i = 0; i < count; i++) {
+        max = std::max(max, uid[i]);
+    }
+
+    return max;
+}
+
+uint32_t MftHotTable::nameHash(const char * name) {
+    return checksum((const unsigned char *) name, strnlen(name, sizeof(mft_item::item_name)));
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef _MFT_HOT_TABLE_HPP_
+#define _MFT_HOT_TABLE_HPP_
+
+#include <cstdint>
+#include <vector>
+
+    struct mft_item;
+
+    // hot flags hold flags of mft item in low bits and these bits
+    const uint8_t MFT_HOT_DIRECTORY = 0x40;
+    const uint8_t MFT_HOT_FIRST = 0x80;
+
+    /* packed copy of mft item fields read by scans over whole mft table, every field has its own array
+     * scan reads few bytes per mft item instead of striding over whole records
+     * entry is refreshed whenever its mft item is journaled
+    */
+    class MftHotTable {
+
+        private:
+
+            std::vector<int32_t> uids;
+            std::vector<uint8_t> flags;
+            std::vector<uint32_t> nameHashes;
+            std::vector<int32_t> sizes;
+
+        public:
+
+            /* set count of entries, new entries are free
+             * +param - count - count of mft items
+            */
+            void resize(const int32_t count);
+            /* copy hot fields of mft item
+             * +param - index - index of mft item
+             * +param - mftItem - mft item
+            */
+            void update(const int32_t index, const struct mft_item * mftItem);
+            /* find free mft item
+             * +param - from - index where search starts
+             * +return index of first free mft item from given one, or NOT_FOUND
+            */
+            int32_t findFree(const int32_t from) const;
+            /* find free mft items
+             * +param - from - index where search starts
+             * +param - count - count of wanted mft items
+             * +param - indexes - indexes of found mft items in ascending order
+             * +return count of found mft items
+            */
+            int32_t findFree(const int32_t from, const int32_t count, std::vector<int32_t> * indexes) const;
+            /* find first mft item of file or directory with given name hash
+             * +param - hash - hash of name
+             * +param - from - index where search starts
+             * +return index of mft item, or NOT_FOUND
+            */
+            int32_t findName(const uint32_t hash, const int32_t from) const;
+            int32_t countFree() const;
+            int32_t maxUid() const;
+
+            /* hash of name of mft item
+             * +param - name - name
+             * +return hash
+            */
+            static uint32_t nameHash(const char * name);
+
+            int32_t getCount() const {return uids.size();};
+            int32_t getUid(const int32_t index) const {return uids[index];};
+            uint8_t getFlags(const int32_t index) const {return flags[index];};
+            int32_t getSize(const int32_t index) const {return sizes[index];};
+    };
+
+#endif
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cstring>
+#include <fnmatch.h>
+
+#include "NameIndex.hpp"
+#include "PseudoNTFS.hpp"
+
+/* split pattern with wildcards to texts every matching name contains
+ * text stops at wildcard and at bracket expression, the rest of unclosed bracket is not used
+ * +param - pattern - pattern with wildcards
+ * +param - literals - texts of pattern
+*/
+static void globLiterals(const char * pattern, std::vector<std::string> * literals) {
+
+    std::string literal;
+    for (int32_t i = 0; pattern[i] != '\0'; i++) {
+        char c = pattern[i];
+        if (c == '*' || c == '?' || c == '[') {
+            if (!literal.empty()) {
+                literals->push_back(literal);
+                literal.clear();
+            }
+            if (c != '[') {
+                continue;
+            }
+
+            // first char of bracket expression can be its closing bracket
+            int32_t end = i + 1;
+            end += pattern[end] == '!' || pattern[end] == '^';
+            end += pattern[end] == ']';
+            while (pattern[end] != '\0' && pattern[end] != ']') {
+                end++;
+            }
+            if (pattern[end] == '\0') {
+                return;
+            }
+            i = end;
+        }
+        else if (c == '\\' && pattern[i + 1] != '\0') {
+            literal += pattern[++i];
+        }
+        else {
+            literal += c;
+        }
+    }
+
+    if (!literal.empty()) {
+        literals->push_back(literal);
+    }
+}
+
+int32_t NameIndex::grams(const char * text, const int32_t length, const int32_t gram, uint32_t * keys) {
+
+    int32_t count = 0;
+    int32_t shortest = gram > 0 ? gram : 1;
+    int32_t longest = gram > 0 ? gram : NAME_INDEX_GRAM;
+
+    for (int32_t size = shortest; size <= longest; size++) {
+        for (int32_t start = 0; start + size <= length; start++) {
+            uint32_t key = 0;
+            for (int32_t k = 0; k < size; k++) {
+                key |= (uint32_t) (unsigned char) text[start + k] << (8 * k);
+            }
+            keys[count++] = key;
+        }
+    }
+
+    std::sort(keys, keys + count);
+    return std::unique(keys, keys + count) - keys;
+}
+
+void NameIndex::compact(const uint32_t key, struct name_posting * posting) {
+
+    char gram[NAME_INDEX_GRAM + 1] = {};
+    for (int32_t k = 0; k < NAME_INDEX_GRAM; k++) {
+        gram[k] = (char) (key >> (8 * k));
+    }
+
+    std::vector<int32_t> & items = posting->items;
+    std::sort(items.begin(), items.end());
+    items.erase(std::unique(items.begin(), items.end()), items.end());
+    items.erase(std::remove_if(items.begin(), items.end(), [this, &gram](const int32_t index) {
+        return strstr(getName(index), gram) == NULL;
+    }), items.end());
+    posting->stale = 0;
+}
+
+bool NameIndex::shortestPosting(const char * text, const int32_t length, const struct name_posting ** shortest) const {
+
+    // text longer than name is in no name
+    if (length >= NAME_INDEX_NAME_SIZE) {
+        return false;
+    }
+
+    uint32_t keys[NAME_INDEX_KEYS];
+    int32_t count = grams(text, length, std::min(length, NAME_INDEX_GRAM), keys);
+
+    for (int32_t i = 0; i < count; i++) {
+        std::unordered_map<uint32_t, struct name_posting>::const_iterator posting = postings.find(keys[i]);
+        if (posting == postings.end()) {
+            return false;
+        }
+        if (*shortest == NULL || posting->second.items.size() < (*shortest)->items.size()) {
+            *shortest = &posting->second;
+        }
+    }
+
+    return true;
+}
+
+void NameIndex::resize(const int32_t count) {
+
+    names.assign((int64_t) count * NAME_INDEX_NAME_SIZE, '\0');
+    postings.clear();
+    namesCount = 0;
+}
+
+bool NameIndex::update(const int32_t index, const struct mft_item * mftItem) {
+
+    if (index < 0 || (int64_t) index * NAME_INDEX_NAME_SIZE >= (int64_t) names.size()) {
+        return false;
+    }
+
+    // only first mft items of files and directories have names, system file is in no directory
+    const char * name = "";
+    if (mftItem->uid != UID_ITEM_FREE && mftItem->item_order == 1 && !(mftItem->item_flags & MFT_ITEM_SYSTEM)) {
+        name = mftItem->item_name;
+    }
+
+    char * indexed = &names[(int64_t) index * NAME_INDEX_NAME_SIZE];
+    int32_t length = strnlen(name, NAME_INDEX_NAME_SIZE - 1);
+    if (strncmp(indexed, name, length) == 0 && indexed[length] == '\0') {
+        return false;
+    }
+
+    uint32_t oldKeys[NAME_INDEX_KEYS], newKeys[NAME_INDEX_KEYS];
+    int32_t oldCount = grams(indexed, strlen(indexed), 0, oldKeys);
+    int32_t newCount = grams(name, length, 0, newKeys);
+    namesCount += (length > 0) - (*indexed != '\0');
+
+    // lists are compacted with the new name, grams it keeps are not touched
+    memcpy(indexed, name, length);
+    indexed[length] = '\0';
+
+    // both grams are sorted, one pass finds grams only in old name and grams only in new name
+    int32_t oldKey = 0, newKey = 0;
+    while (oldKey < oldCount || newKey < newCount) {
+        if (newKey == newCount || (oldKey < oldCount && oldKeys[oldKey] < newKeys[newKey])) {
+            std::unordered_map<uint32_t, struct name_posting>::iterator posting = postings.find(oldKeys[oldKey]);
+            if (posting != postings.end()) {
+                posting->second.stale++;
+                if (posting->second.stale * 2 > (int32_t) posting->second.items.size()) {
+                    compact(posting->first, &posting->second);
+                    if (posting->second.items.empty()) {
+                        postings.erase(posting);
+                    }
+                }
+            }
+            oldKey++;
+        }
+        else if (oldKey == oldCount || newKeys[newKey] < oldKeys[oldKey]) {
+            postings[newKeys[newKey]].items.push_back(index);
+            newKey++;
+        }
+        else {
+            oldKey++;
+            newKey++;
+        }
+    }
+
+    return true;
+}
+
+int32_t NameIndex::find(const char * pattern, std::vector<int32_t> * indexes) const {
+
+    indexes->clear();
+
+    bool glob = isGlob(pattern);
+    std::vector<std::string> literals;
+    if (glob) {
+        globLiterals(pattern, &literals);
+    }
+    else {
+        literals.push_back(pattern);
+    }
+
+    const struct name_posting * shortest = NULL;
+    for (const std::string & literal : literals) {
+        if (!shortestPosting(literal.c_str(), literal.length(), &shortest)) {
+            return 0;
+        }
+    }
+
+    auto found = [this, pattern](const int32_t index) {
+        return *getName(index) != '\0' && matches(pattern, getName(index));
+    };
+
+    // pattern without text compares all names
+    if (shortest == NULL) {
+        int32_t count = names.size() / NAME_INDEX_NAME_SIZE;
+        for (int32_t i = 0; i < count; i++) {
+            if (found(i)) {
+                indexes->push_back(i);
+            }
+        }
+        return indexes->size();
+    }
+
+    for (int32_t index : shortest->items) {
+        if (found(index)) {
+            indexes->push_back(index);
+        }
+    }
+
+    // list can hold renamed mft item more times
+    std::sort(indexes->begin(), indexes->end());
+    indexes->erase(std::unique(indexes->begin(), indexes->end()), indexes->end());
+    return indexes->size();
+}
+
+void NameIndex::serialize(const int32_t stamp, std::string * data) {
+
+    std::vector<struct name_index_name> savedNames;
+    int32_t count = names.size() / NAME_INDEX_NAME_SIZE;
+    for (int32_t i = 0; i < count; i++) {
+        if (*getName(i) != '\0') {
+            struct name_index_name name;
+            name.index = i;
+            memcpy(name.name, getName(i), NAME_INDEX_NAME_SIZE);
+            savedNames.push_back(name);
+        }
+    }
+
+    std::vector<struct name_index_posting> savedPostings;
+    int32_t entries = 0;
+    for (std::unordered_map<uint32_t, struct name_posting>::iterator posting = postings.begin(); posting != postings.end(); ) {
+        if (posting->second.stale > 0) {
+            compact(posting->first, &posting->second);
+        }
+        if (posting->second.items.empty()) {
+            posting = postings.erase(posting);
+            continue;
+        }
+        struct name_index_posting saved = {posting->first, (int32_t) posting->second.items.size()};
+        savedPostings.push_back(saved);
+        entries += saved.count;
+        posting++;
+    }
+
+    struct name_index_header header;
+    memcpy(header.magic, NAME_INDEX_MAGIC, sizeof(header.magic));
+    header.stamp = stamp;
+    header.items_count = count;
+    header.names_count = savedNames.size();
+    header.postings_count = savedPostings.size();
+    header.entries_count = entries;
+
+    data->clear();
+    data->reserve(sizeof(header) + savedNames.size() * sizeof(name_index_name) + savedPostings.size() * sizeof(name_index_posting) + entries * sizeof(int32_t));
+    data->append((const char *) &header, sizeof(header));
+    data->append((const char *) savedNames.data(), savedNames.size() * sizeof(name_index_name));
+    data->append((const char *) savedPostings.data(), savedPostings.size() * sizeof(name_index_posting));
+    // lists follow their grams in the same order
+    for (const struct name_index_posting & saved : savedPostings) {
+        const std::vector<int32_t> & items = postings[saved.key].items;
+        data->append((const char *) items.data(), items.size() * sizeof(int32_t));
+    }
+}
+
+bool NameIndex::deserialize(const std::string & data, const int32_t stamp, const int32_t count) {
+
+    resize(count);
+
+    struct name_index_header header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, NAME_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.stamp != stamp || header.items_count != count
+        || header.names_count < 0 || header.postings_count < 0 || header.entries_count < 0
+        || data.size() != sizeof(header) + (int64_t) header.names_count * sizeof(name_index_name) + (int64_t) header.postings_count * sizeof(name_index_posting) + (int64_t) header.entries_count * sizeof(int32_t)) {
+        return false;
+    }
+
+    const struct name_index_name * savedNames = (const struct name_index_name *) (data.data() + sizeof(header));
+    for (int32_t i = 0; i < header.names_count; i++) {
+        if (savedNames[i].index < 0 || savedNames[i].index >= count) {
+            resize(count);
+            return false;
+        }
+        char * name = &names[(int64_t) savedNames[i].index * NAME_INDEX_NAME_SIZE];
+        memcpy(name, savedNames[i].name, NAME_INDEX_NAME_SIZE);
+        name[NAME_INDEX_NAME_SIZE - 1] = '\0';
+        namesCount += *name != '\0';
+    }
+
+    const struct name_index_posting * savedPostings = (const struct name_index_posting *) (savedNames + header.names_count);
+    const int32_t * entries = (const int32_t *) (savedPostings + header.postings_count);
+    int64_t used = 0;
+    for (int32_t i = 0; i < header.postings_count; i++) {
+        if (savedPostings[i].count < 0 || used + savedPostings[i].count > header.entries_count) {
+            resize(count);
+            return false;
+        }
+        struct name_posting & posting = postings[savedPostings[i].key];
+        posting.items.assign(entries + used, entries + used + savedPostings[i].count);
+        posting.stale = 0;
+        used += savedPostings[i].count;
+        for (int32_t index : posting.items) {
+            if (index < 0 || index >= count) {
+                resize(count);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool NameIndex::isGlob(const char * pattern) {
+    return strpbrk(pattern, "*?[") != NULL;
+}
+
+bool NameIndex::matches(const char * pattern, const char * name) {
+    return isGlob(pattern) ? fnmatch(pattern, name, 0) == 0 : strstr(name, pattern) != NULL;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef _NAME_INDEX_HPP_
+#define _NAME_INDEX_HPP_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+    struct mft_item;
+
+    // size of name of mft item with its end char
+    const int32_t NAME_INDEX_NAME_SIZE = 12;
+    // the longest gram of name in index
+    const int32_t NAME_INDEX_GRAM = 3;
+    // the most distinct grams of one name
+    const int32_t NAME_INDEX_KEYS = (NAME_INDEX_NAME_SIZE - 1) * NAME_INDEX_GRAM;
+
+    const char NAME_INDEX_MAGIC[] = "PNTFSNAM";
+
+    // header of saved name index, indexed names and postings follow it
+    struct name_index_header {
+        char magic[8];              //NAME_INDEX_MAGIC bez ukoncovaciho znaku
+        int32_t stamp;              //razitko indexu, plati jen pri shode s razitkem v boot recordu
+        int32_t items_count;        //pocet polozek MFT svazku
+        int32_t names_count;        //pocet ulozenych jmen
+        int32_t postings_count;     //pocet ulozenych seznamu gramu
+        int32_t entries_count;      //celkovy pocet indexu MFT ve vsech seznamech
+    };
+
+    // indexed name in saved name index
+    struct name_index_name {
+        int32_t index;                      //index prvni polozky MFT
+        char name[NAME_INDEX_NAME_SIZE];    //jmeno souboru nebo adresare
+    };
+
+    // list of grams in saved name index, its mft indexes follow all lists
+    struct name_index_posting {
+        uint32_t key;               //gram, znaky od nejnizsiho bytu
+        int32_t count;              //pocet indexu MFT se jmenem obsahujicim gram
+    };
+
+    /* names of first mft items of files and directories, every gram of 1 to NAME_INDEX_GRAM chars of name points to mft items with it
+     * query takes the shortest list of its grams and compares names of its mft items only
+     * removed name is not taken out of its lists, list is compacted when most of it is stale
+    */
+    class NameIndex {
+
+        private:
+
+            struct name_posting {
+                // mft indexes in order of insertion, removed and renamed items stay until compaction
+                std::vector<int32_t> items;
+                int32_t stale;
+            };
+
+            std::unordered_map<uint32_t, struct name_posting> postings;
+            // name of every mft item, empty for mft item out of index
+            std::vector<char> names;
+            int32_t namesCount;
+
+            /* distinct grams of text no longer than name
+             * +param - text - text
+             * +param - length - length of text
+             * +param - gram - length of grams, 0 for all lengths up to NAME_INDEX_GRAM
+             * +param - keys - found grams in ascending order, room for NAME_INDEX_KEYS grams
+             * +return count of found grams
+            */
+            static int32_t grams(const char * text, const int32_t length, const int32_t gram, uint32_t * keys);
+            /* drop stale mft indexes of list and their duplicates
+             * +param - key - gram of list
+             * +param - posting - list of gram
+            */
+            void compact(const uint32_t key, struct name_posting * posting);
+            /* find the shortest list of grams of text
+             * +param - text - text every matching name contains
+             * +param - length - length of text
+             * +param - shortest - the shortest list found so far, NULL if there is none
+             * +return false - some gram is in no name
+            */
+            bool shortestPosting(const char * text, const int32_t length, const struct name_posting ** shortest) const;
+
+        public:
+
+            NameIndex() : namesCount(0) {};
+
+            /* set count of mft items and drop all names
+             * +param - count - count of mft items
+            */
+            void resize(const int32_t count);
+            /* refresh name of mft item
+             * +param - index - index of mft item
+             * +param - mftItem - mft item
+             * +return true - indexed name was changed
+            */
+            bool update(const int32_t index, const struct mft_item * mftItem);
+            /* find names containing text, or matching pattern with wildcards
+             * +param - pattern - text, or pattern with *, ? or [...]
+             * +param - indexes - mft indexes of found names in ascending order
+             * +return count of found names
+            */
+            int32_t find(const char * pattern, std::vector<int32_t> * indexes) const;
+            /* write index to buffer, lists are compacted
+             * +param - stamp - stamp of saved index
+             * +param - data - saved index
+            */
+            void serialize(const int32_t stamp, std::string * data);
+            /* read index written by serialize
+             * +param - data - saved index
+             * +param - stamp - demanded stamp of saved index
+             * +param - count - count of mft items
+             * +return false - saved index is damaged or it has another stamp, index is empty
+            */
+            bool deserialize(const std::string & data, const int32_t stamp, const int32_t count);
+
+            /* +param - pattern - searched pattern
+             * +return true - pattern has wildcards, else it is searched as text
+            */
+            static bool isGlob(const char * pattern);
+            /* +param - pattern - text, or pattern with wildcards
+             * +param - name - name of file or directory
+             * +return true - name contains text, or it matches pattern
+            */
+            static bool matches(const char * pattern, const char * name);
+
+            int32_t getNamesCount() const {return namesCount;};
+            int32_t getPostingsCount() const {return postings.size();};
+            const char * getName(const int32_t index) const {return &names[(int64_t) index * NAME_INDEX_NAME_SIZE];};
+    };
+
+#endif
\ No newline at end of file
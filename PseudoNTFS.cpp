@@ -1,21 +1,54 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <cmath>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <sstream>
+#include <unordered_set>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
 
 #include "PseudoNTFS.hpp"
+#include "Compression.hpp"
+#include "Crc32c.hpp"
+#include "SlotScan.hpp"
 #include "Utils.hpp"
 
-PseudoNTFS::PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const char * signature) : mftItemsCount((diskSize * 0.1) / sizeof(mft_item)) {
+PseudoNTFS::PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const char * signature, const char * volumePath, const int32_t cacheClusters, const int32_t allocationPolicy) : mftItemsCount((diskSize * 0.1) / sizeof(mft_item)) {
 
     // initialize uid counter to 0
     uidCounter = 1;
+    compression = false;
+    residentData = true;
+    verifyChecksums = false;
+    deduplication = false;
+    deduplicationWritten = 0;
+    deduplicationShared = 0;
+    deduplicationSeconds = 0;
+    delayedAllocation = false;
+    delayedBudget = DELAYED_BUDGET;
+    delayedBytes = 0;
+    delayedClusters = 0;
+    delayedSequence = 0;
+    delayedFlushes = 0;
+    delayedFlushedFiles = 0;
+    delayedFlushedExtents = 0;
+    allocationCursor = 0;
+    nameIndexBuilt = false;
+    nameIndexDirty = false;
     
     struct boot_record br;
     // set signature and description of volume
     strcpy(br.signature, signature);
     strcpy(br.volume_descriptor, "KIV/ZOS\nvastja\nA15B0150P\nvastja@students.zcu.cz\n2017-18");
+    memcpy(br.magic, VOLUME_MAGIC, sizeof(br.magic));
+    br.format_version = VOLUME_VERSION;
 
     br.disk_size = diskSize;
     br.cluster_size = clusterSize;
@@ -23,33 +56,57 @@ PseudoNTFS::PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const
     // 10% of disk space is for mft items
     // Set free mft items to mft items count
     freeMftItems = mftItemsCount;
-    // rest of space is for clusters and bitmap
-    int32_t clusterCount = floor((br.disk_size - sizeof(boot_record) - mftItemsCount * sizeof(mft_item)) / (0.125 + br.cluster_size)); 
+    firstFreeMftItem = 0;
+    // journal is as big as mft table, so update of whole mft table fits into it
+    br.journal_size = mftItemsCount * sizeof(mft_item);
+    // rest of space is for clusters, their bitmap and their checksums
+    int32_t clusterCount = floor((br.disk_size - sizeof(boot_record) - mftItemsCount * sizeof(mft_item) - br.journal_size) / (0.125 + sizeof(uint32_t) + br.cluster_size)); 
     br.cluster_count = clusterCount;
 
-    // free space in data segment
-    freeSpace = clusterCount * br.cluster_size;
-
     //  disk is represented with byte array
-    ntfs = new unsigned char[br.disk_size];
-    memset(ntfs, 0, br.disk_size);
+    // with cache only boot record, mft, bitmap and journal are in it, data clusters are loaded on demand
+    residentSize = br.disk_size;
+    if (volumePath != NULL && cacheClusters > 0) {
+        residentSize = sizeof(boot_record) + mftItemsCount * sizeof(mft_item) + (int64_t) ceil(br.cluster_count / 8.0) + br.journal_size + br.cluster_count * sizeof(uint32_t);
+    }
+    ntfs = new unsigned char[residentSize];
+    memset(ntfs, 0, residentSize);
     bootRecord = (boot_record *) ntfs;
 
     //set start address for parts of disk
-    br.mft_start_address = ((int64_t) ntfs) + sizeof(boot_record);
-    mftItemStart = (mft_item *) br.mft_start_address;
-    br.bitmap_start_address = br.mft_start_address + mftItemsCount * sizeof(mft_item);
-    bitmapStart = (unsigned char *) br.bitmap_start_address;
-    br.data_start_address = br.bitmap_start_address + ceil(br.cluster_count / 8.0);
-    dataStart = (unsigned char *) br.data_start_address;
+    initLayout(&br);
 
     br.mft_max_fragment_count = MFT_FRAGMENTS_COUNT;
+    br.change_generation = 0;
+    br.image_generation = NOT_FOUND;
+    br.allocation_policy = allocationPolicy >= 0 && allocationPolicy < ALLOCATION_POLICIES_COUNT ? allocationPolicy : ALLOCATION_FIRST_FIT;
+    br.group_clusters = allocationGroupClusters(br.cluster_count);
+    br.name_index_item = NOT_FOUND;
+    br.name_index_stamp = 0;
 
     // set boot record for disk
     memcpy(ntfs, &br, sizeof(boot_record));
 
+    volumeFile = -1;
+    if (volumePath != NULL) {
+        volumeFile = open(volumePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    journal = new Journal(journalStart, journalStart - ntfs, br.journal_size, volumeFile);
+
+    cache = NULL;
+    if (residentSize < br.disk_size) {
+        cache = new ClusterCache(volumeFile, dataStart - ntfs, br.cluster_size, cacheClusters);
+    }
+
+    committedBytes = 0;
+    initSnapshots();
+    initChangeTracking();
     initMft();
     initBitmap();
+    initChecksums();
+    rebuildHotTable();
+    allocationGroups.build(bitmapStart, br.cluster_count, br.group_clusters);
+    initSharedReferences();
 
     // create root directory
     struct mft_item mftItem;
@@ -58,21 +115,505 @@ PseudoNTFS::PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const
     mftItem.item_order = 1;
     mftItem.item_order_total = 1;
     strcpy(mftItem.item_name, ROOT_NAME);
+    mftItem.item_flags = 0;
     mftItem.item_size = 0;
+    mftItem.item_next = NOT_FOUND;
+    mftItem.item_valid = 0;
     // save root directory to start of mft table
     clearMftItemFragments(mftItem.fragments);
     setMftItem(0, &mftItem);
 
+    // new volume is written at once, not through journal
+    transactionRanges.clear();
+    transactionDataClusters.clear();
+    transactionFreedClusters.clear();
+    // clusters stay dirty in cache and are written back by it
+    for (int32_t index : transactionPinnedClusters) {
+        cache->unpin(index, false);
+    }
+    transactionPinnedClusters.clear();
+    journal->format();
+
+    if (volumeFile >= 0) {
+        writeFileAt(volumeFile, 0, ntfs, residentSize);
+        // data clusters of cached volume are left as hole in host file
+        if (ftruncate(volumeFile, br.disk_size) != 0) {
+            std::cout << "CANNOT RESIZE VOLUME FILE";
+        }
+        fsync(volumeFile);
+    }
+}
+
+PseudoNTFS::PseudoNTFS(const char * volumePath, const int32_t cacheClusters) : mftItemsCount(readMftItemsCount(volumePath)) {
+
+    struct boot_record br;
+
+    volumeFile = open(volumePath, O_RDWR);
+    if (volumeFile < 0 || !readFileAt(volumeFile, 0, (unsigned char *) &br, sizeof(boot_record))) {
+        std::cout << "VOLUME NOT FOUND";
+        exit(1);
+    }
+    if (!isVolumeFormat(&br)) {
+        std::cout << "VOLUME FORMAT IS NOT SUPPORTED";
+        exit(1);
+    }
+
+    // with cache only part of volume before data clusters is loaded
+    residentSize = br.disk_size;
+    if (cacheClusters > 0) {
+        residentSize = br.data_start_address - (br.mft_start_address - sizeof(boot_record));
+    }
+
+    ntfs = new unsigned char[residentSize];
+    readFileAt(volumeFile, 0, ntfs, residentSize);
+    bootRecord = (boot_record *) ntfs;
+
+    // addresses in boot record are valid only in process which created volume
+    initLayout(bootRecord);
+
+    // bring metadata to consistent state before anything reads it
+    journal = new Journal(journalStart, journalStart - ntfs, bootRecord->journal_size, volumeFile);
+    journal->replay(ntfs, residentSize);
+
+    // cache starts empty, so it sees replayed data clusters
+    cache = NULL;
+    if (cacheClusters > 0) {
+        cache = new ClusterCache(volumeFile, dataStart - ntfs, bootRecord->cluster_size, cacheClusters);
+    }
+
+    indexOutOfRange = false;
+    compression = false;
+    residentData = true;
+    verifyChecksums = false;
+    deduplication = false;
+    deduplicationWritten = 0;
+    deduplicationShared = 0;
+    deduplicationSeconds = 0;
+    delayedAllocation = false;
+    delayedBudget = DELAYED_BUDGET;
+    delayedBytes = 0;
+    delayedClusters = 0;
+    delayedSequence = 0;
+    delayedFlushes = 0;
+    delayedFlushedFiles = 0;
+    delayedFlushedExtents = 0;
+    allocationCursor = 0;
+    nameIndexBuilt = false;
+    nameIndexDirty = false;
+    committedBytes = 0;
+    initSnapshots();
+    initChangeTracking();
+
+    // volume is usable at once, operations needing an index wait for it
+    buildIndexes();
+}
+
+PseudoNTFS::PseudoNTFS(PseudoNTFS * volume, const int32_t snapshotId) : mftItemsCount(volume->mftItemsCount) {
+
+    // only metadata are copied, data clusters of snapshot are not changed while it exists
+    residentSize = volume->dataStart - volume->ntfs;
+    ntfs = new unsigned char[residentSize];
+    volume->readSnapshot(snapshotId, ntfs);
+    bootRecord = (boot_record *) ntfs;
+    initLayout(bootRecord);
+
+    volumeFile = -1;
+    journal = new Journal(journalStart, journalStart - ntfs, bootRecord->journal_size, volumeFile);
+    journal->format();
+    cache = volume->cache;
+    dataStart = volume->dataStart;
+
+    // bitmap of snapshot holds clusters of its files
+    memset(bitmapStart, 0, ceil(bootRecord->cluster_count / 8.0));
+    for (int i = 0; i < mftItemsCount; i++) {
+        if (mftItemStart[i].uid == UID_ITEM_FREE || (mftItemStart[i].item_flags & MFT_ITEM_RESIDENT)) {
+            continue;
+        }
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            int32_t startIndex = mftItemStart[i].fragments[j].fragment_start_address;
+            int32_t bound = std::min(startIndex + mftItemStart[i].fragments[j].fragment_count, bootRecord->cluster_count);
+            for (int32_t k = std::max(startIndex, 0); k < bound && startIndex != EXTENT_HOLE; k++) {
+                bitmapStart[k / 8] |= 128 >> (k % 8);
+            }
+        }
+    }
+
+    indexOutOfRange = false;
+    compression = false;
+    residentData = true;
+    verifyChecksums = false;
+    deduplication = false;
+    deduplicationWritten = 0;
+    deduplicationShared = 0;
+    deduplicationSeconds = 0;
+    delayedAllocation = false;
+    delayedBudget = DELAYED_BUDGET;
+    delayedBytes = 0;
+    delayedClusters = 0;
+    delayedSequence = 0;
+    delayedFlushes = 0;
+    delayedFlushedFiles = 0;
+    delayedFlushedExtents = 0;
+    allocationCursor = 0;
+    nameIndexBuilt = false;
+    nameIndexDirty = false;
+    committedBytes = 0;
+    initSnapshots();
+    initChangeTracking();
+    snapshotOrigin = volume;
+
+    buildIndexes();
+}
+
+void PseudoNTFS::buildIndexes() {
+
+    mftIndex.build([this]() {
+        // data of files held in memory by delayed allocation were lost, files stay empty
+        // change is not journaled, item left delayed on disk is emptied again by next mount
+        for (int i = 0; i < mftItemsCount; i++) {
+            if (mftItemStart[i].uid != UID_ITEM_FREE && (mftItemStart[i].item_flags & MFT_ITEM_DELAYED)) {
+                mftItemStart[i].item_flags = 0;
+                mftItemStart[i].item_size = 0;
+            }
+        }
+
+        // snapshots are not stored, clusters held for them by crashed volume are found before any command changes mft or bitmap
+        if (snapshotOrigin == NULL) {
+            holdLeakedClusters();
+        }
+
+        rebuildHotTable();
+        uidCounter = std::max(hotTable.maxUid() + 1, 1);
+        freeMftItems = hotTable.countFree();
+        firstFreeMftItem = 0;
+    });
+
+    spaceIndex.build([this]() {
+        // groups of volume with invalid group size are counted again, they are not stored
+        int32_t groupClusters = bootRecord->group_clusters;
+        if (groupClusters <= 0 || groupClusters % 8 != 0) {
+            groupClusters = allocationGroupClusters(bootRecord->cluster_count);
+        }
+        // clusters held by mft index builder are left out of free clusters, users of held clusters wait for space index
+        mftIndex.wait();
+        allocationGroups.build(bitmapStart, bootRecord->cluster_count, groupClusters);
+    });
+
+    // references are counted over hot table, builder waits for it
+    referencesIndex.build([this]() {
+        initSharedReferences();
+    });
+}
+
+void PseudoNTFS::waitIndexes() {
+
+    mftIndex.wait();
+    spaceIndex.wait();
+    referencesIndex.wait();
+}
+
+void PseudoNTFS::printIndexStatistics() {
+
+    waitIndexes();
+    std::cout << "MFT items: " << mftIndex.getBuildSeconds() * 1000 << " ms, ";
+    std::cout << "free extents: " << spaceIndex.getBuildSeconds() * 1000 << " ms (" << allocationGroups.getExtentsCount() << " extents in " << allocationGroups.getCount() << " groups), ";
+    std::cout << "shared references: " << referencesIndex.getBuildSeconds() * 1000 << " ms";
 }
 
 PseudoNTFS::~PseudoNTFS() {
+
+    // snapshots live while volume is mounted, clusters held for them are released by sync
+    spaceIndex.wait();
+    snapshotReclaim = !heldClusters.empty();
+    snapshots.clear();
+
+    // unmount writes files held in memory
+    sync();
+    waitIndexes();
+
+    // names changed since the last save are saved for next mount, snapshot is read-only
+    if (nameIndexDirty && snapshotOrigin == NULL) {
+        flushNameIndex();
+    }
+
+    delete journal;
+    // dirty clusters are written back, mounted snapshot uses cache of its volume
+    if (snapshotOrigin == NULL) {
+        delete cache;
+    }
+
+    if (volumeFile >= 0) {
+        close(volumeFile);
+    }
+
     delete [] ntfs;
 }
 
+bool PseudoNTFS::isVolumeFormat(const struct boot_record * br) {
+    return memcmp(br->magic, VOLUME_MAGIC, sizeof(br->magic)) == 0 && br->format_version == VOLUME_VERSION;
+}
+
+int32_t PseudoNTFS::readMftItemsCount(const char * volumePath) {
+
+    struct boot_record br;
+
+    int file = open(volumePath, O_RDONLY);
+    if (file < 0) {
+        return 0;
+    }
+
+    bool read = readFileAt(file, 0, (unsigned char *) &br, sizeof(boot_record));
+    close(file);
+
+    if (!read || !isVolumeFormat(&br)) {
+        return 0;
+    }
+
+    return (br.bitmap_start_address - br.mft_start_address) / sizeof(mft_item);
+}
+
+void PseudoNTFS::initLayout(struct boot_record * br) {
+
+    br->mft_start_address = ((int64_t) ntfs) + sizeof(boot_record);
+    mftItemStart = (mft_item *) br->mft_start_address;
+    br->bitmap_start_address = br->mft_start_address + mftItemsCount * sizeof(mft_item);
+    bitmapStart = (unsigned char *) br->bitmap_start_address;
+    br->journal_start_address = br->bitmap_start_address + ceil(br->cluster_count / 8.0);
+    journalStart = (unsigned char *) br->journal_start_address;
+    br->checksum_start_address = br->journal_start_address + br->journal_size;
+    checksumStart = (uint32_t *) br->checksum_start_address;
+    br->data_start_address = br->checksum_start_address + br->cluster_count * sizeof(uint32_t);
+    dataStart = (unsigned char *) br->data_start_address;
+}
+
+void PseudoNTFS::printCacheStatistics() {
+
+    if (cache == NULL) {
+        std::cout << "CACHE NOT USED";
+        return;
+    }
+
+    cache->printStatistics(&std::cout);
+}
+
+/* JOURNALING */
+
+PseudoNTFS::Transaction::~Transaction() {
+
+    std::set<int32_t> pinnedClusters;
+    int64_t sequence = pntfs->commitTransaction(&pinnedClusters);
+
+    // let other operations run while our transaction is flushed, they can join the same flush
+    lock.unlock();
+    pntfs->journal->waitDurable(sequence);
+
+    // journal has written clusters to their home locations
+    for (int32_t index : pinnedClusters) {
+        pntfs->cache->unpin(index, true);
+    }
+}
+
+void PseudoNTFS::Transaction::commit() {
+
+    std::set<int32_t> pinnedClusters;
+    int64_t sequence = pntfs->commitTransaction(&pinnedClusters);
+    pntfs->journal->waitDurable(sequence);
+
+    for (int32_t index : pinnedClusters) {
+        pntfs->cache->unpin(index, true);
+    }
+}
+
+int64_t PseudoNTFS::transactionLogSize() const {
+
+    int64_t size = (int64_t) (transactionDataClusters.size() + transactionFreedClusters.size()) * sizeof(journal_record);
+    for (const std::pair<const int64_t, struct journal_range> & range : transactionRanges) {
+        size += sizeof(journal_record) + range.second.length;
+    }
+
+    return size;
+}
+
+void PseudoNTFS::journalMftItem(const int index) {
+
+    struct journal_range range = {JOURNAL_RECORD_MFT, sizeof(mft_item)};
+    transactionRanges[((unsigned char *) &mftItemStart[index]) - ntfs] = range;
+
+    // every change of mft item is journaled, hot table and change tracking follow it here
+    hot()->update(index, &mftItemStart[index]);
+    trackMftItemChange(index);
+
+    // the first change of name makes saved name index stale in the same transaction
+    if (hasNameIndex() && names()->update(index, &mftItemStart[index]) && !nameIndexDirty) {
+        nameIndexDirty = true;
+        bootRecord->name_index_stamp++;
+        journalBootRecord(&bootRecord->name_index_stamp);
+    }
+
+    // map of file is loaded again with changed fragments
+    std::lock_guard<std::mutex> lock(extentMapsMutex);
+    extentMaps.erase(index);
+}
+
+void PseudoNTFS::journalBitmap(const int index) {
+
+    struct journal_range range = {JOURNAL_RECORD_BITMAP, sizeof(unsigned char)};
+    transactionRanges[&bitmapStart[index / 8] - ntfs] = range;
+    trackClusterChange(index);
+}
+
+void PseudoNTFS::journalCluster(const int index) {
+
+    struct journal_range range = {JOURNAL_RECORD_DIRECTORY, bootRecord->cluster_size};
+    transactionRanges[clusterOffset(index)] = range;
+    pinCluster(index);
+    updateClusterChecksum(index);
+    trackClusterChange(index);
+}
+
+void PseudoNTFS::journalBootRecord(const int32_t * field) {
+
+    struct journal_range range = {JOURNAL_RECORD_BOOT, sizeof(int32_t)};
+    transactionRanges[((const unsigned char *) field) - ntfs] = range;
+}
+
+void PseudoNTFS::journalData(const int index) {
+
+    transactionFreedClusters.erase(index);
+    transactionDataClusters.insert(index);
+    pinCluster(index);
+    updateClusterChecksum(index);
+    trackClusterChange(index);
+}
+
+void PseudoNTFS::journalData(const int index, const uint32_t checksum) {
+
+    transactionFreedClusters.erase(index);
+    transactionDataClusters.insert(index);
+    pinCluster(index);
+    updateClusterChecksum(index, checksum);
+    trackClusterChange(index);
+}
+
+void PseudoNTFS::journalFreedData(const int index) {
+
+    // cluster written and freed in the same transaction is only cleared
+    transactionDataClusters.erase(index);
+    transactionFreedClusters.insert(index);
+    pinCluster(index);
+    updateClusterChecksum(index);
+    trackClusterChange(index);
+}
+
+void PseudoNTFS::updateClusterChecksum(const int index) {
+
+    // every write of data cluster is journaled after the cluster is changed
+    updateClusterChecksum(index, crc32c(clusterData(index), bootRecord->cluster_size));
+}
+
+void PseudoNTFS::updateClusterChecksum(const int index, const uint32_t checksum) {
+
+    checksumStart[index] = checksum;
+
+    struct journal_range range = {JOURNAL_RECORD_CHECKSUM, sizeof(uint32_t)};
+    transactionRanges[((unsigned char *) &checksumStart[index]) - ntfs] = range;
+}
+
+bool PseudoNTFS::verifyClusterChecksum(const int index, const unsigned char * data) const {
+    return crc32c(data, bootRecord->cluster_size) == checksumStart[index];
+}
+
+void PseudoNTFS::pinCluster(const int index) {
+
+    if (cache == NULL) {
+        return;
+    }
+
+    // cluster must not be written back before its transaction is in journal
+    if (transactionPinnedClusters.insert(index).second) {
+        cache->pin(index);
+    }
+    cache->markDirty(index);
+}
+
+int64_t PseudoNTFS::commitTransaction(std::set<int32_t> * pinnedClusters) {
+
+    JournalTransaction transaction;
+
+    for (int32_t index : transactionDataClusters) {
+        transaction.addOrderedRecord(clusterOffset(index), clusterData(index), bootRecord->cluster_size);
+        committedBytes += bootRecord->cluster_size;
+    }
+
+    // revoke by later transaction is found by offset of cluster, so every freed cluster has its own record
+    for (int32_t index : transactionFreedClusters) {
+        transaction.addZeroRecord(clusterOffset(index), bootRecord->cluster_size);
+    }
+
+    // neighbouring ranges of same type are logged as one record
+    std::map<int64_t, struct journal_range>::iterator it = transactionRanges.begin();
+    while (it != transactionRanges.end()) {
+
+        int64_t offset = it->first;
+        int8_t type = it->second.type;
+        int32_t length = it->second.length;
+
+        // data clusters may not be in memory together
+        if (type == JOURNAL_RECORD_DIRECTORY) {
+            transaction.addRecord(type, offset, clusterData((offset - clusterOffset(0)) / bootRecord->cluster_size), length);
+            committedBytes += length;
+            it++;
+            continue;
+        }
+
+        for (it++; it != transactionRanges.end() && it->first == offset + length && it->second.type == type; it++) {
+            length += it->second.length;
+        }
+
+        transaction.addRecord(type, offset, &ntfs[offset], length);
+        committedBytes += length;
+    }
+
+    transactionRanges.clear();
+    transactionDataClusters.clear();
+    transactionFreedClusters.clear();
+    pinnedClusters->swap(transactionPinnedClusters);
+
+    // reserved clusters not taken by transaction are free again, prepared data written to them are cleared
+    for (const std::pair<const int32_t, int32_t> & run : transactionReserved.getExtents()) {
+        if (cache == NULL) {
+            memset(clusterData(run.first), 0, (int64_t) run.second * bootRecord->cluster_size);
+        }
+        allocationGroups.release(run.first, run.second);
+    }
+    transactionReserved.clear();
+
+    // journal writes transaction bigger than its region in place, operations with many changes commit in parts that fit
+    if (volumeFile >= 0 && (int64_t) transaction.records.size() > journal->getCapacity()) {
+        std::cout << "TRANSACTION IS BIGGER THAN JOURNAL, IT IS WRITTEN WITHOUT LOG\n";
+    }
+
+    return journal->enqueue(&transaction);
+}
+
+unsigned char * PseudoNTFS::clusterData(const int index) {
+
+    if (cache != NULL) {
+        return cache->getCluster(index);
+    }
+
+    return &dataStart[index * bootRecord->cluster_size];
+}
+
+int64_t PseudoNTFS::clusterOffset(const int index) const {
+    return (dataStart - ntfs) + (int64_t) index * bootRecord->cluster_size;
+}
+
 void PseudoNTFS::initMft() {
 
 
     struct mft_item tempMftItem = {UID_ITEM_FREE};
+    tempMftItem.item_next = NOT_FOUND;
 
     struct boot_record * br = (boot_record *) ntfs;
 
@@ -81,6 +622,106 @@ void PseudoNTFS::initMft() {
     }
 }
 
+void PseudoNTFS::rebuildHotTable() {
+
+    hotTable.resize(mftItemsCount);
+    for (int i = 0; i < mftItemsCount; i++) {
+        hotTable.update(i, &mftItemStart[i]);
+    }
+}
+
+NameIndex * PseudoNTFS::names() {
+
+    if (nameIndexBuilt) {
+        return &nameIndex;
+    }
+    nameIndexBuilt = true;
+
+    // index changed after it was saved is built from mft items again
+    if (!loadNameIndex()) {
+        nameIndex.resize(mftItemsCount);
+        for (int i = 0; i < mftItemsCount; i++) {
+            nameIndex.update(i, &mftItemStart[i]);
+        }
+        nameIndexDirty = true;
+    }
+
+    return &nameIndex;
+}
+
+bool PseudoNTFS::loadNameIndex() {
+
+    int32_t mftIndex = bootRecord->name_index_item;
+    if (mftIndex < 0 || mftIndex >= mftItemsCount || mftItemStart[mftIndex].uid == UID_ITEM_FREE || !(mftItemStart[mftIndex].item_flags & MFT_ITEM_SYSTEM)) {
+        return false;
+    }
+
+    std::string data;
+    return loadFileFromPseudoNtfs(mftIndex, &data) && nameIndex.deserialize(data, bootRecord->name_index_stamp, mftItemsCount);
+}
+
+bool PseudoNTFS::saveNameIndex() {
+
+    // saved index is stale until new one replaces it
+    NameIndex * index = names();
+    nameIndexDirty = true;
+    bootRecord->name_index_stamp++;
+    journalBootRecord(&bootRecord->name_index_stamp);
+
+    std::string data;
+    index->serialize(bootRecord->name_index_stamp, &data);
+    int32_t allocated = allocatedSize(data.c_str(), data.length());
+    if (allocated > availableSpace()) {
+        std::cout << "NOT ENOUGH FREE SPACE";
+        return false;
+    }
+
+    int32_t mftIndex = findFreeMft();
+    if (mftIndex == NOT_FOUND) {
+        std::cout << "NOT ENOUGH FREE ITEMS";
+        return false;
+    }
+
+    // system file is in no directory, name index skips it
+    struct mft_item mftItem;
+    mftItem.uid = getUid();
+    strcpy(mftItem.item_name, NAME_INDEX_FILE);
+    mftItem.isDirectory = false;
+    mftItem.item_order = 1;
+    mftItem.item_order_total = 1;
+    mftItem.item_flags = MFT_ITEM_SYSTEM;
+    mftItem.item_size = 0;
+    mftItem.item_next = NOT_FOUND;
+    mftItem.item_valid = 0;
+    clearMftItemFragments(mftItem.fragments);
+    setMftItem(mftIndex, &mftItem);
+
+    std::list<struct data_seg> dataSegmentList;
+    if (!prepareMftItems(&dataSegmentList, allocated, NOT_FOUND, homeGroup(mftIndex)) || !save(&dataSegmentList, NAME_INDEX_FILE, mftItem.uid, &data[0], data.length(), data.length(), MFT_ITEM_SYSTEM, mftIndex)) {
+        freeMftItemWithData(mftIndex);
+        std::cout << "NOT ENOUGH FREE SPACE";
+        return false;
+    }
+
+    if (bootRecord->name_index_item != NOT_FOUND) {
+        freeMftItemWithData(bootRecord->name_index_item);
+    }
+    bootRecord->name_index_item = mftIndex;
+    journalBootRecord(&bootRecord->name_index_item);
+    nameIndexDirty = false;
+    return true;
+}
+
+void PseudoNTFS::initChecksums() {
+
+    std::vector<unsigned char> empty(bootRecord->cluster_size, 0);
+    uint32_t emptyChecksum = crc32c(empty.data(), empty.size());
+
+    for (int i = 0; i < bootRecord->cluster_count; i++) {
+        checksumStart[i] = emptyChecksum;
+    }
+}
+
 // initialize bitmap to free (false = 0)
 void PseudoNTFS::initBitmap() {
 
@@ -106,10 +747,26 @@ void PseudoNTFS::setBitmap(const int index, const bool value) {
         temp = temp | (128 >> j);
     }
     else {
-        temp = temp & (127 >> j);
+        temp = temp & ~(128 >> j);
+    }
+
+    // runs of free clusters follow changes of bitmap
+    if (temp != bitmapStart[i]) {
+        spaceIndex.wait();
+        if (value) {
+            // cluster reserved by transaction is no longer in its group
+            if (!transactionReserved.allocate(index)) {
+                allocationGroups.allocate(index);
+            }
+            clusterGenerations[index] = generation;
+        }
+        else {
+            allocationGroups.release(index);
+        }
     }
 
     memcpy(&bitmapStart[i], &temp, sizeof(unsigned char));
+    journalBitmap(index);
 }
 
 const bool PseudoNTFS::isClusterFree(const int index) {
@@ -133,9 +790,15 @@ void PseudoNTFS::setMftItem(const int index, const struct mft_item * item) {
         return;
     }
 
+    preserveMftItem(index);
     memcpy(&mftItemStart[index], item, sizeof(mft_item));
+    journalMftItem(index);
 
     freeMftItems--;
+    firstFreeMftItem = hot()->findFree(firstFreeMftItem);
+    if (firstFreeMftItem == NOT_FOUND) {
+        firstFreeMftItem = mftItemsCount;
+    }
 }
 
 void PseudoNTFS::printMftItem(const int index) {
@@ -147,9 +810,18 @@ void PseudoNTFS::printMftItem(const int index) {
     std::cout << "UID: " << mftItemStart[index].uid << std::endl;
     std::cout << "Name: " <<  mftItemStart[index].item_name << std::endl;
     std::cout << "Is directory: " <<  mftItemStart[index].isDirectory << std::endl;
+    std::cout << "Compressed: " << ((mftItemStart[index].item_flags & MFT_ITEM_COMPRESSED) != 0) << std::endl;
+    std::cout << "Resident: " << ((mftItemStart[index].item_flags & MFT_ITEM_RESIDENT) != 0) << std::endl;
+    std::cout << "Preallocated: " << ((mftItemStart[index].item_flags & MFT_ITEM_PREALLOCATED) != 0) << std::endl;
     std::cout << "Item size: " << (int)  mftItemStart[index].item_size << std::endl;
     std::cout << "Item order: " << (int)  mftItemStart[index].item_order << std::endl;
     std::cout << "Item order total: " << (int)  mftItemStart[index].item_order_total << std::endl;
+    std::cout << "Next item: " << mftItemStart[index].item_next << std::endl;
+
+    // resident file has data in place of fragments
+    if (mftItemStart[index].item_flags & MFT_ITEM_RESIDENT) {
+        return;
+    }
 
     std::cout << "Fragments - i - start adress - count" << std::endl;
     for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
@@ -165,11 +837,14 @@ void PseudoNTFS::setClusterData(const int index, const unsigned char * data, con
         return;
     }
 
+    unsigned char * cluster = clusterData(index);
+
     // clear cluster data
-    memset(&dataStart[index * bootRecord->cluster_size], 0, bootRecord->cluster_size);
+    memset(cluster, 0, bootRecord->cluster_size);
 
     // set cluster with data
-    memcpy(&dataStart[index * bootRecord->cluster_size], data, size);
+    memcpy(cluster, data, size);
+    journalData(index);
     setBitmap(index, true);
 }
 
@@ -180,130 +855,605 @@ void PseudoNTFS::getClusterData(const int index, unsigned char * data) {
         return;
     }
 
-    memset(data, 0, bootRecord->cluster_size);
-    memcpy(data, &dataStart[index * bootRecord->cluster_size], bootRecord->cluster_size);
+    if (cache != NULL) {
+        cache->readCluster(index, data);
+    }
+    else {
+        memcpy(data, &dataStart[index * bootRecord->cluster_size], bootRecord->cluster_size);
+    }
 
+    if (verifyChecksums && !verifyClusterChecksum(index, data)) {
+        std::cout << "CHECKSUM MISMATCH IN CLUSTER " << index << std::endl;
+    }
 }
 
-void PseudoNTFS::prepareMftItems(std::list<struct data_seg> * dataSegmentList, int32_t demandedSize) {
+bool PseudoNTFS::prepareMftItems(std::list<struct data_seg> * dataSegmentList, int32_t demandedSize, const int32_t goal, const int32_t group) {
 
         struct data_seg dataSegment;
-        int32_t index = 0, providedSize = 0;
+        int32_t index = goal, providedSize = 0;
 
-        do {
-            findFreeSpace(demandedSize, &index, &providedSize);
-
-            if (demandedSize < providedSize) {
-                dataSegment.size = demandedSize;
-            }
-            else {
-                dataSegment.size = providedSize;
-            }
-            
+        findFreeSpace(demandedSize, &index, &providedSize, group);
+        if (providedSize >= demandedSize) {
             dataSegment.startIndex = index;
+            dataSegment.size = demandedSize;
+            dataSegmentList->push_back(dataSegment);
+            return true;
+        }
+
+        // free space is fragmented - free runs are reserved one after another, so no run is used twice
+        // next fit and locality take them from cursor or goal, search wraps around to start of group and continues in next groups
+        int32_t from = 0;
+        if (bootRecord->allocation_policy == ALLOCATION_NEXT_FIT) {
+            from = allocationCursor;
+        }
+        else if (bootRecord->allocation_policy == ALLOCATION_LOCALITY && goal != NOT_FOUND) {
+            from = goal;
+        }
+        int32_t clusterSize = bootRecord->cluster_size;
+        int32_t demandedCount = ceil(demandedSize / (double) clusterSize);
+        int32_t first = preferredGroup(goal, group);
+        std::vector<struct reserved_run> runs;
+        for (int32_t i = 0, reserved = 0; i < allocationGroups.getCount() && reserved < demandedCount; i++) {
+            int32_t current = (first + i) % allocationGroups.getCount();
+            reserved += allocationGroups.reserveRuns(current, allocationGroups.groupOf(from) == current ? from : allocationGroups.groupStart(current), demandedCount - reserved, &runs);
+        }
 
+        // clusters of failed allocation return to their groups at commit
+        for (const struct reserved_run & run : runs) {
+            transactionReserved.release(run.start, run.count);
+            dataSegment.startIndex = run.start;
+            dataSegment.size = std::min(demandedSize, run.count * clusterSize);
             dataSegmentList->push_back(dataSegment);
-            demandedSize -= providedSize;
-        } while (demandedSize > 0);
+            demandedSize -= dataSegment.size;
+        }
+
+        return demandedSize <= 0;
 }
 
-bool PseudoNTFS::save(std::list<struct data_seg> * dataSegmentList, const char * fileName, int32_t uid, char * fileData, int32_t fileLength) {
+bool PseudoNTFS::save(std::list<struct data_seg> * dataSegmentList, const char * fileName, int32_t uid, char * fileData, int32_t fileLength, int32_t itemSize, int8_t itemFlags, const int32_t mftItemIndex) {
+
+        // mft item of delayed file exists already
+        int32_t existingMftItems = mftItemIndex != NOT_FOUND ? 1 : 0;
 
-        int8_t dataClustersCount = dataSegmentList->size();
-       
-        int8_t neededMftItemsCount = neededMftItems(dataClustersCount);
-        if (neededMftItemsCount > freeMftItems) {
+        int32_t neededMftItemsCount = neededMftItems(dataSegmentList->size());
+        if (neededMftItemsCount - existingMftItems > freeMftItems) {
             std::cout << "NOT ENOUGH FREE ITEMS";
             return false;
         }
-        
-        // Prepare struct to save
-        struct mft_item mftItem;
-        mftItem.uid = uid;
-        mftItem.isDirectory = false;
-        mftItem.item_order = 1;
-        mftItem.item_order_total = mftItemsCount;
-        strcpy(mftItem.item_name, fileName);
-        mftItem.item_size = fileLength;
-        
 
-        int8_t counter = 0, dataCounter = 0;
-        int8_t mftItemsLeft = neededMftItemsCount;
-        int8_t mftIndex;
+        int32_t clusterSize = bootRecord->cluster_size;
+        int32_t clustersCount = ceil(fileLength / (double) clusterSize);
 
-        for (data_seg item : *dataSegmentList) {
+        // data are saved first, deduplication can split segments to more fragments
+        // clusters of zeros are holes, runs of other clusters take next clusters of segments
+        std::list<struct mft_fragment> fragments;
+        std::list<struct data_seg>::const_iterator segment = dataSegmentList->begin();
+        int32_t segmentUsed = 0;
+        for (int32_t i = 0, run; i < clustersCount; i += run) {
 
-            counter %= MFT_FRAGMENTS_COUNT;
-            
-            if (counter == 0) {
-                mftIndex = findFreeMft();
-                clearMftItemFragments(mftItem.fragments);  
+            bool hole = isZeroCluster(fileData, fileLength, i);
+            if (!hole && segment == dataSegmentList->end()) {
+                break;
             }
+            int32_t limit = hole ? clustersCount : i + (int32_t) ceil(segment->size / (double) clusterSize) - segmentUsed;
+            for (run = 1; i + run < limit && isZeroCluster(fileData, fileLength, i + run) == hole; run++);
 
-            mftItem.fragments[counter].fragment_start_address = item.startIndex;
-            mftItem.fragments[counter].fragment_count = ceil(item.size / (double) bootRecord->cluster_size);
-            saveContinualSegment(fileData + dataCounter, item.size, item.startIndex);
-            dataCounter += item.size;
+            if (hole) {
+                appendFragment(&fragments, EXTENT_HOLE, run);
+                continue;
+            }
 
-            if (counter == MFT_FRAGMENTS_COUNT - 1) {
-                mftItem.item_order++;
-                setMftItem(mftIndex, &mftItem);
+            saveContinualSegment(fileData + i * clusterSize, std::min(run * clusterSize, fileLength - i * clusterSize), segment->startIndex + segmentUsed, &fragments);
+            segmentUsed += run;
+            if (segmentUsed * clusterSize >= segment->size) {
+                segment++;
+                segmentUsed = 0;
             }
-    
-            counter++;
         }
-        setMftItem(mftIndex, &mftItem);
 
-        return true;
+        return saveMftItems(&fragments, fileName, uid, itemSize, itemFlags, mftItemIndex);
+}
+
+bool PseudoNTFS::saveMftItems(const std::list<struct mft_fragment> * fragments, const char * fileName, int32_t uid, int32_t itemSize, int8_t itemFlags, const int32_t mftItemIndex) {
+
+        // mft item of delayed or prepared file exists already
+        int32_t existingMftItems = mftItemIndex != NOT_FOUND ? 1 : 0;
+
+        // Prepare struct to save
+        struct mft_item mftItem;
+        mftItem.uid = uid;
+        mftItem.isDirectory = false;
+        strcpy(mftItem.item_name, fileName);
+        mftItem.item_flags = itemFlags;
+        mftItem.item_size = itemSize;
+        mftItem.item_order = 1;
+        mftItem.item_order_total = 1;
+        mftItem.item_next = NOT_FOUND;
+        mftItem.item_valid = 0;
+        clearMftItemFragments(mftItem.fragments);
+
+        int32_t neededMftItemsCount = neededMftItems(fragments->size());
+        std::vector<int32_t> mftIndexes;
+        if (neededMftItemsCount > INT16_MAX || !findFreeMftItems(neededMftItemsCount - existingMftItems, &mftIndexes)) {
+            // data without mft item would be lost
+            for (const mft_fragment & fragment : *fragments) {
+                if (fragment.fragment_start_address != EXTENT_HOLE) {
+                    clearClusterData(fragment.fragment_start_address, fragment.fragment_count);
+                }
+            }
+            std::cout << "NOT ENOUGH FREE ITEMS";
+            return false;
+        }
+
+        // first mft item of file, fragments over MFT_FRAGMENTS_COUNT continue in next ones
+        int32_t headIndex = mftItemIndex;
+        if (existingMftItems > 0) {
+            preserveMftItem(mftItemIndex);
+            memcpy(&mftItemStart[mftItemIndex], &mftItem, sizeof(mft_item));
+            journalMftItem(mftItemIndex);
+        }
+        else {
+            headIndex = mftIndexes[0];
+            setMftItem(headIndex, &mftItem);
+        }
+
+        return setFileFragments(headIndex, fragments);
+
+}
 
+void PseudoNTFS::saveResident(const int32_t mftItemIndex, const char * fileData, int32_t fileLength) {
+
+        struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+        preserveMftItem(mftItemIndex);
+        mftItem->item_flags = MFT_ITEM_RESIDENT;
+        mftItem->item_size = fileLength;
+
+        clearMftItemFragments(mftItem->fragments);
+        memcpy(mftItem->fragments, fileData, fileLength);
+        journalMftItem(mftItemIndex);
 }
 
 bool PseudoNTFS::saveFileToPseudoNtfs(const char * fileName, const char * filePath, int32_t parentDirectoryMftIndex) {
 
+        // host file is read before volume is locked, other files are saved meanwhile
+        std::string fileData;
+        bool found = readFile(filePath, &fileData);
+        return saveFileData(fileName, &fileData, found, parentDirectoryMftIndex, compression);
+}
+
+bool PseudoNTFS::saveFileData(const char * fileName, std::string * content, const bool found, const int32_t parentDirectoryMftIndex, const bool compress) {
+
+        std::string & fileData = *content;
+        int32_t itemSize = fileData.length();
+        int8_t itemFlags = 0;
+
+        // data of file going to data clusters of in-memory volume are written to clusters reserved in allocation groups, only metadata wait for lock
+        struct prepared_file prepared;
+        bool clustered = !(residentData && itemSize <= MFT_RESIDENT_SIZE) && !(delayedAllocation && itemSize <= delayedBudget);
+        if (found && clustered && cache == NULL && !deduplication && parentDirectoryMftIndex >= 0 && parentDirectoryMftIndex < mftItemsCount
+            && allocationGroups.beginPrepared()) {
+
+            if (compress) {
+                std::string storedData;
+                compressData(fileData.c_str(), itemSize, &storedData);
+                fileData.swap(storedData);
+                itemFlags |= MFT_ITEM_COMPRESSED;
+            }
+
+            if (prepareFileData(fileData.c_str(), fileData.length(), homeGroup(parentDirectoryMftIndex), &prepared)) {
+                return savePrepared(&prepared, fileName, parentDirectoryMftIndex, itemSize, itemFlags);
+            }
+
+            // there is no room in groups, snapshot clusters can be reclaimed under lock
+            allocationGroups.endPrepared();
+        }
+
+        Transaction transaction(this);
+
         if (parentDirectoryMftIndex < 0 || parentDirectoryMftIndex  >= mftItemsCount) {
             indexOutOfRange = true;
             return false;
         }
 
-        if (contains(parentDirectoryMftIndex, fileName, false) != NOT_FOUND) {
-            std::cout << "FILE WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
+        struct directory_entry entry;
+        if (findDirectoryEntry(parentDirectoryMftIndex, fileName, &entry)) {
+            std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
             return false;
         }
 
-        if (contains(parentDirectoryMftIndex, fileName, true) != NOT_FOUND) {
-            std::cout << "DIRECTORY WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
+        if (!found) {
+            std::cout << "FILE NOT FOUND";
             return false;
         }
 
-        std::string fileData;
-        if (!readFile(filePath, &fileData)) {
-            std::cout << "FILE NOT FOUND";
-            return false;
+        // small file does not need any data cluster
+        if (residentData && itemSize <= MFT_RESIDENT_SIZE) {
+            if (freeMftItems == 0) {
+                std::cout << "NOT ENOUGH FREE ITEMS";
+                return false;
+            }
+
+            int32_t mftIndex = createItem(parentDirectoryMftIndex, fileName, false);
+            if (mftIndex == NOT_FOUND) {
+                std::cout << "NOT ENOUGH FREE SPACE";
+                return false;
+            }
+
+            saveResident(mftIndex, fileData.c_str(), itemSize);
+            return true;
+        }
+
+        // data wait in memory, files are allocated together later
+        if (delayedAllocation && itemSize <= delayedBudget) {
+            return saveDelayed(fileName, &fileData, parentDirectoryMftIndex);
         }
+
+        // compressed file is stored as sequence of compressed chunks, file prepared before lock is compressed already
+        if (compress && !(itemFlags & MFT_ITEM_COMPRESSED)) {
+            std::string storedData;
+            compressData(fileData.c_str(), itemSize, &storedData);
+            fileData.swap(storedData);
+            itemFlags |= MFT_ITEM_COMPRESSED;
+        }
+
         // No end char - we only store values to save
         int len = fileData.length();
 
         char * data = new char[len];
         memcpy(data, fileData.c_str(), len);
-        
-        if (len > freeSpace) {
+
+        // holes of sparse file take no space
+        int32_t allocated = allocatedSize(data, len);
+        if (allocated > availableSpace()) {
             std::cout << "NOT ENOUGH FREE SPACE";
             return false;
         };
     
-        int32_t uid = getUid();
-        if (!saveUid(parentDirectoryMftIndex, uid)) {
+        int32_t mftIndex = createItem(parentDirectoryMftIndex, fileName, false);
+        if (mftIndex == NOT_FOUND) {
             std::cout << "NOT ENOUGH FREE SPACE";
             return false;
         }
 
         std::list<struct data_seg> dataSegmentList;
-        prepareMftItems(&dataSegmentList, len);
-        return save(&dataSegmentList, fileName, uid, data, len);
+        if (!prepareMftItems(&dataSegmentList, allocated, allocationGoal(parentDirectoryMftIndex), homeGroup(parentDirectoryMftIndex)) || !save(&dataSegmentList, fileName, mftItemStart[mftIndex].uid, data, len, itemSize, itemFlags, mftIndex)) {
+            removeDirectoryEntry(parentDirectoryMftIndex, fileName);
+            freeMftItemWithData(mftIndex);
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        return true;
+}
+
+bool PseudoNTFS::prepareFileData(const char * fileData, const int32_t fileLength, const int32_t group, struct prepared_file * prepared) {
+
+        spaceIndex.wait();
+
+        int32_t clusterSize = bootRecord->cluster_size;
+        int32_t clustersCount = ceil(fileLength / (double) clusterSize);
+        int32_t demandedCount = allocatedSize(fileData, fileLength) / clusterSize;
+
+        // one run by allocation policy, locality keeps files of group after each other, else runs of groups one after another
+        int32_t start = 0;
+        int32_t goal = bootRecord->allocation_policy == ALLOCATION_LOCALITY ? std::min(allocationGroups.getCursor(group), bootRecord->cluster_count - 1) : NOT_FOUND;
+        if (demandedCount > 0 && reserveFreeRun(demandedCount, goal, group, &start) > 0) {
+            struct reserved_run run = {start, demandedCount};
+            prepared->runs.push_back(run);
+            allocationCursor = start + demandedCount;
+        }
+        else if (demandedCount > 0) {
+            int32_t reserved = 0;
+            for (int32_t i = 0; i < allocationGroups.getCount() && reserved < demandedCount; i++) {
+                int32_t current = (group + i) % allocationGroups.getCount();
+                reserved += allocationGroups.reserveRuns(current, allocationGroups.groupStart(current), demandedCount - reserved, &prepared->runs);
+            }
+            if (reserved < demandedCount) {
+                for (const struct reserved_run & run : prepared->runs) {
+                    allocationGroups.release(run.start, run.count);
+                }
+                prepared->runs.clear();
+                return false;
+            }
+        }
+
+        // clusters of zeros are holes, other clusters take reserved clusters in order
+        std::vector<struct reserved_run>::const_iterator run = prepared->runs.begin();
+        int32_t runUsed = 0;
+        for (int32_t i = 0; i < clustersCount; i++) {
+
+            if (isZeroCluster(fileData, fileLength, i)) {
+                appendFragment(&prepared->fragments, EXTENT_HOLE);
+                continue;
+            }
+
+            int32_t index = run->start + runUsed;
+            unsigned char * cluster = clusterData(index);
+            int32_t length = std::min(clusterSize, fileLength - i * clusterSize);
+            memcpy(cluster, fileData + i * clusterSize, length);
+            memset(cluster + length, 0, clusterSize - length);
+            prepared->checksums.push_back(crc32c(cluster, clusterSize));
+            appendFragment(&prepared->fragments, index);
+
+            if (++runUsed == run->count) {
+                run++;
+                runUsed = 0;
+            }
+        }
+
+        return true;
+}
+
+bool PseudoNTFS::savePrepared(const struct prepared_file * prepared, const char * fileName, const int32_t parentDirectoryMftIndex, const int32_t itemSize, const int8_t itemFlags) {
+
+        Transaction transaction(this);
+
+        // clusters not taken by file are cleared and released at commit
+        for (const struct reserved_run & run : prepared->runs) {
+            transactionReserved.release(run.start, run.count);
+        }
+        allocationGroups.endPrepared();
+
+        struct directory_entry entry;
+        if (findDirectoryEntry(parentDirectoryMftIndex, fileName, &entry)) {
+            std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
+            return false;
+        }
+
+        int32_t mftIndex = createItem(parentDirectoryMftIndex, fileName, false);
+        if (mftIndex == NOT_FOUND) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        if (neededMftItems(prepared->fragments.size()) - 1 > freeMftItems) {
+            removeDirectoryEntry(parentDirectoryMftIndex, fileName);
+            freeMftItemWithData(mftIndex);
+            std::cout << "NOT ENOUGH FREE ITEMS";
+            return false;
+        }
+
+        // written clusters are taken in order of fragments, their checksums were computed before lock
+        size_t written = 0;
+        for (const struct mft_fragment & fragment : prepared->fragments) {
+            for (int32_t i = 0; i < fragment.fragment_count && fragment.fragment_start_address != EXTENT_HOLE; i++) {
+                journalData(fragment.fragment_start_address + i, prepared->checksums[written++]);
+                setBitmap(fragment.fragment_start_address + i, true);
+            }
+        }
+
+        if (!saveMftItems(&prepared->fragments, fileName, mftItemStart[mftIndex].uid, itemSize, itemFlags, mftIndex)) {
+            removeDirectoryEntry(parentDirectoryMftIndex, fileName);
+            freeMftItemWithData(mftIndex);
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        return true;
+}
+
+bool PseudoNTFS::saveDelayed(const char * fileName, std::string * fileData, const int32_t parentDirectoryMftIndex) {
+
+        int32_t itemSize = fileData->length();
+
+        // size threshold - files held in memory are written before budget is exceeded
+        if (delayedBytes + itemSize > delayedBudget) {
+            flushDelayedFiles();
+        }
+
+        if (freeMftItems == 0) {
+            std::cout << "NOT ENOUGH FREE ITEMS";
+            return false;
+        }
+
+        // clusters of file are reserved until flush allocates them, so flush does not run out of space
+        int32_t reserved = clustersOf(itemSize);
+        if (reserved > availableClusters()) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+
+        int32_t mftIndex = createItem(parentDirectoryMftIndex, fileName, false);
+        if (mftIndex == NOT_FOUND) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+
+        preserveMftItem(mftIndex);
+        mftItemStart[mftIndex].item_flags = MFT_ITEM_DELAYED | (compression ? MFT_ITEM_COMPRESSED : 0);
+        mftItemStart[mftIndex].item_size = itemSize;
+        journalMftItem(mftIndex);
+
+        struct delayed_file & file = delayedFiles[mftIndex];
+        file.parentMftItemIndex = parentDirectoryMftIndex;
+        file.sequence = delayedSequence++;
+        file.data.swap(*fileData);
+        delayedBytes += itemSize;
+        delayedClusters += reserved;
+
+        return true;
+}
+
+bool PseudoNTFS::flushDelayedFiles() {
+
+        if (delayedFiles.empty()) {
+            return true;
+        }
+
+        // files of one directory go next to each other, in order they were created
+        std::vector<std::map<int32_t, struct delayed_file>::iterator> files;
+        for (std::map<int32_t, struct delayed_file>::iterator it = delayedFiles.begin(); it != delayedFiles.end(); it++) {
+            files.push_back(it);
+        }
+        std::sort(files.begin(), files.end(), [](const std::map<int32_t, struct delayed_file>::iterator & a, const std::map<int32_t, struct delayed_file>::iterator & b) {
+            return a->second.parentMftItemIndex != b->second.parentMftItemIndex ? a->second.parentMftItemIndex < b->second.parentMftItemIndex : a->second.sequence < b->second.sequence;
+        });
+
+        int32_t clusterSize = bootRecord->cluster_size;
+        int32_t clustersCount = 0;
+        for (std::map<int32_t, struct delayed_file>::iterator & file : files) {
+            if (mftItemStart[file->first].item_flags & MFT_ITEM_COMPRESSED) {
+                std::string storedData;
+                compressData(file->second.data.c_str(), file->second.data.length(), &storedData);
+                file->second.data.swap(storedData);
+            }
+            clustersCount += allocatedSize(file->second.data.c_str(), file->second.data.length()) / clusterSize;
+        }
+
+        // whole batch is allocated at once, so it gets one extent if there is continual free space for it
+        std::list<struct data_seg> batchSegments;
+        bool allocated = prepareMftItems(&batchSegments, clustersCount * clusterSize, allocationGoal(files.front()->second.parentMftItemIndex), homeGroup(files.front()->second.parentMftItemIndex));
+
+        std::vector<int32_t> clusters;
+        for (const data_seg & segment : batchSegments) {
+            for (int32_t i = 0; i < segment.size / clusterSize; i++) {
+                clusters.push_back(segment.startIndex + i);
+            }
+        }
+
+        size_t position = 0;
+        for (std::map<int32_t, struct delayed_file>::iterator & file : files) {
+
+            int32_t mftIndex = file->first;
+            struct mft_item * mftItem = &mftItemStart[mftIndex];
+            int32_t length = file->second.data.length();
+            int32_t count = allocatedSize(file->second.data.c_str(), length) / clusterSize;
+
+            // file takes next clusters of batch, holes of file take none
+            std::list<struct data_seg> dataSegmentList;
+            struct data_seg segment;
+            for (int32_t i = 0; allocated && i < count; i++) {
+                if (!dataSegmentList.empty() && dataSegmentList.back().startIndex + dataSegmentList.back().size / clusterSize == clusters[position]) {
+                    dataSegmentList.back().size += clusterSize;
+                }
+                else {
+                    segment.startIndex = clusters[position];
+                    segment.size = clusterSize;
+                    dataSegmentList.push_back(segment);
+                }
+                position++;
+            }
+
+            if (!allocated || !save(&dataSegmentList, mftItem->item_name, mftItem->uid, (char *) file->second.data.c_str(), length, mftItem->item_size, mftItem->item_flags & ~MFT_ITEM_DELAYED, mftIndex)) {
+                preserveMftItem(mftIndex);
+                mftItem->item_flags = 0;
+                mftItem->item_size = 0;
+                journalMftItem(mftIndex);
+                allocated = false;
+            }
+        }
+
+        delayedFlushes++;
+        delayedFlushedFiles += files.size();
+        delayedFlushedExtents += batchSegments.size();
+
+        delayedFiles.clear();
+        delayedBytes = 0;
+        delayedClusters = 0;
+
+        if (!allocated) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+        }
+
+        return allocated;
+}
+
+void PseudoNTFS::setDelayedAllocation(const bool delayedAllocation, const int32_t budget) {
+
+    Transaction transaction(this);
+
+    flushDelayedFiles();
+    this->delayedAllocation = delayedAllocation;
+    delayedBudget = budget;
+}
+
+bool PseudoNTFS::sync() {
+
+    Transaction transaction(this);
+    spaceIndex.wait();
+    if (snapshotReclaim) {
+        reclaimSnapshotClusters();
+    }
+    return flushDelayedFiles();
+}
+
+void PseudoNTFS::printDelayedStatistics() {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    std::cout << "Delayed allocation: " << (delayedAllocation ? "on" : "off") << ", budget: " << delayedBudget / 1024 << " kB" << std::endl;
+    std::cout << "Held in memory: " << delayedFiles.size() << " files, " << delayedBytes << " B, reserved clusters: " << delayedClusters << std::endl;
+    std::cout << "Flushes: " << delayedFlushes << ", files: " << delayedFlushedFiles << ", extents: " << delayedFlushedExtents;
+    std::cout << ", files per extent: " << (delayedFlushedExtents == 0 ? 0 : (double) delayedFlushedFiles / delayedFlushedExtents);
+}
+
+void PseudoNTFS::printSpaceStatistics() {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    int32_t clusterCount = bootRecord->cluster_count;
+    int32_t freeClusters = availableClusters() + delayedClusters;
+    std::cout << "Clusters: " << clusterCount << ", used: " << clusterCount - freeClusters << ", free: " << freeClusters;
+    std::cout << ", reserved by delayed allocation: " << delayedClusters << ", held for snapshots: " << heldClusters.size() << std::endl;
+    std::cout << "Allocation policy: " << ALLOCATION_POLICY_NAMES[bootRecord->allocation_policy] << std::endl;
+
+    // free clusters of every group, clusters reserved by files being imported are not free
+    std::vector<int32_t> groupFree;
+    allocationGroups.groupFreeClusters(&groupFree);
+    std::cout << "Allocation groups: " << allocationGroups.getCount() << " of " << allocationGroups.getGroupClusters() << " clusters, free:";
+    for (int32_t free : groupFree) {
+        std::cout << " " << free;
+    }
+    std::cout << std::endl;
+
+    int32_t largestStart = 0;
+    int32_t largest = allocationGroups.findLargest(&largestStart);
+    std::cout << "Free extents: " << allocationGroups.getExtentsCount() << ", the largest: " << largest << " clusters";
+    if (largest > 0) {
+        std::cout << " at " << largestStart;
+    }
+    std::cout << std::endl;
+
+    std::vector<int32_t> histogram;
+    allocationGroups.histogram(&histogram);
+    for (size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0) {
+            continue;
+        }
+        int32_t from = 1 << i;
+        std::cout << "  " << from;
+        if (from > 1) {
+            std::cout << " - " << (from << 1) - 1;
+        }
+        std::cout << " clusters: " << histogram[i] << std::endl;
+    }
+
+    // extents of file are its runs of continual data clusters, holes and resident files have none
+    int64_t files = 0, filesWithData = 0, extents = 0;
+    ExtentMap extentMap;
+    for (int32_t i = 0; i < mftItemsCount; i++) {
+        if (hot()->getUid(i) == UID_ITEM_FREE || (hot()->getFlags(i) & (MFT_HOT_FIRST | MFT_HOT_DIRECTORY)) != MFT_HOT_FIRST) {
+            continue;
+        }
+        files++;
+        if (!loadExtentMap(i, &extentMap)) {
+            continue;
+        }
+        int32_t fileExtents = 0;
+        for (const struct extent & extent : extentMap.getExtents()) {
+            fileExtents += extent.start != EXTENT_HOLE;
+        }
+        filesWithData += fileExtents > 0;
+        extents += fileExtents;
+    }
+    std::cout << "Files: " << files << ", files with data clusters: " << filesWithData << ", extents: " << extents;
+    std::cout << ", extents per file: " << (filesWithData == 0 ? 0 : (double) extents / filesWithData) << std::endl;
+
+    int32_t usedMftItems = mftItemsCount - freeMftItems;
+    std::cout << "MFT items: " << mftItemsCount << ", used: " << usedMftItems << ", fill: " << (double) usedMftItems * 100 / mftItemsCount << " %";
 }
 
 bool PseudoNTFS::copy(const int32_t fileMftItemIndex, int32_t toMftItemIndex) {
 
+        Transaction transaction(this);
+
         if (fileMftItemIndex < 0 || fileMftItemIndex >= mftItemsCount || toMftItemIndex < 0 || toMftItemIndex >= mftItemsCount ) {
             indexOutOfRange = true;
             return false;
@@ -311,595 +1461,3165 @@ bool PseudoNTFS::copy(const int32_t fileMftItemIndex, int32_t toMftItemIndex) {
 
         struct mft_item * mftItem = &mftItemStart[fileMftItemIndex];
 
-        if (contains(toMftItemIndex, mftItem->item_name, false) != NOT_FOUND) {
-            std::cout << "FILE WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
-            return false;
-        }
-
-        if (contains(toMftItemIndex, mftItem->item_name, true) != NOT_FOUND) {
-            std::cout << "DIRECTORY WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
+        struct directory_entry entry;
+        if (findDirectoryEntry(toMftItemIndex, mftItem->item_name, &entry)) {
+            std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
             return false;
         }
 
         std::string content;
         loadFileFromPseudoNtfs(fileMftItemIndex, &content);
+        int32_t itemSize = content.length();
+
+        if (residentData && itemSize <= MFT_RESIDENT_SIZE) {
+            if (freeMftItems == 0) {
+                std::cout << "NOT ENOUGH FREE ITEMS";
+                return false;
+            }
+
+            int32_t mftIndex = createItem(toMftItemIndex, mftItem->item_name, false);
+            if (mftIndex == NOT_FOUND) {
+                std::cout << "NOT ENOUGH FREE SPACE";
+                return false;
+            }
+
+            saveResident(mftIndex, content.c_str(), itemSize);
+            return true;
+        }
+
+        // copy of compressed file is compressed too
+        int8_t itemFlags = mftItem->item_flags & MFT_ITEM_COMPRESSED;
+        if (itemFlags & MFT_ITEM_COMPRESSED) {
+            std::string storedData;
+            compressData(content.c_str(), itemSize, &storedData);
+            content.swap(storedData);
+        }
+
         // No end char - we only store values to save
         int len = content.length();
 
         char * data = new char[len];
         memcpy(data, content.c_str(), len);
-        
-        if (len > freeSpace) {
+
+        // holes of sparse file take no space
+        int32_t allocated = allocatedSize(data, len);
+        if (allocated > availableSpace()) {
             std::cout << "NOT ENOUGH FREE SPACE";
             return false;
         };
 
-        int32_t uid = getUid();
-        if (!saveUid(toMftItemIndex, uid)) {
+        int32_t mftIndex = createItem(toMftItemIndex, mftItem->item_name, false);
+        if (mftIndex == NOT_FOUND) {
             std::cout << "NOT ENOUGH FREE SPACE";
             return false;
         }
 
         std::list<struct data_seg> dataSegmentList;
-        prepareMftItems(&dataSegmentList, len);
-        return save(&dataSegmentList, mftItem->item_name, uid, data, len);
+        if (!prepareMftItems(&dataSegmentList, allocated, allocationGoal(toMftItemIndex), homeGroup(toMftItemIndex)) || !save(&dataSegmentList, mftItemStart[mftIndex].item_name, mftItemStart[mftIndex].uid, data, len, itemSize, itemFlags, mftIndex)) {
+            removeDirectoryEntry(toMftItemIndex, mftItemStart[mftIndex].item_name);
+            freeMftItemWithData(mftIndex);
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        return true;
 }
 
-void PseudoNTFS::clearMftItemFragments(mft_fragment * fragments) const {
+bool PseudoNTFS::copyTree(const int32_t mftItemIndex, const int32_t toMftItemIndex) {
 
-    mft_fragment clearFragments[MFT_FRAGMENTS_COUNT] = {0, 0};
-    memcpy(fragments, clearFragments, MFT_FRAGMENTS_COUNT * sizeof(mft_fragment));
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || toMftItemIndex < 0 || toMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    if (!mftItemStart[mftItemIndex].isDirectory) {
+        return copy(mftItemIndex, toMftItemIndex);
+    }
+
+    // position of copied file in walk and directory it goes to
+    struct tree_file {
+        int32_t mftItemIndex;
+        int32_t targetMftItemIndex;
+        char name[12];
+    };
+    std::vector<struct tree_file> files;
+    std::string rootName = mftItemStart[mftItemIndex].item_name;
+    int32_t root = NOT_FOUND;
+
+    {
+        Transaction transaction(this);
+
+        struct directory_entry entry;
+        if (findDirectoryEntry(toMftItemIndex, mftItemStart[mftItemIndex].item_name, &entry)) {
+            std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
+            return false;
+        }
+
+        std::vector<struct tree_directory> directories;
+        walkTree(mftItemIndex, &directories);
+
+        // every copied item takes one mft item, copy which cannot get all of them is not started
+        size_t items = directories.size();
+        for (const struct tree_directory & directory : directories) {
+            for (const struct directory_entry & child : directory.entries) {
+                items += !child.isDirectory;
+            }
+        }
+        if ((size_t) freeMftItems < items) {
+            std::cout << "NOT ENOUGH FREE ITEMS\n";
+            return false;
+        }
+
+        // directories are created in order of walk, so parent of every directory exists already
+        std::vector<int32_t> targets(directories.size(), NOT_FOUND);
+        for (size_t i = 0; i < directories.size(); i++) {
+            int32_t parent = directories[i].parent == NOT_FOUND ? toMftItemIndex : targets[directories[i].parent];
+            if (availableSpace() < bootRecord->cluster_size
+                || (targets[i] = createItem(parent, mftItemStart[directories[i].mftItemIndex].item_name, true)) == NOT_FOUND) {
+                // created directories are empty, they are freed in the same transaction, so none of them is committed
+                for (size_t j = i; j-- > 0; ) {
+                    freeMftItemWithData(targets[j]);
+                }
+                if (i > 0) {
+                    removeDirectoryEntry(toMftItemIndex, rootName.c_str());
+                }
+                std::cout << "NOT ENOUGH FREE SPACE\n";
+                return false;
+            }
+            for (const struct directory_entry & child : directories[i].entries) {
+                if (!child.isDirectory) {
+                    struct tree_file file = {child.mft_index, targets[i], ""};
+                    strncpy(file.name, child.name, sizeof(file.name) - 1);
+                    files.push_back(file);
+                }
+            }
+        }
+        root = targets[0];
+    }
+
+    // files are copied by pool of threads, content is read under lock, data are prepared and saved as new files
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> workers;
+    int32_t threadsCount = std::max((int32_t) std::thread::hardware_concurrency(), 1);
+    for (int32_t t = 0; t < threadsCount; t++) {
+        workers.push_back(std::thread([this, &files, &next, &failed]() {
+            for (size_t i = next++; i < files.size() && !failed; i = next++) {
+                const struct tree_file & file = files[i];
+                std::string content;
+                bool compressed = false;
+                {
+                    std::lock_guard<std::mutex> lock(operationMutex);
+                    // file removed meanwhile is not copied
+                    const struct mft_item * mftItem = &mftItemStart[file.mftItemIndex];
+                    if (mftItem->uid == UID_ITEM_FREE || mftItem->isDirectory || strncmp(mftItem->item_name, file.name, sizeof(file.name)) != 0) {
+                        continue;
+                    }
+                    loadFileFromPseudoNtfs(file.mftItemIndex, &content);
+                    compressed = mftItem->item_flags & MFT_ITEM_COMPRESSED;
+                }
+
+                // copy of compressed file is compressed too
+                if (!saveFileData(file.name, &content, true, file.targetMftItemIndex, compression || compressed)) {
+                    failed = true;
+                }
+            }
+        }));
+    }
+
+    for (std::thread & worker : workers) {
+        worker.join();
+    }
+
+    // every file commits its own transaction, copy which did not finish is removed as a whole
+    if (failed) {
+        if (contains(toMftItemIndex, rootName.c_str(), true) == root) {
+            removeTree(root, toMftItemIndex);
+        }
+        std::cout << "PARTIAL COPY IS REMOVED\n";
+        return false;
+    }
+
+    return true;
 }
 
-int PseudoNTFS::neededMftItems(int8_t dataClustersCount) const {
+bool PseudoNTFS::removeTree(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex) {
 
-    int8_t count = 0;
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || parentDirectoryMftItemIndex < 0 || parentDirectoryMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
 
-    do {  
-        dataClustersCount -= MFT_FRAGMENTS_COUNT;
-        count++;
+    if (!mftItemStart[mftItemIndex].isDirectory) {
+        return removeFile(mftItemIndex, parentDirectoryMftItemIndex);
+    }
+
+    Transaction transaction(this);
+
+    std::vector<struct tree_directory> directories;
+    walkTree(mftItemIndex, &directories);
+    std::string rootName = mftItemStart[mftItemIndex].item_name;
+
+    // names of removed items by their directories, entries go away with directory blocks unless part is committed first
+    std::vector<std::vector<std::string>> removed(directories.size());
+    auto commitPart = [this, &transaction, &directories, &removed]() {
+        for (size_t i = 0; i < directories.size(); i++) {
+            for (const std::string & name : removed[i]) {
+                removeDirectoryEntry(directories[i].mftItemIndex, name.c_str());
+            }
+            removed[i].clear();
+        }
+        transaction.commit();
+    };
+
+    // subtree is removed from leaves, every committed part leaves the rest of it whole
+    int64_t budget = journal->getCapacity() / 2;
+    int32_t count = 0;
+    for (size_t i = directories.size(); i-- > 0; ) {
+        for (const struct directory_entry & entry : directories[i].entries) {
+            if (!entry.isDirectory) {
+                freeMftItemWithData(entry.mft_index);
+                removed[i].push_back(entry.name);
+                if (++count % TREE_REMOVE_CHECK == 0 && transactionLogSize() > budget) {
+                    commitPart();
+                }
+            }
+        }
+
+        // directory is removed with its blocks, so its entries need not be
+        removed[i].clear();
+        if (directories[i].parent != NOT_FOUND) {
+            removed[directories[i].parent].push_back(mftItemStart[directories[i].mftItemIndex].item_name);
+        }
+        freeMftItemWithData(directories[i].mftItemIndex);
+        if (++count % TREE_REMOVE_CHECK == 0 && transactionLogSize() > budget) {
+            commitPart();
+        }
+    }
+
+    removeDirectoryEntry(parentDirectoryMftItemIndex, rootName.c_str());
+    return true;
+}
+
+void PseudoNTFS::clearMftItemFragments(mft_fragment * fragments) const {
+
+    mft_fragment clearFragments[MFT_FRAGMENTS_COUNT] = {0, 0};
+    memcpy(fragments, clearFragments, MFT_FRAGMENTS_COUNT * sizeof(mft_fragment));
+}
+
+int PseudoNTFS::neededMftItems(int32_t dataClustersCount) const {
+
+    int32_t count = 0;
+
+    do {  
+        dataClustersCount -= MFT_FRAGMENTS_COUNT;
+        count++;
     } while (dataClustersCount > 0);
 
-    return count;
+    return count;
+}
+
+int PseudoNTFS::findFreeMft() const {
+    return hot()->findFree(firstFreeMftItem);
+}
+
+bool PseudoNTFS::findFreeMftItems(const int32_t count, std::vector<int32_t> * indexes) const {
+
+    return hot()->findFree(firstFreeMftItem, count, indexes) == count;
+}
+
+
+void PseudoNTFS::findFreeSpace(const int32_t demandedSize, int32_t * startIndex, int32_t * providedSize, const int32_t group) {
+
+    *providedSize = 0;
+
+    if (*startIndex < NOT_FOUND || *startIndex >= bootRecord->cluster_count) {
+        indexOutOfRange = true;
+        return;
+    }
+
+    spaceIndex.wait();
+
+    // run large enough chosen by policy is reserved, else the largest one is only reported
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t goal = *startIndex;
+    int32_t start = 0;
+    int32_t demandedCount = std::max((int32_t) ceil(demandedSize / (double) clusterSize), 1);
+    int32_t count = reserveFreeRun(demandedCount, goal, group, &start);
+
+    // clusters held for deleted snapshots are released when they are needed
+    if (count == 0 && snapshotReclaim && reclaimSnapshotClusters() > 0) {
+        count = reserveFreeRun(demandedCount, goal, group, &start);
+    }
+    if (count > 0) {
+        transactionReserved.release(start, count);
+        allocationCursor = start + count;
+    }
+    else {
+        count = allocationGroups.findLargest(&start);
+    }
+
+    if (count > 0) {
+        *startIndex = start;
+        *providedSize = count * clusterSize;
+    }
+}
+
+int32_t PseudoNTFS::reserveFreeRun(const int32_t count, const int32_t goal, const int32_t group, int32_t * start) {
+
+    int32_t policy = bootRecord->allocation_policy;
+    int32_t cursor = allocationCursor;
+    int32_t first = preferredGroup(goal, group);
+
+    for (int32_t i = 0; i < allocationGroups.getCount(); i++) {
+        int32_t current = (first + i) % allocationGroups.getCount();
+        int32_t found = allocationGroups.reserve(current, count, [&](const FreeExtentIndex & freeExtents, int32_t * runStart) -> int32_t {
+            switch (policy) {
+                case ALLOCATION_NEXT_FIT:
+                    return freeExtents.findNext(count, allocationGroups.groupOf(cursor) == current ? cursor : allocationGroups.groupStart(current), runStart);
+                case ALLOCATION_BEST_FIT:
+                    return freeExtents.findBest(count, runStart);
+                case ALLOCATION_LOCALITY:
+                    // new directory starts in the middle of the largest run, so it and the directory before it have room for their files
+                    if (goal == NOT_FOUND) {
+                        int32_t largest = freeExtents.findLargest(runStart);
+                        if (largest < count) {
+                            return 0;
+                        }
+                        int32_t skipped = (largest - count) / 2;
+                        *runStart += skipped;
+                        return largest - skipped;
+                    }
+                    return freeExtents.findNear(count, goal, runStart);
+                default:
+                    return freeExtents.findFirst(count, runStart);
+            }
+        }, start);
+
+        if (found >= count) {
+            return count;
+        }
+    }
+
+    return 0;
+}
+
+int32_t PseudoNTFS::preferredGroup(const int32_t goal, const int32_t group) const {
+
+    // locality keeps data near its goal, other policies keep files of directory in its group
+    if (goal != NOT_FOUND && (group == NOT_FOUND || bootRecord->allocation_policy == ALLOCATION_LOCALITY)) {
+        return allocationGroups.groupOf(goal);
+    }
+    return group != NOT_FOUND ? group : 0;
+}
+
+int32_t PseudoNTFS::allocationGroupClusters(const int32_t clusterCount) {
+
+    int32_t groupClusters = (clusterCount + ALLOCATION_GROUPS_MAX - 1) / ALLOCATION_GROUPS_MAX;
+    return std::max((groupClusters + 7) / 8 * 8, ALLOCATION_GROUP_MIN_CLUSTERS);
+}
+
+bool PseudoNTFS::reserveCluster(const int32_t index) {
+
+    spaceIndex.wait();
+    if (!allocationGroups.reserveAt(index)) {
+        return false;
+    }
+    transactionReserved.release(index, 1);
+    return true;
+}
+
+int32_t PseudoNTFS::allocationGoal(const int32_t mftItemIndex) {
+
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || (mftItemStart[mftItemIndex].item_flags & (MFT_ITEM_RESIDENT | MFT_ITEM_DELAYED))) {
+        return NOT_FOUND;
+    }
+
+    for (const struct extent & extent : cachedExtentMap(mftItemIndex)->getExtents()) {
+        if (extent.start != EXTENT_HOLE) {
+            return extent.start;
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+bool PseudoNTFS::setAllocationPolicy(const int32_t allocationPolicy) {
+
+    if (allocationPolicy < 0 || allocationPolicy >= ALLOCATION_POLICIES_COUNT) {
+        return false;
+    }
+
+    Transaction transaction(this);
+
+    bootRecord->allocation_policy = allocationPolicy;
+    journalBootRecord(&bootRecord->allocation_policy);
+    allocationCursor = 0;
+    return true;
+}
+
+
+void PseudoNTFS::saveContinualSegment(const char * data, const int32_t size, const int32_t startIndex, std::list<struct mft_fragment> * fragments) {
+    
+    if (startIndex < 0 || startIndex >= bootRecord->cluster_count) {
+        indexOutOfRange = true;
+        return;
+    }
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t count = ceil(size / (double) clusterSize);
+    unsigned char * cluster = new unsigned char[clusterSize];
+
+    for (int i = 0; i < count; i++) {
+
+        int32_t length = std::min(clusterSize, size - i * clusterSize);
+        int32_t index = startIndex + i;
+
+        if (!deduplication) {
+            setClusterData(index, (unsigned char *) data + i * clusterSize, length);
+            appendFragment(fragments, index);
+            continue;
+        }
+
+        // clusters are compared with their padding, as they are stored
+        memset(cluster, 0, clusterSize);
+        memcpy(cluster, data + i * clusterSize, length);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint32_t hash = checksum(cluster, clusterSize);
+        int32_t shared = findDuplicateCluster(cluster, hash);
+        deduplicationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        deduplicationWritten++;
+
+        // shared cluster can start new fragment and next written cluster another one, fragments continue in next mft items
+        if (shared != NOT_FOUND) {
+            clusterReferences()[shared]++;
+            deduplicationShared++;
+            appendFragment(fragments, shared);
+            continue;
+        }
+
+        setClusterData(index, cluster, clusterSize);
+        deduplicationIndex[hash].push_back(index);
+        appendFragment(fragments, index);
+    }
+
+    delete [] cluster;
+}
+
+void PseudoNTFS::appendFragment(std::list<struct mft_fragment> * fragments, const int32_t index, const int32_t count) const {
+
+    if (count <= 0) {
+        return;
+    }
+
+    // hole follows hole, data cluster follows the last data cluster
+    if (!fragments->empty() && (index == EXTENT_HOLE ? fragments->back().fragment_start_address == EXTENT_HOLE
+        : fragments->back().fragment_start_address != EXTENT_HOLE && fragments->back().fragment_start_address + fragments->back().fragment_count == index)) {
+        fragments->back().fragment_count += count;
+        return;
+    }
+
+    struct mft_fragment fragment;
+    fragment.fragment_start_address = index;
+    fragment.fragment_count = count;
+    fragments->push_back(fragment);
+}
+
+bool PseudoNTFS::isZeroCluster(const char * data, const int32_t length, const int32_t cluster) const {
+
+    int32_t start = cluster * bootRecord->cluster_size;
+    return isZero((const unsigned char *) data + start, std::min(bootRecord->cluster_size, length - start));
+}
+
+int32_t PseudoNTFS::allocatedSize(const char * data, const int32_t length) const {
+
+    int32_t clustersCount = ceil(length / (double) bootRecord->cluster_size);
+    int32_t allocated = 0;
+
+    for (int32_t i = 0; i < clustersCount; i++) {
+        allocated += !isZeroCluster(data, length, i);
+    }
+
+    return allocated * bootRecord->cluster_size;
+}
+
+bool PseudoNTFS::setFileFragments(const int32_t mftItemIndex, const std::list<struct mft_fragment> * fragments) {
+
+    std::vector<int32_t> mftIndexes;
+    for (int32_t index = mftItemIndex; index != NOT_FOUND; index = nextMftItem(index)) {
+        mftIndexes.push_back(index);
+    }
+    int32_t usedMftItemsCount = mftIndexes.size();
+
+    int32_t neededMftItemsCount = neededMftItems(fragments->size());
+    std::vector<int32_t> freeIndexes;
+    if (neededMftItemsCount > INT16_MAX || (neededMftItemsCount > usedMftItemsCount && !findFreeMftItems(neededMftItemsCount - usedMftItemsCount, &freeIndexes))) {
+        return false;
+    }
+    mftIndexes.insert(mftIndexes.end(), freeIndexes.begin(), freeIndexes.end());
+
+    // every mft item holds MFT_FRAGMENTS_COUNT fragments and links the next one, all of them have properties of the first one
+    struct mft_item mftItem;
+    memcpy(&mftItem, &mftItemStart[mftItemIndex], sizeof(mft_item));
+    mftItem.item_order_total = neededMftItemsCount;
+
+    std::list<struct mft_fragment>::const_iterator fragment = fragments->begin();
+    for (int32_t i = 0; i < neededMftItemsCount; i++) {
+
+        mftItem.item_order = i + 1;
+        mftItem.item_next = i + 1 < neededMftItemsCount ? mftIndexes[i + 1] : NOT_FOUND;
+
+        clearMftItemFragments(mftItem.fragments);
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT && fragment != fragments->end(); j++, fragment++) {
+            mftItem.fragments[j] = *fragment;
+        }
+
+        if (i < usedMftItemsCount) {
+            preserveMftItem(mftIndexes[i]);
+            memcpy(&mftItemStart[mftIndexes[i]], &mftItem, sizeof(mft_item));
+            journalMftItem(mftIndexes[i]);
+        }
+        else {
+            setMftItem(mftIndexes[i], &mftItem);
+        }
+    }
+
+    // shorter chain does not need the rest
+    for (int32_t i = neededMftItemsCount; i < usedMftItemsCount; i++) {
+        freeMftItem(mftIndexes[i]);
+    }
+
+    return true;
+}
+
+/* DEDUPLICATION */
+
+void PseudoNTFS::setDeduplication(const bool deduplication) {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    this->deduplication = deduplication;
+    deduplicationWritten = 0;
+    deduplicationShared = 0;
+    deduplicationSeconds = 0;
+
+    // data stored before are shared too
+    if (deduplication) {
+        buildDeduplicationIndex();
+    }
+    else {
+        deduplicationIndex.clear();
+    }
+}
+
+void PseudoNTFS::countClusterReferences(std::vector<int32_t> * references) {
+
+    references->assign(bootRecord->cluster_count, 0);
+
+    struct mft_item * mftItem = mftItemStart;
+    const MftHotTable * table = hot();
+    for (int i = 0; i < mftItemsCount; i++) {
+
+        if (table->getUid(i) == UID_ITEM_FREE || (table->getFlags(i) & MFT_ITEM_RESIDENT)) {
+            continue;
+        }
+
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            int32_t startIndex = mftItem[i].fragments[j].fragment_start_address;
+            int32_t bound = std::min(startIndex + mftItem[i].fragments[j].fragment_count, bootRecord->cluster_count);
+            for (int32_t k = std::max(startIndex, 0); k < bound && startIndex != EXTENT_HOLE; k++) {
+                (*references)[k]++;
+            }
+        }
+    }
+}
+
+void PseudoNTFS::initSharedReferences() {
+
+    countClusterReferences(&sharedReferences);
+
+    // first reference is not shared one
+    for (int32_t & references : sharedReferences) {
+        if (references > 0) {
+            references--;
+        }
+    }
+}
+
+void PseudoNTFS::buildDeduplicationIndex() {
+
+    deduplicationIndex.clear();
+
+    unsigned char * cluster = new unsigned char[bootRecord->cluster_size];
+    std::vector<bool> indexed(bootRecord->cluster_count, false);
+
+    struct mft_item * mftItem = mftItemStart;
+    const MftHotTable * table = hot();
+    for (int i = 0; i < mftItemsCount; i++) {
+
+        // directory clusters change in place, they cannot be shared
+        if (table->getUid(i) == UID_ITEM_FREE || (table->getFlags(i) & (MFT_HOT_DIRECTORY | MFT_ITEM_RESIDENT))) {
+            continue;
+        }
+
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            int32_t startIndex = mftItem[i].fragments[j].fragment_start_address;
+            int32_t bound = std::min(startIndex + mftItem[i].fragments[j].fragment_count, bootRecord->cluster_count);
+            for (int32_t k = std::max(startIndex, 0); k < bound && startIndex != EXTENT_HOLE; k++) {
+                if (!indexed[k]) {
+                    getClusterData(k, cluster);
+                    deduplicationIndex[checksum(cluster, bootRecord->cluster_size)].push_back(k);
+                    indexed[k] = true;
+                }
+            }
+        }
+    }
+
+    delete [] cluster;
+}
+
+int32_t PseudoNTFS::findDuplicateCluster(const unsigned char * data, const uint32_t hash) {
+
+    std::unordered_map<uint32_t, std::list<int32_t>>::iterator it = deduplicationIndex.find(hash);
+    if (it == deduplicationIndex.end()) {
+        return NOT_FOUND;
+    }
+
+    // hash can collide, content has to be compared
+    unsigned char * candidate = new unsigned char[bootRecord->cluster_size];
+    int32_t found = NOT_FOUND;
+
+    for (int32_t index : it->second) {
+        getClusterData(index, candidate);
+        if (memcmp(candidate, data, bootRecord->cluster_size) == 0) {
+            found = index;
+            break;
+        }
+    }
+
+    delete [] candidate;
+    return found;
+}
+
+void PseudoNTFS::unindexCluster(const int32_t index) {
+
+    if (deduplicationIndex.empty()) {
+        return;
+    }
+
+    std::unordered_map<uint32_t, std::list<int32_t>>::iterator it = deduplicationIndex.find(checksum(clusterData(index), bootRecord->cluster_size));
+    if (it == deduplicationIndex.end()) {
+        return;
+    }
+
+    it->second.remove(index);
+    if (it->second.empty()) {
+        deduplicationIndex.erase(it);
+    }
+}
+
+void PseudoNTFS::printDeduplicationStatistics() {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    // whole volume - clusters referenced by files and clusters really used for them
+    int64_t referenced = 0, shared = 0;
+    std::vector<int32_t> references;
+    countClusterReferences(&references);
+    for (int i = 0; i < bootRecord->cluster_count; i++) {
+        referenced += references[i];
+        shared += clusterReferences()[i];
+    }
+
+    std::cout << "Deduplication: " << (deduplication ? "on" : "off") << std::endl;
+    std::cout << "Referenced clusters: " << referenced << ", stored: " << referenced - shared;
+    std::cout << ", ratio: " << (referenced == shared ? 1 : (double) referenced / (referenced - shared)) << std::endl;
+    std::cout << "Written clusters: " << deduplicationWritten << ", shared: " << deduplicationShared << std::endl;
+    std::cout << "Index: " << deduplicationIndex.size() << " hashes, lookups: " << deduplicationSeconds * 1000 << " ms";
+}
+
+
+int32_t PseudoNTFS::contains(const int32_t mftItemIndex, const char * name, const bool directory) {
+
+    if (mftItemIndex < 0 || mftItemIndex  >= mftItemsCount) {
+        indexOutOfRange = true;
+        return NOT_FOUND;
+    }
+
+    struct directory_entry entry;
+    if (!mftItemStart[mftItemIndex].isDirectory || !findDirectoryEntry(mftItemIndex, name, &entry) || entry.isDirectory != directory) {
+        return NOT_FOUND;
+    }
+
+    return entry.mft_index;
+}
+
+int32_t PseudoNTFS::createItem(const int32_t parentMftItemIndex, const char * name, const bool directory) {
+
+    int32_t mftIndex = findFreeMft();
+    if (mftIndex == NOT_FOUND) {
+        return NOT_FOUND;
+    }
+
+    struct mft_item mftItem;
+    mftItem.uid = getUid();
+    strcpy(mftItem.item_name, name);
+    mftItem.isDirectory = directory;
+    mftItem.item_order = 1;
+    mftItem.item_order_total = 1;
+    mftItem.item_flags = 0;
+    mftItem.item_size = 0;
+    mftItem.item_next = NOT_FOUND;
+    mftItem.item_valid = 0;
+    clearMftItemFragments(mftItem.fragments);
+    setMftItem(mftIndex, &mftItem);
+
+    struct directory_entry entry;
+    memset(&entry, 0, sizeof(directory_entry));
+    strncpy(entry.name, name, sizeof(entry.name) - 1);
+    entry.mft_index = mftIndex;
+    entry.isDirectory = directory;
+
+    // growing directory can need the last free mft item or data cluster
+    if (!insertDirectoryEntry(parentMftItemIndex, &entry)) {
+        freeMftItem(mftIndex);
+        return NOT_FOUND;
+    }
+
+    return mftIndex;
+}
+
+/* DIRECTORY BLOCKS */
+
+int32_t PseudoNTFS::directoryRecordSize(const int32_t level) const {
+    return level == 0 ? sizeof(directory_entry) : sizeof(directory_index);
+}
+
+int32_t PseudoNTFS::directoryBlockCapacity(const int32_t level) const {
+    return (bootRecord->cluster_size - (int32_t) sizeof(directory_block)) / directoryRecordSize(level);
+}
+
+int32_t PseudoNTFS::directoryRecordPosition(const unsigned char * block, const char * name, const bool upper) const {
+
+    const struct directory_block * header = (const struct directory_block *) block;
+    const unsigned char * records = block + sizeof(directory_block);
+    int32_t size = directoryRecordSize(header->level);
+
+    // every record starts with name
+    int32_t low = 0;
+    int32_t high = std::min(std::max(header->entries_count, 0), directoryBlockCapacity(header->level));
+    while (low < high) {
+        int32_t middle = (low + high) / 2;
+        int compare = strncmp((const char *) records + middle * size, name, sizeof(directory_entry::name));
+        if (compare < 0 || (upper && compare == 0)) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+bool PseudoNTFS::findDirectoryLeaf(const int32_t directoryMftItemIndex, const char * name, std::vector<int32_t> * path, unsigned char * block) {
+
+    const struct directory_block * header = (const struct directory_block *) block;
+    const struct directory_index * indexes = (const struct directory_index *) (block + sizeof(directory_block));
+
+    path->clear();
+
+    // child block holds names from its smallest one to the smallest one of next child
+    for (int32_t order = 0; (int32_t) path->size() < DIRECTORY_MAX_DEPTH; ) {
+        if (!readDirectoryBlock(directoryMftItemIndex, order, block)) {
+            return false;
+        }
+        path->push_back(order);
+
+        if (header->level == 0) {
+            return true;
+        }
+        order = indexes[std::max(directoryRecordPosition(block, name, true) - 1, 0)].block;
+    }
+
+    return false;
+}
+
+bool PseudoNTFS::findDirectoryEntry(const int32_t directoryMftItemIndex, const char * name, struct directory_entry * entry) {
+
+    // readers run in parallel, they work on copy of block
+    unsigned char * block = new unsigned char[bootRecord->cluster_size];
+    const struct directory_block * header = (const struct directory_block *) block;
+    const struct directory_entry * entries = (const struct directory_entry *) (block + sizeof(directory_block));
+
+    std::vector<int32_t> path;
+    bool found = false;
+    if (findDirectoryLeaf(directoryMftItemIndex, name, &path, block)) {
+        int32_t position = directoryRecordPosition(block, name, false);
+        found = position < header->entries_count && strncmp(entries[position].name, name, sizeof(entries[position].name)) == 0;
+        if (found) {
+            *entry = entries[position];
+        }
+    }
+
+    delete [] block;
+    return found;
+}
+
+bool PseudoNTFS::insertDirectoryEntry(const int32_t directoryMftItemIndex, const struct directory_entry * entry) {
+
+    // split block needs at least one record in both halves
+    int32_t order;
+    if (directoryBlockCapacity(0) < 1 || directoryBlockCapacity(1) < 2
+        || (cachedExtentMap(directoryMftItemIndex)->getClusterCount() == 0 && !appendDirectoryBlock(directoryMftItemIndex, &order))) {
+        return false;
+    }
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    unsigned char * block = new unsigned char[clusterSize];
+    unsigned char * right = new unsigned char[clusterSize];
+    struct directory_block * header = (struct directory_block *) block;
+    unsigned char * records = block + sizeof(directory_block);
+
+    std::vector<int32_t> path;
+    if (!findDirectoryLeaf(directoryMftItemIndex, entry->name, &path, block)) {
+        delete [] block;
+        delete [] right;
+        return false;
+    }
+
+    // blocks for all splits are appended first, so lack of space leaves tree untouched
+    int32_t needed = 0;
+    for (int32_t depth = path.size() - 1; depth >= 0; depth--) {
+        readDirectoryBlock(directoryMftItemIndex, path[depth], block);
+        if (header->entries_count < directoryBlockCapacity(header->level)) {
+            break;
+        }
+        needed += depth == 0 ? 2 : 1;
+    }
+
+    std::vector<int32_t> freeBlocks;
+    for (int32_t i = 0; i < needed; i++) {
+        if (!appendDirectoryBlock(directoryMftItemIndex, &order)) {
+            delete [] block;
+            delete [] right;
+            return false;
+        }
+        freeBlocks.push_back(order);
+    }
+
+    // record goes to block on path, full block is split and separator of its right half goes to parent
+    unsigned char record[sizeof(directory_entry)];
+    unsigned char * merged = new unsigned char[clusterSize + sizeof(directory_entry)];
+    memcpy(record, entry, sizeof(directory_entry));
+
+    for (int32_t depth = path.size() - 1; depth >= 0; depth--) {
+
+        readDirectoryBlock(directoryMftItemIndex, path[depth], block);
+        int32_t level = header->level;
+        int32_t size = directoryRecordSize(level);
+        int32_t count = header->entries_count;
+        int32_t position = directoryRecordPosition(block, (const char *) record, false);
+
+        if (count < directoryBlockCapacity(level)) {
+            memmove(records + (position + 1) * size, records + position * size, (count - position) * size);
+            memcpy(records + position * size, record, size);
+            header->entries_count++;
+            writeDirectoryBlock(directoryMftItemIndex, path[depth], block);
+            break;
+        }
+
+        // full root moves to new block and points to it, the moved block is split below new root
+        if (depth == 0) {
+            int32_t child = freeBlocks.back();
+            freeBlocks.pop_back();
+            writeDirectoryBlock(directoryMftItemIndex, child, block);
+
+            memset(right, 0, clusterSize);
+            struct directory_block * root = (struct directory_block *) right;
+            root->level = level + 1;
+            root->entries_count = 1;
+            ((struct directory_index *) (right + sizeof(directory_block)))->block = child;
+            writeDirectoryBlock(directoryMftItemIndex, 0, right);
+
+            path.insert(path.begin() + 1, child);
+            depth += 2;
+            continue;
+        }
+
+        // records with the new one are divided to halves
+        memcpy(merged, records, position * size);
+        memcpy(merged + position * size, record, size);
+        memcpy(merged + (position + 1) * size, records + position * size, (count - position) * size);
+        int32_t leftCount = (count + 1) / 2;
+
+        memset(records, 0, clusterSize - sizeof(directory_block));
+        memcpy(records, merged, leftCount * size);
+        header->entries_count = leftCount;
+
+        memset(right, 0, clusterSize);
+        struct directory_block * rightHeader = (struct directory_block *) right;
+        rightHeader->level = level;
+        rightHeader->entries_count = count + 1 - leftCount;
+        memcpy(right + sizeof(directory_block), merged + leftCount * size, rightHeader->entries_count * size);
+
+        int32_t rightOrder = freeBlocks.back();
+        freeBlocks.pop_back();
+        writeDirectoryBlock(directoryMftItemIndex, path[depth], block);
+        writeDirectoryBlock(directoryMftItemIndex, rightOrder, right);
+
+        struct directory_index separator;
+        memset(&separator, 0, sizeof(directory_index));
+        memcpy(separator.name, merged + leftCount * size, sizeof(separator.name));
+        separator.block = rightOrder;
+        memcpy(record, &separator, sizeof(directory_index));
+    }
+
+    delete [] block;
+    delete [] right;
+    delete [] merged;
+
+    preserveMftItem(directoryMftItemIndex);
+    mftItemStart[directoryMftItemIndex].item_size += sizeof(directory_entry);
+    journalMftItem(directoryMftItemIndex);
+
+    return true;
+}
+
+bool PseudoNTFS::removeDirectoryEntry(const int32_t directoryMftItemIndex, const char * name) {
+
+    unsigned char * block = new unsigned char[bootRecord->cluster_size];
+    struct directory_block * header = (struct directory_block *) block;
+    struct directory_entry * entries = (struct directory_entry *) (block + sizeof(directory_block));
+
+    std::vector<int32_t> path;
+    int32_t position = 0;
+    if (!findDirectoryLeaf(directoryMftItemIndex, name, &path, block) || (position = directoryRecordPosition(block, name, false)) == header->entries_count
+        || strncmp(entries[position].name, name, sizeof(entries[position].name)) != 0) {
+        delete [] block;
+        return false;
+    }
+
+    // entries behind removed one keep their order, empty leaf stays in tree
+    header->entries_count--;
+    memmove(entries + position, entries + position + 1, (header->entries_count - position) * sizeof(directory_entry));
+    memset(entries + header->entries_count, 0, sizeof(directory_entry));
+    writeDirectoryBlock(directoryMftItemIndex, path.back(), block);
+
+    delete [] block;
+
+    preserveMftItem(directoryMftItemIndex);
+    mftItemStart[directoryMftItemIndex].item_size -= sizeof(directory_entry);
+    journalMftItem(directoryMftItemIndex);
+
+    return true;
+}
+
+bool PseudoNTFS::appendDirectoryBlock(const int32_t directoryMftItemIndex, int32_t * block) {
+
+    std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(directoryMftItemIndex);
+    const std::vector<struct extent> & extents = extentMap->getExtents();
+    *block = extentMap->getClusterCount();
+
+    // block behind the last one keeps directory in one extent
+    int32_t cluster = NOT_FOUND;
+    if (!extents.empty()) {
+        int32_t next = extents.back().start + extents.back().count;
+        if (next < bootRecord->cluster_count && reserveCluster(next)) {
+            cluster = next;
+        }
+    }
+
+    // first block of new directory starts new region of volume, next ones go near the first one
+    if (cluster == NOT_FOUND) {
+        int32_t providedSize = 0;
+        int32_t startIndex = extents.empty() ? NOT_FOUND : allocationGoal(directoryMftItemIndex);
+        findFreeSpace(bootRecord->cluster_size, &startIndex, &providedSize, extents.empty() ? homeGroup(directoryMftItemIndex) : NOT_FOUND);
+        if (providedSize == 0) {
+            return false;
+        }
+        cluster = startIndex;
+    }
+
+    int32_t lastMftItemIndex = directoryMftItemIndex;
+    for (int32_t index = nextMftItem(directoryMftItemIndex); index != NOT_FOUND; index = nextMftItem(index)) {
+        lastMftItemIndex = index;
+    }
+
+    struct mft_item * last = &mftItemStart[lastMftItemIndex];
+    preserveMftItem(lastMftItemIndex);
+    int i = 0;
+    while (i < MFT_FRAGMENTS_COUNT && last->fragments[i].fragment_count > 0) {
+        i++;
+    }
+
+    if (i > 0 && last->fragments[i - 1].fragment_start_address + last->fragments[i - 1].fragment_count == cluster) {
+        last->fragments[i - 1].fragment_count++;
+        journalMftItem(lastMftItemIndex);
+    }
+    else if (i < MFT_FRAGMENTS_COUNT) {
+        last->fragments[i].fragment_start_address = cluster;
+        last->fragments[i].fragment_count = 1;
+        journalMftItem(lastMftItemIndex);
+    }
+    else if (!extendDirectory(directoryMftItemIndex, lastMftItemIndex, cluster)) {
+        return false;
+    }
+    // map of directory is kept with its first mft item
+    journalMftItem(directoryMftItemIndex);
+
+    // new block is empty leaf
+    unsigned char * data = new unsigned char[bootRecord->cluster_size];
+    memset(data, 0, bootRecord->cluster_size);
+    writeDirectoryBlock(directoryMftItemIndex, *block, data);
+    setBitmap(cluster, true);
+
+    delete [] data;
+    return true;
+}
+
+bool PseudoNTFS::extendDirectory(const int32_t directoryMftItemIndex, const int32_t lastMftItemIndex, const int32_t cluster) {
+
+    int32_t mftIndex = findFreeMft();
+    if (mftIndex == NOT_FOUND) {
+        return false;
+    }
+
+    struct mft_item * directory = &mftItemStart[directoryMftItemIndex];
+    struct mft_item * last = &mftItemStart[lastMftItemIndex];
+
+    struct mft_item mftItem;
+    memcpy(&mftItem, directory, sizeof(mft_item));
+    mftItem.item_order = last->item_order + 1;
+    mftItem.item_next = NOT_FOUND;
+    clearMftItemFragments(mftItem.fragments);
+    mftItem.fragments[0].fragment_start_address = cluster;
+    mftItem.fragments[0].fragment_count = 1;
+    setMftItem(mftIndex, &mftItem);
+
+    preserveMftItem(lastMftItemIndex);
+    last->item_next = mftIndex;
+    journalMftItem(lastMftItemIndex);
+
+    // every mft item of directory knows their count
+    for (int32_t index = directoryMftItemIndex; index != NOT_FOUND; index = nextMftItem(index)) {
+        preserveMftItem(index);
+        mftItemStart[index].item_order_total = mftItem.item_order;
+        journalMftItem(index);
+    }
+
+    return true;
+}
+
+bool PseudoNTFS::readDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, unsigned char * block) {
+
+    int32_t cluster = cachedExtentMap(directoryMftItemIndex)->find(order);
+    if (cluster == NOT_FOUND) {
+        return false;
+    }
+
+    getClusterData(cluster, block);
+    return true;
+}
+
+void PseudoNTFS::writeDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, const unsigned char * block) {
+
+    int32_t cluster = cachedExtentMap(directoryMftItemIndex)->find(order);
+    if (cluster == NOT_FOUND) {
+        indexOutOfRange = true;
+        return;
+    }
+
+    // block of snapshot stays as it is, directory gets its copy
+    if (isClusterFrozen(cluster) && !redirectDirectoryBlock(directoryMftItemIndex, order, &cluster)) {
+        std::cout << "NOT ENOUGH FREE SPACE";
+        return;
+    }
+
+    memcpy(clusterData(cluster), block, bootRecord->cluster_size);
+    journalCluster(cluster);
+}
+
+bool PseudoNTFS::loadFileFromPseudoNtfs(int32_t mftItemIndex, std::string * content) {
+
+    if (mftItemIndex < 0 || mftItemIndex  >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+
+    if (mftItem->item_flags & MFT_ITEM_DELAYED) {
+        std::map<int32_t, struct delayed_file>::const_iterator file = delayedFiles.find(mftItemIndex);
+        content->clear();
+        if (file != delayedFiles.end()) {
+            *content = file->second.data;
+        }
+        return true;
+    }
+
+    if (mftItem->item_flags & MFT_ITEM_RESIDENT) {
+        content->assign((char *) mftItem->fragments, mftItem->item_size);
+        return true;
+    }
+
+    if (mftItem->item_flags & MFT_ITEM_COMPRESSED) {
+        if (!loadCompressedData(mftItemIndex, content)) {
+            std::cout << "FILE IS CORRUPTED";
+            return false;
+        }
+        return true;
+    }
+
+    ExtentMap extentMap;
+    loadExtentMap(mftItemIndex, &extentMap);
+
+    // unwritten clusters of preallocated file are not read, they are zeros like holes
+    int32_t validClusters = clustersOf(validSize(mftItemIndex));
+
+    std::ostringstream oss;
+    for (const struct extent & extent : extentMap.getExtents()) {
+        int32_t loaded = std::max(0, std::min(extent.count, validClusters - extent.logical_start));
+        if (extent.start != EXTENT_HOLE && loaded > 0) {
+            loadDataFragment(extent.start, loaded, &oss);
+        }
+        else {
+            loaded = 0;
+        }
+        // clusters reserved behind end of file are left out
+        int32_t zeros = std::max(0, std::min(extent.count, clustersOf(mftItem->item_size) - extent.logical_start)) - loaded;
+        if (zeros > 0) {
+            oss << std::string((size_t) zeros * bootRecord->cluster_size, '\0');
+        }
+    }
+
+    // last cluster is padded with zeros, bytes behind written data are zeros too
+    *content = oss.str();
+    content->resize(validSize(mftItemIndex));
+    content->resize(mftItem->item_size, '\0');
+    return true;
+}
+
+bool PseudoNTFS::loadCompressedData(const int32_t mftItemIndex, std::string * content) {
+
+    const struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+
+    ExtentMap extentMap;
+    loadExtentMap(mftItemIndex, &extentMap);
+
+    std::string stored;
+    unsigned char * buffer = new unsigned char[bootRecord->cluster_size];
+
+    content->clear();
+    content->reserve(mftItem->item_size);
+
+    int32_t consumed = 0;
+    for (std::vector<struct extent>::const_iterator extent = extentMap.getExtents().begin(); extent != extentMap.getExtents().end() && consumed != NOT_FOUND; extent++) {
+
+        int32_t startIndex = extent->start;
+        int32_t bound = startIndex + extent->count;
+
+        for (int32_t j = startIndex; j < bound && (int32_t) content->length() < mftItem->item_size; j++) {
+
+            if (extent->start == EXTENT_HOLE) {
+                memset(buffer, 0, bootRecord->cluster_size);
+            }
+            else {
+                getClusterData(j, buffer);
+            }
+            stored.append((char *) buffer, bootRecord->cluster_size);
+
+            // decompress every chunk as soon as it is read whole
+            consumed = decompressChunks((unsigned char *) stored.data(), stored.length(), content, mftItem->item_size);
+            if (consumed == NOT_FOUND) {
+                break;
+            }
+            stored.erase(0, consumed);
+        }
+    }
+
+    delete [] buffer;
+    return consumed != NOT_FOUND && (int32_t) content->length() == mftItem->item_size;
+}
+
+int32_t PseudoNTFS::getUsedClusters(const int32_t mftItemIndex) {
+
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return 0;
+    }
+
+    if (mftItemStart[mftItemIndex].item_flags & MFT_ITEM_RESIDENT) {
+        return 0;
+    }
+
+    ExtentMap extentMap;
+    loadExtentMap(mftItemIndex, &extentMap);
+    return extentMap.getAllocatedCount();
+}
+
+bool PseudoNTFS::loadExtentMap(const int32_t mftItemIndex, ExtentMap * extentMap) {
+
+    extentMap->clear();
+
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    if (mftItemStart[mftItemIndex].item_flags & MFT_ITEM_RESIDENT) {
+        return false;
+    }
+
+    for (int32_t index = mftItemIndex; index != NOT_FOUND; index = nextMftItem(index)) {
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
+            extentMap->append(mftItemStart[index].fragments[i].fragment_start_address, mftItemStart[index].fragments[i].fragment_count);
+        }
+    }
+
+    return true;
+}
+
+int32_t PseudoNTFS::nextMftItem(const int32_t mftItemIndex) const {
+
+    int32_t next = mftItemStart[mftItemIndex].item_next;
+
+    if (next < 0 || next >= mftItemsCount) {
+        return NOT_FOUND;
+    }
+
+    return next;
+}
+
+/* PARTIAL FILE ACCESS */
+
+std::shared_ptr<const ExtentMap> PseudoNTFS::cachedExtentMap(const int32_t mftItemIndex) {
+
+    std::lock_guard<std::mutex> lock(extentMapsMutex);
+
+    std::unordered_map<int32_t, std::shared_ptr<const ExtentMap>>::const_iterator it = extentMaps.find(mftItemIndex);
+    if (it != extentMaps.end()) {
+        return it->second;
+    }
+
+    if (extentMaps.size() >= EXTENT_MAPS_CACHED) {
+        extentMaps.clear();
+    }
+
+    std::shared_ptr<ExtentMap> extentMap = std::make_shared<ExtentMap>();
+    loadExtentMap(mftItemIndex, extentMap.get());
+    extentMaps[mftItemIndex] = extentMap;
+
+    return extentMap;
+}
+
+bool PseudoNTFS::isFile(const int32_t mftItemIndex) {
+
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    const struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    return mftItem->uid != UID_ITEM_FREE && !mftItem->isDirectory && mftItem->item_order == 1;
+}
+
+int32_t PseudoNTFS::readFileData(const int32_t mftItemIndex, const int32_t offset, char * buffer, const int32_t length) {
+
+    if (!isFile(mftItemIndex) || offset < 0 || length < 0) {
+        return NOT_FOUND;
+    }
+
+    const struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    int32_t count = std::max(0, std::min(length, mftItem->item_size - offset));
+    if (count == 0) {
+        return 0;
+    }
+
+    // data held in memory, in mft item or in compressed chunks are not addressed by data clusters
+    if (mftItem->item_flags & (MFT_ITEM_DELAYED | MFT_ITEM_RESIDENT | MFT_ITEM_COMPRESSED)) {
+        std::string content;
+        if (!loadFileFromPseudoNtfs(mftItemIndex, &content)) {
+            return NOT_FOUND;
+        }
+        count = std::max(0, std::min(count, (int32_t) content.length() - offset));
+        memcpy(buffer, content.data() + offset, count);
+        return count;
+    }
+
+    std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(mftItemIndex);
+    const std::vector<struct extent> & extents = extentMap->getExtents();
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t valid = validSize(mftItemIndex);
+    unsigned char * cluster = new unsigned char[clusterSize];
+
+    // extent of the first cluster is found by binary search, next clusters follow in it and in next extents
+    int32_t logicalCluster = offset / clusterSize;
+    int32_t extentIndex = extentMap->findExtent(logicalCluster);
+    int32_t done = 0;
+
+    while (done < count && extentIndex != NOT_FOUND && extentIndex < (int32_t) extents.size()) {
+
+        // unwritten cluster is not read, its part behind written data is zeros
+        const struct extent & extent = extents[extentIndex];
+        if (extent.start == EXTENT_HOLE || logicalCluster * clusterSize >= valid) {
+            memset(cluster, 0, clusterSize);
+        }
+        else {
+            getClusterData(extent.start + logicalCluster - extent.logical_start, cluster);
+            if (valid < (logicalCluster + 1) * clusterSize) {
+                memset(cluster + valid - logicalCluster * clusterSize, 0, (logicalCluster + 1) * clusterSize - valid);
+            }
+        }
+
+        int32_t from = offset + done - logicalCluster * clusterSize;
+        int32_t size = std::min(clusterSize - from, count - done);
+        memcpy(buffer + done, cluster + from, size);
+        done += size;
+
+        logicalCluster++;
+        if (logicalCluster == extent.logical_start + extent.count) {
+            extentIndex++;
+        }
+    }
+
+    delete [] cluster;
+    return done;
+}
+
+bool PseudoNTFS::writeFileData(const int32_t mftItemIndex, const int32_t offset, const char * buffer, const int32_t length) {
+
+    Transaction transaction(this);
+
+    if (!isFile(mftItemIndex) || offset < 0 || length < 0 || length > INT32_MAX - offset) {
+        return false;
+    }
+
+    return writeData(mftItemIndex, offset, buffer, length);
+}
+
+bool PseudoNTFS::appendFileData(const int32_t mftItemIndex, const char * buffer, const int32_t length) {
+
+    Transaction transaction(this);
+
+    if (!isFile(mftItemIndex) || length < 0 || length > INT32_MAX - mftItemStart[mftItemIndex].item_size) {
+        return false;
+    }
+
+    return writeData(mftItemIndex, mftItemStart[mftItemIndex].item_size, buffer, length);
+}
+
+bool PseudoNTFS::truncateFile(const int32_t mftItemIndex, const int32_t size) {
+
+    Transaction transaction(this);
+
+    if (!isFile(mftItemIndex) || size < 0) {
+        return false;
+    }
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+
+    // data outside of data clusters grow by zeros
+    if (size >= mftItem->item_size && (mftItem->item_flags & (MFT_ITEM_DELAYED | MFT_ITEM_COMPRESSED | MFT_ITEM_RESIDENT))) {
+        std::string zeros(size - mftItem->item_size, '\0');
+        return writeData(mftItemIndex, mftItem->item_size, zeros.data(), zeros.length());
+    }
+
+    if (mftItem->item_flags & MFT_ITEM_DELAYED) {
+        std::map<int32_t, struct delayed_file>::iterator file = delayedFiles.find(mftItemIndex);
+        if (file == delayedFiles.end()) {
+            return false;
+        }
+        delayedBytes -= file->second.data.length() - size;
+        delayedClusters -= clustersOf(file->second.data.length()) - clustersOf(size);
+        file->second.data.resize(size);
+        preserveMftItem(mftItemIndex);
+        mftItem->item_size = size;
+        journalMftItem(mftItemIndex);
+        return true;
+    }
+
+    if (mftItem->item_flags & (MFT_ITEM_COMPRESSED | MFT_ITEM_RESIDENT)) {
+        std::string content;
+        if (!loadFileFromPseudoNtfs(mftItemIndex, &content)) {
+            return false;
+        }
+        content.resize(size);
+        return rewriteFile(mftItemIndex, &content);
+    }
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t keptCount = ceil(size / (double) clusterSize);
+
+    // rest of the last kept cluster is cleared, so file can grow again with zeros, unwritten data are zeros already
+    int32_t tail = std::min(keptCount * clusterSize, validSize(mftItemIndex)) - size;
+    if (tail > 0) {
+        std::string zeros(tail, '\0');
+        if (!writeData(mftItemIndex, size, zeros.data(), tail)) {
+            return false;
+        }
+    }
+
+    // growing file gets hole, bytes behind its end in the last cluster are zeros already
+    std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(mftItemIndex);
+    std::list<struct mft_fragment> fragments;
+    for (const struct extent & extent : extentMap->getExtents()) {
+        appendFragment(&fragments, extent.start, std::max(0, std::min(extent.count, keptCount - extent.logical_start)));
+    }
+    appendFragment(&fragments, EXTENT_HOLE, keptCount - extentMap->getClusterCount());
+
+    if (!setFileFragments(mftItemIndex, &fragments)) {
+        std::cout << "NOT ENOUGH FREE ITEMS";
+        return false;
+    }
+
+    for (const struct extent & extent : extentMap->getExtents()) {
+        int32_t kept = std::max(0, std::min(extent.count, keptCount - extent.logical_start));
+        if (kept < extent.count && extent.start != EXTENT_HOLE) {
+            clearClusterData(extent.start + kept, extent.count - kept);
+        }
+    }
+
+    preserveMftItem(mftItemIndex);
+    int32_t valid = std::min(validSize(mftItemIndex), size);
+    mftItem->item_size = size;
+    if (mftItem->item_flags & MFT_ITEM_PREALLOCATED) {
+        setValidSize(mftItemIndex, valid);
+    }
+    journalMftItem(mftItemIndex);
+
+    return true;
+}
+
+bool PseudoNTFS::preallocate(const int32_t mftItemIndex, const int32_t size, const int32_t flags) {
+
+    Transaction transaction(this);
+
+    if (!isFile(mftItemIndex) || size < 0) {
+        return false;
+    }
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+
+    // compressed chunks are saved again by every write, they cannot be written to reserved clusters
+    if (mftItem->item_flags & MFT_ITEM_COMPRESSED) {
+        std::cout << "FILE IS COMPRESSED";
+        return false;
+    }
+
+    // data held in memory or in mft item are written to reserved clusters, file is empty until then
+    // file is emptied only when its clusters are reserved, failed preallocation leaves it as it was
+    std::string content;
+    bool converted = mftItem->item_flags & (MFT_ITEM_DELAYED | MFT_ITEM_RESIDENT);
+    if (converted && !loadFileFromPseudoNtfs(mftItemIndex, &content)) {
+        return false;
+    }
+    std::map<int32_t, struct delayed_file>::iterator file = delayedFiles.find(mftItemIndex);
+    int32_t delayedCount = file != delayedFiles.end() ? clustersOf(file->second.data.length()) : 0;
+
+    // resident data are not fragments, converted file has no data clusters yet
+    std::shared_ptr<const ExtentMap> extentMap = converted ? std::make_shared<const ExtentMap>() : cachedExtentMap(mftItemIndex);
+    int32_t clustersCount = extentMap->getClusterCount();
+    int32_t demandedCount = clustersOf(std::max(size, (int32_t) content.length())) - clustersCount;
+    int32_t valid = converted ? 0 : validSize(mftItemIndex);
+
+    int32_t reservedStart = 0;
+    if (demandedCount > 0) {
+
+        // clusters reserved for data held in memory are free for them
+        if (demandedCount > availableClusters() + delayedCount) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+
+        // run goes behind the last data cluster of file, new file starts in its own group
+        int32_t goal = allocationGroups.groupStart(homeGroup(mftItemIndex));
+        for (const struct extent & extent : extentMap->getExtents()) {
+            if (extent.start != EXTENT_HOLE) {
+                goal = extent.start + extent.count;
+            }
+        }
+
+        // all reserved clusters are one run, it can cross borders of groups
+        bool reserved = allocationGroups.reserveContiguous(demandedCount, goal, &reservedStart);
+        if (!reserved && snapshotReclaim && reclaimSnapshotClusters() > 0) {
+            reserved = allocationGroups.reserveContiguous(demandedCount, goal, &reservedStart);
+        }
+        if (!reserved) {
+            std::cout << "NOT ENOUGH CONTIGUOUS SPACE";
+            return false;
+        }
+        // reserved clusters return to their groups at commit when file does not take them
+        transactionReserved.release(reservedStart, demandedCount);
+        allocationCursor = reservedStart + demandedCount;
+    }
+
+    struct mft_item original;
+    memcpy(&original, mftItem, sizeof(mft_item));
+    if (converted) {
+        preserveMftItem(mftItemIndex);
+        mftItem->item_flags = 0;
+        mftItem->item_size = 0;
+        clearMftItemFragments(mftItem->fragments);
+        journalMftItem(mftItemIndex);
+    }
+
+    if (demandedCount > 0) {
+
+        std::list<struct mft_fragment> fragments;
+        for (const struct extent & extent : extentMap->getExtents()) {
+            appendFragment(&fragments, extent.start, extent.count);
+        }
+        appendFragment(&fragments, reservedStart, demandedCount);
+        if (!setFileFragments(mftItemIndex, &fragments)) {
+            // emptied file gets its data back, they are still held in memory or in saved mft item
+            if (converted) {
+                memcpy(mftItem, &original, sizeof(mft_item));
+                journalMftItem(mftItemIndex);
+            }
+            std::cout << "NOT ENOUGH FREE ITEMS";
+            return false;
+        }
+
+        // clusters are used without writing them
+        for (int32_t i = reservedStart; i < reservedStart + demandedCount; i++) {
+            setBitmap(i, true);
+        }
+    }
+
+    // data held in memory are written to clusters below
+    if (file != delayedFiles.end()) {
+        delayedBytes -= file->second.data.length();
+        delayedClusters -= delayedCount;
+        delayedFiles.erase(file);
+    }
+
+    preserveMftItem(mftItemIndex);
+    if (!(flags & PREALLOCATE_KEEP_SIZE)) {
+        mftItem->item_size = std::max(mftItem->item_size, size);
+    }
+    setValidSize(mftItemIndex, valid);
+    journalMftItem(mftItemIndex);
+
+    return content.empty() || writeData(mftItemIndex, 0, content.data(), content.length());
+}
+
+void PseudoNTFS::writeFileCluster(const int32_t index, const unsigned char * data) {
+
+    // old content of cluster leaves deduplication index, new one can be shared by next written files
+    unindexCluster(index);
+    setClusterData(index, data, bootRecord->cluster_size);
+
+    if (deduplication) {
+        deduplicationIndex[checksum(data, bootRecord->cluster_size)].push_back(index);
+    }
+}
+
+int32_t PseudoNTFS::validSize(const int32_t mftItemIndex) const {
+
+    const struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    return (mftItem->item_flags & MFT_ITEM_PREALLOCATED) ? mftItem->item_valid : mftItem->item_size;
+}
+
+void PseudoNTFS::setValidSize(const int32_t mftItemIndex, const int32_t size) {
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    if (size >= mftItem->item_size && cachedExtentMap(mftItemIndex)->getClusterCount() <= clustersOf(mftItem->item_size)) {
+        mftItem->item_flags &= ~MFT_ITEM_PREALLOCATED;
+        mftItem->item_valid = 0;
+    }
+    else {
+        mftItem->item_flags |= MFT_ITEM_PREALLOCATED;
+        mftItem->item_valid = size;
+    }
+}
+
+bool PseudoNTFS::writeData(const int32_t mftItemIndex, const int32_t offset, const char * buffer, const int32_t length) {
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    int32_t end = offset + length;
+
+    if (length == 0) {
+        return true;
+    }
+
+    // data held in memory are changed there
+    if (mftItem->item_flags & MFT_ITEM_DELAYED) {
+        std::map<int32_t, struct delayed_file>::iterator file = delayedFiles.find(mftItemIndex);
+        if (file == delayedFiles.end()) {
+            return false;
+        }
+
+        std::string & data = file->second.data;
+        if ((int32_t) data.length() < end) {
+            int32_t reserved = clustersOf(end) - clustersOf(data.length());
+            if (reserved > availableClusters()) {
+                std::cout << "NOT ENOUGH FREE SPACE";
+                return false;
+            }
+            delayedClusters += reserved;
+            delayedBytes += end - data.length();
+            data.resize(end, '\0');
+        }
+        data.replace(offset, length, buffer, length);
+        preserveMftItem(mftItemIndex);
+        mftItem->item_size = data.length();
+        journalMftItem(mftItemIndex);
+
+        return delayedBytes <= delayedBudget || flushDelayedFiles();
+    }
+
+    // compressed chunks and resident data cannot be changed in place, file is saved again
+    if (mftItem->item_flags & (MFT_ITEM_COMPRESSED | MFT_ITEM_RESIDENT)) {
+        std::string content;
+        if (!loadFileFromPseudoNtfs(mftItemIndex, &content)) {
+            return false;
+        }
+        if ((int32_t) content.length() < end) {
+            content.resize(end, '\0');
+        }
+        content.replace(offset, length, buffer, length);
+        return rewriteFile(mftItemIndex, &content);
+    }
+
+    int32_t clusterSize = bootRecord->cluster_size;
+
+    // unwritten data of preallocated file in front of written ones would be read as zeros no more, zeros are written there
+    int32_t valid = validSize(mftItemIndex);
+    if ((mftItem->item_flags & MFT_ITEM_PREALLOCATED) && offset > valid) {
+        std::string zeros(std::min(offset - valid, DELAYED_BUDGET), '\0');
+        while (valid < offset) {
+            int32_t count = std::min(offset - valid, (int32_t) zeros.length());
+            if (!writeData(mftItemIndex, valid, zeros.data(), count)) {
+                return false;
+            }
+            valid += count;
+        }
+    }
+
+    std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(mftItemIndex);
+    int32_t clustersCount = extentMap->getClusterCount();
+    int32_t neededClusters = ceil(std::max(mftItem->item_size, end) / (double) clusterSize);
+    int32_t first = offset / clusterSize;
+    int32_t last = (end - 1) / clusterSize;
+
+    // written cluster gets new data cluster when it is shared with other files or snapshot or when it is hole
+    // zeros written to hole or behind end of file leave hole there
+    std::map<int32_t, int32_t> placed;
+    for (int32_t i = first; i <= last; i++) {
+        int32_t index = extentMap->find(i);
+        int32_t from = std::max(offset, i * clusterSize);
+        int32_t to = std::min(end, (i + 1) * clusterSize);
+        if (index != NOT_FOUND ? clusterReferences()[index] > 0 || isClusterFrozen(index) : !isZero((const unsigned char *) buffer + from - offset, to - from)) {
+            placed[i] = NOT_FOUND;
+        }
+    }
+
+    if (!placed.empty() || neededClusters > clustersCount) {
+
+        std::vector<int32_t> newClusters;
+        std::list<struct data_seg> dataSegmentList;
+        if ((int32_t) placed.size() > availableClusters()) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        // new clusters go near the file
+        int32_t goal = NOT_FOUND;
+        for (const struct extent & extent : extentMap->getExtents()) {
+            if (extent.start != EXTENT_HOLE) {
+                goal = std::min(extent.start + extent.count, bootRecord->cluster_count - 1);
+            }
+        }
+        if (!placed.empty() && !prepareMftItems(&dataSegmentList, placed.size() * clusterSize, goal, NOT_FOUND)) {
+            std::cout << "NOT ENOUGH FREE SPACE";
+            return false;
+        }
+        for (const data_seg & segment : dataSegmentList) {
+            for (int32_t i = 0; i < segment.size / clusterSize; i++) {
+                newClusters.push_back(segment.startIndex + i);
+            }
+        }
+
+        size_t next = 0;
+        for (std::pair<const int32_t, int32_t> & target : placed) {
+            target.second = newClusters[next++];
+        }
+
+        // fragments are set before data are written, nothing is changed when there are not enough free mft items
+        std::list<struct mft_fragment> fragments;
+        std::map<int32_t, int32_t>::const_iterator target = placed.begin();
+        for (const struct extent & extent : extentMap->getExtents()) {
+            int32_t position = extent.logical_start;
+            int32_t bound = extent.logical_start + extent.count;
+            for (; target != placed.end() && target->first < bound; target++) {
+                appendFragment(&fragments, extent.start == EXTENT_HOLE ? EXTENT_HOLE : extent.start + position - extent.logical_start, target->first - position);
+                appendFragment(&fragments, target->second);
+                position = target->first + 1;
+            }
+            appendFragment(&fragments, extent.start == EXTENT_HOLE ? EXTENT_HOLE : extent.start + position - extent.logical_start, bound - position);
+        }
+
+        // clusters behind old end of file are written ones and holes between them
+        for (int32_t position = clustersCount; position < neededClusters; position++) {
+            if (target != placed.end() && target->first == position) {
+                appendFragment(&fragments, target->second);
+                target++;
+            }
+            else {
+                int32_t bound = target != placed.end() ? target->first : neededClusters;
+                appendFragment(&fragments, EXTENT_HOLE, bound - position);
+                position = bound - 1;
+            }
+        }
+
+        if (!setFileFragments(mftItemIndex, &fragments)) {
+            std::cout << "NOT ENOUGH FREE ITEMS";
+            return false;
+        }
+    }
+
+    unsigned char * cluster = new unsigned char[clusterSize];
+
+    for (int32_t i = first; i <= last; i++) {
+
+        int32_t index = extentMap->find(i);
+        std::map<int32_t, int32_t>::const_iterator target = placed.find(i);
+        if (index == NOT_FOUND && target == placed.end()) {
+            continue;
+        }
+
+        // unwritten cluster is not read, its part behind written data is zeros
+        if (index != NOT_FOUND && i * clusterSize < valid) {
+            getClusterData(index, cluster);
+            if (valid < (i + 1) * clusterSize) {
+                memset(cluster + valid - i * clusterSize, 0, (i + 1) * clusterSize - valid);
+            }
+        }
+        else {
+            memset(cluster, 0, clusterSize);
+        }
+
+        if (target != placed.end()) {
+            if (index != NOT_FOUND) {
+                snapshotCopiedClusters += isClusterFrozen(index);
+                clearClusterData(index, 1);
+            }
+            index = target->second;
+        }
+
+        int32_t from = std::max(offset, i * clusterSize);
+        int32_t to = std::min(end, (i + 1) * clusterSize);
+        memcpy(cluster + from - i * clusterSize, buffer + from - offset, to - from);
+
+        writeFileCluster(index, cluster);
+    }
+
+    delete [] cluster;
+
+    preserveMftItem(mftItemIndex);
+    mftItem->item_size = std::max(mftItem->item_size, end);
+    if (mftItem->item_flags & MFT_ITEM_PREALLOCATED) {
+        setValidSize(mftItemIndex, std::max(valid, end));
+    }
+    journalMftItem(mftItemIndex);
+
+    return true;
+}
+
+bool PseudoNTFS::rewriteFile(const int32_t mftItemIndex, const std::string * content) {
+
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    bool compressed = mftItem->item_flags & MFT_ITEM_COMPRESSED;
+    // new data go where the old ones were
+    int32_t goal = allocationGoal(mftItemIndex);
+
+    // old data clusters and next mft items are released, the first mft item stays in its directory
+    if (!(mftItem->item_flags & MFT_ITEM_RESIDENT)) {
+        std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(mftItemIndex);
+        for (const struct extent & extent : extentMap->getExtents()) {
+            if (extent.start != EXTENT_HOLE) {
+                clearClusterData(extent.start, extent.count);
+            }
+        }
+    }
+
+    std::list<struct mft_fragment> fragments;
+    preserveMftItem(mftItemIndex);
+    mftItem->item_flags = 0;
+    mftItem->item_size = 0;
+    setFileFragments(mftItemIndex, &fragments);
+
+    int32_t length = content->length();
+    if (residentData && length <= MFT_RESIDENT_SIZE) {
+        mftItem->item_flags = MFT_ITEM_RESIDENT;
+        mftItem->item_size = length;
+        memcpy(mftItem->fragments, content->data(), length);
+        journalMftItem(mftItemIndex);
+        return true;
+    }
+
+    std::string storedData;
+    if (compressed) {
+        compressData(content->data(), length, &storedData);
+    }
+    const std::string * data = compressed ? &storedData : content;
+
+    if (data->empty()) {
+        mftItem->item_flags = compressed ? MFT_ITEM_COMPRESSED : 0;
+        journalMftItem(mftItemIndex);
+        return true;
+    }
+
+    std::list<struct data_seg> dataSegmentList;
+    if (!prepareMftItems(&dataSegmentList, allocatedSize(data->data(), data->length()), goal, NOT_FOUND)) {
+        std::cout << "NOT ENOUGH FREE SPACE";
+        return false;
+    }
+
+    return save(&dataSegmentList, mftItem->item_name, mftItem->uid, (char *) data->data(), data->length(), length, compressed ? MFT_ITEM_COMPRESSED : 0, mftItemIndex);
+}
+
+void PseudoNTFS::loadDataFragment(int32_t startIndex, int32_t fragmentCount, std::ostringstream * oss) {
+
+    if (startIndex < 0 || startIndex + fragmentCount > bootRecord->cluster_count) {
+        indexOutOfRange = true;
+        return;
+    }
+
+    char * buffer = new char[bootRecord->cluster_size];
+
+    // clusters are loaded whole, file data can contain zeros
+    for (int i = startIndex; i < startIndex + fragmentCount; i++) {
+        getClusterData(i, (unsigned char *) buffer);
+        oss->write(buffer, bootRecord->cluster_size);
+    }
+    delete [] buffer;
+    buffer = NULL;
+}
+
+bool PseudoNTFS::readDirectoryEntries(const int32_t directoryMftItemIndex, std::vector<struct directory_entry> * entries) {
+
+    if (directoryMftItemIndex < 0 || directoryMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    unsigned char * block = new unsigned char[bootRecord->cluster_size];
+    const struct directory_block * header = (const struct directory_block *) block;
+    const struct directory_entry * records = (const struct directory_entry *) (block + sizeof(directory_block));
+    const struct directory_index * indexes = (const struct directory_index *) (block + sizeof(directory_block));
+
+    // tree is walked in order, so entries are sorted by name, every block is visited once
+    int32_t blocksCount = cachedExtentMap(directoryMftItemIndex)->getClusterCount();
+    std::vector<int32_t> stack;
+    if (blocksCount > 0) {
+        stack.push_back(0);
+    }
+
+    for (int32_t visited = 0; !stack.empty() && visited < blocksCount; visited++) {
+
+        int32_t order = stack.back();
+        stack.pop_back();
+        if (!readDirectoryBlock(directoryMftItemIndex, order, block)) {
+            continue;
+        }
+
+        int32_t count = std::min(std::max(header->entries_count, 0), directoryBlockCapacity(header->level));
+        for (int32_t i = count - 1; header->level > 0 && i >= 0; i--) {
+            stack.push_back(indexes[i].block);
+        }
+
+        for (int32_t i = 0; header->level == 0 && i < count; i++) {
+            if (records[i].mft_index >= 0 && records[i].mft_index < mftItemsCount) {
+                entries->push_back(records[i]);
+            }
+        }
+    }
+
+    delete [] block;
+    return true;
+}
+
+bool PseudoNTFS::walkTree(const int32_t directoryMftItemIndex, std::vector<struct tree_directory> * directories, const std::function<void(const int32_t, const struct tree_directory &)> & visit) {
+
+    if (directoryMftItemIndex < 0 || directoryMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    // directory waiting for its entries, its parent has its position already
+    struct walk_task {
+        int32_t mftItemIndex;
+        int32_t parent;
+        char name[12];
+    };
+    struct walk_queue {
+        std::mutex mutex;
+        std::deque<struct walk_task> tasks;
+    };
+
+    int32_t threadsCount = std::max((int32_t) std::thread::hardware_concurrency(), 1);
+    std::vector<std::unique_ptr<struct walk_queue>> queues;
+    for (int32_t t = 0; t < threadsCount; t++) {
+        queues.push_back(std::unique_ptr<struct walk_queue>(new walk_queue()));
+    }
+
+    struct walk_task first = {directoryMftItemIndex, NOT_FOUND, ""};
+    strncpy(first.name, mftItemStart[directoryMftItemIndex].item_name, sizeof(first.name) - 1);
+    queues[0]->tasks.push_back(first);
+
+    // directories queued or being read, walk ends when there is none
+    std::atomic<int32_t> unfinished(1);
+    std::atomic<int32_t> visited(0);
+    // directory listed twice in corrupted tree is walked once
+    std::mutex seenMutex;
+    std::unordered_set<int32_t> seen = {directoryMftItemIndex};
+
+    // every worker keeps directories it has read with their positions, they are put together at the end
+    std::vector<std::vector<struct tree_directory>> found(threadsCount);
+    std::vector<std::vector<int32_t>> positions(threadsCount);
+
+    std::vector<std::thread> workers;
+    for (int32_t t = 0; t < threadsCount; t++) {
+        workers.push_back(std::thread([this, t, threadsCount, &queues, &unfinished, &visited, &seenMutex, &seen, &found, &positions, &visit]() {
+            struct walk_queue * own = queues[t].get();
+            while (unfinished > 0) {
+
+                // own directories are taken depth first, so the queue stays short
+                struct walk_task task;
+                bool taken = false;
+                {
+                    std::lock_guard<std::mutex> lock(own->mutex);
+                    if (!own->tasks.empty()) {
+                        task = own->tasks.back();
+                        own->tasks.pop_back();
+                        taken = true;
+                    }
+                }
+
+                // idle worker steals the oldest directory of other worker, it is the nearest to root and has the largest subtree
+                for (int32_t k = 1; !taken && k < threadsCount; k++) {
+                    struct walk_queue * victim = queues[(t + k) % threadsCount].get();
+                    std::lock_guard<std::mutex> lock(victim->mutex);
+                    if (!victim->tasks.empty()) {
+                        task = victim->tasks.front();
+                        victim->tasks.pop_front();
+                        taken = true;
+                    }
+                }
+
+                if (!taken) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                int32_t position = visited++;
+                found[t].push_back(tree_directory());
+                positions[t].push_back(position);
+                struct tree_directory & directory = found[t].back();
+                directory.mftItemIndex = task.mftItemIndex;
+                directory.parent = task.parent;
+                memcpy(directory.name, task.name, sizeof(directory.name));
+                readDirectoryEntries(task.mftItemIndex, &directory.entries);
+
+                // subdirectories are counted before their directory is finished, so walk cannot end meanwhile
+                for (const struct directory_entry & entry : directory.entries) {
+                    if (!entry.isDirectory) {
+                        continue;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(seenMutex);
+                        if (!seen.insert(entry.mft_index).second) {
+                            continue;
+                        }
+                    }
+                    struct walk_task child = {entry.mft_index, position, ""};
+                    memcpy(child.name, entry.name, sizeof(child.name));
+                    unfinished++;
+                    std::lock_guard<std::mutex> lock(own->mutex);
+                    own->tasks.push_back(child);
+                }
+
+                if (visit) {
+                    visit(position, directory);
+                }
+                unfinished--;
+            }
+        }));
+    }
+
+    for (std::thread & worker : workers) {
+        worker.join();
+    }
+
+    // position is given when directory is read, its parent was read before it
+    directories->clear();
+    directories->resize(visited);
+    for (int32_t t = 0; t < threadsCount; t++) {
+        for (size_t i = 0; i < found[t].size(); i++) {
+            (*directories)[positions[t][i]] = std::move(found[t][i]);
+        }
+    }
+
+    return true;
+}
+
+bool PseudoNTFS::getDirectoryContent(const int32_t directoryMftItemIndex, std::list<mft_item> * content) {
+
+    // entries hold mft index, so no mft item has to be searched for
+    std::vector<struct directory_entry> entries;
+    if (!readDirectoryEntries(directoryMftItemIndex, &entries)) {
+        return false;
+    }
+
+    for (const struct directory_entry & entry : entries) {
+        content->push_back(mftItemStart[entry.mft_index]);
+    }
+    return true;
+}
+
+void PseudoNTFS::treePaths(const std::vector<struct tree_directory> & directories, std::vector<std::string> * paths) const {
+
+    // parent is before its directories, so its path is known already, starting directory is not part of paths
+    paths->assign(directories.size(), std::string());
+    for (size_t i = 1; i < directories.size(); i++) {
+        (*paths)[i] = (*paths)[directories[i].parent] + directories[i].name + '/';
+    }
+}
+
+bool PseudoNTFS::findItems(const int32_t directoryMftItemIndex, const char * pattern, std::vector<std::string> * paths) {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    // names are matched by threads reading directories, paths are made when all parents are known
+    std::mutex matchedMutex;
+    std::vector<std::pair<int32_t, std::string>> matched;
+    std::vector<struct tree_directory> directories;
+    bool walked = walkTree(directoryMftItemIndex, &directories, [pattern, &matchedMutex, &matched](const int32_t position, const struct tree_directory & directory) {
+        std::vector<std::pair<int32_t, std::string>> local;
+        for (const struct directory_entry & entry : directory.entries) {
+            if (fnmatch(pattern, entry.name, 0) == 0) {
+                local.push_back(std::make_pair(position, std::string(entry.name) + (entry.isDirectory ? "/" : "")));
+            }
+        }
+        if (!local.empty()) {
+            std::lock_guard<std::mutex> lock(matchedMutex);
+            matched.insert(matched.end(), local.begin(), local.end());
+        }
+    });
+
+    std::vector<std::string> directoryPaths;
+    if (!matched.empty()) {
+        treePaths(directories, &directoryPaths);
+    }
+    for (const std::pair<int32_t, std::string> & match : matched) {
+        paths->push_back(directoryPaths[match.first] + match.second);
+    }
+    std::sort(paths->begin(), paths->end());
+    return walked;
+}
+
+bool PseudoNTFS::diskUsage(const int32_t directoryMftItemIndex, struct tree_usage * usage) {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    // every directory is counted by thread which has read it, totals are added once per directory
+    std::atomic<int64_t> size(0), allocated(0);
+    std::atomic<int32_t> files(0);
+    std::vector<struct tree_directory> directories;
+    bool walked = walkTree(directoryMftItemIndex, &directories, [this, &size, &allocated, &files](const int32_t /*position*/, const struct tree_directory & directory) {
+        int64_t directorySize = 0;
+        int64_t directoryClusters = getUsedClusters(directory.mftItemIndex);
+        int32_t directoryFiles = 0;
+        for (const struct directory_entry & entry : directory.entries) {
+            if (!entry.isDirectory) {
+                directorySize += mftItemStart[entry.mft_index].item_size;
+                directoryClusters += getUsedClusters(entry.mft_index);
+                directoryFiles++;
+            }
+        }
+        size += directorySize;
+        allocated += directoryClusters * bootRecord->cluster_size;
+        files += directoryFiles;
+    });
+
+    usage->size = size;
+    usage->allocated = allocated;
+    usage->files = files;
+    usage->directories = directories.size();
+    return walked;
+}
+
+bool PseudoNTFS::printTree(const int32_t directoryMftItemIndex) {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    std::vector<struct tree_directory> directories;
+    if (!walkTree(directoryMftItemIndex, &directories)) {
+        return false;
+    }
+
+    std::unordered_map<int32_t, int32_t> positions;
+    for (size_t i = 0; i < directories.size(); i++) {
+        positions[directories[i].mftItemIndex] = i;
+    }
+
+    // entries are printed in order of names, deep tree is printed without recursion
+    struct tree_level {
+        int32_t position;
+        size_t entry;
+    };
+    std::vector<struct tree_level> stack;
+    stack.push_back(tree_level{0, 0});
+    int32_t files = 0;
+    std::string indent;
+    std::cout << "+" << directories[0].name << std::endl;
+
+    while (!stack.empty()) {
+        struct tree_level & level = stack.back();
+        const struct tree_directory & directory = directories[level.position];
+        if (level.entry == directory.entries.size()) {
+            stack.pop_back();
+            continue;
+        }
+
+        const struct directory_entry & entry = directory.entries[level.entry++];
+        indent.resize(stack.size() * 2, ' ');
+        std::cout << indent << (entry.isDirectory ? '+' : '-') << entry.name << '\n';
+        files += !entry.isDirectory;
+
+        std::unordered_map<int32_t, int32_t>::const_iterator child = positions.find(entry.mft_index);
+        if (entry.isDirectory && child != positions.end() && directories[child->second].parent == level.position) {
+            stack.push_back(tree_level{child->second, 0});
+        }
+    }
+
+    std::cout << directories.size() - 1 << " directories, " << files << " files";
+    return true;
+}
+
+int32_t PseudoNTFS::locateItems(const char * pattern, std::vector<int32_t> * indexes) {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    indexes->clear();
+    if (hasNameIndex()) {
+        names()->find(pattern, indexes);
+    }
+    else {
+        // every first mft item of file or directory is compared, system file is in no directory
+        const MftHotTable * table = hot();
+        for (int32_t i = 0; i < mftItemsCount; i++) {
+            if (table->getUid(i) != UID_ITEM_FREE && (table->getFlags(i) & (MFT_HOT_FIRST | MFT_ITEM_SYSTEM)) == MFT_HOT_FIRST
+                && NameIndex::matches(pattern, mftItemStart[i].item_name)) {
+                indexes->push_back(i);
+            }
+        }
+    }
+
+    return indexes->size();
+}
+
+bool PseudoNTFS::setNameIndex(const bool enabled) {
+
+    Transaction transaction(this);
+
+    if (enabled == hasNameIndex()) {
+        return true;
+    }
+
+    if (enabled) {
+        // index of all names is built before its system file exists
+        nameIndexBuilt = false;
+        if (!saveNameIndex()) {
+            nameIndex.resize(0);
+            nameIndexBuilt = false;
+            nameIndexDirty = false;
+            return false;
+        }
+        return true;
+    }
+
+    freeMftItemWithData(bootRecord->name_index_item);
+    bootRecord->name_index_item = NOT_FOUND;
+    journalBootRecord(&bootRecord->name_index_item);
+    nameIndex.resize(0);
+    nameIndexBuilt = false;
+    nameIndexDirty = false;
+    return true;
+}
+
+bool PseudoNTFS::flushNameIndex() {
+
+    Transaction transaction(this);
+
+    if (!hasNameIndex()) {
+        return false;
+    }
+    return !nameIndexDirty || saveNameIndex();
+}
+
+void PseudoNTFS::printNameIndexStatistics() {
+
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    if (!hasNameIndex()) {
+        std::cout << "NAME INDEX IS OFF";
+        return;
+    }
+
+    NameIndex * index = names();
+    std::cout << "Names: " << index->getNamesCount() << ", grams: " << index->getPostingsCount();
+    std::cout << ", saved index: " << mftItemStart[bootRecord->name_index_item].item_size << " B" << (nameIndexDirty ? " (stale)" : "");
+}
+
+bool PseudoNTFS::makeDirectory(const int32_t parentMftItemIndex, const char * name) {
+
+    Transaction transaction(this);
+
+    if (parentMftItemIndex < 0 || parentMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
+    }
+
+    struct directory_entry entry;
+    if (findDirectoryEntry(parentMftItemIndex, name, &entry)) {
+        std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
+        return false;
+    }
+
+    if (availableSpace() < bootRecord->cluster_size) {
+        std::cout << "NOT ENOUGH FREE SPACE\n";
+        return false;
+    }
+
+    if (freeMftItems == 0) {
+        std::cout << "NOT ENOUGH FREE MFT ITEMS\n";
+        return false;
+    }
+
+    // new directory gets its first block with its first entry
+    if (createItem(parentMftItemIndex, name, true) == NOT_FOUND) {
+        std::cout << "NOT ENOUGH FREE SPACE\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool PseudoNTFS::isDirEmpty(const int32_t mftItemIndex) {
+
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;;
+    }
+
+    return mftItemStart[mftItemIndex].item_size == 0;
 }
 
-int PseudoNTFS::findFreeMft() const {
+bool PseudoNTFS::removeDirectory(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex) {
 
-    struct mft_item * mftItem = mftItemStart;
+    Transaction transaction(this);
 
-    for (int i = 0; i < mftItemsCount; i++) {
-        if (mftItem[i].uid == UID_ITEM_FREE) {
-            return i;
-        }
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || parentDirectoryMftItemIndex < 0 || parentDirectoryMftItemIndex >= mftItemsCount) {
+        indexOutOfRange = true;
+        return false;
     }
 
-    // In case there is no free mft item
-    return NOT_FOUND;
-}
-
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
 
-void PseudoNTFS::findFreeSpace(const int32_t demandedSize, int32_t * startIndex, int32_t * providedSize) {
+    if (!isDirEmpty(mftItemIndex)) {
+        std::cout << "NOT EMPTY\n";
+        return false;
+    }
+    else {
+        // empty directory can still have its blocks
+        removeDirectoryEntry(parentDirectoryMftItemIndex, mftItem->item_name);
+        freeMftItemWithData(mftItemIndex);
+        return true; 
+    }
+}
 
-    *providedSize = 0;
-    
-    int32_t maxSize = 0;
-    int32_t maxIndex = 0;
+void PseudoNTFS::freeMftItem(const int32_t mftItemIndex) {
 
-    if (*startIndex < 0 || *startIndex >= bootRecord->cluster_count) {
+    if (mftItemIndex < 0 || mftItemIndex > mftItemsCount) {
         indexOutOfRange = true;
         return;
     }
 
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
 
-    int32_t bound = ceil(bootRecord->cluster_count * bootRecord->cluster_size / 8.0); 
-    for (int i = 0; i < bound; i++) {
-        if (isClusterFree(i)) {
-            if (maxSize == 0) {
-                maxIndex = i;
-            }
-            maxSize += bootRecord->cluster_size;
-        }
-        else {
-            if (maxSize > *providedSize) {
-                *providedSize = maxSize;
-                *startIndex = maxIndex;
-            }
-            maxSize = 0; 
-        }
+    preserveMftItem(mftItemIndex);
+    mftItem->uid = UID_ITEM_FREE;
+    strcpy(mftItem->item_name, "");
+    mftItem->item_size = 0;
+    mftItem->item_order = 0;
+    mftItem->item_order_total = 0;
+    mftItem->isDirectory = false;
+    mftItem->item_flags = 0;
+    mftItem->item_next = NOT_FOUND;
+    mftItem->item_valid = 0;
+    clearMftItemFragments(mftItem->fragments);
+    journalMftItem(mftItemIndex);
 
-        if (maxSize >= demandedSize) {
-            *providedSize = maxSize;
-            *startIndex = maxIndex;
-            return;    
-        } 
-    }
+    freeMftItems++;
+    firstFreeMftItem = std::min(firstFreeMftItem, mftItemIndex);
 }
 
+void PseudoNTFS::freeMftItemWithData(const int32_t mftItemIndex) {
 
-void PseudoNTFS::saveContinualSegment(const char * data, const int32_t size, const int32_t startIndex) {
-    
-    if (startIndex < 0 || startIndex >= bootRecord->cluster_count) {
+    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
         indexOutOfRange = true;
         return;
     }
 
-    int32_t bound = size / bootRecord->cluster_size;
-    int32_t left = size;
-    
-    for (int i = 0; i < bound; i++) {  
-        setClusterData(startIndex + i, (unsigned char *) data + i * bootRecord->cluster_size , bootRecord->cluster_size);
-        left -= bootRecord->cluster_size;
+    // file removed before flush never gets data clusters
+    std::map<int32_t, struct delayed_file>::iterator file = delayedFiles.find(mftItemIndex);
+    if (file != delayedFiles.end()) {
+        delayedBytes -= file->second.data.length();
+        delayedClusters -= clustersOf(file->second.data.length());
+        delayedFiles.erase(file);
     }
 
-    if (left > 0) {
-        setClusterData(startIndex + bound, (unsigned char *) data + bound * bootRecord->cluster_size, left);
+    for (int32_t index = mftItemIndex, next; index != NOT_FOUND; index = next) {
+
+        struct mft_item * mftItem = &mftItemStart[index];
+        next = nextMftItem(index);
+
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && !(mftItem->item_flags & MFT_ITEM_RESIDENT); i++) {
+            if (mftItem->fragments[i].fragment_count != 0 && mftItem->fragments[i].fragment_start_address != EXTENT_HOLE) {
+                clearClusterData(mftItem->fragments[i].fragment_start_address, mftItem->fragments[i].fragment_count);
+            }
+        }
+
+        freeMftItem(index);
     }
 }
 
+bool PseudoNTFS::move(const int32_t fileMftItemIndex, const int32_t fromMftItemIndex, const int32_t toMftItemIndex) {
 
-int32_t PseudoNTFS::contains(const int32_t mftItemIndex, const char * name, const bool directory) {
+    Transaction transaction(this);
 
-    if (mftItemIndex < 0 || mftItemIndex  >= mftItemsCount) {
+    if (fileMftItemIndex < 0 || fileMftItemIndex >= mftItemsCount ||
+        fromMftItemIndex < 0 || fromMftItemIndex >= mftItemsCount ||
+        toMftItemIndex < 0 || fromMftItemIndex >= mftItemsCount) {
         indexOutOfRange = true;
-        return NOT_FOUND;
+        return false;
     }
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
-    
-    int32_t dataClusterStartIndex, dataClustersCount, searchedMftItemIndex;
-    for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
-        dataClusterStartIndex = mftItem->fragments[i].fragment_start_address;
-        dataClustersCount = mftItem->fragments[i].fragment_count;
+    struct mft_item * mftItem = &mftItemStart[fileMftItemIndex];
 
-        searchedMftItemIndex = searchClusters(dataClusterStartIndex, dataClustersCount, name, directory);
-        if (searchedMftItemIndex != NOT_FOUND) {
-            return searchedMftItemIndex;
-        }
+    struct directory_entry entry;
+    if (findDirectoryEntry(toMftItemIndex, mftItem->item_name, &entry)) {
+        std::cout << (entry.isDirectory ? "DIRECTORY" : "FILE") << " WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
+        return false;
     }
 
-    return NOT_FOUND;
+    memset(&entry, 0, sizeof(directory_entry));
+    strncpy(entry.name, mftItem->item_name, sizeof(entry.name) - 1);
+    entry.mft_index = fileMftItemIndex;
+    entry.isDirectory = mftItem->isDirectory;
+
+    if (insertDirectoryEntry(toMftItemIndex, &entry)) {
+        removeDirectoryEntry(fromMftItemIndex, mftItem->item_name);
+        return true;
+    }
 
+    return false;
 }
 
-int32_t PseudoNTFS::searchClusters(const int32_t dataClusterStartIndex, const int32_t dataClustersCount, const char * name, const bool directory) {
-    
-    int32_t mftItemIndex;
+bool PseudoNTFS::removeFile(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex) {
 
-    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount >= bootRecord->cluster_count) {
+    Transaction transaction(this);
+
+     if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || parentDirectoryMftItemIndex < 0 || parentDirectoryMftItemIndex >= mftItemsCount) {
         indexOutOfRange = true;
-        return NOT_FOUND;
+        return false;
     }
 
-    for (int32_t i = dataClusterStartIndex; i < dataClusterStartIndex + dataClustersCount; i++) {
-        mftItemIndex = searchCluster(i, name, directory);
-        if (mftItemIndex != NOT_FOUND) {
-            return mftItemIndex;
-        }
-    }
+    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
 
-    return NOT_FOUND;
-    
+    // entry is found by name, it is removed while mft item still has it
+    removeDirectoryEntry(parentDirectoryMftItemIndex, mftItem->item_name);
+    freeMftItemWithData(mftItemIndex);
+    return true;
 }
 
-int32_t PseudoNTFS::searchCluster(const int32_t dataClusterIndex, const char * name, const bool directory) {
+void PseudoNTFS::clearClusterData(const int startIndex, const int32_t clustersCount) {
 
-    if (dataClusterIndex < 0 || dataClusterIndex >= bootRecord->cluster_count) {
+    if (startIndex < 0 || startIndex + clustersCount > bootRecord->cluster_count) {
         indexOutOfRange = true;
-        return NOT_FOUND;
+        return;
     }
 
-    int maxUidInDataCluster = bootRecord->cluster_size / sizeof(int32_t);
-    int32_t * mftItemUid = (int32_t *) &dataStart[dataClusterIndex * bootRecord->cluster_size];
+    // clusters released by the whole fragment are collected to runs, run is released at once
+    int32_t runStart = startIndex;
+    for (int i = startIndex; i < startIndex + clustersCount; i++) {
 
-    int32_t mftItemIndex;
-    for (int i = 0; i < maxUidInDataCluster; i++) {
-        mftItemIndex = findMftItemWithProperties(mftItemUid[i], name, directory);
+        // shared cluster is cleared with its last reference
+        if (clusterReferences()[i] > 0) {
+            releaseClusters(runStart, i - runStart);
+            runStart = i + 1;
+            clusterReferences()[i]--;
+            continue;
+        }
 
-        if (mftItemIndex != NOT_FOUND) {
-            return mftItemIndex;
+        // cluster of snapshot is kept until no snapshot needs it, its content cannot be shared again
+        if (isClusterFrozen(i)) {
+            releaseClusters(runStart, i - runStart);
+            runStart = i + 1;
+            unindexCluster(i);
+            struct held_cluster held = {i, clusterGenerations[i], generation};
+            heldClusters.push_back(held);
+            // images leave held cluster out as free one
+            trackClusterChange(i);
+            continue;
         }
     }
-
-    return NOT_FOUND;  
+    releaseClusters(runStart, startIndex + clustersCount - runStart);
 }
 
-int32_t PseudoNTFS::findMftItemWithProperties(const int32_t uid, const char * name, const bool directory) {
+void PseudoNTFS::holdLeakedClusters() {
 
-    struct mft_item * tempMftItem = mftItemStart;
+    std::vector<unsigned char> referenced(ceil(bootRecord->cluster_count / 8.0), 0);
     for (int i = 0; i < mftItemsCount; i++) {
-        if (tempMftItem[i].uid == uid && strcmp(tempMftItem[i].item_name, name) == 0 && tempMftItem[i].isDirectory == directory) {
-            return i;
+        if (mftItemStart[i].uid == UID_ITEM_FREE || (mftItemStart[i].item_flags & MFT_ITEM_RESIDENT)) {
+            continue;
+        }
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            int32_t startIndex = mftItemStart[i].fragments[j].fragment_start_address;
+            int32_t bound = std::min(startIndex + mftItemStart[i].fragments[j].fragment_count, bootRecord->cluster_count);
+            for (int32_t k = std::max(startIndex, 0); k < bound && startIndex != EXTENT_HOLE; k++) {
+                referenced[k / 8] |= 128 >> (k % 8);
+            }
         }
     }
 
-    return NOT_FOUND;
+    // no snapshot needs leaked cluster, it stays used until sync or allocation short of space releases it
+    // full image replaces bitmap, clusters held before it are found again
+    heldClusters.clear();
+    for (int32_t i = 0; i < bootRecord->cluster_count; i++) {
+        if (bitmapStart[i / 8] & ~referenced[i / 8] & (128 >> (i % 8))) {
+            struct held_cluster held = {i, 0, 0};
+            heldClusters.push_back(held);
+        }
+    }
+    snapshotReclaim = !heldClusters.empty();
 }
 
-bool PseudoNTFS::saveUid(int32_t destinationMftItemIndex, int32_t uid) {
+void PseudoNTFS::releaseCluster(const int index) {
 
-    if (destinationMftItemIndex < 0 || destinationMftItemIndex > mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
-    }
+    unindexCluster(index);
+    memset(clusterData(index), 0, bootRecord->cluster_size);
+    journalFreedData(index);
+    setBitmap(index, false);
+}
 
-    struct mft_item * mftItem = &mftItemStart[destinationMftItemIndex];
+void PseudoNTFS::releaseClusters(const int32_t startIndex, const int32_t clustersCount) {
 
-    int32_t fragmentCount;
-    int32_t size = mftItem->item_size;
-    for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
+    if (clustersCount <= 0) {
+        return;
+    }
 
-        fragmentCount = mftItem->fragments[i].fragment_count;
-        if (fragmentCount > 0) {
-            if (writeUid(mftItem->fragments[i].fragment_start_address, fragmentCount, uid)) {
-                mftItem->item_size += sizeof(int32_t);
-                return true;
-            }
+    // index is searched by content, so clusters are unindexed before they are cleared
+    for (int32_t i = startIndex; i < startIndex + clustersCount; i++) {
+        unindexCluster(i);
+    }
+    // volume without cache has run of clusters in one piece
+    if (cache == NULL) {
+        memset(clusterData(startIndex), 0, (int64_t) clustersCount * bootRecord->cluster_size);
+    }
+    for (int32_t i = startIndex; i < startIndex + clustersCount; i++) {
+        if (cache != NULL) {
+            memset(clusterData(i), 0, bootRecord->cluster_size);
         }
-        else if (fragmentCount == 0) {
-            int32_t providedSize = 0;
-            int32_t startIndex = 0;
-
-            findFreeSpace(bootRecord->cluster_size, &startIndex, &providedSize);
+        journalFreedData(i);
+    }
 
-            if (providedSize == 0 || providedSize < sizeof(int32_t)) {
-                return false;
-            }
-            else {
-                mftItem->item_size += sizeof(int32_t);
-                mftItem->fragments[i].fragment_count = 1;
-                mftItem->fragments[i].fragment_start_address = startIndex;
-                writeUid(startIndex, 1, uid);
-                setBitmap(startIndex, true);
-                return true;
-            }
+    // bits are cleared directly, runs of cleared bits go back to their groups in one step
+    spaceIndex.wait();
+    int32_t freedStart = startIndex;
+    for (int32_t i = startIndex; i <= startIndex + clustersCount; i++) {
+        bool used = i < startIndex + clustersCount && !isClusterFree(i);
+        if (used) {
+            bitmapStart[i / 8] &= ~(128 >> (i % 8));
+            journalBitmap(i);
+            continue;
         }
+        if (i > freedStart) {
+            allocationGroups.release(freedStart, i - freedStart);
+        }
+        freedStart = i + 1;
     }
-
-    return false;
 }
 
-bool PseudoNTFS::writeUid(int32_t startIndex, int32_t clusterCount, int32_t uid) {
-    
-    if (startIndex < 0 || startIndex >= bootRecord->cluster_count || startIndex + clusterCount > bootRecord->cluster_count) {
-        indexOutOfRange = true;
-        return false;
-    }
+/* ADVANCE FUNCTIONS */
 
-    int32_t * tempUid = (int32_t *)&dataStart[startIndex * bootRecord->cluster_size]; 
-    int32_t bound = clusterCount * bootRecord->cluster_size / sizeof(int32_t);
+/* SNAPSHOTS */
 
-    for (int i = 0; i < bound; i++) {
-        if (tempUid[i] == 0) {
-            tempUid[i] = uid;
-            return true;
-        }
-    }
+void PseudoNTFS::initSnapshots() {
 
-    return false;
+    snapshots.clear();
+    snapshotCounter = 1;
+    generation = 1;
+    clusterGenerations.assign(bootRecord->cluster_count, 0);
+    mftGenerations.assign(mftItemsCount, 0);
+    heldClusters.clear();
+    snapshotReclaim = false;
+    snapshotCopiedClusters = 0;
+    snapshotCopiedItems = 0;
+    snapshotOrigin = NULL;
 }
 
-bool PseudoNTFS::loadFileFromPseudoNtfs(int32_t mftItemIndex, std::string * content) {
+void PseudoNTFS::preserveMftItem(const int index) {
 
-    if (mftItemIndex < 0 || mftItemIndex  >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
+    // item copied after the newest snapshot was created has its content there already
+    if (snapshots.empty() || mftGenerations[index] > snapshots.back().generation) {
+        return;
     }
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    snapshots.back().mftItems[index] = mftItemStart[index];
+    mftGenerations[index] = generation;
+    snapshotCopiedItems++;
+}
 
-    std::ostringstream oss;
-    for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
-        loadDataFragment(mftItem->fragments[i].fragment_start_address, mftItem->fragments[i].fragment_count, &oss);
-    }
+bool PseudoNTFS::isClusterFrozen(const int index) {
 
-    *content = oss.str();
-    return true;
+    // the newest snapshot has all used clusters allocated before it
+    return !snapshots.empty() && clusterGenerations[index] <= snapshots.back().generation && !isClusterFree(index);
 }
 
-void PseudoNTFS::loadDataFragment(int32_t startIndex, int32_t fragmentCount, std::ostringstream * oss) {
+int32_t PseudoNTFS::createSnapshot() {
 
-    if (startIndex < 0 || startIndex + fragmentCount >= bootRecord->cluster_count) {
-        indexOutOfRange = true;
-        return;
-    }
+    Transaction transaction(this);
 
-    char * buffer = new char[bootRecord->cluster_size + 1];
-    buffer[bootRecord->cluster_size] = '\0';
+    // clusters leaked by crash are held before any cluster is held for snapshot
+    spaceIndex.wait();
 
-    for (int i = startIndex; i < startIndex + fragmentCount; i++) {
-        getClusterData(i, (unsigned char *) buffer);
-        *oss << buffer;
-    }
-    delete [] buffer;
-    buffer = NULL;
-}
+    // files held in memory get their clusters first, snapshot has their data
+    flushDelayedFiles();
 
-bool PseudoNTFS::getDirectoryContent(const int32_t directoryMftItemIndex, std::list<mft_item> * content) {
+    struct volume_snapshot snapshot;
+    snapshot.id = snapshotCounter++;
+    snapshot.generation = generation++;
+    snapshots.push_back(snapshot);
 
-    if (directoryMftItemIndex < 0 || directoryMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
-    }
+    return snapshot.id;
+}
 
-    struct mft_item * directoryMftItem = &mftItemStart[directoryMftItemIndex];
+bool PseudoNTFS::deleteSnapshot(const int32_t id) {
 
-    std::list<int32_t> uids;
+    Transaction transaction(this);
 
-    for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
-        getAllUidsFromFragment(directoryMftItem->fragments[i].fragment_start_address, directoryMftItem->fragments[i].fragment_count, &uids);
+    std::list<struct volume_snapshot>::iterator snapshot = snapshots.begin();
+    while (snapshot != snapshots.end() && snapshot->id != id) {
+        snapshot++;
+    }
+    if (snapshot == snapshots.end()) {
+        return false;
     }
 
-    struct mft_item * mftItem = mftItemStart;
-    int32_t mftItemIndex;
-
-    for (int32_t uid : uids) {
-        mftItemIndex = findMftItemWithUid(uid);
-        if (mftItemIndex != NOT_FOUND) {
-            content->push_back(mftItem[mftItemIndex]);
-        }
+    // item not changed before the next copy had the same content at time of older snapshot, older snapshot takes it
+    if (snapshot != snapshots.begin()) {
+        std::list<struct volume_snapshot>::iterator older = std::prev(snapshot);
+        older->mftItems.insert(snapshot->mftItems.begin(), snapshot->mftItems.end());
     }
 
+    snapshots.erase(snapshot);
+    snapshotReclaim = !heldClusters.empty();
     return true;
-
 }
 
-void PseudoNTFS::getAllUidsFromFragment(const int32_t startIndex, const int32_t fragmentsCount, std::list<int32_t> * uids) {
-
-     if (startIndex < 0 || startIndex + fragmentsCount >= bootRecord->cluster_count) {
-        indexOutOfRange = true;
-        return;
-    }
+bool PseudoNTFS::hasSnapshot(const int32_t id) {
 
-    int32_t * tempUid = (int32_t *) &dataStart[startIndex * bootRecord->cluster_size];
-    int32_t bound = (fragmentsCount * bootRecord->cluster_size) / sizeof(int32_t);
+    std::lock_guard<std::mutex> lock(operationMutex);
 
-    for (int i = 0; i < bound; i++) {
-        if (tempUid[i] != 0) {
-            uids->push_back(tempUid[i]);
-        }    
+    for (const struct volume_snapshot & snapshot : snapshots) {
+        if (snapshot.id == id) {
+            return true;
+        }
     }
+    return false;
 }
 
-int32_t PseudoNTFS::findMftItemWithUid(const int32_t uid) {
+int32_t PseudoNTFS::reclaimSnapshotClusters() {
 
-    for (int i = 0; i < mftItemsCount; i++) {
-        if (mftItemStart[i].uid == uid) {
-            return i;
+    spaceIndex.wait();
+
+    // cluster is needed by snapshot created after its allocation and before it was freed
+    std::vector<struct held_cluster> kept;
+    int32_t released = 0;
+    for (const struct held_cluster & held : heldClusters) {
+        bool needed = false;
+        for (const struct volume_snapshot & snapshot : snapshots) {
+            if (held.birth <= snapshot.generation && snapshot.generation < held.death) {
+                needed = true;
+                break;
+            }
+        }
+
+        if (needed) {
+            kept.push_back(held);
+        }
+        else {
+            releaseCluster(held.index);
+            released++;
         }
     }
 
-    return NOT_FOUND;
+    heldClusters.swap(kept);
+    snapshotReclaim = false;
+    return released;
 }
 
-bool PseudoNTFS::makeDirectory(const int32_t parentMftItemIndex, const char * name) {
+void PseudoNTFS::readSnapshot(const int32_t id, unsigned char * volume) {
 
-    if (parentMftItemIndex < 0 || parentMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
-    }
+    std::lock_guard<std::mutex> lock(operationMutex);
 
-    if (contains(parentMftItemIndex, name, true) != NOT_FOUND) {
-        std::cout << "DIRECTORY WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
-        return false;
-    }
+    memcpy(volume, ntfs, dataStart - ntfs);
 
-    if (contains(parentMftItemIndex, name, false) != NOT_FOUND) {
-        std::cout << "FILE WITH GIVEN NAME ALREADY EXISTS IN THIS DIRECTORY";
-        return false;
+    // content from time of snapshot is in the snapshot or in the first newer one which copied the item
+    struct mft_item * items = (struct mft_item *) (volume + ((unsigned char *) mftItemStart - ntfs));
+    std::vector<bool> copied(mftItemsCount, false);
+    std::list<struct volume_snapshot>::const_iterator snapshot = snapshots.begin();
+    while (snapshot != snapshots.end() && snapshot->id != id) {
+        snapshot++;
     }
-
-    if (freeSpace < bootRecord->cluster_size) {
-        std::cout << "NOT ENOUGH FREE SPACE\n";
-        return false;
+    for (; snapshot != snapshots.end(); snapshot++) {
+        for (const std::pair<const int32_t, struct mft_item> & item : snapshot->mftItems) {
+            if (!copied[item.first]) {
+                items[item.first] = item.second;
+                copied[item.first] = true;
+            }
+        }
     }
+}
 
-    int32_t mftIndex = findFreeMft();
+bool PseudoNTFS::redirectDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, int32_t * cluster) {
 
-    if (mftIndex == NOT_FOUND) {
-        std::cout << "NOT ENOUGH FREE MFT ITEMS\n";
+    int32_t startIndex = allocationGoal(directoryMftItemIndex), providedSize = 0;
+    findFreeSpace(bootRecord->cluster_size, &startIndex, &providedSize, NOT_FOUND);
+    if (providedSize == 0) {
         return false;
     }
 
-    int32_t demandedSize, providedSize, startIndex = 0;
-
-    demandedSize = bootRecord->cluster_size;
-    findFreeSpace(demandedSize, &startIndex, &providedSize);
+    std::shared_ptr<const ExtentMap> extentMap = cachedExtentMap(directoryMftItemIndex);
+    std::list<struct mft_fragment> fragments;
+    for (const struct extent & extent : extentMap->getExtents()) {
+        if (order < extent.logical_start || order >= extent.logical_start + extent.count) {
+            appendFragment(&fragments, extent.start, extent.count);
+            continue;
+        }
+        int32_t position = order - extent.logical_start;
+        appendFragment(&fragments, extent.start, position);
+        appendFragment(&fragments, startIndex);
+        appendFragment(&fragments, extent.start + position + 1, extent.count - position - 1);
+    }
 
-    if (providedSize == 0) {
-        std::cout << "NOT ENOUGH FREE SPACE\n";
+    if (!setFileFragments(directoryMftItemIndex, &fragments)) {
         return false;
     }
 
-    struct mft_item mftItem;
-    mftItem.uid = getUid();
-    strcpy(mftItem.item_name, name);
-    mftItem.isDirectory = true;
-    mftItem.item_order = 1;
-    mftItem.item_order_total = 1;
-    mftItem.item_size = 0;
-    clearMftItemFragments(mftItem.fragments);
-    setMftItem(mftIndex, &mftItem);
-    saveUid(parentMftItemIndex, mftItem.uid);
-
+    setBitmap(startIndex, true);
+    clearClusterData(*cluster, 1);
+    snapshotCopiedClusters++;
+    *cluster = startIndex;
     return true;
 }
 
-bool PseudoNTFS::isDirEmpty(const int32_t mftItemIndex) {
+void PseudoNTFS::printSnapshots() {
 
-    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;;
-    }
+    std::lock_guard<std::mutex> lock(operationMutex);
+    spaceIndex.wait();
 
-    return mftItemStart[mftItemIndex].item_size == 0;
+    std::cout << "Snapshots: " << snapshots.size() << ", generation: " << generation << std::endl;
+    for (const struct volume_snapshot & snapshot : snapshots) {
+        std::cout << snapshot.id << " - generation " << snapshot.generation << " - " << snapshot.mftItems.size() << " mft items copied" << std::endl;
+    }
+    std::cout << "Held clusters: " << heldClusters.size() << (snapshotReclaim ? " (release pending)" : "");
+    std::cout << ", clusters written copy on write: " << snapshotCopiedClusters << ", mft items copied: " << snapshotCopiedItems;
 }
 
-bool PseudoNTFS::removeDirectory(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex) {
+/* CHANGE TRACKING */
+void PseudoNTFS::initChangeTracking() {
 
-    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || parentDirectoryMftItemIndex < 0 || parentDirectoryMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
-    }
+    // changes of generation stored in boot record made before mount are not known, tracking starts in the next one
+    changeGeneration = bootRecord->change_generation + 1;
+    trackedGeneration = changeGeneration;
+    clusterChanges.assign(bootRecord->cluster_count, 0);
+    mftChanges.assign(mftItemsCount, 0);
+    clusterChangeLog.clear();
+    mftChangeLog.clear();
+}
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+void PseudoNTFS::trackClusterChange(const int index) {
 
-    if (!isDirEmpty(mftItemIndex)) {
-        std::cout << "NOT EMPTY\n";
-        return false;
+    if (clusterChanges[index] != changeGeneration) {
+        clusterChanges[index] = changeGeneration;
+        struct change_record change = {changeGeneration, index};
+        clusterChangeLog.push_back(change);
     }
-    else {
-        removeUidFromDirectory(parentDirectoryMftItemIndex, mftItem->uid);
-        freeMftItem(mftItemIndex); 
-        return true; 
+
+    // changed volume no longer matches image it was restored from
+    if (bootRecord->image_generation != NOT_FOUND) {
+        bootRecord->image_generation = NOT_FOUND;
+        journalBootRecord(&bootRecord->image_generation);
     }
 }
 
-void PseudoNTFS::freeMftItem(const int32_t mftItemIndex) {
+void PseudoNTFS::trackMftItemChange(const int index) {
 
-    if (mftItemIndex < 0 || mftItemIndex > mftItemsCount) {
-        indexOutOfRange = true;
-        return;
+    if (mftChanges[index] != changeGeneration) {
+        mftChanges[index] = changeGeneration;
+        struct change_record change = {changeGeneration, index};
+        mftChangeLog.push_back(change);
     }
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    if (bootRecord->image_generation != NOT_FOUND) {
+        bootRecord->image_generation = NOT_FOUND;
+        journalBootRecord(&bootRecord->image_generation);
+    }
+}
 
-    mftItem->uid = UID_ITEM_FREE;
-    strcpy(mftItem->item_name, "");
-    mftItem->item_size = 0;
-    mftItem->item_order = 0;
-    mftItem->item_order_total = 0;
-    mftItem->isDirectory = false;
-    clearMftItemFragments(mftItem->fragments);
+void PseudoNTFS::findChanges(const std::vector<int32_t> & changes, const std::vector<struct change_record> & log, const int32_t baseGeneration, std::vector<int32_t> * indexes) const {
 
-    freeMftItems++;
+    // log is ordered by generations, changes after base are at its end
+    std::vector<struct change_record>::const_iterator it = std::upper_bound(log.begin(), log.end(), baseGeneration,
+        [](const int32_t generation, const struct change_record & change) {return generation < change.generation;});
+
+    indexes->clear();
+    for (; it != log.end(); it++) {
+        // index changed in more generations is taken once, at its last change
+        if (changes[it->index] == it->generation) {
+            indexes->push_back(it->index);
+        }
+    }
 }
 
-void PseudoNTFS::freeMftItemWithData(const int32_t mftItemIndex) {
+/* VOLUME IMAGE */
+void PseudoNTFS::findImageRuns(const int32_t baseGeneration, std::vector<struct image_run> * runs, std::vector<struct image_run> * freeRuns) {
 
-    if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
+    // clusters held only for snapshots are not part of volume
+    spaceIndex.wait();
+    std::unordered_set<int32_t> held;
+    for (const struct held_cluster & cluster : heldClusters) {
+        held.insert(cluster.index);
+    }
+
+    auto append = [](std::vector<struct image_run> * list, const int32_t index) {
+        if (!list->empty() && list->back().start + list->back().count == index) {
+            list->back().count++;
+        }
+        else {
+            struct image_run run = {index, 1};
+            list->push_back(run);
+        }
+    };
+
+    runs->clear();
+    freeRuns->clear();
+
+    // only changed clusters are looked at, incremental image costs as much as the changes
+    if (baseGeneration != NOT_FOUND) {
+        std::vector<int32_t> changed;
+        findChanges(clusterChanges, clusterChangeLog, baseGeneration, &changed);
+        std::sort(changed.begin(), changed.end());
+        for (int32_t index : changed) {
+            append(isClusterFree(index) || held.count(index) > 0 ? freeRuns : runs, index);
+        }
         return;
     }
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    for (int32_t i = 0; i < bootRecord->cluster_count; i++) {
 
-    for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
-        if (mftItem->fragments[i].fragment_count != 0) {
-            clearClusterData(mftItem->fragments[i].fragment_start_address, mftItem->fragments[i].fragment_count);
+        // bytes of free clusters are skipped at once
+        if (i % 8 == 0 && bitmapStart[i / 8] == 0) {
+            i += 7;
+            continue;
+        }
+        if ((bitmapStart[i / 8] & (128 >> (i % 8))) && (held.empty() || held.count(i) == 0)) {
+            append(runs, i);
         }
     }
-
-    freeMftItem(mftItemIndex);
 }
 
-void PseudoNTFS::removeUidFromDirectory(const int32_t directoryMftItemIndex, int32_t uid) {
+int32_t PseudoNTFS::exportImage(const char * imagePath, const int32_t baseGeneration) {
 
-    if (directoryMftItemIndex < 0 || directoryMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return;
+    Transaction transaction(this);
+
+    // files held in memory get their clusters first, image has their data
+    flushDelayedFiles();
+
+    // changes are known only since mount, base image must be made after it
+    if (baseGeneration != NOT_FOUND && (baseGeneration < trackedGeneration || baseGeneration >= changeGeneration)) {
+        std::cout << "GENERATION NOT TRACKED";
+        return NOT_FOUND;
     }
 
-    struct mft_item * mftItem = &mftItemStart[directoryMftItemIndex];
+    int file = open(imagePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        std::cout << "CANNOT CREATE IMAGE";
+        return NOT_FOUND;
+    }
 
-    for (int i =0; i < MFT_FRAGMENTS_COUNT; i++) {
-        if (removeUid(mftItem->fragments[i].fragment_start_address, mftItem->fragments[i].fragment_count, uid)) {
-            mftItem->item_size -= sizeof(int32_t);
-            break;
+    // full image has used mft items, incremental one changed items, free ones too
+    std::vector<int32_t> items;
+    if (baseGeneration == NOT_FOUND) {
+        const MftHotTable * table = hot();
+        for (int i = 0; i < mftItemsCount; i++) {
+            if (table->getUid(i) != UID_ITEM_FREE) {
+                items.push_back(i);
+            }
         }
     }
-}
+    else {
+        findChanges(mftChanges, mftChangeLog, baseGeneration, &items);
+        std::sort(items.begin(), items.end());
+    }
 
-bool PseudoNTFS::removeUid(int32_t startIndex, int32_t clusterCount, int32_t uid) {
-   
-    if (startIndex < 0 || startIndex >= bootRecord->cluster_count || startIndex + clusterCount > bootRecord->cluster_count) {
-        indexOutOfRange = true;
-        return false;
+    std::vector<struct image_run> runs, freeRuns;
+    findImageRuns(baseGeneration, &runs, &freeRuns);
+
+    struct image_header header;
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_VERSION;
+    header.base_generation = baseGeneration;
+    header.generation = changeGeneration;
+    header.mft_items_count = items.size();
+    header.runs_count = runs.size();
+    header.free_runs_count = freeRuns.size();
+    header.clusters_count = 0;
+    for (const struct image_run & run : runs) {
+        header.clusters_count += run.count;
     }
 
-    int32_t * tempUid = (int32_t *)&dataStart[startIndex * bootRecord->cluster_size]; 
+    // image is written sequentially in large chunks
+    int64_t offset = 0;
+    bool written = true;
+    auto append = [&](const void * data, const int64_t length) {
+        written = written && writeFileAt(file, offset, (const unsigned char *) data, length);
+        offset += length;
+    };
+
+    append(&header, sizeof(header));
+    append(bootRecord, sizeof(boot_record));
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t chunkClusters = std::max(IMAGE_CHUNK_SIZE / clusterSize, 1);
+    unsigned char * chunk = new unsigned char[(int64_t) chunkClusters * clusterSize];
+
+    int32_t chunkItems = (int64_t) chunkClusters * clusterSize / sizeof(image_mft_item);
+    struct image_mft_item * records = (struct image_mft_item *) chunk;
+    int32_t count = 0;
+    for (int32_t index : items) {
+        records[count].index = index;
+        records[count].item = mftItemStart[index];
+        if (++count == chunkItems) {
+            append(records, count * sizeof(image_mft_item));
+            count = 0;
+        }
+    }
+    append(records, count * sizeof(image_mft_item));
 
-    bool removed = false;
-    int32_t indexOfRemoved, indexOfLastFilled;
-    int32_t bound = clusterCount * bootRecord->cluster_count / sizeof(int32_t);
-    for (int i = 0; i < bound; i++) {
-        if (tempUid[i] == uid) {
-            tempUid[i] = 0;
-            removed = true;
+    for (const struct image_run & run : runs) {
+        append(&run, sizeof(run));
+        append(&checksumStart[run.start], run.count * sizeof(uint32_t));
+
+        for (int32_t i = run.start; i < run.start + run.count && written; i += chunkClusters) {
+            int32_t clusters = std::min(chunkClusters, run.start + run.count - i);
+            // clusters of volume in memory are written in place, cached volume is read by whole chunks
+            if (cache == NULL) {
+                append(&dataStart[(int64_t) i * clusterSize], (int64_t) clusters * clusterSize);
+                continue;
+            }
+            cache->readClusters(i, clusters, chunk);
+            append(chunk, (int64_t) clusters * clusterSize);
         }
-        else if (tempUid[i] != 0) {
-            indexOfLastFilled = i;
-        }   
+    }
+    for (const struct image_run & run : freeRuns) {
+        append(&run, sizeof(run));
     }
 
-    if (removed && indexOfLastFilled != 0) {
-        tempUid[indexOfRemoved] = tempUid[indexOfLastFilled];
+    delete [] chunk;
+    close(file);
+
+    if (!written) {
+        std::cout << "CANNOT WRITE IMAGE";
+        return NOT_FOUND;
     }
-    
-    return false;
+
+    // changes made after image belong to next generation
+    int32_t imageGeneration = changeGeneration++;
+    bootRecord->change_generation = changeGeneration;
+    journalBootRecord(&bootRecord->change_generation);
+
+    return imageGeneration;
 }
 
-bool PseudoNTFS::move(const int32_t fileMftItemIndex, const int32_t fromMftItemIndex, const int32_t toMftItemIndex) {
+bool PseudoNTFS::readImageBootRecord(const char * imagePath, struct boot_record * br) {
 
-    if (fileMftItemIndex < 0 || fileMftItemIndex >= mftItemsCount ||
-        fromMftItemIndex < 0 || fromMftItemIndex >= mftItemsCount ||
-        toMftItemIndex < 0 || fromMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
+    int file = open(imagePath, O_RDONLY);
+    if (file < 0) {
         return false;
     }
 
-    struct mft_item * mftItem = &mftItemStart[fileMftItemIndex];
+    struct image_header header;
+    bool read = readFileAt(file, 0, (unsigned char *) &header, sizeof(header))
+        && readFileAt(file, sizeof(header), (unsigned char *) br, sizeof(boot_record));
+    close(file);
+
+    br->signature[sizeof(br->signature) - 1] = '\0';
+    return read && memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) == 0 && header.version == IMAGE_VERSION && isVolumeFormat(br);
+}
 
-    if (contains(toMftItemIndex, mftItem->item_name, false) != NOT_FOUND) {
-        std::cout << "FILE WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
+bool PseudoNTFS::importImage(const char * imagePath) {
+
+    // bitmap is written directly, no file may hold reserved clusters
+    AllocationGroups::Freeze freeze(&allocationGroups);
+    std::lock_guard<std::mutex> lock(operationMutex);
+    waitIndexes();
+
+    struct boot_record br;
+    if (!readImageBootRecord(imagePath, &br)) {
+        std::cout << "INVALID IMAGE";
+        return false;
+    }
+    if (br.cluster_size != bootRecord->cluster_size || br.cluster_count != bootRecord->cluster_count
+        || (br.bitmap_start_address - br.mft_start_address) / (int64_t) sizeof(mft_item) != mftItemsCount) {
+        std::cout << "IMAGE DOES NOT MATCH VOLUME";
         return false;
     }
 
-    if (contains(toMftItemIndex, mftItem->item_name, true) != NOT_FOUND) {
-        std::cout << "DIRECTORY WITH GIVEN NAME ALREADY EXISTS IN DESTINATION DIRECTORY";
+    int file = open(imagePath, O_RDONLY);
+    struct image_header header;
+    readFileAt(file, 0, (unsigned char *) &header, sizeof(header));
+    bool incremental = header.base_generation != NOT_FOUND;
+
+    // full image is written over clusters never used, so nothing of them is cached or journaled
+    if (!incremental && (snapshotOrigin != NULL || hotTable.countFree() != mftItemsCount - 1 || allocationGroups.getFreeClusters() != bootRecord->cluster_count)) {
+        std::cout << "VOLUME IS NOT EMPTY";
+        close(file);
+        return false;
+    }
+    // incremental image follows image volume was restored from, volume must not be changed since
+    if (incremental && (snapshotOrigin != NULL || !snapshots.empty() || bootRecord->image_generation != header.base_generation)) {
+        std::cout << "IMAGE DOES NOT FOLLOW VOLUME";
+        close(file);
         return false;
     }
 
-    if (saveUid(toMftItemIndex, mftItem->uid)) {
-        removeUidFromDirectory(fromMftItemIndex, mftItem->uid);
-        return true;
+    // changed metadata are written at once, not through journal
+    auto persist = [&](const void * data, const int64_t length) {
+        if (volumeFile >= 0) {
+            writeFileAt(volumeFile, (const unsigned char *) data - ntfs, (const unsigned char *) data, length);
+        }
+    };
+
+    // volume partly changed by failed import matches no image
+    if (incremental) {
+        bootRecord->image_generation = NOT_FOUND;
+        persist(&bootRecord->image_generation, sizeof(int32_t));
+        if (volumeFile >= 0) {
+            fsync(volumeFile);
+        }
     }
 
-    return false;
-}
+    int64_t offset = sizeof(header) + sizeof(boot_record);
+    bool valid = true;
+    auto consume = [&](void * data, const int64_t length) {
+        valid = valid && readFileAt(file, offset, (unsigned char *) data, length);
+        offset += length;
+    };
+
+    // runs of free clusters follow changes of bitmap
+    auto mark = [&](const int32_t index, const bool allocated) {
+        unsigned char bit = 128 >> (index % 8);
+        if (((bitmapStart[index / 8] & bit) != 0) == allocated) {
+            return;
+        }
+        bitmapStart[index / 8] ^= bit;
+        if (allocated) {
+            allocationGroups.allocate(index);
+            clusterGenerations[index] = generation;
+        }
+        else {
+            allocationGroups.release(index);
+        }
+    };
+
+    int32_t clusterSize = bootRecord->cluster_size;
+    int32_t chunkClusters = std::max(IMAGE_CHUNK_SIZE / clusterSize, 1);
+    unsigned char * chunk = new unsigned char[(int64_t) chunkClusters * clusterSize];
+
+    int32_t chunkItems = (int64_t) chunkClusters * clusterSize / sizeof(image_mft_item);
+    struct image_mft_item * records = (struct image_mft_item *) chunk;
+    for (int32_t i = 0; i < header.mft_items_count && valid; i += chunkItems) {
+        int32_t count = std::min(chunkItems, header.mft_items_count - i);
+        consume(records, count * sizeof(image_mft_item));
+        for (int32_t j = 0; j < count && valid; j++) {
+            int32_t index = records[j].index;
+            valid = index >= 0 && index < mftItemsCount;
+            if (!valid) {
+                break;
+            }
+            freeMftItems -= mftItemStart[index].uid == UID_ITEM_FREE;
+            mftItemStart[index] = records[j].item;
+            freeMftItems += mftItemStart[index].uid == UID_ITEM_FREE;
+            uidCounter = std::max(uidCounter, mftItemStart[index].uid + 1);
+            hotTable.update(index, &mftItemStart[index]);
+            trackMftItemChange(index);
+            if (incremental) {
+                persist(&mftItemStart[index], sizeof(mft_item));
+            }
+        }
+    }
 
-bool PseudoNTFS::removeFile(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex) {
+    bool corrupted = false;
+    for (int32_t r = 0; r < header.runs_count && valid; r++) {
+        struct image_run run;
+        consume(&run, sizeof(run));
+        valid = valid && run.start >= 0 && run.count > 0 && (int64_t) run.start + run.count <= bootRecord->cluster_count;
+        if (!valid) {
+            break;
+        }
+        consume(&checksumStart[run.start], run.count * sizeof(uint32_t));
+
+        for (int32_t i = run.start; i < run.start + run.count && valid; i += chunkClusters) {
+            int32_t clusters = std::min(chunkClusters, run.start + run.count - i);
+            int64_t length = (int64_t) clusters * clusterSize;
+            consume(chunk, length);
+            for (int32_t j = 0; j < clusters && valid; j++) {
+                corrupted = !verifyClusterChecksum(i + j, &chunk[(int64_t) j * clusterSize]);
+                valid = !corrupted;
+            }
+            if (!valid) {
+                break;
+            }
 
-     if (mftItemIndex < 0 || mftItemIndex >= mftItemsCount || parentDirectoryMftItemIndex < 0 || parentDirectoryMftItemIndex >= mftItemsCount) {
-        indexOutOfRange = true;
-        return false;
+            // clusters of empty cached volume go to its host file directly, changed ones through cache
+            if (cache == NULL) {
+                memcpy(&dataStart[(int64_t) i * clusterSize], chunk, length);
+                if (incremental) {
+                    persist(&dataStart[(int64_t) i * clusterSize], length);
+                }
+            }
+            else if (!incremental) {
+                valid = writeFileAt(volumeFile, clusterOffset(i), chunk, length);
+            }
+            else {
+                for (int32_t j = 0; j < clusters; j++) {
+                    memcpy(cache->getCluster(i + j), &chunk[(int64_t) j * clusterSize], clusterSize);
+                    cache->markDirty(i + j);
+                }
+            }
+
+            for (int32_t j = i; j < i + clusters; j++) {
+                mark(j, true);
+                trackClusterChange(j);
+            }
+        }
+
+        if (incremental) {
+            persist(&checksumStart[run.start], run.count * sizeof(uint32_t));
+            persist(&bitmapStart[run.start / 8], (run.start + run.count - 1) / 8 - run.start / 8 + 1);
+        }
     }
 
-    struct mft_item * mftItem = &mftItemStart[mftItemIndex];
+    // freed clusters are cleared as by release of cluster
+    memset(chunk, 0, clusterSize);
+    uint32_t emptyChecksum = crc32c(chunk, clusterSize);
+    for (int32_t r = 0; r < header.free_runs_count && valid; r++) {
+        struct image_run run;
+        consume(&run, sizeof(run));
+        valid = valid && run.start >= 0 && run.count > 0 && (int64_t) run.start + run.count <= bootRecord->cluster_count;
+        if (!valid) {
+            break;
+        }
 
-    freeMftItemWithData(mftItemIndex);
-    removeUidFromDirectory(parentDirectoryMftItemIndex, mftItem->uid);
-    return true;
-}
+        for (int32_t i = run.start; i < run.start + run.count; i++) {
+            memset(clusterData(i), 0, clusterSize);
+            if (cache != NULL) {
+                cache->markDirty(i);
+            }
+            else {
+                persist(clusterData(i), clusterSize);
+            }
+            checksumStart[i] = emptyChecksum;
+            mark(i, false);
+            trackClusterChange(i);
+        }
+        persist(&checksumStart[run.start], run.count * sizeof(uint32_t));
+        persist(&bitmapStart[run.start / 8], (run.start + run.count - 1) / 8 - run.start / 8 + 1);
+    }
 
-void PseudoNTFS::clearClusterData(const int startIndex, const int32_t clustersCount) {
+    delete [] chunk;
+    close(file);
 
-    if (startIndex < 0 || startIndex + clustersCount > bootRecord->cluster_count - 1) {
-        indexOutOfRange = true;
-        return;
+    if (!valid) {
+        std::cout << (corrupted ? "IMAGE IS CORRUPTED" : "INVALID IMAGE");
+        return false;
     }
 
-    // clear cluster data
-    memset(&dataStart[startIndex * bootRecord->cluster_size], 0, clustersCount * bootRecord->cluster_size);
+    // restored volume matches image, next incremental image can follow it
+    bootRecord->image_generation = header.generation;
+    // saved name index came with mft items of image, index is loaded from it on first use
+    bootRecord->name_index_item = br.name_index_item;
+    bootRecord->name_index_stamp = br.name_index_stamp;
+    nameIndexBuilt = false;
+    nameIndexDirty = false;
+
+    if (volumeFile >= 0) {
+        // rest of volume was written by format
+        if (!incremental) {
+            int32_t lastItem = 0;
+            for (int32_t i = 0; i < mftItemsCount; i++) {
+                lastItem = mftItemStart[i].uid != UID_ITEM_FREE ? i : lastItem;
+            }
+            persist(mftItemStart, (lastItem + 1) * sizeof(mft_item));
+            persist(bitmapStart, (int64_t) ceil(bootRecord->cluster_count / 8.0));
+            persist(checksumStart, (int64_t) bootRecord->cluster_count * sizeof(uint32_t));
+            // volume without cache has data clusters in memory
+            if (cache == NULL) {
+                persist(dataStart, (int64_t) bootRecord->cluster_count * bootRecord->cluster_size);
+            }
+        }
+        persist(bootRecord, sizeof(boot_record));
+        if (cache != NULL) {
+            cache->flush();
+        }
+        fsync(volumeFile);
+    }
 
-    for (int i = startIndex; i < clustersCount; i++) {
-        setBitmap(i, false);
+    {
+        std::lock_guard<std::mutex> lock(extentMapsMutex);
+        extentMaps.clear();
     }
-}
 
-/* ADVANCE FUNCTIONS */
+    // indexes of full image are built again, incremental image updated them cluster by cluster
+    if (!incremental) {
+        buildIndexes();
+        return true;
+    }
+
+    firstFreeMftItem = 0;
+    referencesIndex.build([this]() {
+        initSharedReferences();
+    });
+    if (deduplication) {
+        buildDeduplicationIndex();
+    }
+
+    return true;
+}
 
 /* CONSISTENCY */
-bool PseudoNTFS::checkDiskConsistency() {
+bool PseudoNTFS::checkDiskConsistency(const bool countBytes, const bool verifyClusters) {
+
+    // files held in memory have no data clusters to check yet
+    sync();
+    checkBytes = countBytes;
+    checkChecksums = verifyClusters;
 
     // INIT
     std::thread slaves[SLAVES_COUNT];
@@ -908,6 +4628,8 @@ bool PseudoNTFS::checkDiskConsistency() {
     isCorrupted = false;
     lastCheckedMftItemIndex = 0;
 
+    checkSharedReferences();
+
     // consistencyCheckSlave();
     for (int i = 0; i < SLAVES_COUNT; i++) {
         
@@ -922,6 +4644,70 @@ bool PseudoNTFS::checkDiskConsistency() {
 
 }
 
+bool PseudoNTFS::scrub(std::vector<int32_t> * corrupted) {
+
+    // files held in memory have no data clusters to scrub yet
+    sync();
+    std::lock_guard<std::mutex> lock(operationMutex);
+
+    const int32_t clustersPerTask = 1024;
+    int32_t threadsCount = std::max((int32_t) std::thread::hardware_concurrency(), 1);
+    std::vector<std::vector<int32_t>> found(threadsCount);
+    std::atomic<int32_t> nextCluster(0);
+
+    // threads take ranges of clusters until all are checked, every thread reads to its own buffer
+    std::vector<std::thread> threads;
+    for (int32_t t = 0; t < threadsCount; t++) {
+        threads.push_back(std::thread([this, t, &found, &nextCluster, clustersPerTask]() {
+            unsigned char * cluster = new unsigned char[bootRecord->cluster_size];
+            int32_t start;
+            while ((start = nextCluster.fetch_add(clustersPerTask)) < bootRecord->cluster_count) {
+                for (int32_t i = start; i < std::min(start + clustersPerTask, bootRecord->cluster_count); i++) {
+                    if (isClusterFree(i)) {
+                        continue;
+                    }
+                    const unsigned char * data = cluster;
+                    if (cache == NULL) {
+                        data = &dataStart[(int64_t) i * bootRecord->cluster_size];
+                    }
+                    else {
+                        cache->readCluster(i, cluster);
+                    }
+                    if (!verifyClusterChecksum(i, data)) {
+                        found[t].push_back(i);
+                    }
+                }
+            }
+            delete [] cluster;
+        }));
+    }
+
+    for (std::thread & thread : threads) {
+        thread.join();
+    }
+
+    corrupted->clear();
+    for (const std::vector<int32_t> & clusters : found) {
+        corrupted->insert(corrupted->end(), clusters.begin(), clusters.end());
+    }
+    std::sort(corrupted->begin(), corrupted->end());
+
+    return corrupted->empty();
+}
+
+void PseudoNTFS::checkSharedReferences() {
+
+    std::vector<int32_t> references;
+    countClusterReferences(&references);
+
+    for (int i = 0; i < bootRecord->cluster_count; i++) {
+        if (clusterReferences()[i] != std::max(references[i] - 1, 0)) {
+            isCorrupted = true;
+            return;
+        }
+    }
+}
+
 bool PseudoNTFS::getMftItemsToCheck(int32_t * mftItemStartIndex, int32_t * mftItemEndIndex) {
 
     bool isWorkToDo = true;
@@ -931,7 +4717,7 @@ bool PseudoNTFS::getMftItemsToCheck(int32_t * mftItemStartIndex, int32_t * mftIt
     }
     else {
         *mftItemStartIndex = lastCheckedMftItemIndex;
-        *mftItemEndIndex = lastCheckedMftItemIndex + MFT_ITEMS_PER_SLAVE;
+        *mftItemEndIndex = std::min(lastCheckedMftItemIndex + MFT_ITEMS_PER_SLAVE, mftItemsCount);
         lastCheckedMftItemIndex += MFT_ITEMS_PER_SLAVE; 
     }
     sem_post(&semaphore);
@@ -942,28 +4728,97 @@ bool PseudoNTFS::getMftItemsToCheck(int32_t * mftItemStartIndex, int32_t * mftIt
 void PseudoNTFS::consistencyCheckSlave() {
 
     struct mft_item * mftItem = mftItemStart;
-    int32_t mftItemStartIndex, mftItemEndIndex, size;
+    int32_t mftItemStartIndex, mftItemEndIndex, size, clusters;
     int32_t (PseudoNTFS::*checkDataFragmentUsedSize)(int32_t, int32_t) = NULL;
+    const MftHotTable * table = hot();
 
     while (getMftItemsToCheck(&mftItemStartIndex, &mftItemEndIndex)) {
 
         for (int i = mftItemStartIndex; i < mftItemEndIndex; i++) {
 
+            // next mft items of file are checked together with its first one
+            if (table->getUid(i) != UID_ITEM_FREE && !(table->getFlags(i) & MFT_HOT_FIRST)) {
+                continue;
+            }
+
+            if (mftItem[i].uid != UID_ITEM_FREE && !checkMftItemChain(i)) {
+                isCorrupted = true;
+                continue;
+            }
+
+            // compressed data contain zeros, file is consistent if it decompresses to its size
+            if (mftItem[i].uid != UID_ITEM_FREE && !mftItem[i].isDirectory && (mftItem[i].item_flags & MFT_ITEM_COMPRESSED)) {
+                std::string content;
+                if (!checkFragmentsRange(i) || (checkBytes && !loadCompressedData(i, &content))) {
+                    isCorrupted = true;
+                }
+                continue;
+            }
+
             size = 0;
-            if (mftItem[i].isDirectory) {
+            clusters = 0;
+            if (mftItem[i].item_flags & MFT_ITEM_RESIDENT) {
+                // resident data are checked like data in data clusters
+                const char * data = (const char *) mftItem[i].fragments;
+                for (int j = 0; j < MFT_RESIDENT_SIZE; j++) {
+                    size += data[j] != 0;
+                }
+                if (size > mftItem[i].item_size || mftItem[i].item_size > MFT_RESIDENT_SIZE) {
+                    isCorrupted = true;
+                }
+                continue;
+            }
+            else if (mftItem[i].isDirectory) {
                 checkDataFragmentUsedSize = &PseudoNTFS::getDirectoryDataFragmentUsedSize; 
             }
-            else {
+            else if (checkBytes) {
                 checkDataFragmentUsedSize = &PseudoNTFS::getFileDataFragmentUsedSize;
             }
+            else {
+                checkDataFragmentUsedSize = &PseudoNTFS::getFileDataFragmentRange;
+            }
 
-            for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
-                if (mftItem[i].fragments[j].fragment_count != 0) {
-                    size += (this->*checkDataFragmentUsedSize)(mftItem[i].fragments[j].fragment_start_address, mftItem[i].fragments[j].fragment_count);
+            // content of unwritten clusters of preallocated file is not defined, only their range is checked
+            int32_t countedClusters = INT32_MAX;
+            if (!mftItem[i].isDirectory && (mftItem[i].item_flags & MFT_ITEM_PREALLOCATED)) {
+                countedClusters = clustersOf(mftItem[i].item_valid);
+            }
+
+            for (int32_t index = i; index != NOT_FOUND; index = nextMftItem(index)) {
+                for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+                    if (mftItem[index].fragments[j].fragment_count != 0 && mftItem[index].fragments[j].fragment_start_address != EXTENT_HOLE) {
+                        int32_t start = mftItem[index].fragments[j].fragment_start_address;
+                        int32_t count = mftItem[index].fragments[j].fragment_count;
+                        int32_t counted = std::max(0, std::min(count, countedClusters - clusters));
+                        int32_t used = counted > 0 ? (this->*checkDataFragmentUsedSize)(start, counted) : 0;
+                        if (counted < count && getFileDataFragmentRange(start + counted, count - counted) < 0) {
+                            used = -1;
+                        }
+                        if (checkChecksums && getDataFragmentChecksums(start, count) < 0) {
+                            used = -1;
+                        }
+                        // fragment out of disk or damaged directory block
+                        if (used < 0) {
+                            isCorrupted = true;
+                        }
+                        size += used;
+                    }
+                    clusters += mftItem[index].fragments[j].fragment_count;
                 }
             }
 
-            if (mftItem[i].item_size != size) {
+            if (mftItem[i].isDirectory && mftItem[i].item_size != size) {
+                isCorrupted = true;
+            }
+
+            // file written at offsets can hold zeros, its size has to fit its data clusters and holes
+            // preallocated file can have clusters reserved behind its end, its written data end in front of it
+            bool preallocated = mftItem[i].item_flags & MFT_ITEM_PREALLOCATED;
+            if (!mftItem[i].isDirectory && (size > mftItem[i].item_size || mftItem[i].item_size > clusters * bootRecord->cluster_size
+                || (!preallocated && mftItem[i].item_size <= (clusters - 1) * bootRecord->cluster_size))) {
+                isCorrupted = true;
+            }
+            if (preallocated && (mftItem[i].item_valid < 0 || mftItem[i].item_valid > mftItem[i].item_size)) {
                 isCorrupted = true;
             }
         }
@@ -971,48 +4826,154 @@ void PseudoNTFS::consistencyCheckSlave() {
 
 }
 
+bool PseudoNTFS::checkMftItemChain(const int32_t mftItemIndex) const {
+
+    const struct mft_item * first = &mftItemStart[mftItemIndex];
+    int32_t order = 1;
+
+    // item order total bounds the walk, so cycle in chain cannot hang the check
+    for (int32_t index = nextMftItem(mftItemIndex); index != NOT_FOUND; index = nextMftItem(index)) {
+        order++;
+        if (order > first->item_order_total || mftItemStart[index].uid != first->uid || mftItemStart[index].item_order != order) {
+            return false;
+        }
+    }
+
+    return order == first->item_order_total;
+}
+
 int32_t PseudoNTFS::getFileDataFragmentUsedSize(int32_t dataClusterStartIndex, int32_t dataClustersCount) {
 
-    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount >= bootRecord->cluster_count) {
+    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount > bootRecord->cluster_count) {
         indexOutOfRange = true;
         return -1;
     }
 
-    unsigned char * dataCluster = &dataStart[dataClusterStartIndex * bootRecord->cluster_size];
+    // without cache clusters are counted in place, data clusters of checked files are not written during check
+    if (cache == NULL) {
+        return countNonZero(&dataStart[(int64_t) dataClusterStartIndex * bootRecord->cluster_size], (int64_t) dataClustersCount * bootRecord->cluster_size);
+    }
+
+    // checker threads run in parallel, they work on copies of clusters
+    unsigned char * dataCluster = new unsigned char[bootRecord->cluster_size];
 
     int32_t size = 0;
-    for (int i = 0; i < dataClustersCount * bootRecord->cluster_size; i++) {
-        if (dataCluster[i] != 0) {
-            size++;
-        }
+    for (int i = dataClusterStartIndex; i < dataClusterStartIndex + dataClustersCount; i++) {
+        getClusterData(i, dataCluster);
+        size += countNonZero(dataCluster, bootRecord->cluster_size);
     }
 
+    delete [] dataCluster;
     return size;
 }
 
-int32_t PseudoNTFS::getDirectoryDataFragmentUsedSize(int32_t dataClusterStartIndex, int32_t dataClustersCount) {
+int32_t PseudoNTFS::getFileDataFragmentRange(int32_t dataClusterStartIndex, int32_t dataClustersCount) {
+
+    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount > bootRecord->cluster_count) {
+        indexOutOfRange = true;
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t PseudoNTFS::getDataFragmentChecksums(int32_t dataClusterStartIndex, int32_t dataClustersCount) {
 
-    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount >= bootRecord->cluster_count) {
+    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount > bootRecord->cluster_count) {
         indexOutOfRange = true;
         return -1;
     }
 
-    int32_t * dataCluster = (int32_t *) &dataStart[dataClusterStartIndex * bootRecord->cluster_size];
+    // checker threads run in parallel, with cache they work on copies of clusters
+    unsigned char * dataCluster = cache == NULL ? NULL : new unsigned char[bootRecord->cluster_size];
+
+    int32_t result = 0;
+    for (int i = dataClusterStartIndex; i < dataClusterStartIndex + dataClustersCount && result == 0; i++) {
+        const unsigned char * data = &dataStart[(int64_t) i * bootRecord->cluster_size];
+        if (cache != NULL) {
+            getClusterData(i, dataCluster);
+            data = dataCluster;
+        }
+        if (!verifyClusterChecksum(i, data)) {
+            result = -1;
+        }
+    }
+
+    delete [] dataCluster;
+    return result;
+}
+
+bool PseudoNTFS::checkFragmentsRange(const int32_t mftItemIndex) {
+
+    int32_t (PseudoNTFS::*checkFragment)(int32_t, int32_t) = checkChecksums ? &PseudoNTFS::getDataFragmentChecksums : &PseudoNTFS::getFileDataFragmentRange;
+
+    for (int32_t index = mftItemIndex; index != NOT_FOUND; index = nextMftItem(index)) {
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            const struct mft_fragment * fragment = &mftItemStart[index].fragments[j];
+            if (fragment->fragment_count != 0 && fragment->fragment_start_address != EXTENT_HOLE
+                && (this->*checkFragment)(fragment->fragment_start_address, fragment->fragment_count) < 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int32_t PseudoNTFS::getDirectoryDataFragmentUsedSize(int32_t dataClusterStartIndex, int32_t dataClustersCount) {
+
+    if (dataClusterStartIndex < 0 || dataClusterStartIndex + dataClustersCount > bootRecord->cluster_count) {
+        indexOutOfRange = true;
+        return -1;
+    }
 
-    int32_t bound = dataClustersCount * bootRecord->cluster_size / sizeof(int32_t);
+    unsigned char * dataCluster = new unsigned char[bootRecord->cluster_size];
+    const struct directory_block * header = (const struct directory_block *) dataCluster;
+    const unsigned char * records = dataCluster + sizeof(directory_block);
 
     int32_t size = 0;
-    for (int i = 0; i < bound; i++) {
-        if (dataCluster[i] != 0) {
-            size += sizeof(int32_t);
+    for (int i = dataClusterStartIndex; i < dataClusterStartIndex + dataClustersCount; i++) {
+        getClusterData(i, dataCluster);
+
+        // block with more records than fit to it, or with unsorted ones cannot be searched
+        if (header->level < 0 || header->level >= DIRECTORY_MAX_DEPTH || header->entries_count < 0 || header->entries_count > directoryBlockCapacity(header->level)) {
+            size = -1;
+            break;
+        }
+        int32_t recordSize = directoryRecordSize(header->level);
+        for (int j = 1; j < header->entries_count; j++) {
+            if (strncmp((const char *) records + (j - 1) * recordSize, (const char *) records + j * recordSize, sizeof(directory_entry::name)) >= 0) {
+                size = -1;
+            }
+        }
+        if (size < 0) {
+            break;
+        }
+
+        // only leaves hold entries of directory
+        if (header->level == 0) {
+            size += header->entries_count * sizeof(directory_entry);
         }
     }
 
+    delete [] dataCluster;
     return size;
 }
 
 /* DEFRAGMENTATION */
 void PseudoNTFS::defragmentDisk() {
+
+    // clusters are moved over whole volume, no file may hold reserved clusters
+    AllocationGroups::Freeze freeze(&allocationGroups);
+    Transaction transaction(this);
+
+    // clusters are moved in place, snapshots would lose their content
+    if (!snapshots.empty()) {
+        std::cout << "VOLUME HAS SNAPSHOTS";
+        return;
+    }
+
+    flushDelayedFiles();
     
     int32_t * indexTable = new int32_t[bootRecord->cluster_count];
     prepareIndexTable(indexTable);
@@ -1021,33 +4982,91 @@ void PseudoNTFS::defragmentDisk() {
     //     std::cout <<  indexTable[i] << " ";
     // }
 
+    // fragments are counted before clusters are moved, moving changes index table
+    std::vector<std::list<struct mft_fragment>> fragments;
+    if (!defragmentPrepareFragments(indexTable, &fragments)) {
+        std::cout << "DISK CANNOT BE DEFRAGMENTED";
+        delete [] indexTable;
+        return;
+    }
+    int32_t * newIndexes = new int32_t[bootRecord->cluster_count];
+    memcpy(newIndexes, indexTable, bootRecord->cluster_count * sizeof(int32_t));
+
     for (int i = 0; i < bootRecord->cluster_count; i++) {
         defragment(indexTable, i);
     }
 
     initBitmap();
-    defragmentUpdateMftTable();
+    defragmentUpdateMftTable(&fragments, newIndexes);
     
     delete [] indexTable;
+    delete [] newIndexes;
 }
 
-void PseudoNTFS::defragmentUpdateMftTable() {
+bool PseudoNTFS::defragmentPrepareFragments(const int32_t indexTable[], std::vector<std::list<struct mft_fragment>> * fragments) {
+
     struct mft_item * mftItem = mftItemStart;
+    fragments->assign(mftItemsCount, std::list<struct mft_fragment>());
+    const MftHotTable * table = hot();
+
+    for (int i = 0; i < mftItemsCount; i++) {
+
+        if ((table->getSize(i) == 0 && !(table->getFlags(i) & MFT_ITEM_PREALLOCATED)) || (table->getFlags(i) & MFT_ITEM_RESIDENT)) {
+            continue;
+        }
+
+        for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
+            int32_t startIndex = mftItem[i].fragments[j].fragment_start_address;
+            if (startIndex == EXTENT_HOLE) {
+                appendFragment(&(*fragments)[i], EXTENT_HOLE, mftItem[i].fragments[j].fragment_count);
+                continue;
+            }
+            for (int32_t k = startIndex; k < startIndex + mftItem[i].fragments[j].fragment_count; k++) {
+                appendFragment(&(*fragments)[i], indexTable[k]);
+            }
+        }
 
-    int32_t start = 0, count;
+        // shared cluster moved with another mft item can split fragment
+        if ((*fragments)[i].size() > (size_t) MFT_FRAGMENTS_COUNT) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PseudoNTFS::defragmentUpdateMftTable(const std::vector<std::list<struct mft_fragment>> * fragments, const int32_t indexTable[]) {
+    struct mft_item * mftItem = mftItemStart;
 
     for (int i = 0; i < mftItemsCount; i++) {
-        count = ceil(mftItem[i].item_size / (double) bootRecord->cluster_size);
+
+        // resident data do not move
+        if (mftItem[i].item_flags & MFT_ITEM_RESIDENT) {
+            continue;
+        }
 
         clearMftItemFragments(mftItem[i].fragments);
-        mftItem[i].fragments[0].fragment_start_address = start;
-        mftItem[i].fragments[0].fragment_count = count;
-       
-        for (int j = start; j < start + count; j++) {
-            setBitmap(j, true);
+        int j = 0;
+        for (const mft_fragment & fragment : (*fragments)[i]) {
+            mftItem[i].fragments[j++] = fragment;
+            for (int k = fragment.fragment_start_address; k < fragment.fragment_start_address + fragment.fragment_count && fragment.fragment_start_address != EXTENT_HOLE; k++) {
+                setBitmap(k, true);
+            }
+        }
+        journalMftItem(i);
+    }
+
+    // shared references move with clusters
+    std::vector<int32_t> references(bootRecord->cluster_count, 0);
+    for (int i = 0; i < bootRecord->cluster_count; i++) {
+        if (indexTable[i] != -1) {
+            references[indexTable[i]] = clusterReferences()[i];
         }
+    }
+    clusterReferences().swap(references);
 
-         start += count;
+    if (deduplication) {
+        buildDeduplicationIndex();
     }
 }
 
@@ -1060,17 +5079,17 @@ void PseudoNTFS::prepareIndexTable(int32_t indexTable[]) {
         indexTable[i] = -1;
     }
 
+    const MftHotTable * table = hot();
     for (int i = 0; i < mftItemsCount; i++) {
         
-        if (mftItem[i].item_size == 0) {
+        if ((table->getSize(i) == 0 && !(table->getFlags(i) & MFT_ITEM_PREALLOCATED)) || (table->getFlags(i) & MFT_ITEM_RESIDENT)) {
                 continue;
         }
 
         for (int j = 0; j < MFT_FRAGMENTS_COUNT; j++) {
 
-            if (mftItem[i].fragments[j].fragment_count != 0) {
-                fillIndexTable(indexTable, mftItem[i].fragments[j].fragment_start_address, mftItem[i].fragments[j].fragment_count, indexer);
-                indexer += mftItem[i].fragments[j].fragment_count;
+            if (mftItem[i].fragments[j].fragment_count != 0 && mftItem[i].fragments[j].fragment_start_address != EXTENT_HOLE) {
+                indexer = fillIndexTable(indexTable, mftItem[i].fragments[j].fragment_start_address, mftItem[i].fragments[j].fragment_count, indexer);
             }
         }
 
@@ -1079,12 +5098,16 @@ void PseudoNTFS::prepareIndexTable(int32_t indexTable[]) {
    
 }
 
-void PseudoNTFS::fillIndexTable(int32_t indexTable[] ,const int32_t startIndex, const int32_t count, const int32_t startWithIndex) {
+int32_t PseudoNTFS::fillIndexTable(int32_t indexTable[] ,const int32_t startIndex, const int32_t count, const int32_t startWithIndex) {
 
     int32_t index = startWithIndex;
     for (int i = startIndex; i < startIndex + count; i++) {
-        indexTable[i] = index++;
+        if (indexTable[i] == -1) {
+            indexTable[i] = index++;
+        }
     }
+
+    return index;
 }
 
 void PseudoNTFS::defragment(int32_t indexTable[], int32_t checkIndex) {
@@ -1093,44 +5116,26 @@ void PseudoNTFS::defragment(int32_t indexTable[], int32_t checkIndex) {
         return;
     }
 
-    int32_t swapIndex, t;
-
-    unsigned char * swap = new unsigned char[bootRecord->cluster_size];
-    unsigned char * copy = new unsigned char[bootRecord->cluster_size];
-    unsigned char * temp; 
-
-   
-   
-
-        swapIndex = indexTable[checkIndex];
-        getClusterData(swapIndex, swap);
-        getClusterData(checkIndex, copy);
-        setClusterData(swapIndex, copy, bootRecord->cluster_size);
-
-        t = indexTable[swapIndex];
-        indexTable[swapIndex] = checkIndex;
-        indexTable[checkIndex] = t;
-        
-        while (checkIndex != indexTable[checkIndex] && t != -1) {
-
-            swapIndex = indexTable[checkIndex];
+    unsigned char * moved = new unsigned char[bootRecord->cluster_size];
+    unsigned char * displaced = new unsigned char[bootRecord->cluster_size];
+    getClusterData(checkIndex, moved);
 
-            temp = copy;
-            copy = swap;
-            swap = copy;
+    // content goes to its new index and content found there moves on, until free cluster or start of cycle is reached
+    // moved clusters are marked as staying in place, so the cycle is not walked again from its next cluster
+    int32_t index = checkIndex;
+    while (indexTable[index] != -1 && indexTable[index] != index) {
 
-            getClusterData(swapIndex, swap);
-            setClusterData(swapIndex, copy, bootRecord->cluster_size);
+        int32_t target = indexTable[index];
+        indexTable[index] = index;
 
-            t = indexTable[swapIndex];
-            indexTable[swapIndex] = checkIndex;
-            indexTable[checkIndex] = swapIndex;
-        };
+        getClusterData(target, displaced);
+        setClusterData(target, moved, bootRecord->cluster_size);
+        std::swap(moved, displaced);
+        index = target;
+    }
 
-        setClusterData(checkIndex, swap, bootRecord->cluster_size);
-    
-    delete [] swap;
-    delete [] copy;
+    delete [] moved;
+    delete [] displaced;
 }
 
 /* TEST FUNCTIONS */
@@ -1139,9 +5144,17 @@ void PseudoNTFS::printMftItemInfo(const mft_item * mftItem) {
     std::cout << "UID: " << mftItem->uid << std::endl;
     std::cout << "Name: " << mftItem->item_name << std::endl;
     std::cout << "Is directory: " << mftItem->isDirectory << std::endl;
+    std::cout << "Compressed: " << ((mftItem->item_flags & MFT_ITEM_COMPRESSED) != 0) << std::endl;
+    std::cout << "Resident: " << ((mftItem->item_flags & MFT_ITEM_RESIDENT) != 0) << std::endl;
+    std::cout << "Preallocated: " << ((mftItem->item_flags & MFT_ITEM_PREALLOCATED) != 0) << std::endl;
     std::cout << "Item size: " << (int) mftItem->item_size << std::endl;
     std::cout << "Item order: " << (int) mftItem->item_order << std::endl;
     std::cout << "Item order total: " << (int) mftItem->item_order_total << std::endl;
+    std::cout << "Next item: " << mftItem->item_next << std::endl;
+
+    if (mftItem->item_flags & MFT_ITEM_RESIDENT) {
+        return;
+    }
 
     std::cout << "Fragments - i - start adress - count" << std::endl;
     for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
@@ -1160,6 +5173,7 @@ void PseudoNTFS::printBootRecord(std::ofstream * output) const {
     *output << "Cluster count: "<< br->cluster_count << std::endl;
     *output << "Mft start address: "<< br->mft_start_address << std::endl;
     *output << "Bitmap start address: "<< br->bitmap_start_address << std::endl;
+    *output << "Checksum start address: "<< br->checksum_start_address << std::endl;
     *output << "Data start address: "<< br->data_start_address << std::endl;
     *output << "Mft max fragment count: "<< br->mft_max_fragment_count << std::endl;
 
@@ -1173,6 +5187,7 @@ void PseudoNTFS::printMftItem(mft_item * mftItem, std::ofstream * output) const
     *output << "Item size: " << mftItem->item_size << std::endl;
     *output << "Item order: " << mftItem->item_order << std::endl;
     *output << "Item order total: " << mftItem->item_order_total << std::endl;
+    *output << "Next item: " << mftItem->item_next << std::endl;
 
 } 
 
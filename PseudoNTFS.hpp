@@ -4,15 +4,78 @@
 #include <iostream>
 #include <fstream>
 #include <list>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
 #include <thread>
 #include <semaphore.h>
 
+#include "Journal.hpp"
+#include "ClusterCache.hpp"
+#include "ExtentMap.hpp"
+#include "MftHotTable.hpp"
+#include "FreeExtentIndex.hpp"
+#include "AllocationGroups.hpp"
+#include "LazyIndex.hpp"
+#include "NameIndex.hpp"
+
     const int32_t UID_ITEM_FREE = 0;
     const int32_t MFT_FRAGMENTS_COUNT = 32;
 
+    // flags of mft item
+    const int8_t MFT_ITEM_COMPRESSED = 0x01;
+    // data of small file are stored in place of its fragments
+    const int8_t MFT_ITEM_RESIDENT = 0x02;
+    // data of new file are held in memory until they are allocated by delayed allocation flush
+    const int8_t MFT_ITEM_DELAYED = 0x04;
+    // file has reserved data clusters behind its written data, they are read as zeros until they are written
+    const int8_t MFT_ITEM_PREALLOCATED = 0x08;
+    // file of volume itself, it is in no directory
+    const int8_t MFT_ITEM_SYSTEM = 0x10;
+
+    // name of system file with saved name index
+    const char NAME_INDEX_FILE[] = "$NAMES";
+
+    // flags of preallocation, size of file is kept and clusters are reserved behind its end
+    const int32_t PREALLOCATE_KEEP_SIZE = 0x01;
+
+    // default size of data of new files held in memory before they are allocated
+    const int32_t DELAYED_BUDGET = 1024 * 1024;
+
+    // maximal count of cached extent maps of files, cache is cleared when it is full
+    const size_t EXTENT_MAPS_CACHED = 1024;
+
+    // policies choosing free run for new data clusters
+    // the first run large enough from start of volume
+    const int32_t ALLOCATION_FIRST_FIT = 0;
+    // the first run large enough from the end of last allocation
+    const int32_t ALLOCATION_NEXT_FIT = 1;
+    // the smallest run large enough
+    const int32_t ALLOCATION_BEST_FIT = 2;
+    // run nearest to the first block of parent directory, new directory starts in the largest run
+    const int32_t ALLOCATION_LOCALITY = 3;
+    const int32_t ALLOCATION_POLICIES_COUNT = 4;
+    const char * const ALLOCATION_POLICY_NAMES[] = {"first", "next", "best", "locality"};
+
+    // data clusters are split to allocation groups of same size, small volume has one group
+    const int32_t ALLOCATION_GROUPS_MAX = 16;
+    const int32_t ALLOCATION_GROUP_MIN_CLUSTERS = 4096;
+
+    const char VOLUME_MAGIC[] = "PNTFSVOL";
+    // version of layout of boot record and mft item, volume of other version is not mounted
+    const int32_t VOLUME_VERSION = 1;
+
     struct boot_record {
         char signature[9];              //login autora FS
         char volume_descriptor[251];    //popis vygenerovaného FS
+        char magic[8];                  //VOLUME_MAGIC bez ukoncovaciho znaku
+        int32_t format_version;         //verze formatu svazku VOLUME_VERSION
         int32_t disk_size;              //celkova velikost VFS
         int32_t cluster_size;           //velikost clusteru
         int32_t cluster_count;          //pocet clusteru
@@ -21,6 +84,15 @@
         int64_t data_start_address;     //adresa pocatku datovych bloku
         int32_t mft_max_fragment_count; //maximalni pocet fragmentu v jednom zaznamu v mft (pozor, ne souboru)
                                         // stejne jako   MFT_FRAGMENTS_COUNT
+        int64_t journal_start_address;  //adresa pocatku zurnalu
+        int32_t journal_size;           //velikost zurnalu v bytech
+        int64_t checksum_start_address; //adresa pocatku kontrolnich souctu CRC32C datovych clusteru
+        int32_t change_generation;      //generace zmen svazku, kazdy obraz svazku ji uzavira
+        int32_t image_generation;       //generace obrazu, ze ktereho byl svazek obnoven, NOT_FOUND po zmene svazku
+        int32_t allocation_policy;      //strategie vyberu volneho useku pro nove datove clustery (ALLOCATION_*)
+        int32_t group_clusters;         //pocet datovych clusteru v jedne alokacni skupine, nasobek 8
+        int32_t name_index_item;        //polozka MFT systemoveho souboru s indexem jmen, NOT_FOUND bez indexu jmen
+        int32_t name_index_stamp;       //razitko platneho ulozeneho indexu jmen, meni se prvni zmenou jmena po ulozeni
     };
 
     struct mft_fragment {
@@ -31,28 +103,143 @@
     struct mft_item {
         int32_t uid;                                        //UID polozky, pokud UID = UID_ITEM_FREE, je polozka volna
         bool isDirectory;                                   //soubor, nebo adresar
-        int8_t item_order;                                  //poradi v MFT pri vice souborech, jinak 1
-        int8_t item_order_total;                            //celkovy pocet polozek v MFT
+        int16_t item_order;                                 //poradi v MFT pri vice souborech, jinak 1
+        int16_t item_order_total;                           //celkovy pocet polozek v MFT
         char item_name[12];                                 //8+3 + /0 C/C++ ukoncovaci string znak
-        int32_t item_size;                                  //velikost souboru v bytech
-        struct mft_fragment fragments[MFT_FRAGMENTS_COUNT]; //fragmenty souboru
+        int8_t item_flags;                                  //priznaky polozky (MFT_ITEM_COMPRESSED)
+        int32_t item_size;                                  //velikost souboru v bytech (u komprimovaneho souboru puvodni velikost), plati prvni polozka
+        int32_t item_next;                                  //index dalsi polozky souboru v MFT, NOT_FOUND u posledni
+        int32_t item_valid;                                 //velikost zapsanych dat predalokovaneho souboru (MFT_ITEM_PREALLOCATED), data za ni se ctou jako nuly
+        struct mft_fragment fragments[MFT_FRAGMENTS_COUNT]; //fragmenty souboru, u rezidentniho souboru jeho data
     };
 
+    // maximal size of file stored in its mft item
+    const int32_t MFT_RESIDENT_SIZE = sizeof(mft_fragment) * MFT_FRAGMENTS_COUNT;
+
     const char ROOT_NAME[] = "root";
 
+    // data cluster of directory - block of records sorted by name
+    struct directory_block {
+        int32_t entries_count;      //pocet zaznamu v bloku
+        int32_t level;              //uroven bloku ve strome, 0 - list se zaznamy polozek, jinak indexovy blok
+    };
+
+    // record of leaf block
+    struct directory_entry {
+        char name[12];              //jmeno polozky, podle nej jsou zaznamy v bloku serazeny
+        int32_t mft_index;          //index prvni polozky v MFT
+        bool isDirectory;           //soubor, nebo adresar
+    };
+
+    // record of index block
+    struct directory_index {
+        char name[12];              //nejmensi jmeno v podstromu, u prvniho zaznamu prazdne
+        int32_t block;              //poradi bloku podstromu v adresari
+    };
+
+    // tree deeper than this is corrupted, walk through it stops there
+    const int32_t DIRECTORY_MAX_DEPTH = 32;
+    // removal of subtree measures its transaction every time it removes this many items
+    const int32_t TREE_REMOVE_CHECK = 64;
+
+    // directory reached by walk of subtree
+    struct tree_directory {
+        int32_t mftItemIndex;                           //index prvni polozky adresare v MFT
+        int32_t parent;                                 //poradi nadrazeneho adresare v pruchodu, NOT_FOUND u vychoziho adresare
+        char name[12];                                  //jmeno adresare
+        std::vector<struct directory_entry> entries;    //zaznamy adresare serazene podle jmena
+    };
+
+    // size of subtree counted by its walk
+    struct tree_usage {
+        int64_t size;               //soucet velikosti souboru v bytech
+        int64_t allocated;          //bajty datovych clusteru souboru a bloku adresaru
+        int32_t files;              //pocet souboru
+        int32_t directories;        //pocet adresaru vcetne vychoziho
+    };
+
     struct data_seg {
         int32_t startIndex;
         int32_t size;
     };
 
+    // data of new file written to reserved clusters before volume is locked
+    struct prepared_file {
+        std::vector<struct reserved_run> runs;          //rezervovane useky datovych clusteru
+        std::list<struct mft_fragment> fragments;       //fragmenty souboru vcetne der
+        std::vector<uint32_t> checksums;                //CRC32C zapsanych clusteru v poradi fragmentu
+    };
+
+    // new file waiting for allocation of its data clusters
+    struct delayed_file {
+        int32_t parentMftItemIndex;
+        int64_t sequence;
+        std::string data;
+    };
+
+    // read-only point-in-time copy of volume
+    struct volume_snapshot {
+        int32_t id;                                             //cislo snapshotu
+        int32_t generation;                                     //generace svazku v dobe vytvoreni
+        std::unordered_map<int32_t, struct mft_item> mftItems;  //polozky MFT zmenene po vytvoreni - jejich obsah v dobe vytvoreni
+    };
+
+    // data cluster freed while snapshot needed it
+    struct held_cluster {
+        int32_t index;              //index datoveho clusteru
+        int32_t birth;              //generace, ve ktere byl cluster alokovan
+        int32_t death;              //generace, ve ktere byl cluster uvolnen
+    };
+
+    // change of data cluster or mft item, the first one in its generation
+    struct change_record {
+        int32_t generation;         //generace zmen svazku
+        int32_t index;              //index datoveho clusteru nebo polozky MFT
+    };
+
+    // binary image of volume - header, boot record, mft items and runs of data clusters
+    // full image has used mft items and allocated clusters, incremental one items and clusters changed since its base
+    const char IMAGE_MAGIC[] = "PNTFSIMG";
+    const int32_t IMAGE_VERSION = 2;
+    // data clusters are streamed in chunks of this size
+    const int32_t IMAGE_CHUNK_SIZE = 1024 * 1024;
+
+    struct image_header {
+        char magic[8];              //IMAGE_MAGIC bez ukoncovaciho znaku
+        int32_t version;            //verze formatu obrazu
+        int32_t base_generation;    //generace obrazu, na ktery prirustkovy obraz navazuje, NOT_FOUND u uplneho obrazu
+        int32_t generation;         //posledni generace zmen svazku obsazena v obrazu
+        int32_t mft_items_count;    //pocet ulozenych polozek MFT
+        int32_t runs_count;         //pocet ulozenych behu datovych clusteru
+        int32_t clusters_count;     //pocet ulozenych datovych clusteru
+        int32_t free_runs_count;    //pocet behu uvolnenych clusteru, nasleduji za behy s daty
+    };
+
+    // used mft item in image
+    struct image_mft_item {
+        int32_t index;              //index polozky v MFT
+        struct mft_item item;       //obsah polozky
+    };
+
+    // run of allocated data clusters in image, checksums and data of its clusters follow it
+    // run of freed clusters of incremental image has no data
+    struct image_run {
+        int32_t start;              //index prvniho clusteru behu
+        int32_t count;              //pocet clusteru v behu
+    };
+
     class PseudoNTFS {
 
         private:
 
             /* CONSISTENCY CHECK PROPERTIES */
             const int SLAVES_COUNT = 4;
-            const int MFT_ITEMS_PER_SLAVE = 1;
+            const int MFT_ITEMS_PER_SLAVE = 64;
             bool isCorrupted;
+            // data of files are counted byte by byte, else only ranges of their clusters are checked
+            bool checkBytes;
+            // data clusters are compared with their checksums
+            bool checkChecksums;
 
             sem_t semaphore;
 
@@ -63,27 +250,298 @@
             const int32_t mftItemsCount;
             int32_t uidCounter;
 
+            /* new files are saved compressed */
+            bool compression;
+            /* small files are saved in their mft items */
+            bool residentData;
+            /* data clusters read from disk are compared with their checksums */
+            bool verifyChecksums;
+
+            /* DEDUPLICATION */
+            // file data clusters with content already stored are shared
+            bool deduplication;
+            // references to data cluster over the first one, made by deduplication
+            std::vector<int32_t> sharedReferences;
+            // content hash of file data cluster - indexes of clusters with this hash
+            std::unordered_map<uint32_t, std::list<int32_t>> deduplicationIndex;
+            // statistics - clusters of file data written since deduplication was turned on and shared ones of them
+            int64_t deduplicationWritten;
+            int64_t deduplicationShared;
+            // time spent in hash index lookups
+            double deduplicationSeconds;
+            /********************************/
+
+            /* DELAYED ALLOCATION */
+            // data of new files are held in memory and allocated together at flush
+            bool delayedAllocation;
+            // maximal size of data held in memory in bytes
+            int32_t delayedBudget;
+            int32_t delayedBytes;
+            // data clusters reserved for files held in memory, available space does not count them
+            int32_t delayedClusters;
+            int64_t delayedSequence;
+            // mft item index - data of file waiting for allocation
+            std::map<int32_t, struct delayed_file> delayedFiles;
+            // statistics - flushes, flushed files and extents they were written to
+            int64_t delayedFlushes;
+            int64_t delayedFlushedFiles;
+            int64_t delayedFlushedExtents;
+            /********************************/
+
+            /* SNAPSHOTS */
+            // snapshots from the oldest one
+            std::list<struct volume_snapshot> snapshots;
+            int32_t snapshotCounter;
+            // generation of volume grows with every snapshot, snapshot keeps content of older generations
+            int32_t generation;
+            // generation in which data cluster was allocated, clusters of snapshot are written copy on write
+            std::vector<int32_t> clusterGenerations;
+            // generation in which mft item was copied to snapshot the last time
+            std::vector<int32_t> mftGenerations;
+            // clusters freed by volume and kept for snapshots, clusters leaked by crash are added by free extents index
+            std::vector<struct held_cluster> heldClusters;
+            // snapshot was deleted, clusters held for it are released by next allocation short of space or by sync
+            bool snapshotReclaim;
+            // statistics - clusters written copy on write and mft items copied to snapshots
+            int64_t snapshotCopiedClusters;
+            int64_t snapshotCopiedItems;
+            // volume of mounted snapshot, NULL for volume itself
+            PseudoNTFS * snapshotOrigin;
+
+            // generation of changes of volume, every exported image closes it
+            int32_t changeGeneration;
+            // changes are known from this generation, older ones were made before mount
+            int32_t trackedGeneration;
+            // generation of the last change of data cluster and mft item, 0 - not changed since mount
+            std::vector<int32_t> clusterChanges;
+            std::vector<int32_t> mftChanges;
+            // first changes of data clusters and mft items in every generation, in order of generations
+            std::vector<struct change_record> clusterChangeLog;
+            std::vector<struct change_record> mftChangeLog;
+            /********************************/
+
+            /* EXTENT MAPS */
+            // first mft item index of file - map of its data clusters, it is dropped when any mft item of file changes
+            std::unordered_map<int32_t, std::shared_ptr<const ExtentMap>> extentMaps;
+            // readers share cached maps, it guards the table
+            std::mutex extentMapsMutex;
+            /********************************/
+
             /* infromations about free space and mft items*/
-            int32_t freeSpace;
+            // free data clusters are counted by free extents, allocation and release of cluster keep them exact
             int32_t freeMftItems;
+            // all mft items before it are used, search for free mft item starts there
+            int32_t firstFreeMftItem;
+            // packed hot fields of all mft items, scans over mft table read it instead of records
+            MftHotTable hotTable;
+            // runs of free data clusters split to allocation groups, every group has its own lock
+            AllocationGroups allocationGroups;
+            // next fit search starts here, behind the last allocated run
+            std::atomic<int32_t> allocationCursor;
+
+            /* INDEXES BUILT AFTER MOUNT */
+            // hot table, uid counter and free mft items count
+            LazyIndex mftIndex;
+            // free extents and free space
+            LazyIndex spaceIndex;
+            // shared references of data clusters
+            LazyIndex referencesIndex;
+
+            /* NAME INDEX */
+            // names of all files and directories, it is loaded from its system file or built on first use
+            NameIndex nameIndex;
+            bool nameIndexBuilt;
+            // names changed since index was saved, stamp of saved index does not match boot record
+            bool nameIndexDirty;
+            /********************************/
 
             /* starts of important disk parts*/
             unsigned char * ntfs;
             struct boot_record * bootRecord;
             struct mft_item * mftItemStart;
             unsigned char * bitmapStart;
+            unsigned char * journalStart;
+            // CRC32C of every data cluster
+            uint32_t * checksumStart;
             unsigned char * dataStart;
+
+            /* PERSISTENCE AND JOURNALING */
+            // host file with volume, -1 for in-memory volume
+            int volumeFile;
+            // size of part of volume held in ntfs array - whole disk, or everything before data clusters with cache
+            int64_t residentSize;
+            // cache of data clusters, NULL if whole volume is in memory
+            ClusterCache * cache;
+            Journal * journal;
+            // serializes operations changing volume, flush of their transactions runs outside of it
+            std::mutex operationMutex;
+            // volume ranges updated by running transaction - offset from volume start
+            std::map<int64_t, struct journal_range> transactionRanges;
+            // data clusters written by running transaction
+            std::set<int32_t> transactionDataClusters;
+            // data clusters freed by running transaction, they are cleared on volume after its metadata are logged
+            std::set<int32_t> transactionFreedClusters;
+            // free data clusters reserved by running transaction, setting their bits takes them, the rest returns to allocation groups at commit
+            FreeExtentIndex transactionReserved;
+            // cached data clusters pinned by running transaction until it is written by journal
+            std::set<int32_t> transactionPinnedClusters;
+            // statistics - bytes of data clusters and metadata committed by transactions
+            int64_t committedBytes;
+
+            /* operation changing volume - its updates are committed as one journal transaction
+             * operations are serialized, commit waits for flush outside of operation lock, so commits of concurrent operations are flushed together
+            */
+            class Transaction {
+
+                private:
+                    PseudoNTFS * pntfs;
+                    std::unique_lock<std::mutex> lock;
+
+                public:
+                    // every operation changing volume updates hot table of its mft items
+                    Transaction(PseudoNTFS * pntfs) : pntfs(pntfs), lock(pntfs->operationMutex) {pntfs->mftIndex.wait();};
+                    ~Transaction();
+                    /* commit changes made so far and go on, lock is kept, so no other operation sees the part
+                    */
+                    void commit();
+            };
+            /********************************/
             
             /* global flag for index out of range 
              * set in case you pass to function invalid disk index
             */
             bool indexOutOfRange;
 
+            /* set addresses of disk parts in boot record and pointers to them
+             * +param - br - boot record with disk size, cluster size and cluster count
+            */
+            void initLayout(struct boot_record * br);
+            /* +param - br - boot record of volume
+             * +return true - volume has format of this version
+            */
+            static bool isVolumeFormat(const struct boot_record * br);
+            /* read mft items count of volume stored in host file
+             * +param - volumePath - path to host file with volume
+             * +return mft items count, or 0 when volume is not found or it has other format
+            */
+            static int32_t readMftItemsCount(const char * volumePath);
+
+            /* add mft item to running transaction
+             * +param - index - mft items table index
+            */
+            void journalMftItem(const int index);
+            /* add bitmap byte of data cluster to running transaction
+             * +param - index - data cluster index
+            */
+            void journalBitmap(const int index);
+            /* add directory data cluster to running transaction
+             * +param - index - data cluster index
+            */
+            void journalCluster(const int index);
+            /* add field of boot record to running transaction
+             * +param - field - changed field of boot record
+            */
+            void journalBootRecord(const int32_t * field);
+            /* add file data cluster to running transaction, it is written before transaction is logged
+             * +param - index - data cluster index
+            */
+            void journalData(const int index);
+            /* add file data cluster with checksum computed before volume was locked to running transaction
+             * +param - index - data cluster index
+             * +param - checksum - CRC32C of cluster
+            */
+            void journalData(const int index, const uint32_t checksum);
+            /* add freed data cluster to running transaction, it is cleared on volume after transaction is logged
+             * crash before log keeps data of cluster for mft items still pointing to it
+             * +param - index - data cluster index
+            */
+            void journalFreedData(const int index);
+            /* compute checksum of changed data cluster and add it to running transaction
+             * +param - index - data cluster index
+            */
+            void updateClusterChecksum(const int index);
+            /* set checksum of changed data cluster and add it to running transaction
+             * +param - index - data cluster index
+             * +param - checksum - CRC32C of cluster
+            */
+            void updateClusterChecksum(const int index, const uint32_t checksum);
+            /* compare data cluster with its checksum
+             * +param - index - data cluster index
+             * +param - data - data of cluster
+             * +return true - checksum matches, else false
+            */
+            bool verifyClusterChecksum(const int index, const unsigned char * data) const;
+            /* pin cached data cluster changed by running transaction
+             * +param - index - data cluster index
+            */
+            void pinCluster(const int index);
+            /* commit running transaction to journal
+             * +param - pinnedClusters - cached data clusters pinned by transaction, to be unpinned once it is durable
+             * +return sequence of committed transaction, 0 if nothing was changed
+            */
+            int64_t commitTransaction(std::set<int32_t> * pinnedClusters);
+            /* +return bytes of log taken by running transaction, neighbouring ranges are counted as separate records
+            */
+            int64_t transactionLogSize() const;
+
+            /* get data cluster in memory
+             * pointer is valid only until next access to data clusters, cluster can be evicted from cache
+             * +param - index - data cluster index
+             * +return data of cluster
+            */
+            unsigned char * clusterData(const int index);
+            /* +param - index - data cluster index
+             * +return offset of data cluster from volume start
+            */
+            int64_t clusterOffset(const int index) const;
+
             // initialize mft items to be free
             void initMft();
+            // copy hot fields of all mft items to hot table
+            void rebuildHotTable();
+            /* start building of indexes of mounted volume in worker threads
+            */
+            void buildIndexes();
+            /* hot table, it waits until it is built
+             * +return hot table
+            */
+            MftHotTable * hot() {mftIndex.wait(); return &hotTable;};
+            const MftHotTable * hot() const {mftIndex.wait(); return &hotTable;};
+            /* name index, saved index is loaded or index is built when it is used first time
+             * it is used under volume lock
+             * +return name index
+            */
+            NameIndex * names();
+            /* load name index from its system file
+             * +return true - saved index is valid
+            */
+            bool loadNameIndex();
+            /* save name index to new system file and free the old one
+             * +return true - saved
+            */
+            bool saveNameIndex();
+            /* shared references of data clusters, they wait until they are counted
+             * +return references over the first one of every data cluster
+            */
+            std::vector<int32_t> & clusterReferences() {referencesIndex.wait(); return sharedReferences;};
+            /* free data clusters without clusters reserved for files held in memory, it waits until they are counted
+             * +return count of clusters
+            */
+            int32_t availableClusters() {spaceIndex.wait(); return allocationGroups.getFreeClusters() - delayedClusters;};
+            /* +return free space in bytes, it waits until it is counted
+            */
+            int32_t availableSpace() {return availableClusters() * bootRecord->cluster_size;};
+            /* count of data clusters taking data of given size
+             * +param - size - size of data in bytes
+             * +return count of clusters
+            */
+            int32_t clustersOf(const int32_t size) const {return (size + bootRecord->cluster_size - 1) / bootRecord->cluster_size;};
             /* initialize bitmap to be free
             */
             void initBitmap();
+            /* set checksums of all data clusters to checksum of empty cluster
+            */
+            void initChecksums();
             /* set free/use for data cluster
              * can set index out of borders flag
              * +param index - data cluster index
@@ -106,11 +564,16 @@
              * param mftItemIndex - index in mft items table
             */
             void freeMftItem(const int32_t mftItemIndex);
-            /* free mft item from mft item table and clear its data clusters
+            /* free all mft items of file from mft item table and clear its data clusters
              * can set index out of borders flag
-             * +param mftItemIndex - index in mft items table
+             * +param mftItemIndex - index of first mft item of file in mft items table
             */
             void freeMftItemWithData(const int32_t mftItemIndex);
+            /* get next mft item of file - file with more than MFT_FRAGMENTS_COUNT fragments has chain of mft items
+             * +param mftItemIndex - index in mft items table
+             * +return index of next mft item, or NOT_FOUND for the last one
+            */
+            int32_t nextMftItem(const int32_t mftItemIndex) const;
 
             /* set data in data cluster
              * can set index out of borders flag
@@ -131,39 +594,184 @@
              * +param - clustersCount - how many data cluster from given index
             */
             void clearClusterData(const int startIndex, const int32_t clustersCount);
+            /* free data cluster, it is cleared
+             * +param - index - data cluster index
+            */
+            void releaseCluster(const int index);
+            /* free run of data clusters, they are cleared, bitmap and free runs of groups are updated once for the whole run
+             * +param - startIndex - first data cluster index
+             * +param - clustersCount - count of data clusters
+            */
+            void releaseClusters(const int32_t startIndex, const int32_t clustersCount);
+
+            /* SNAPSHOTS */
+            /* set volume without snapshots
+            */
+            void initSnapshots();
+            /* copy mft item to the newest snapshot before its first change after snapshot was created
+             * +param - index - mft items table index
+            */
+            void preserveMftItem(const int index);
+            /* +param - index - data cluster index
+             * +return true - used cluster belongs to snapshot, it cannot be changed in place
+            */
+            bool isClusterFrozen(const int index);
+            /* release clusters held for deleted snapshots
+             * +return count of released clusters
+            */
+            int32_t reclaimSnapshotClusters();
+            /* hold used clusters no mft item points to, they were held for snapshots when volume crashed
+             * they are released with other held clusters, so their data are cleared in transaction
+             * runs in mft index builder, no command reads or changes mft and bitmap until it ends
+            */
+            void holdLeakedClusters();
+            /* copy metadata of volume as they were when snapshot was created
+             * +param - id - id of snapshot
+             * +param - volume - buffer for everything before data clusters
+            */
+            void readSnapshot(const int32_t id, unsigned char * volume);
+            /* move directory block kept by snapshot to new data cluster
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - order - order of block in directory
+             * +param - cluster - new data cluster of block
+             * +return true - block was moved, false - there is no free data cluster or mft item
+            */
+            bool redirectDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, int32_t * cluster);
+
+            /* CHANGE TRACKING */
+            /* start tracking of changes in generation stored in boot record
+            */
+            void initChangeTracking();
+            /* remember change of data cluster or mft item in current generation, volume no longer matches its image
+             * +param - index - data cluster index, mft items table index
+            */
+            void trackClusterChange(const int index);
+            void trackMftItemChange(const int index);
+            /* +param - changes - generations of the last change
+             * +param - log - first changes in every generation
+             * +param - baseGeneration - generation of base image
+             * +param - indexes - indexes changed after base generation, in order of their first change
+            */
+            void findChanges(const std::vector<int32_t> & changes, const std::vector<struct change_record> & log, const int32_t baseGeneration, std::vector<int32_t> * indexes) const;
+
+            /* VOLUME IMAGE */
+            /* find runs of data clusters of image, clusters held only for snapshots are left out as free
+             * +param - baseGeneration - NOT_FOUND - all allocated clusters, else clusters changed after base generation
+             * +param - runs - allocated clusters in order of their indexes
+             * +param - freeRuns - freed clusters of incremental image
+            */
+            void findImageRuns(const int32_t baseGeneration, std::vector<struct image_run> * runs, std::vector<struct image_run> * freeRuns);
 
             /* return UID
              * +return - UID 
             */
             const int getUid() {return uidCounter++;};
-            /* remove UID from directory
-             * can set index out of borders flag
-             * + param - directoryMftItemIndex - index of directory mft item in mft items table, we want to remove UID from
-             * +param - uid - UID to be removed
+            /* create first mft item of new empty file or directory and its entry in parent directory
+             * +param - parentMftItemIndex - index of mft item of parent directory
+             * +param - name - name of new item
+             * +param - directory - true - directory, false - file
+             * +return index of new mft item, or NOT_FOUND if there is no free mft item or data cluster
             */
-            void removeUidFromDirectory(const int32_t directoryMftItemIndex, int32_t uid);
-            /* save UID to given mft item data clusters
-             * can set index out of borders flag
-             * +param - destinationMftItemIndex - mft item where should be UID saved
-             * +param - uid - UID to be saved
+            int32_t createItem(const int32_t parentMftItemIndex, const char * name, const bool directory);
+
+            /* DIRECTORY BLOCKS */
+            /* directory is B+ tree of blocks sorted by name, its root is the first block
+             * leaves hold entries, index blocks hold the smallest name of every child block
+             * new blocks are appended to directory, full root moves to new block and the tree grows in its root
+            */
+            /* size of record in directory block
+             * +param - level - level of block, 0 - leaf
+             * +return size of record in bytes
+            */
+            int32_t directoryRecordSize(const int32_t level) const;
+            /* count of records in one directory block
+             * +param - level - level of block, 0 - leaf
+             * +return count of records
+            */
+            int32_t directoryBlockCapacity(const int32_t level) const;
+            /* position of name in sorted records of block - binary search
+             * +param - block - content of block
+             * +param - name - searched name
+             * +param - upper - true - first record with greater name, false - first record with name not less than given one
+             * +return position of record
             */
-            bool saveUid(int32_t destinationMftItemIndex, int32_t uid);
-            /* try to remove UID from data cluster, in case given UID is there
+            int32_t directoryRecordPosition(const unsigned char * block, const char * name, const bool upper) const;
+            /* walk directory tree from root to leaf where name belongs
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - name - name of entry
+             * +param - path - order of blocks in directory from root to leaf
+             * +param - block - content of leaf
+             * +return true - leaf was found, false - directory has no block
+            */
+            bool findDirectoryLeaf(const int32_t directoryMftItemIndex, const char * name, std::vector<int32_t> * path, unsigned char * block);
+            /* find entry of directory
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - name - name of entry
+             * +param - entry - found entry
+             * +return true - found, else false
+            */
+            bool findDirectoryEntry(const int32_t directoryMftItemIndex, const char * name, struct directory_entry * entry);
+            /* insert entry to its leaf, full blocks on path are split
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - entry - new entry
+             * +return true - inserted, false - no free mft item or data cluster
+            */
+            bool insertDirectoryEntry(const int32_t directoryMftItemIndex, const struct directory_entry * entry);
+            /* remove entry from its leaf, entries behind it are shifted, blocks are never merged
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - name - name of entry
+             * +return true - removed, false - there is no such entry
+            */
+            bool removeDirectoryEntry(const int32_t directoryMftItemIndex, const char * name);
+            /* append new empty block to directory, data cluster behind the last block is preferred
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - block - order of new block in directory
+             * +return true - appended, false - no free mft item or data cluster
+            */
+            bool appendDirectoryBlock(const int32_t directoryMftItemIndex, int32_t * block);
+            /* append mft item with one new data cluster to chain of directory
+             * +param - directoryMftItemIndex - first mft item of directory
+             * +param - lastMftItemIndex - last mft item of directory
+             * +param - cluster - free data cluster for new block
+             * +return true - appended, false - no free mft item
+            */
+            bool extendDirectory(const int32_t directoryMftItemIndex, const int32_t lastMftItemIndex, const int32_t cluster);
+            /* read directory block from its data cluster
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - order - order of block in directory
+             * +param - block - content of block
+             * +return true - read, false - directory has no such block
+            */
+            bool readDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, unsigned char * block);
+            /* read all entries of directory, blocks are only read, so more threads can read directories at once
              * can set index out of borders flag
-             * +param - startIndex - index of first data cluster
-             * +param - clusterCount - count of culuster to be searched
-             * +param - uid - UID to be deleted
-             * +return true - given uid was found in given data clusters range and deleted, else false
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - entries - entries sorted by name are appended
+             * +return true - read
             */
-            bool removeUid(int32_t startIndex, int32_t clusterCount, int32_t uid); 
-            /* try to write UID to data cluster, in case there is enough free space
+            bool readDirectoryEntries(const int32_t directoryMftItemIndex, std::vector<struct directory_entry> * entries);
+            /* walk subtree of directory, directories are read by pool of threads
+             * every thread has its own queue of directories, idle thread steals from queues of others
+             * directories must not change during walk
              * can set index out of borders flag
-             * +param - startIndex - index of first data cluster
-             * +param - clusterCount - count of culuster to be searched
-             * +param - uid - UID to be saved
-             * +return true - given uid was saved, else false
+             * +param - directoryMftItemIndex - index of first mft item of starting directory
+             * +param - directories - all directories of subtree with their entries, parent is before its directories
+             * +param - visit - called by thread which has read directory with its position in directories, calls run in parallel
+             * +return true - walked
+            */
+            bool walkTree(const int32_t directoryMftItemIndex, std::vector<struct tree_directory> * directories,
+                const std::function<void(const int32_t, const struct tree_directory &)> & visit = nullptr);
+            /* paths of all directories reached by walk
+             * +param - directories - directories of walk
+             * +param - paths - path from starting directory ending with separator at position of directory, empty for starting directory
             */
-            bool writeUid(int32_t startIndex, int32_t clusterCount, int32_t uid);
+            void treePaths(const std::vector<struct tree_directory> & directories, std::vector<std::string> * paths) const;
+            /* write directory block to its data cluster
+             * +param - directoryMftItemIndex - index of first mft item of directory
+             * +param - order - order of block in directory
+             * +param - block - content of block
+            */
+            void writeDirectoryBlock(const int32_t directoryMftItemIndex, const int32_t order, const unsigned char * block);
             
             /* clear mft fragments
              * +param - fragments - array of mft fragments
@@ -172,85 +780,249 @@
             /* find free mft item
             */
             int findFreeMft() const;
+            /* find free mft items for chain of file
+             * +param - count - count of demanded mft items
+             * +param - indexes - indexes of found mft items in ascending order
+             * +return true - all were found, else false
+            */
+            bool findFreeMftItems(const int32_t count, std::vector<int32_t> * indexes) const;
             /* count how many mft items we need to save given count of data clusters
              * +param - dataClustersCount - count of data clusters we need to save
              * +return count of needed mft fragment to save given count of data clusters, or NOT_FOUND
             */
-            int neededMftItems(int8_t dataClustersCount) const;
-            /* find maximal continula free space in bytes
+            int neededMftItems(int32_t dataClustersCount) const;
+            /* find maximal continula free space in bytes, free run is chosen by allocation policy of volume
+             * demanded space is reserved for running transaction when it is found, the largest run is not reserved
              * can set index out of borders flag
              * +param - demandedSize - ideal length of continual free space in bytes
-             * +param - startIndex - index of first data cluster in found free space
+             * +param - startIndex - data cluster the space should be near to for locality policy, NOT_FOUND for new region of volume
+             *                       index of first data cluster in found free space on return
              * +param - providedSize - found maximal continual free space 
+             * +param - group - allocation group searched first, NOT_FOUND for group of startIndex
+            */
+            void findFreeSpace(const int32_t demandedSize, int32_t * startIndex, int32_t * providedSize, const int32_t group);
+            /* find free run with given count of clusters by allocation policy of volume and reserve it
+             * groups are searched from the given one, so files of one directory stay in one group
+             * +param - count - count of clusters
+             * +param - goal - data cluster the run should be near to for locality policy, or NOT_FOUND
+             * +param - group - allocation group searched first
+             * +param - start - first cluster of reserved run
+             * +return count of reserved clusters, 0 if there is no run large enough
+            */
+            int32_t reserveFreeRun(const int32_t count, const int32_t goal, const int32_t group, int32_t * start);
+            /* allocation group searched first for data of given directory or file
+             * +param - goal - data cluster the data should be near to, or NOT_FOUND
+             * +param - group - group of parent directory, or NOT_FOUND
+             * +return index of allocation group
+            */
+            int32_t preferredGroup(const int32_t goal, const int32_t group) const;
+            /* allocation group of new files of directory, directories are spread over groups
+             * +param - mftItemIndex - index of first mft item of directory
+             * +return index of allocation group
+            */
+            int32_t homeGroup(const int32_t mftItemIndex) const {spaceIndex.wait(); return mftItemIndex % allocationGroups.getCount();};
+            /* count of data clusters in allocation group, groups are multiple of bitmap byte
+             * +param - clusterCount - count of data clusters of volume
+             * +return count of clusters in one group
+            */
+            static int32_t allocationGroupClusters(const int32_t clusterCount);
+            /* reserve free cluster for running transaction
+             * +param - index - data cluster index
+             * +return true - cluster was free and it is reserved
             */
-            void findFreeSpace(const int32_t demandedSize, int32_t * startIndex, int32_t * providedSize);
+            bool reserveCluster(const int32_t index);
             /* save continula data
+             * with deduplication clusters with already stored content are shared instead of written
              * can set index out of borders flag
              * +param - data - data to be saved
              * +param - size - size of data to be saved in bytes
              * +param - startIndex - index of first data cluster for data saving
+             * +param - fragments - fragments data were saved to are appended here
             */
-            void saveContinualSegment(const char * data, const int32_t size, const int32_t startIndex);
+            void saveContinualSegment(const char * data, const int32_t size, const int32_t startIndex, std::list<struct mft_fragment> * fragments);
+            /* append data clusters to fragments, they extend last fragment if they follow it
+             * +param - fragments - list of fragments
+             * +param - index - index of first data cluster
+             * +param - count - count of data clusters
+            */
+            void appendFragment(std::list<struct mft_fragment> * fragments, const int32_t index, const int32_t count = 1) const;
+            /* check that cluster of data holds only zeros, it is not allocated then - it is hole of sparse file
+             * +param - data - data of file
+             * +param - length - length of data
+             * +param - cluster - order of cluster in data
+             * +return true - zeros only, else false
+            */
+            bool isZeroCluster(const char * data, const int32_t length, const int32_t cluster) const;
+            /* count size of data clusters needed for data, clusters of zeros are holes
+             * +param - data - data of file
+             * +param - length - length of data
+             * +return size of data clusters in bytes
+            */
+            int32_t allocatedSize(const char * data, const int32_t length) const;
+            /* set fragments of file, chain of its mft items is extended by free mft items or shortened
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - fragments - all fragments of file in order
+             * +return true - fragments were set, false - not enough free mft items
+            */
+            bool setFileFragments(const int32_t mftItemIndex, const std::list<struct mft_fragment> * fragments);
+
+            /* count references of data clusters from mft items
+             * +param - references - count of references of every data cluster
+            */
+            void countClusterReferences(std::vector<int32_t> * references);
+            /* count shared references of data clusters from mft items
+            */
+            void initSharedReferences();
+            /* add content hashes of all file data clusters to deduplication index
+            */
+            void buildDeduplicationIndex();
+            /* find file data cluster with same content
+             * +param - data - content of cluster
+             * +param - hash - content hash of cluster
+             * +return data cluster index or NOT_FOUND
+            */
+            int32_t findDuplicateCluster(const unsigned char * data, const uint32_t hash);
+            /* remove data cluster from deduplication index
+             * +param - index - data cluster index
+            */
+            void unindexCluster(const int32_t index);
             /* prepare list with data segmets - start index and size in bytes - for demanded data size we want to save
-             * TODO - check find free space not 0
+             * one continual segment is used if there is any, else free runs are used in order of their addresses from where policy starts
              * +param - dataSegmentList - list of prepared data segments
              * +param - demandedSize - size of content to be saved in bytes 
+             * +param - goal - data cluster the segments should be near to, NOT_FOUND if there is none
+             * +param - group - allocation group searched first, NOT_FOUND for group of goal
+             * +return true - segments were prepared, false - not enough free data clusters
+            */
+            bool prepareMftItems(std::list<struct data_seg> * dataSegmentList, int32_t demandedSize, const int32_t goal, const int32_t group);
+            /* data cluster new data of file or directory should be near to
+             * +param - mftItemIndex - index of first mft item of file or directory
+             * +return its first data cluster, or NOT_FOUND if it has none
             */
-            void prepareMftItems(std::list<struct data_seg> * dataSegmentList, int32_t demandedSize);
+            int32_t allocationGoal(const int32_t mftItemIndex);
             /* save file to ntfs
-             * +param - dataSegmentList - list of prepared data segments
+             * fragments over MFT_FRAGMENTS_COUNT continue in next mft items linked by item_next
+             * clusters of zeros are saved as holes, they do not take any data cluster
+             * +param - dataSegmentList - list of prepared data segments for allocatedSize of data
              * +param - fileName - name of file
              * +param - uid - UID of file
+             * +param - fileData - stored content of file
+             * +param - fileLength - size of stored content in bytes
+             * +param - itemSize - size of file in bytes, differs from fileLength for compressed file
+             * +param - itemFlags - flags of mft item
+             * +param - mftItemIndex - existing mft item of file, or NOT_FOUND for new one
+            */
+            bool save(std::list<struct data_seg> * dataSegmentList, const char * fileName, int32_t uid, char * fileData, int32_t fileLength, int32_t itemSize, int8_t itemFlags, const int32_t mftItemIndex);
+            /* save mft items of file with saved data, data clusters are cleared when there are not enough free mft items
+             * +param - fragments - fragments of saved data
+             * +param - fileName - name of file
+             * +param - uid - UID of file
+             * +param - itemSize - size of file in bytes
+             * +param - itemFlags - flags of mft item
+             * +param - mftItemIndex - existing mft item of file, or NOT_FOUND for new one
+             * +return true - file was saved, false - not enough free mft items
+            */
+            bool saveMftItems(const std::list<struct mft_fragment> * fragments, const char * fileName, int32_t uid, int32_t itemSize, int8_t itemFlags, const int32_t mftItemIndex);
+            /* reserve data clusters in allocation groups and write data of new file to them before volume is locked
+             * only whole volume in memory is written this way, clusters are free in bitmap until file is saved
+             * +param - fileData - stored content of file
+             * +param - fileLength - size of stored content in bytes
+             * +param - group - allocation group searched first
+             * +param - prepared - reserved runs, fragments and checksums of written clusters
+             * +return true - data were written, false - there is no room for them, nothing is reserved
+            */
+            bool prepareFileData(const char * fileData, const int32_t fileLength, const int32_t group, struct prepared_file * prepared);
+            /* save new file with prepared data, reserved clusters are taken over by running transaction
+             * +param - prepared - data written before volume was locked
+             * +param - fileName - name of file
+             * +param - parentDirectoryMftIndex - index of parent directory
+             * +param - itemSize - size of file in bytes
+             * +param - itemFlags - flags of mft item
+             * +return true - file was saved
+            */
+            bool savePrepared(const struct prepared_file * prepared, const char * fileName, const int32_t parentDirectoryMftIndex, const int32_t itemSize, const int8_t itemFlags);
+            /* save new file with given content, data of file going to data clusters are prepared before volume is locked
+             * +param - fileName - name of file
+             * +param - content - content of file, it can be moved or replaced by compressed data
+             * +param - found - false - source of content was not found, only error is reported
+             * +param - parentDirectoryMftIndex - index of mft item of directory where the file will be saved
+             * +param - compress - true - file is saved compressed
+             * +return true - file was saved
+            */
+            bool saveFileData(const char * fileName, std::string * content, const bool found, const int32_t parentDirectoryMftIndex, const bool compress);
+            /* save small file to its mft item, no data cluster is used
+             * +param - mftItemIndex - index of existing mft item of file
              * +param - fileData - content of file
-             * +param - fileLength - size of file in bytes
+             * +param - fileLength - size of file in bytes, at most MFT_RESIDENT_SIZE
             */
-            bool save(std::list<struct data_seg> * dataSegmentList, const char * fileName, int32_t uid, char * fileData, int32_t fileLength);
-            
-            /* search for clusters for directory/file with given name
-             * can set index out of borders flag
-             * +param - dataClusterStartIndex - index of first data cluster for search
-             * +param - dataClustersCount - count of data clusters for search
-             * +param - name - name of searched file/directory  
-             * +param - directory - true - directory, false - file
-             * +return mft item index or NOT_FOUND
+            void saveResident(const int32_t mftItemIndex, const char * fileData, int32_t fileLength);
+            /* create file whose data are held in memory until delayed allocation flush
+             * +param - fileName - name of file
+             * +param - fileData - content of file, it is moved to memory buffer
+             * +param - parentDirectoryMftIndex - index of mft item of directory where the file will be saved
             */
-            int32_t searchClusters(const int32_t dataClusterStartIndex, const int32_t dataClustersCount, const char * name, const bool directory);
-            /* search for cluster for directory/file with given name 
-             * can set index out of borders flag
-             * +param - dataClusterIndex - index of searched data cluster
-             * +param - name - name of searched file/directory
-             * +param - directory - true - directory, false - file
-             * +return mft item index or NOT_FOUND
-            */
-            int32_t searchCluster(const int32_t dataClusterIndex, const char * name, const bool directory);
-            /* search for mft item with given name, durectory/file and UID
-             * +param - uid - file/directory UID
-             * +param - name - file/directory name
-             * +param - directory - directory - true , file - false
-             * +return mft item index or NOT_FOUND
-            */ 
-            int32_t findMftItemWithProperties(const int32_t uid, const char * name, const bool directory);
-
-            /* load data fragment
+            bool saveDelayed(const char * fileName, std::string * fileData, const int32_t parentDirectoryMftIndex);
+            /* allocate data clusters for all files waiting in memory and write them
+             * files are placed one after another in one extent if possible, files of one directory are next to each other
+             * +return true - all files were written, false - not enough free space, files left without data are empty
+            */
+            bool flushDelayedFiles();
+            
+            /* load data fragment, clusters are loaded whole
              * can set index out of borders flag
              * +param - startIndex - first index of data cluster for loading
              * +param - fragmentCount - count of data clusters for loading
              * +param - oss - stream for loading of content
             */
             void loadDataFragment(int32_t startIndex, int32_t fragmentCount, std::ostringstream * oss);
-            /* get all UIDs from fragment
+            /* load compressed file, chunks are decompressed while data clusters are read
+             * works on copies of data clusters, so it can run in parallel with other readers
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - content - string for file loading
+             * +return true - loaded, false - compressed data are corrupted
+            */
+            bool loadCompressedData(const int32_t mftItemIndex, std::string * content);
+            /* get extent map of file from cache, it is loaded when it is missing
+             * +param - mftItemIndex - index of first mft item of file
+             * +return map of file data clusters
+            */
+            std::shared_ptr<const ExtentMap> cachedExtentMap(const int32_t mftItemIndex);
+            /* check that mft item is first mft item of file
              * can set index out of borders flag
-             * +param - startIndex - index of first data cluster
-             * +param - fragmentsCount - count of data clusters from which are UIDs loaded
-             * +param - uids - list where are stored uids from data clusters
+             * +param - mftItemIndex - index of mft item
+             * +return true - file, else false
             */
-            void getAllUidsFromFragment(const int32_t startIndex, const int32_t fragmentsCount, std::list<int32_t> * uids);
-            /* find mft item with UID
-             * +param - uid - searched UID
-             * +return mft item index with UID or NOT_FOUND 
+            bool isFile(const int32_t mftItemIndex);
+            /* write whole data cluster of file, deduplication index follows its new content
+             * +param - index - data cluster index
+             * +param - data - content of cluster
             */
-            int32_t findMftItemWithUid(const int32_t uid);
-
+            void writeFileCluster(const int32_t index, const unsigned char * data);
+            /* write data to file at given position in running transaction
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - offset - position in file in bytes
+             * +param - buffer - data to write
+             * +param - length - count of bytes to write
+             * +return true - written, false - not enough free space
+            */
+            bool writeData(const int32_t mftItemIndex, const int32_t offset, const char * buffer, const int32_t length);
+            /* save new content of file to its existing first mft item, old data clusters and next mft items are released
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - content - new content of file
+             * +return true - saved, false - not enough free space, file is left empty
+            */
+            bool rewriteFile(const int32_t mftItemIndex, const std::string * content);
+            /* size of written data of file, data behind it are read as zeros
+             * +param - mftItemIndex - index of first mft item of file
+             * +return written size of preallocated file, else size of file
+            */
+            int32_t validSize(const int32_t mftItemIndex) const;
+            /* set size of written data of file after its size or data clusters were changed, call it between preserving and journaling mft item
+             * file without unwritten data and without clusters behind its end is ordinary file again
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - size - size of written data in bytes
+            */
+            void setValidSize(const int32_t mftItemIndex, const int32_t size);
             /* check if directory is empty
              * can set index out of borders flag
              * +param - mftitemIndex - index of mft item to be checked
@@ -273,6 +1045,11 @@
              * * +return true - is somthing to check, else false
             */
             bool getMftItemsToCheck(int32_t * mftItemStartIndex, int32_t * mftItemEndIndex);
+            /* check that chain of mft items of file has its UID, continual item order and item order total items
+             * +param - mftItemIndex - index of first mft item of file
+             * +return true - chain is consistent, else false
+            */
+            bool checkMftItemChain(const int32_t mftItemIndex) const;
             /* get size of file in data clusters
              * can set index out of borders flag
              * +param - dataClusterStartIndex - index of first counted data cluster 
@@ -280,28 +1057,61 @@
              * +return size of used space in data clusters
             */
             int32_t getFileDataFragmentUsedSize(int32_t dataClusterStartIndex, int32_t dataClustersCount);
-            /* get size of directory in data clusters
+            /* check that data clusters of file are on disk, without reading them
+             * can set index out of borders flag
+             * +param - dataClusterStartIndex - index of first checked data cluster
+             * +param - dataClustersCount - count of checked data clusters
+             * +return 0, or -1 for clusters out of disk
+            */
+            int32_t getFileDataFragmentRange(int32_t dataClusterStartIndex, int32_t dataClustersCount);
+            /* compare data clusters with their checksums
+             * can set index out of borders flag
+             * +param - dataClusterStartIndex - index of first checked data cluster
+             * +param - dataClustersCount - count of checked data clusters
+             * +return 0, or -1 for clusters out of disk or not matching their checksums
+            */
+            int32_t getDataFragmentChecksums(int32_t dataClusterStartIndex, int32_t dataClustersCount);
+            /* check that all data clusters of file are on disk, they are compared with their checksums when checksums are checked
+             * +param - mftItemIndex - index of first mft item of file
+             * +return true - all clusters are on disk, else false
+            */
+            bool checkFragmentsRange(const int32_t mftItemIndex);
+            /* get size of directory entries in data clusters
              * can set index out of borders flag
              * +param - dataClusterStartIndex - index of first counted data cluster 
              * +param - dataClustersCount - count of counted data clusters
              * +return size of used space in data clusters
             */
             int32_t getDirectoryDataFragmentUsedSize(int32_t dataClusterStartIndex, int32_t dataClustersCount);
+            /* check that shared references of data clusters match mft items
+            */
+            void checkSharedReferences();
             /** DEFRAGMENTATION **/
+            /* count new fragments of mft items after defragmentation
+             * shared clusters are moved once, all mft items referencing them get their new index
+             * +param - indexTable - new indexes of data clusters
+             * +param - fragments - new fragments of every mft item
+             * +return true - fragments of every mft item fit to it, else false
+            */
+            bool defragmentPrepareFragments(const int32_t indexTable[], std::vector<std::list<struct mft_fragment>> * fragments);
             /* update mft table after defragmentation
+             * +param - fragments - new fragments of every mft item
+             * +param - indexTable - new indexes of data clusters
             */
-            void defragmentUpdateMftTable();
+            void defragmentUpdateMftTable(const std::vector<std::list<struct mft_fragment>> * fragments, const int32_t indexTable[]);
             /* count index table for defragmentation
              * +param - indexTable - index table
             */
             void prepareIndexTable(int32_t indextable[]);
             /* fill index table with values 
+             * shared cluster keeps index it got from first mft item
              * +param - indexTable - index table
              * +param - startIndex - start index in index table
              * +param - count - count of indexs filled into index table
              * +param - startWithIndex - start number (filled in index table)             
+             * +return next unused number
             */
-            void fillIndexTable(int32_t indexTable[] ,const int32_t startIndex, const int32_t count, const int32_t startWithIndex);
+            int32_t fillIndexTable(int32_t indexTable[] ,const int32_t startIndex, const int32_t count, const int32_t startWithIndex);
             /* defragment data cluster
              * +param - indextable - index table
              * +param - checkIndex - data cluster we check (move)
@@ -316,9 +1126,87 @@
 
         public:
 
-            PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const char * singnature);
+            /* format new volume
+             * +param - diskSize - size of volume in bytes
+             * +param - clusterSize - size of data cluster in bytes
+             * +param - signature - volume signature
+             * +param - volumePath - host file volume is stored in, or NULL for in-memory volume
+             * +param - cacheClusters - 0 - whole volume is held in memory, else data clusters are accessed through cache of this size
+             * +param - allocationPolicy - policy choosing free runs for data clusters (ALLOCATION_*), it is stored in boot record
+            */
+            PseudoNTFS(const int32_t diskSize, const int32_t clusterSize, const char * singnature, const char * volumePath = NULL, const int32_t cacheClusters = 0, const int32_t allocationPolicy = ALLOCATION_FIRST_FIT);
+            /* mount volume stored in host file, journal is replayed
+             * +param - volumePath - host file with volume
+             * +param - cacheClusters - 0 - whole volume is held in memory, else data clusters are accessed through cache of this size
+            */
+            PseudoNTFS(const char * volumePath, const int32_t cacheClusters = 0);
+            /* mount snapshot of volume read-only, it shares data clusters with volume
+             * +param - volume - volume with snapshot, it is not changed while snapshot is mounted
+             * +param - snapshotId - id of snapshot
+            */
+            PseudoNTFS(PseudoNTFS * volume, const int32_t snapshotId);
             ~PseudoNTFS();
 
+            /* get journal of volume
+             * +return journal
+            */
+            Journal * getJournal() {return journal;};
+            /* print hit rate and eviction metrics of data cluster cache
+            */
+            void printCacheStatistics();
+            /* +param - compression - true - new files are saved compressed, else uncompressed
+            */
+            void setCompression(const bool compression) {this->compression = compression;};
+            const bool getCompression() {return compression;};
+            /* +param - residentData - true - files up to MFT_RESIDENT_SIZE are saved in their mft items, else in data clusters
+            */
+            void setResidentData(const bool residentData) {this->residentData = residentData;};
+            /* +param - verifyChecksums - true - data clusters are compared with their checksums when they are read
+            */
+            void setVerifyChecksums(const bool verifyChecksums) {this->verifyChecksums = verifyChecksums;};
+            const bool getVerifyChecksums() {return verifyChecksums;};
+            /* +param - delayedAllocation - true - data of new files are held in memory and allocated together, else they are allocated at once
+             * +param - budget - maximal size of data held in memory in bytes, bigger files are allocated at once
+            */
+            void setDelayedAllocation(const bool delayedAllocation, const int32_t budget);
+            const bool getDelayedAllocation() {return delayedAllocation;};
+            /* allocate and write data of all files held in memory by delayed allocation
+             * +return true - all files were written, else false
+            */
+            bool sync();
+            /* print count of files held in memory and count of files per extent written by flushes
+            */
+            void printDelayedStatistics();
+            /* print free clusters, histogram of free extent sizes, the largest free extent, extents per file and fill of mft
+            */
+            void printSpaceStatistics();
+            /* +param - allocationPolicy - policy choosing free runs for data clusters (ALLOCATION_*), it is stored in boot record
+             * +return true - policy was set, false - unknown policy
+            */
+            bool setAllocationPolicy(const int32_t allocationPolicy);
+            int32_t getAllocationPolicy() const {return bootRecord->allocation_policy;};
+            int32_t getAllocationGroupsCount() {spaceIndex.wait(); return allocationGroups.getCount();};
+            int32_t getAllocationGroupClusters() {spaceIndex.wait(); return allocationGroups.getGroupClusters();};
+            int32_t getClusterSize() const {return bootRecord->cluster_size;};
+            /* +param - deduplication - true - file data clusters with already stored content are shared, else they are always written
+            */
+            void setDeduplication(const bool deduplication);
+            const bool getDeduplication() {return deduplication;};
+            /* print deduplication ratio and time spent in deduplication index
+            */
+            void printDeduplicationStatistics();
+            /* get count of data clusters used by file
+             * +param - mftItemIndex - index of mft item of file
+             * +return count of data clusters
+            */
+            int32_t getUsedClusters(const int32_t mftItemIndex);
+            /* get map of file data clusters from all its mft items
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - extentMap - map of file data clusters
+             * +return true - map was loaded, false - invalid index or resident file
+            */
+            bool loadExtentMap(const int32_t mftItemIndex, ExtentMap * extentMap);
+
             /* save file to ntfs
              * can set index out of borders flag
              * +param - fileName - name of file
@@ -332,6 +1220,45 @@
              * +param - string for file loading 
             */
             bool loadFileFromPseudoNtfs(int32_t mftItemIndex, std::string * content);
+            /* read part of file, data cluster of offset is found in extent map of file in O(log extents)
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - offset - position in file in bytes
+             * +param - buffer - buffer for read data
+             * +param - length - count of bytes to read
+             * +return count of read bytes, 0 at end of file, or NOT_FOUND for invalid file
+            */
+            int32_t readFileData(const int32_t mftItemIndex, const int32_t offset, char * buffer, const int32_t length);
+            /* write data to file at given position, file grows when data end behind its end, gap is left as hole
+             * data clusters are written in place, shared ones are copied first, compressed and resident file is saved again
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - offset - position in file in bytes
+             * +param - buffer - data to write
+             * +param - length - count of bytes to write
+             * +return true - written, false - invalid file or not enough free space
+            */
+            bool writeFileData(const int32_t mftItemIndex, const int32_t offset, const char * buffer, const int32_t length);
+            /* append data to end of file
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - buffer - data to append
+             * +param - length - count of bytes to append
+             * +return true - appended, false - invalid file or not enough free space
+            */
+            bool appendFileData(const int32_t mftItemIndex, const char * buffer, const int32_t length);
+            /* change size of file, data clusters behind new end are released, growing file gets hole
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - size - new size of file in bytes
+             * +return true - size was changed, false - invalid file or not enough free space
+            */
+            bool truncateFile(const int32_t mftItemIndex, const int32_t size);
+            /* reserve data clusters of file up to given size in one run, reserved clusters are not written
+             * they are unwritten until data are written to them, they are read as zeros without reading data cluster
+             * holes of file stay holes, resident and delayed file is moved to data clusters first
+             * +param - mftItemIndex - index of first mft item of file
+             * +param - size - size of file in bytes covered by data clusters
+             * +param - flags - PREALLOCATE_KEEP_SIZE keeps size of file, else file grows to given size
+             * +return true - clusters are reserved, false - invalid or compressed file or there is no free run of demanded clusters
+            */
+            bool preallocate(const int32_t mftItemIndex, const int32_t size, const int32_t flags);
 
             /* clear error state
             */
@@ -361,6 +1288,51 @@
              * +param - content - list for content saving
             */
             bool getDirectoryContent(const int32_t directoryMftItemIndex, std::list<mft_item> * content);
+            /* find files and directories of subtree with names matching pattern, subtree is walked in parallel
+             * can set index out of borders flag
+             * +param - directoryMftItemIndex - index of mft item of starting directory
+             * +param - pattern - shell pattern of name, * ? and [] can be used
+             * +param - paths - sorted paths from starting directory, path of directory ends with separator
+             * +return true - walked
+            */
+            bool findItems(const int32_t directoryMftItemIndex, const char * pattern, std::vector<std::string> * paths);
+            /* count size of files and allocated clusters of subtree, subtree is walked in parallel
+             * can set index out of borders flag
+             * +param - directoryMftItemIndex - index of mft item of starting directory
+             * +param - usage - totals of subtree
+             * +return true - walked
+            */
+            bool diskUsage(const int32_t directoryMftItemIndex, struct tree_usage * usage);
+            /* print subtree with entries of every directory sorted by name, subtree is walked in parallel
+             * can set index out of borders flag
+             * +param - directoryMftItemIndex - index of mft item of starting directory
+             * +return true - walked
+            */
+            bool printTree(const int32_t directoryMftItemIndex);
+            /* find files and directories of whole volume with names matching pattern
+             * names are searched in name index, all mft items are compared without it
+             * +param - pattern - text contained in name, or shell pattern of name with * ? or []
+             * +param - indexes - indexes of found first mft items in ascending order
+             * +return count of found items
+            */
+            int32_t locateItems(const char * pattern, std::vector<int32_t> * indexes);
+            /* +param - mftItemIndex - index of mft item
+             * +return name of file or directory, it is valid until item is changed
+            */
+            const char * getItemName(const int32_t mftItemIndex) const {return mftItemStart[mftItemIndex].item_name;};
+            bool isItemDirectory(const int32_t mftItemIndex) const {return mftItemStart[mftItemIndex].isDirectory;};
+            /* +param - enabled - true - names are indexed and index is saved in volume, else index and its system file are dropped
+             * +return true - index was enabled or disabled
+            */
+            bool setNameIndex(const bool enabled);
+            /* save name index changed since the last save, index is saved by unmount too
+             * +return true - saved index is valid
+            */
+            bool flushNameIndex();
+            bool hasNameIndex() const {return bootRecord->name_index_item >= 0;};
+            /* print count of indexed names, grams and size of saved index
+            */
+            void printNameIndexStatistics();
 
             /* make directory
              * can set index out of borders flag
@@ -393,12 +1365,90 @@
              * +param - toMftItemIndex - index of destination mft item
             */
             bool copy(const int32_t fileMftItemIndex, int32_t toMftItemIndex);
+            /* copy directory with its whole subtree, file is copied as by copy
+             * directories are created in one transaction, files are copied by pool of threads, each in its own transaction
+             * copy is not started without free mft item for every copied item, copy which fails later is removed
+             * can set index out of borders flag
+             * +param - mftItemIndex - index of mft item of copied directory
+             * +param - toMftItemIndex - index of destination directory mft item
+             * +return true - all was copied
+            */
+            bool copyTree(const int32_t mftItemIndex, const int32_t toMftItemIndex);
+            /* remove directory with its whole subtree, file is removed as by removeFile
+             * subtree is walked by pool of threads and removed from leaves in parts which fit journal
+             * subtree left by crash is whole, entries of removed items are only removed when part is committed before their directory
+             * can set index out of borders flag
+             * +param - mftItemIndex - index of mft item for removal
+             * +param - parentDirectoryMftItemIndex - index of mft item of directory where removed item is
+             * +return true - removed
+            */
+            bool removeTree(const int32_t mftItemIndex, const int32_t parentDirectoryMftItemIndex);
             /*********************/
             /* ADVANCE FUNCTIONS */
             /*********************/
-            bool checkDiskConsistency();
+            /* check mft items, directories and data of files, size of file has to match its data
+             * +param - countBytes - true - non-zero bytes of files are counted, false - only count of clusters of files is compared with their size
+             * +param - verifyClusters - true - every used data cluster of files and directories is compared with its checksum too
+             * +return true - disk is consistent, else false
+            */
+            bool checkDiskConsistency(const bool countBytes = true, const bool verifyClusters = false);
+            /* block until all indexes of mounted volume are built
+            */
+            void waitIndexes();
+            /* print build time of indexes of mounted volume
+            */
+            void printIndexStatistics();
+            /* compare every used data cluster with its checksum, clusters are read in parallel
+             * +param - corrupted - indexes of data clusters not matching their checksums in ascending order
+             * +return true - all data clusters match, else false
+            */
+            bool scrub(std::vector<int32_t> * corrupted);
             void defragmentDisk();
             /*********************/
+            /* SNAPSHOTS */
+            /* create read-only snapshot of volume, later changes of its mft items and data clusters are copy on write
+             * +return id of snapshot
+            */
+            int32_t createSnapshot();
+            /* delete snapshot, data clusters held for it are released lazily
+             * +param - id - id of snapshot
+             * +return true - snapshot was deleted, false - snapshot does not exist
+            */
+            bool deleteSnapshot(const int32_t id);
+            bool hasSnapshot(const int32_t id);
+            /* print snapshots with their copied mft items and clusters held for them
+            */
+            void printSnapshots();
+            /* +return true - volume is mounted snapshot
+            */
+            bool isSnapshot() const {return snapshotOrigin != NULL;};
+            int64_t getSnapshotCopiedClusters() const {return snapshotCopiedClusters;};
+            int64_t getSnapshotCopiedItems() const {return snapshotCopiedItems;};
+            int32_t getHeldClusters() const {spaceIndex.wait(); return heldClusters.size();};
+            int64_t getCommittedBytes() const {return committedBytes;};
+            /*********************/
+            /* VOLUME IMAGE */
+            /* write image of volume - boot record, used mft items and allocated data clusters with their checksums
+             * incremental image has only mft items and data clusters changed after its base, it closes current generation
+             * +param - imagePath - path of image in host file system
+             * +param - baseGeneration - generation of base image, NOT_FOUND for full image
+             * +return generation of image, NOT_FOUND if image was not written
+            */
+            int32_t exportImage(const char * imagePath, const int32_t baseGeneration);
+            /* restore full image to newly formatted volume of the same geometry, or apply incremental image
+             * to volume restored from its base and not changed since, checksums of data clusters are verified
+             * +param - imagePath - path of image in host file system
+             * +return true - image was restored
+            */
+            bool importImage(const char * imagePath);
+            int32_t getChangeGeneration() const {return changeGeneration;};
+            /* read boot record of volume in image, volume for import is formatted by it
+             * +param - imagePath - path of image in host file system
+             * +param - br - boot record of volume
+             * +return false - image does not exist or it is not image of this version
+            */
+            static bool readImageBootRecord(const char * imagePath, struct boot_record * br);
+            /*********************/
             /*** TEST FUNCTION ***/
             void printDisk();
             void printMftItemInfo(const mft_item * mftItem);
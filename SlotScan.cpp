@@ -0,0 +1,308 @@
+#include <atomic>
+#include <cstring>
+
+#include "SlotScan.hpp"
+#include "Utils.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SLOT_SCAN_X86
+#include <immintrin.h>
+#endif
+
+struct slot_kernels {
+    int32_t (* find)(const int32_t * slots, const int32_t count, const int32_t value);
+    int32_t (* count)(const int32_t * slots, const int32_t count, const int32_t value);
+    int32_t (* collect)(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity);
+    int64_t (* nonZero)(const unsigned char * data, const int64_t length);
+};
+
+/* SCALAR */
+
+static int32_t findScalar(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    for (int32_t i = 0; i < count; i++) {
+        if (slots[i] == value) {
+            return i;
+        }
+    }
+
+    return NOT_FOUND;
+}
+
+static int32_t countScalar(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    int32_t found = 0;
+    for (int32_t i = 0; i < count; i++) {
+        found += slots[i] == value;
+    }
+
+    return found;
+}
+
+static int32_t collectScalar(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity) {
+
+    int32_t found = 0;
+    for (int32_t i = 0; i < count && found < capacity; i++) {
+        if (slots[i] == value) {
+            indexes[found++] = i;
+        }
+    }
+
+    return found;
+}
+
+static int64_t nonZeroScalar(const unsigned char * data, const int64_t length) {
+
+    const uint64_t low = 0x7f7f7f7f7f7f7f7full;
+    const uint64_t ones = 0x0101010101010101ull;
+
+    // high bit of every non-zero byte of word is set, multiplication sums the bits to the top byte
+    int64_t count = 0;
+    int64_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        uint64_t nonZero = (((word & low) + low) | word) & ~low;
+        count += ((nonZero >> 7) * ones) >> 56;
+    }
+
+    for (; i < length; i++) {
+        count += data[i] != 0;
+    }
+
+    return count;
+}
+
+#ifdef SLOT_SCAN_X86
+
+/* SSE4.1 - 4 slots at once, bit of mask for every matching slot */
+
+__attribute__((target("sse4.1,popcnt")))
+static int32_t findSse41(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    __m128i needle = _mm_set1_epi32(value);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i data = _mm_loadu_si128((const __m128i *) (slots + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(data, needle)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    int32_t tail = findScalar(slots + i, count - i, value);
+    return tail == NOT_FOUND ? NOT_FOUND : i + tail;
+}
+
+__attribute__((target("sse4.1,popcnt")))
+static int32_t countSse41(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    // matching lanes are -1, subtracting them counts matches per lane
+    __m128i needle = _mm_set1_epi32(value);
+    __m128i counts = _mm_setzero_si128();
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i data = _mm_loadu_si128((const __m128i *) (slots + i));
+        counts = _mm_sub_epi32(counts, _mm_cmpeq_epi32(data, needle));
+    }
+
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1, 0, 3, 2)));
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(counts) + countScalar(slots + i, count - i, value);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+static int32_t collectSse41(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity) {
+
+    __m128i needle = _mm_set1_epi32(value);
+    int32_t found = 0;
+    int32_t i = 0;
+    for (; i + 4 <= count && found < capacity; i += 4) {
+        __m128i data = _mm_loadu_si128((const __m128i *) (slots + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(data, needle)));
+        while (mask != 0 && found < capacity) {
+            indexes[found++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    int32_t tail = collectScalar(slots + i, count - i, value, indexes + found, capacity - found);
+    for (int32_t j = found; j < found + tail; j++) {
+        indexes[j] += i;
+    }
+
+    return found + tail;
+}
+
+__attribute__((target("sse4.1,popcnt")))
+static int64_t nonZeroSse41(const unsigned char * data, const int64_t length) {
+
+    // bit of mask is set for every zero byte
+    __m128i zero = _mm_setzero_si128();
+    int64_t zeros = 0;
+    int64_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        zeros += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)));
+    }
+
+    return i - zeros + nonZeroScalar(data + i, length - i);
+}
+
+/* AVX2 - 8 slots at once */
+
+__attribute__((target("avx2,popcnt")))
+static int32_t findAvx2(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    __m256i needle = _mm256_set1_epi32(value);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i data = _mm256_loadu_si256((const __m256i *) (slots + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(data, needle)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    int32_t tail = findScalar(slots + i, count - i, value);
+    return tail == NOT_FOUND ? NOT_FOUND : i + tail;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int32_t countAvx2(const int32_t * slots, const int32_t count, const int32_t value) {
+
+    __m256i needle = _mm256_set1_epi32(value);
+    __m256i counts = _mm256_setzero_si256();
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i data = _mm256_loadu_si256((const __m256i *) (slots + i));
+        counts = _mm256_sub_epi32(counts, _mm256_cmpeq_epi32(data, needle));
+    }
+
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(half) + countScalar(slots + i, count - i, value);
+}
+
+__attribute__((target("avx2,popcnt")))
+static int32_t collectAvx2(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity) {
+
+    __m256i needle = _mm256_set1_epi32(value);
+    int32_t found = 0;
+    int32_t i = 0;
+    for (; i + 8 <= count && found < capacity; i += 8) {
+        __m256i data = _mm256_loadu_si256((const __m256i *) (slots + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(data, needle)));
+        while (mask != 0 && found < capacity) {
+            indexes[found++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    int32_t tail = collectScalar(slots + i, count - i, value, indexes + found, capacity - found);
+    for (int32_t j = found; j < found + tail; j++) {
+        indexes[j] += i;
+    }
+
+    return found + tail;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int64_t nonZeroAvx2(const unsigned char * data, const int64_t length) {
+
+    __m256i zero = _mm256_setzero_si256();
+    int64_t zeros = 0;
+    int64_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+        zeros += __builtin_popcount((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero)));
+    }
+
+    return i - zeros + nonZeroScalar(data + i, length - i);
+}
+
+#endif
+
+static const struct slot_kernels KERNELS[] = {
+    {findScalar, countScalar, collectScalar, nonZeroScalar},
+#ifdef SLOT_SCAN_X86
+    {findSse41, countSse41, collectSse41, nonZeroSse41},
+    {findAvx2, countAvx2, collectAvx2, nonZeroAvx2}
+#endif
+};
+
+bool slotKernelSupported(const enum slot_kernel kernel) {
+
+#ifdef SLOT_SCAN_X86
+    __builtin_cpu_init();
+    switch (kernel) {
+        case SLOT_KERNEL_SCALAR: return true;
+        case SLOT_KERNEL_SSE41: return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+        case SLOT_KERNEL_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    }
+    return false;
+#else
+    return kernel == SLOT_KERNEL_SCALAR;
+#endif
+}
+
+/* +return the best instruction set supported by cpu
+*/
+static enum slot_kernel detectSlotKernel() {
+
+    if (slotKernelSupported(SLOT_KERNEL_AVX2)) {
+        return SLOT_KERNEL_AVX2;
+    }
+    if (slotKernelSupported(SLOT_KERNEL_SSE41)) {
+        return SLOT_KERNEL_SSE41;
+    }
+
+    return SLOT_KERNEL_SCALAR;
+}
+
+// kernel is switched by command while scans run on workers of parallel walk
+static std::atomic<enum slot_kernel> activeKernel(detectSlotKernel());
+
+bool setSlotKernel(const enum slot_kernel kernel) {
+
+    if (!slotKernelSupported(kernel)) {
+        return false;
+    }
+
+    activeKernel.store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+enum slot_kernel getSlotKernel() {
+    return activeKernel.load(std::memory_order_relaxed);
+}
+
+const char * slotKernelName(const enum slot_kernel kernel) {
+
+    switch (kernel) {
+        case SLOT_KERNEL_SCALAR: return "scalar";
+        case SLOT_KERNEL_SSE41: return "SSE4.1";
+        case SLOT_KERNEL_AVX2: return "AVX2";
+    }
+
+    return "unknown";
+}
+
+int32_t findSlot(const int32_t * slots, const int32_t count, const int32_t value) {
+    return count <= 0 ? NOT_FOUND : KERNELS[activeKernel.load(std::memory_order_relaxed)].find(slots, count, value);
+}
+
+int32_t countSlots(const int32_t * slots, const int32_t count, const int32_t value) {
+    return count <= 0 ? 0 : KERNELS[activeKernel.load(std::memory_order_relaxed)].count(slots, count, value);
+}
+
+int32_t collectSlots(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity) {
+    return count <= 0 || capacity <= 0 ? 0 : KERNELS[activeKernel.load(std::memory_order_relaxed)].collect(slots, count, value, indexes, capacity);
+}
+
+int64_t countNonZero(const unsigned char * data, const int64_t length) {
+    return length <= 0 ? 0 : KERNELS[activeKernel.load(std::memory_order_relaxed)].nonZero(data, length);
+}
\ No newline at end of file
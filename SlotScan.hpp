@@ -0,0 +1,54 @@
+#ifndef _SLOT_SCAN_HPP_
+#define _SLOT_SCAN_HPP_
+
+#include <cstdint>
+
+    // instruction sets of slot and byte kernels, the best one supported by cpu is chosen at start
+    enum slot_kernel {
+        SLOT_KERNEL_SCALAR = 0,
+        SLOT_KERNEL_SSE41 = 1,
+        SLOT_KERNEL_AVX2 = 2
+    };
+
+    /* find first slot with given value
+     * +param - slots - array of slots
+     * +param - count - count of slots
+     * +param - value - searched value
+     * +return index of slot, or NOT_FOUND
+    */
+    int32_t findSlot(const int32_t * slots, const int32_t count, const int32_t value);
+    /* +param - slots - array of slots
+     * +param - count - count of slots
+     * +param - value - counted value
+     * +return count of slots with given value
+    */
+    int32_t countSlots(const int32_t * slots, const int32_t count, const int32_t value);
+    /* compact indexes of slots with given value to start of array
+     * +param - slots - array of slots
+     * +param - count - count of slots
+     * +param - value - searched value
+     * +param - indexes - array for indexes of found slots
+     * +param - capacity - size of indexes array, search stops when it is full
+     * +return count of found slots
+    */
+    int32_t collectSlots(const int32_t * slots, const int32_t count, const int32_t value, int32_t * indexes, const int32_t capacity);
+
+    /* +param - data - data
+     * +param - length - length of data
+     * +return count of non-zero bytes
+    */
+    int64_t countNonZero(const unsigned char * data, const int64_t length);
+
+    /* +param - kernel - instruction set
+     * +return true if cpu supports it
+    */
+    bool slotKernelSupported(const enum slot_kernel kernel);
+    /* use kernels of given instruction set
+     * +param - kernel - instruction set
+     * +return false if cpu does not support it
+    */
+    bool setSlotKernel(const enum slot_kernel kernel);
+    enum slot_kernel getSlotKernel();
+    const char * slotKernelName(const enum slot_kernel kernel);
+
+#endif
\ No newline at end of file
@@ -1,27 +1,113 @@
 #include "Utils.hpp"
 
+#include <algorithm>
+#include <fcntl.h>
 #include <fstream>
 #include <sstream>
+#include <unistd.h>
 
 /*
-Load content of file to string - with EOF 
+Load content of file to string - all bytes, zeros of binary file too
 */
 bool readFile(const char * filePath, std::string * str) {
 
-    std::ifstream file(filePath);
+    std::ifstream file(filePath, std::ios::binary);
 
     if (!file) {
         return false;
     }
 
     std::ostringstream oss;
-    char c;
-    while ((c = file.get()) != EOF {
-        oss << c;
-    }
+    oss << file.rdbuf();
     file.close();
 
     *str = oss.str();
 
     return true;
+}
+
+/*
+Checksum of data - FNV-1a
+*/
+uint32_t checksum(const unsigned char * data, const int64_t length) {
+
+    uint32_t hash = 2166136261u;
+    for (int64_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+Write all bytes to file at given offset
+*/
+bool writeFileAt(const int file, const int64_t offset, const unsigned char * data, const int64_t length) {
+
+    int64_t written = 0;
+    while (written < length) {
+        ssize_t count = pwrite(file, data + written, length - written, offset + written);
+        if (count <= 0) {
+            return false;
+        }
+        written += count;
+    }
+
+    return true;
+}
+
+/*
+Read all bytes from file at given offset
+*/
+bool readFileAt(const int file, const int64_t offset, unsigned char * data, const int64_t length) {
+
+    int64_t read = 0;
+    while (read < length) {
+        ssize_t count = pread(file, data + read, length - read, offset + read);
+        if (count <= 0) {
+            return false;
+        }
+        read += count;
+    }
+
+    return true;
+}
+
+/*
+Check that all bytes are zeros
+*/
+bool isZero(const unsigned char * data, const int64_t length) {
+
+    for (int64_t i = 0; i < length; i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+Write content to file, blocks of zeros are skipped - file system of host keeps them as holes
+*/
+bool writeSparseFile(const char * filePath, const std::string & content, const int64_t blockSize) {
+
+    int file = open(filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        return false;
+    }
+
+    // size is set first, skipped blocks read as zeros
+    bool written = ftruncate(file, content.length()) == 0;
+    for (int64_t offset = 0; written && offset < (int64_t) content.length(); offset += blockSize) {
+        int64_t length = std::min(blockSize, (int64_t) content.length() - offset);
+        const unsigned char * block = (const unsigned char *) content.data() + offset;
+        if (!isZero(block, length)) {
+            written = writeFileAt(file, offset, block, length);
+        }
+    }
+
+    close(file);
+    return written;
 }
\ No newline at end of file
@@ -2,9 +2,18 @@
 #define _UTILS_HPP_
 
 #include <string>
+#include <cstdint>
 
 const int32_t NOT_FOUND = -1;
 
 bool readFile(const char * filePath, std::string * str);
 
+uint32_t checksum(const unsigned char * data, const int64_t length);
+
+bool writeFileAt(const int file, const int64_t offset, const unsigned char * data, const int64_t length);
+bool readFileAt(const int file, const int64_t offset, unsigned char * data, const int64_t length);
+
+bool isZero(const unsigned char * data, const int64_t length);
+bool writeSparseFile(const char * filePath, const std::string & content, const int64_t blockSize);
+
 #endif
\ No newline at end of file